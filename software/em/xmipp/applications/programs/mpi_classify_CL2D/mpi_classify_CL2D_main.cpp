@@ -150,6 +150,7 @@ void CL2DClass::transferUpdate(bool centerReference)
         if (XSIZE(rotationalCorr) != finalSize)
             rotationalCorr.resize(finalSize);
         rotAux.local_transformer.setReal(rotationalCorr);
+        batchRotation.setReference(polarFourierP);
 
         // Take the list of images
         currentListImg = nextListImg;
@@ -215,7 +216,8 @@ void CL2DClass::fitBasic(MultidimArray<double> &I, CL2DAssignment &result,
     ARS.initIdentity(3);
     ASR = ARS;
     MultidimArray<double> IauxSR = I, IauxRS = I;
-    Polar<std::complex<double> > polarFourierI;
+    Polar<std::complex<double> > polarFourierSR, polarFourierRS;
+    std::vector<double> bestRot;
 #ifdef DEBUG_MORE
     Image<double> save2;
     save2()=P;
@@ -226,10 +228,13 @@ void CL2DClass::fitBasic(MultidimArray<double> &I, CL2DAssignment &result,
     if (prm->alignImages)
     {
 		for (int i = 0; i < 3; i++) {
-			double shiftX, shiftY, bestRot;
+			double shiftX, shiftY;
 
 			// Shift then rotate
-			bestShift(P, IauxSR, shiftX, shiftY, corrAux);
+			if (prm->singlePrecision)
+				bestShift(P, IauxSR, shiftX, shiftY, corrAuxFloat);
+			else
+				bestShift(P, IauxSR, shiftX, shiftY, corrAux);
 			MAT_ELEM(ASR,0,2) += shiftX;
 			MAT_ELEM(ASR,1,2) += shiftY;
 			applyGeometry(LINEAR, IauxSR, I, ASR, IS_NOT_INV, WRAP);
@@ -239,11 +244,17 @@ void CL2DClass::fitBasic(MultidimArray<double> &I, CL2DAssignment &result,
 			std::cout << "ASR\n" << ASR << std::endl;
 	#endif
 
-			normalizedPolarFourierTransform(IauxSR, polarFourierI, true,
+			// The rotations of both alignments are computed together
+			normalizedPolarFourierTransform(IauxSR, polarFourierSR, true,
 											XSIZE(P) / 5, XSIZE(P) / 2-2, plans, 1);
+			normalizedPolarFourierTransform(IauxRS, polarFourierRS, true,
+											XSIZE(P) / 5, XSIZE(P) / 2-2, plans, 1);
+			batchRotation.clearImages();
+			batchRotation.addImage(polarFourierSR);
+			batchRotation.addImage(polarFourierRS);
+			batchRotation.bestRotations(bestRot, rotAux);
 
-			bestRot = best_rotation(polarFourierP, polarFourierI, rotAux);
-			rotation2DMatrix(bestRot, R);
+			rotation2DMatrix(bestRot[0], R);
 			SPEED_UP_tempsDouble;
 			M3x3_BY_M3x3(ASR,R,ASR);
 			applyGeometry(LINEAR, IauxSR, I, ASR, IS_NOT_INV, WRAP);
@@ -254,10 +265,7 @@ void CL2DClass::fitBasic(MultidimArray<double> &I, CL2DAssignment &result,
 	#endif
 
 			// Rotate then shift
-			normalizedPolarFourierTransform(IauxRS, polarFourierI, true,
-											XSIZE(P) / 5, XSIZE(P) / 2-2, plans, 1);
-			bestRot = best_rotation(polarFourierP, polarFourierI, rotAux);
-			rotation2DMatrix(bestRot, R);
+			rotation2DMatrix(bestRot[1], R);
 			M3x3_BY_M3x3(ARS,R,ARS);
 			applyGeometry(LINEAR, IauxRS, I, ARS, IS_NOT_INV, WRAP);
 	#ifdef DEBUG_MORE
@@ -266,7 +274,10 @@ void CL2DClass::fitBasic(MultidimArray<double> &I, CL2DAssignment &result,
 			std::cout << "ARS\n" << ARS << std::endl;
 	#endif
 
-			bestShift(P, IauxRS, shiftX, shiftY, corrAux);
+			if (prm->singlePrecision)
+				bestShift(P, IauxRS, shiftX, shiftY, corrAuxFloat);
+			else
+				bestShift(P, IauxRS, shiftX, shiftY, corrAux);
 			MAT_ELEM(ARS,0,2) += shiftX;
 			MAT_ELEM(ARS,1,2) += shiftY;
 			applyGeometry(LINEAR, IauxRS, I, ARS, IS_NOT_INV, WRAP);
@@ -1616,6 +1627,7 @@ void ProgClassifyCL2D::readParams()
 	if (useThresholdMask)
 		threshold=getDoubleParam("--useThresholdMask");
 	alignImages = !checkParam("--dontAlign");
+	singlePrecision = checkParam("--singlePrecision");
 }
 
 void ProgClassifyCL2D::show() const {
@@ -1638,6 +1650,7 @@ void ProgClassifyCL2D::show() const {
 			<< "Normalize images:        " << normalizeImages << std::endl
 			<< "Mirror images:           " << mirrorImages << std::endl
 			<< "Align images:            " << alignImages << std::endl
+			<< "Single precision shifts: " << singlePrecision << std::endl
 	;
 	if (useThresholdMask)
 		std::cout << "Threshold mask:          " << threshold << std::endl;
@@ -1682,6 +1695,9 @@ void ProgClassifyCL2D::defineParams()
 	addParamsLine("   [--dontMirrorImages]      : By default, input images are studied unmirrored and mirrored");
 	addParamsLine("   [--useThresholdMask <t>]  : Use a mask to compare images. Remove pixels whose value is smaller or equal t");
 	addParamsLine("   [--dontAlign]             : Do not align images");
+	addParamsLine("   [--singlePrecision]       : Search the shifts with single precision Fourier transforms.");
+	addParamsLine("                             : It halves the memory traffic of the shift search, the shifts");
+	addParamsLine("                             : may differ from the double precision ones by rounding");
     addExampleLine("mpirun -np 3 `which xmipp_mpi_classify_CL2D` -i images.stk --nref 256 --oroot class --odir CL2Dresults --iter 10");
 }
 
@@ -0,0 +1,60 @@
+#include <data/metadata.h>
+#include <stdlib.h>
+#include <time.h>
+#include <iostream>
+
+// Time of reading a STAR metadata with the stream based reader and
+// with the tokenizer. The equality of both readers is checked by
+// test_metadata, this program only measures them.
+// Usage: xmipp_benchmark_metadata [rows=20000]
+int main(int argc, char **argv)
+{
+    size_t nRows = argc > 1 ? textToInteger(argv[1]) : 20000;
+
+    char sfn[32] = "";
+    strncpy(sfn, "/tmp/benchmarkReadStar_XXXXXX", sizeof sfn);
+    if (mkstemp(sfn)==-1)
+    {
+        std::cerr << "Cannot create temporary file" << std::endl;
+        return 1;
+    }
+    try
+    {
+        MetaData mdBig;
+        std::vector<double> v(3);
+        size_t id;
+        for (size_t i = 0; i < nRows; ++i)
+        {
+            id = mdBig.addObject();
+            mdBig.setValue(MDL_IMAGE, formatString("%06lu@images.stk", i + 1), id);
+            mdBig.setValue(MDL_ANGLE_ROT, 0.5 * i, id);
+            mdBig.setValue(MDL_ANGLE_TILT, 0.25 * i, id);
+            mdBig.setValue(MDL_SHIFT_X, -1.5, id);
+            mdBig.setValue(MDL_REF, (int)(i % 7), id);
+            mdBig.setValue(MDL_ENABLED, 1, id);
+            mdBig.setValue(MDL_ORDER, i, id);
+            v[0] = i;
+            mdBig.setValue(MDL_CLASSIFICATION_DATA, v, id);
+        }
+        mdBig.write(sfn);
+
+        MetaData mdStream, mdFast;
+        clock_t t0 = clock();
+        mdStream.setStreamStarReader();
+        mdStream.read(sfn);
+        clock_t t1 = clock();
+        mdFast.read(sfn);
+        clock_t t2 = clock();
+        std::cout << "Reading " << nRows << " rows, stream reader "
+        << (double)(t1 - t0) / CLOCKS_PER_SEC << "s, tokenizer "
+        << (double)(t2 - t1) / CLOCKS_PER_SEC << "s" << std::endl;
+    }
+    catch (XmippError &xe)
+    {
+        std::cerr << xe;
+        unlink(sfn);
+        return 1;
+    }
+    unlink(sfn);
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include <data/xmipp_image.h>
+#include <data/filters.h>
+#include <data/xmipp_fftw.h>
+#include <data/polar.h>
+#include <sys/time.h>
+#include <iostream>
+
+static double elapsedTime(const struct timeval &start_time)
+{
+    struct timeval end_time;
+    gettimeofday(&end_time, NULL);
+    return (end_time.tv_sec - start_time.tv_sec) + (end_time.tv_usec - start_time.tv_usec) / 1e6;
+}
+
+// Time of the rotational alignment of a reference with many images, one
+// best_rotation per image and with BatchRotationalCorrelation in double and
+// single precision. The equality of the rotations is checked by test_polar,
+// this program only measures them.
+// Usage: xmipp_benchmark_polar [size=64] [images=64] [repetitions=20]
+int main(int argc, char **argv)
+{
+    int size = argc > 1 ? textToInteger(argv[1]) : 64;
+    int N = argc > 2 ? textToInteger(argv[2]) : 64;
+    int repetitions = argc > 3 ? textToInteger(argv[3]) : 20;
+    try
+    {
+        // Rotated copies of a random image
+        MultidimArray<double> I(size,size), Irot;
+        I.setXmippOrigin();
+        I.initRandom(0,1);
+        Polar_fftw_plans *plans = NULL;
+        Polar< std::complex<double> > polarRef;
+        std::vector< Polar< std::complex<double> > > polarI(N);
+        normalizedPolarFourierTransform(I, polarRef, false, XSIZE(I) / 5, XSIZE(I) / 2, plans);
+        for (int n = 0; n < N; n++)
+        {
+            rotate(BSPLINE3, Irot, I, n * 5.0, 'Z', WRAP);
+            normalizedPolarFourierTransform(Irot, polarI[n], true, XSIZE(I) / 5, XSIZE(I) / 2, plans);
+        }
+
+        RotationalCorrelationAux aux;
+        MultidimArray<double> rotationalCorr;
+        rotationalCorr.resize(2 * polarRef.getSampleNoOuterRing() - 1);
+        aux.local_transformer.setReal(rotationalCorr);
+
+        std::vector<double> rotations;
+        struct timeval start_time;
+        gettimeofday(&start_time, NULL);
+        for (int r = 0; r < repetitions; r++)
+            for (int n = 0; n < N; n++)
+                best_rotation(polarRef, polarI[n], aux);
+        double t = elapsedTime(start_time);
+
+        BatchRotationalCorrelation<double> batch;
+        BatchRotationalCorrelation<float> batchFloat;
+        batch.setReference(polarRef);
+        batchFloat.setReference(polarRef);
+        for (int n = 0; n < N; n++)
+        {
+            batch.addImage(polarI[n]);
+            batchFloat.addImage(polarI[n]);
+        }
+        gettimeofday(&start_time, NULL);
+        for (int r = 0; r < repetitions; r++)
+            batch.bestRotations(rotations, aux);
+        double tBatch = elapsedTime(start_time);
+        gettimeofday(&start_time, NULL);
+        for (int r = 0; r < repetitions; r++)
+            batchFloat.bestRotations(rotations, aux);
+        double tFloat = elapsedTime(start_time);
+        std::cout << "best_rotation: " << t << " secs. Batch: " << tBatch
+        << " secs. Batch in float: " << tFloat << " secs." << std::endl;
+        delete plans;
+    }
+    catch (XmippError &xe)
+    {
+        std::cerr << xe;
+        return 1;
+    }
+    return 0;
+}
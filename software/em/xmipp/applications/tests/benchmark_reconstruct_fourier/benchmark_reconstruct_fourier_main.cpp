@@ -0,0 +1,83 @@
+#include <data/xmipp_image.h>
+#include <data/projection.h>
+#include <data/metadata.h>
+#include <reconstruction/reconstruct_fourier.h>
+#include <sys/time.h>
+#include <iostream>
+
+// Time of reconstruct_fourier with 1 to 64 threads.
+// The correctness is checked by test_reconstruct_fourier, this program
+// only measures the speed-up.
+// Usage: xmipp_benchmark_reconstruct_fourier [size=64] [images=200] [extra args]
+int main(int argc, char **argv)
+{
+    int size = argc > 1 ? textToInteger(argv[1]) : 64;
+    int Nimages = argc > 2 ? textToInteger(argv[2]) : 200;
+    String extraArgs = argc > 3 ? argv[3] : "";
+
+    FileName fnRoot, fnStack, fnSel, fnVol;
+    try
+    {
+        // Projections of a synthetic phantom
+        MultidimArray<double> V(size, size, size);
+        V.setXmippOrigin();
+        FOR_ALL_ELEMENTS_IN_ARRAY3D(V)
+        {
+            double r1 = (k - 3) * (k - 3) + i * i + (j + 4) * (j + 4);
+            double r2 = (k + 5) * (k + 5) + (i - 6) * (i - 6) + j * j;
+            A3D_ELEM(V, k, i, j) = (r1 < 36 ? 1. : 0.) + (r2 < 16 ? 2. : 0.);
+        }
+
+        fnRoot.initUniqueName("/tmp/temp_recfourier_XXXXXX");
+        fnStack = fnRoot + ".stk";
+        fnSel = fnRoot + ".xmd";
+        fnVol = fnRoot + ".vol";
+        MetaData md;
+        Projection P;
+        FileName fnImg;
+        size_t id;
+        for (int n = 0; n < Nimages; ++n)
+        {
+            double rot = (n * 137) % 360, tilt = (n * 3) % 180, psi = (n * 53) % 360;
+            projectVolume(V, P, size, size, rot, tilt, psi);
+            P.write(fnStack, ALL_IMAGES, true, WRITE_APPEND);
+            fnImg.compose(n + 1, fnStack);
+            id = md.addObject();
+            md.setValue(MDL_IMAGE, fnImg, id);
+            md.setValue(MDL_ANGLE_ROT, rot, id);
+            md.setValue(MDL_ANGLE_TILT, tilt, id);
+            md.setValue(MDL_ANGLE_PSI, psi, id);
+        }
+        md.write(fnSel);
+
+        double t1 = 0;
+        for (int threads = 1; threads <= 64; threads *= 2)
+        {
+            struct timeval start_time, end_time;
+            ProgRecFourier prog;
+            prog.read(formatString("xmipp_reconstruct_fourier -i %s -o %s --thr %d -v 0 %s",
+                                   fnSel.c_str(), fnVol.c_str(), threads, extraArgs.c_str()));
+            gettimeofday(&start_time, NULL);
+            prog.run();
+            gettimeofday(&end_time, NULL);
+            double t = (end_time.tv_sec - start_time.tv_sec) + (end_time.tv_usec - start_time.tv_usec) / 1e6;
+            if (threads == 1)
+                t1 = t;
+            std::cout << threads << " threads: " << t << " secs. Speed-up: " << t1 / t << std::endl;
+        }
+    }
+    catch (XmippError &xe)
+    {
+        std::cerr << xe;
+        fnStack.deleteFile();
+        fnSel.deleteFile();
+        fnVol.deleteFile();
+        fnRoot.deleteFile();
+        return 1;
+    }
+    fnStack.deleteFile();
+    fnSel.deleteFile();
+    fnVol.deleteFile();
+    fnRoot.deleteFile();
+    return 0;
+}
@@ -5,6 +5,7 @@
 #include "data/transform_downsample.h"
 #include <gtest/gtest.h>
 #include "data/ctf.h"
+#include "reconstruction/ctf_correct_wiener2d.h"
 
 // MORE INFO HERE: http://code.google.com/p/googletest/wiki/AdvancedGuide
 // This test is named "Size", and belongs to the "MetadataTest"
@@ -143,6 +144,224 @@ TEST_F( CtfTest, errorMaxFreqCTFs2D)
     XMIPP_CATCH
 }
 
+TEST_F( CtfTest, getCTFGrid)
+{
+    XMIPP_TRY
+    CTFDescription ctf;
+    ctf.Tm = 1.5;
+    ctf.kV = 300;
+    ctf.DeltafU = 15000;
+    ctf.DeltafV = 12000;
+    ctf.azimuthal_angle = 30;
+    ctf.Cs = 2;
+    ctf.Q0 = 0.1;
+    ctf.alpha = 0.5;
+    ctf.enable_CTFnoise = false;
+    ctf.produceSideInfo();
+
+    // Same values as pixel by pixel
+    MultidimArray<double> grid;
+    ctf.getCTFGrid(64, 63, grid, true);
+    ASSERT_EQ(XSIZE(grid), (size_t)32);
+    FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY2D(grid)
+    {
+        double wx, wy;
+        FFT_IDX2DIGFREQ(i, 64, wy);
+        FFT_IDX2DIGFREQ(j, 63, wx);
+        ctf.precomputeValues(wx / ctf.Tm, wy / ctf.Tm);
+        EXPECT_NEAR(DIRECT_A2D_ELEM(grid, i, j), ctf.getValueAt(), 1e-10);
+    }
+
+    // The tables are reused with another defocus
+    ctf.DeltafU = 20000;
+    ctf.produceSideInfo();
+    ctf.getCTFGrid(64, 63, grid, true, false);
+    double wx, wy;
+    FFT_IDX2DIGFREQ(5, 63, wx);
+    FFT_IDX2DIGFREQ(60, 64, wy);
+    ctf.precomputeValues(wx / ctf.Tm, wy / ctf.Tm);
+    EXPECT_NEAR(DIRECT_A2D_ELEM(grid, 60, 5), ctf.getValuePureWithoutDampingAt(), 1e-10);
+    XMIPP_CATCH
+}
+
+// CTF of a Ydim x Xdim image evaluated pixel by pixel, as it was done before the grids
+void pixelByPixelCTF(CTFDescription &ctf, int Ydim, int Xdim, MultidimArray<double> &ctfIm)
+{
+    ctfIm.initZeros(Ydim, Xdim);
+    FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY2D(ctfIm)
+    {
+        double wx, wy;
+        FFT_IDX2DIGFREQ(i, Ydim, wy);
+        FFT_IDX2DIGFREQ(j, Xdim, wx);
+        ctf.precomputeValues(wx / ctf.Tm, wy / ctf.Tm);
+        DIRECT_A2D_ELEM(ctfIm, i, j) = ctf.getValueAt();
+    }
+}
+
+TEST_F( CtfTest, applyFiltersInFourier)
+{
+    XMIPP_TRY
+    CTFDescription ctf;
+    ctf.Tm = 1.5;
+    ctf.kV = 300;
+    ctf.DeltafU = 15000;
+    ctf.DeltafV = 12000;
+    ctf.azimuthal_angle = 30;
+    ctf.Cs = 2;
+    ctf.Q0 = 0.1;
+    ctf.enable_CTFnoise = false;
+    ctf.produceSideInfo();
+
+    // Even and odd images, the half transform has Xdim/2+1 columns
+    int Ydim = 64, Xdims[] = {64, 63};
+    for (int s = 0; s < 2; ++s)
+    {
+        int Xdim = Xdims[s];
+        MultidimArray<double> ctfIm;
+        pixelByPixelCTF(ctf, Ydim, Xdim, ctfIm);
+
+        MultidimArray< std::complex<double> > F(Ydim, Xdim / 2 + 1), Fflip, Fwiener, FwienerFlipped;
+        FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY2D(F)
+        DIRECT_A2D_ELEM(F, i, j) = std::complex<double>(i + 1., j - 3.);
+        Fflip = Fwiener = FwienerFlipped = F;
+        ctf.applyPhaseFlip(Fflip, Ydim, Xdim);
+        ctf.applyWienerFilter(Fwiener, Ydim, Xdim, -1);
+        ctf.applyWienerFilter(FwienerFlipped, Ydim, Xdim, 0.2, true);
+
+        // Default Wiener constant, 10% of the average of CTF^2 over the whole image
+        double wienerConstant = 0;
+        FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(ctfIm)
+        wienerConstant += DIRECT_MULTIDIM_ELEM(ctfIm, n) * DIRECT_MULTIDIM_ELEM(ctfIm, n);
+        wienerConstant *= 0.1 / MULTIDIM_SIZE(ctfIm);
+
+        FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY2D(F)
+        {
+            double c = DIRECT_A2D_ELEM(ctfIm, i, j);
+            std::complex<double> f = DIRECT_A2D_ELEM(F, i, j);
+            // The sign is not defined at the zeros of the CTF
+            if (fabs(c) > 1e-8)
+                EXPECT_NEAR(abs(DIRECT_A2D_ELEM(Fflip, i, j) - (c < 0 ? -f : f)), 0, 1e-8);
+            EXPECT_NEAR(abs(DIRECT_A2D_ELEM(Fwiener, i, j) - f * c / (c * c + wienerConstant)), 0, 1e-8);
+            EXPECT_NEAR(abs(DIRECT_A2D_ELEM(FwienerFlipped, i, j) - f * fabs(c) / (c * c + 0.2)), 0, 1e-8);
+        }
+    }
+    XMIPP_CATCH
+}
+
+TEST_F( CtfTest, correctWiener2D)
+{
+    XMIPP_TRY
+    ProgCorrectWiener2D prog;
+    prog.Ydim = prog.Xdim = 32;
+    prog.pad = 2;
+    prog.sampling_rate = 1.5;
+    prog.wiener_constant = -1;
+    prog.phase_flipped = false;
+    prog.correct_envelope = false;
+    prog.isIsotropic = false;
+
+    CTFDescription ctf;
+    ctf.kV = 300;
+    ctf.DeltafU = 15000;
+    ctf.DeltafV = 12000;
+    ctf.azimuthal_angle = 30;
+    ctf.Cs = 2;
+    ctf.Q0 = 0.1;
+
+    int paddim = 64;
+    MultidimArray< std::complex<double> > F(paddim, paddim / 2 + 1), Fastig, Fiso, Fexpected;
+    FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY2D(F)
+    DIRECT_A2D_ELEM(F, i, j) = std::complex<double>(i + 1., j - 3.);
+
+    // The filter has the size of the half transform of the padded image
+    CTFDescription ctfProg = ctf;
+    Fastig = F;
+    prog.applyWienerFilter(Fastig, ctfProg);
+    CTFDescription ctfExpected = ctf;
+    ctfExpected.Tm = prog.sampling_rate;
+    ctfExpected.enable_CTFnoise = false;
+    ctfExpected.produceSideInfo();
+    Fexpected = F;
+    ctfExpected.applyWienerFilter(Fexpected, paddim, paddim, -1, false, false);
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(F)
+    EXPECT_NEAR(abs(DIRECT_MULTIDIM_ELEM(Fastig, n) - DIRECT_MULTIDIM_ELEM(Fexpected, n)), 0, 1e-10);
+
+    // With --isIsotropic the filter is the one of the average defocus
+    prog.isIsotropic = true;
+    ctfProg = ctf;
+    Fiso = F;
+    prog.applyWienerFilter(Fiso, ctfProg);
+    ctfExpected.DeltafU = ctfExpected.DeltafV = 13500;
+    ctfExpected.produceSideInfo();
+    Fexpected = F;
+    ctfExpected.applyWienerFilter(Fexpected, paddim, paddim, -1, false, false);
+    double maxDiff = 0;
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(F)
+    {
+        EXPECT_NEAR(abs(DIRECT_MULTIDIM_ELEM(Fiso, n) - DIRECT_MULTIDIM_ELEM(Fexpected, n)), 0, 1e-10);
+        maxDiff = XMIPP_MAX(maxDiff, abs(DIRECT_MULTIDIM_ELEM(Fiso, n) - DIRECT_MULTIDIM_ELEM(Fastig, n)));
+    }
+    EXPECT_GT(maxDiff, 0.1);
+    XMIPP_CATCH
+}
+
+TEST_F( CtfTest, CTFImageCache)
+{
+    XMIPP_TRY
+    CTFDescription ctfA;
+    ctfA.Tm = 1.5;
+    ctfA.kV = 300;
+    ctfA.DeltafU = 15000;
+    ctfA.DeltafV = 12000;
+    ctfA.azimuthal_angle = 30;
+    ctfA.Cs = 2;
+    ctfA.Q0 = 0.1;
+    ctfA.enable_CTFnoise = false;
+    CTFDescription ctfB = ctfA;
+    ctfB.Ca = ctfA.Ca + 1;
+    CTFDescription ctfC = ctfA;
+    ctfC.envR1 = ctfA.envR1 + 0.1;
+
+    CTFImageCache cache(2, 10);
+    MultidimArray<double> *img;
+    ASSERT_FALSE(cache.getImage(ctfA, 32, 32, img));
+    img->resizeNoCopy(32, 32);
+    img->initConstant(1.);
+    ASSERT_FALSE(cache.getImage(ctfB, 32, 32, img));
+    img->resizeNoCopy(32, 32);
+    img->initConstant(2.);
+
+    // Same CTF within the defocus step
+    ctfA.DeltafU += 2;
+    ASSERT_TRUE(cache.getImage(ctfA, 32, 32, img));
+    EXPECT_EQ(A2D_ELEM(*img, 0, 0), 1.);
+    // Another size is another image
+    EXPECT_FALSE(cache.getImage(ctfA, 32, 30, img));
+    img->resizeNoCopy(32, 30);
+    img->initConstant(3.);
+
+    // The least recently used (B) has been replaced
+    EXPECT_TRUE(cache.getImage(ctfA, 32, 30, img));
+    EXPECT_EQ(A2D_ELEM(*img, 0, 0), 3.);
+    EXPECT_TRUE(cache.getImage(ctfA, 32, 32, img));
+    EXPECT_EQ(A2D_ELEM(*img, 0, 0), 1.);
+    EXPECT_FALSE(cache.getImage(ctfB, 32, 32, img));
+    img->resizeNoCopy(32, 32);
+    img->initConstant(2.);
+    // Now A 32x30 was the least recently used
+    EXPECT_TRUE(cache.getImage(ctfA, 32, 32, img));
+    EXPECT_FALSE(cache.getImage(ctfA, 32, 30, img));
+    // The envelope is part of the key
+    EXPECT_FALSE(cache.getImage(ctfC, 32, 32, img));
+    EXPECT_EQ(cache.hits, (size_t)4);
+    EXPECT_EQ(cache.misses, (size_t)6);
+
+    cache.clear();
+    EXPECT_FALSE(cache.getImage(ctfA, 32, 32, img));
+    EXPECT_EQ(cache.hits, (size_t)0);
+    XMIPP_CATCH
+}
+
 GTEST_API_ int main(int argc, char **argv)
 {
     testing::InitGoogleTest(&argc, argv);
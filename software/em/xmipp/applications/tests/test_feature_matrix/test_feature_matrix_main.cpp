@@ -0,0 +1,89 @@
+#include <classification/feature_matrix.h>
+#include <classification/vector_ops.h>
+#include <data/xmipp_error.h>
+#include <stdlib.h>
+#include <iostream>
+#include <gtest/gtest.h>
+// MORE INFO HERE: http://code.google.com/p/googletest/wiki/AdvancedGuide
+class FeatureMatrixTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        srand(1);
+    }
+
+    void randomVectors(std::vector<FeatureVector> &v, size_t n, size_t dim)
+    {
+        v.assign(n, FeatureVector(dim));
+        for (size_t i = 0; i < n; ++i)
+            for (size_t j = 0; j < dim; ++j)
+                v[i][j] = rand() / (floatFeature)RAND_MAX;
+    }
+};
+
+// Dimensions that are and are not multiple of the row alignment
+TEST_F( FeatureMatrixTest, squaredDistances)
+{
+    XMIPP_TRY
+    for (size_t dim = 1; dim < 40; dim += 7)
+    {
+        std::vector<FeatureVector> A, B;
+        randomVectors(A, 300, dim);
+        randomVectors(B, 37, dim);
+        FeatureMatrix MA, MB;
+        MA.fromVectors(A);
+        MB.fromVectors(B);
+        EXPECT_EQ(dim, MA.dimension());
+        EXPECT_EQ(0u, ((size_t)MA.row(1)) % FEATURE_MATRIX_ALIGNMENT);
+
+        size_t first = 50, n = 100;
+        std::vector<double> D(n * B.size());
+        MA.squaredDistances(first, n, MB, &D[0]);
+        for (size_t i = 0; i < n; ++i)
+            for (size_t j = 0; j < B.size(); ++j)
+            {
+                double d = euclideanDistance(A[first + i], B[j]);
+                EXPECT_NEAR(d * d, D[i * B.size() + j], 1e-9);
+            }
+    }
+    XMIPP_CATCH
+}
+
+TEST_F( FeatureMatrixTest, closestRow)
+{
+    XMIPP_TRY
+    for (size_t dim = 1; dim < 40; dim += 7)
+    {
+        std::vector<FeatureVector> A, B;
+        randomVectors(A, 20, dim);
+        randomVectors(B, 37, dim);
+        FeatureMatrix MA, MB;
+        MA.fromVectors(A);
+        MB.fromVectors(B);
+        for (size_t i = 0; i < A.size(); ++i)
+        {
+            size_t bestN = 0;
+            double bestDist = euclideanDistance(A[i], B[0]);
+            for (size_t j = 1; j < B.size(); ++j)
+            {
+                double d = euclideanDistance(A[i], B[j]);
+                if (d < bestDist)
+                {
+                    bestDist = d;
+                    bestN = j;
+                }
+            }
+            double dist2;
+            EXPECT_EQ(bestN, MB.closestRow(MA.row(i), dist2));
+            EXPECT_NEAR(bestDist * bestDist, dist2, 1e-9);
+        }
+    }
+    XMIPP_CATCH
+}
+
+GTEST_API_ int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -77,6 +77,70 @@ TEST_F( FftwTest, directFourierTransformComplex)
     transformer1.cleanup();
 }
 
+TEST_F( FftwTest, planCache)
+{
+    MultidimArray< std::complex< double > > FFT1, FFT2;
+    MultidimArray< double > other=mulDouble;
+    FourierTransformer transformer1, transformer2;
+    transformer1.FourierTransform(mulDouble, FFT1, true);
+    size_t nplans=FFTWPlanCache::size();
+    // Same size but different arrays share the cached plans
+    transformer2.FourierTransform(other, FFT2, true);
+    EXPECT_EQ(nplans, FFTWPlanCache::size());
+    EXPECT_EQ(FFT1, FFT2);
+    transformer2.inverseFourierTransform();
+    EXPECT_EQ(mulDouble, other);
+}
+
+TEST_F( FftwTest, singlePrecisionAccuracy)
+{
+    MultidimArray< double > I(32,64), Ip;
+    MultidimArray< float > If, Ifp;
+    I.initRandom(0,1);
+    typeCast(I,If);
+    Ip=I;
+    Ifp=If;
+
+    MultidimArray< std::complex< double > > FFT;
+    MultidimArray< std::complex< float > > FFTf;
+    FourierTransformer transformer;
+    FourierTransformerFloat transformerf;
+    transformer.FourierTransform(Ip, FFT, false);
+    transformerf.FourierTransform(Ifp, FFTf, false);
+    ASSERT_EQ(MULTIDIM_SIZE(FFT),MULTIDIM_SIZE(FFTf));
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(FFT)
+    {
+        EXPECT_NEAR(DIRECT_MULTIDIM_ELEM(FFT,n).real(),DIRECT_MULTIDIM_ELEM(FFTf,n).real(),1e-5);
+        EXPECT_NEAR(DIRECT_MULTIDIM_ELEM(FFT,n).imag(),DIRECT_MULTIDIM_ELEM(FFTf,n).imag(),1e-5);
+    }
+
+    transformerf.inverseFourierTransform();
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(I)
+    EXPECT_NEAR(DIRECT_MULTIDIM_ELEM(I,n),DIRECT_MULTIDIM_ELEM(Ifp,n),1e-5);
+}
+
+TEST_F( FftwTest, batchFourierTransform)
+{
+    MultidimArray< double > stack(4,16,20), I;
+    stack.initRandom(0,1);
+    MultidimArray< std::complex< double > > stackFourier, IFourier, FFT;
+    BatchFourierTransformer batchTransformer;
+    FourierTransformer transformer;
+    batchTransformer.FourierTransform(stack, stackFourier, true);
+    ASSERT_EQ(NSIZE(stackFourier),(size_t)4);
+    for (size_t n=0; n<NSIZE(stack); ++n)
+    {
+        I.aliasImageInStack(stack,n);
+        transformer.FourierTransform(I, FFT, true);
+        IFourier.aliasImageInStack(stackFourier,n);
+        EXPECT_EQ(FFT, IFourier);
+    }
+
+    MultidimArray< double > original=stack;
+    batchTransformer.inverseFourierTransform();
+    EXPECT_EQ(original, stack);
+}
+
 TEST_F( FftwTest, fft_IDX2DIGFREQ)
 {
 	double w;
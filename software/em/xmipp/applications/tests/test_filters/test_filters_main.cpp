@@ -68,6 +68,27 @@ TEST_F( FiltersTest, bestShift)
 
 }
 
+TEST_F( FiltersTest, bestShiftSinglePrecision)
+{
+    // The single precision search finds the same shift as the double one
+    MultidimArray<double> I1(64,64), I2;
+    I1.initRandom(0,1);
+    I1.setXmippOrigin();
+    Matrix2D<double> A;
+    A.initIdentity(3);
+    MAT_ELEM(A,0,2) = 3.4;
+    MAT_ELEM(A,1,2) = -2.2;
+    applyGeometry(LINEAR, I2, I1, A, IS_NOT_INV, WRAP);
+
+    double x, y, xFloat, yFloat;
+    CorrelationAux aux;
+    CorrelationAuxFloat auxFloat;
+    bestShift(I1,I2,x,y,aux);
+    bestShift(I1,I2,xFloat,yFloat,auxFloat);
+    EXPECT_NEAR(x,xFloat,1e-3);
+    EXPECT_NEAR(y,yFloat,1e-3);
+}
+
 TEST_F( FiltersTest, correlation_matrix)
 {
     MultidimArray<double> Mcorr;
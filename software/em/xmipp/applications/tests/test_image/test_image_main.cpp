@@ -2,6 +2,8 @@
 #include <stdlib.h>
 #include <data/xmipp_image.h>
 #include <data/xmipp_image_extension.h>
+#include <data/xmipp_image_prefetch.h>
+#include <data/xmipp_image_stack_map.h>
 #include <iostream>
 #include <gtest/gtest.h>
 #include <data/metadata.h>
@@ -420,6 +422,73 @@ TEST_F( ImageTest, checkImageFileSize)
     XMIPP_CATCH
 }
 
+TEST_F( ImageTest, prefetchAndWrite)
+{
+    XMIPP_TRY
+    MetaData md(stackName);
+    std::vector<size_t> ids;
+    md.findObjects(ids);
+    FileName fnImg, fnOut, auxFn;
+    auxFn.initUniqueName("/tmp/temp_prefetch_XXXXXX");
+    auxFn = auxFn + ":stk";
+    Image<double> img, expected;
+    {
+        ImagePrefetcher prefetcher(md, MDL_IMAGE, ids, 2, 2);
+        ImageWriter writer(2);
+        for (size_t i = 0; i < ids.size(); ++i)
+        {
+            md.getValue(MDL_IMAGE, fnImg, ids[i]);
+            expected.read(fnImg);
+            // Images not read in time are read by the caller
+            if (!prefetcher.get(ids[i], fnImg, false, img))
+                img.read(fnImg);
+            EXPECT_EQ(expected, img);
+            fnOut.compose(i + 1, auxFn);
+            writer.write(img, fnOut);
+        }
+        // Nothing is served for unknown objects
+        EXPECT_FALSE(prefetcher.get(ids.back() + 1, fnImg, false, img));
+        writer.flush();
+    }
+    img.read(auxFn);
+    EXPECT_EQ(myStack(), img());
+    auxFn.deleteFile();
+    XMIPP_CATCH
+}
+
+TEST_F( ImageTest, stackMap)
+{
+    XMIPP_TRY
+    FileName auxFn, fnImg;
+    auxFn.initUniqueName("/tmp/temp_mrcstk_XXXXXX");
+    auxFn = auxFn + ":mrcs";
+    myStack.write(auxFn);
+
+    ImageStackMap spiderMap, mrcMap;
+    spiderMap.open(stackName);
+    mrcMap.open(auxFn);
+    ASSERT_EQ(NSIZE(myStack()), spiderMap.size());
+    ASSERT_EQ(NSIZE(myStack()), mrcMap.size());
+
+    MultidimArray<float> If;
+    MultidimArray<double> Id, expected;
+    ImageStackMaps maps;
+    for (size_t n = 1; n <= spiderMap.size(); ++n)
+    {
+        expected.aliasImageInStack(myStack(), n - 1);
+        spiderMap.getImage(n, If); // alias
+        typeCast(If, Id);
+        EXPECT_EQ(expected, Id);
+        mrcMap.getImage(n, Id); // cast
+        EXPECT_EQ(expected, Id);
+        fnImg.compose(n, stackName);
+        maps.read(fnImg, Id);
+        EXPECT_EQ(expected, Id);
+    }
+    auxFn.deleteFile();
+    XMIPP_CATCH
+}
+
 GTEST_API_ int main(int argc, char **argv)
 {
     testing::InitGoogleTest(&argc, argv);
@@ -1198,6 +1198,112 @@ TEST_F( MetadataTest, ReadWrite)
     unlink(sfn);
 }
 
+TEST_F( MetadataTest, ReadWriteBinary)
+{
+    char sfn[32] = "";
+    strncpy(sfn, "/tmp/testBinary_XXXXXX", sizeof sfn);
+    if (mkstemp(sfn)==-1)
+    	REPORT_ERROR(ERR_IO_NOTOPEN,"Cannot create temporary file");
+    FileName fnBinary = (String)sfn + ".xmdb";
+    MetaData mdOut;
+    std::vector<double> v(2);
+    for (size_t i = 0; i < 10; ++i)
+    {
+        id = mdOut.addObject();
+        mdOut.setValue(MDL_IMAGE, formatString("%06lu@images.stk", i + 1), id);
+        mdOut.setValue(MDL_ANGLE_ROT, 1.5 * i, id);
+        mdOut.setValue(MDL_REF, (int)i, id);
+        mdOut.setValue(MDL_ORDER, i, id);
+        mdOut.setValue(MDL_FLIP, i % 2 == 0, id);
+        v[0] = i;
+        v[1] = -0.5 * i;
+        mdOut.setValue(MDL_CLASSIFICATION_DATA, v, id);
+    }
+    mdOut.write((String)"images@" + fnBinary);
+    MetaData mdIn;
+    mdIn.read(fnBinary);
+    EXPECT_EQ(mdOut, mdIn);
+    StringVector blocks;
+    getBlocksInMetaDataFile(fnBinary, blocks);
+    EXPECT_EQ((size_t)1, blocks.size());
+    EXPECT_EQ("images", blocks[0]);
+
+    //read only some rows and labels
+    std::vector<MDLabel> labels;
+    labels.push_back(MDL_IMAGE);
+    labels.push_back(MDL_CLASSIFICATION_DATA);
+    mdIn.readBinary(fnBinary, &labels, 4, 3);
+    EXPECT_EQ((size_t)3, mdIn.size());
+    EXPECT_FALSE(mdIn.containsLabel(MDL_ANGLE_ROT));
+    String image;
+    id = mdIn.firstObject();
+    mdIn.getValue(MDL_IMAGE, image, id);
+    EXPECT_EQ("000005@images.stk", image);
+    mdIn.getValue(MDL_CLASSIFICATION_DATA, v, id);
+    EXPECT_EQ(-2., v[1]);
+    unlink(sfn);
+    unlink(fnBinary.c_str());
+}
+
+//compare the tokenizer with the stream based reader
+TEST_F( MetadataTest, ReadStarTokenizer)
+{
+    char sfn[32] = "";
+    strncpy(sfn, "/tmp/testReadStar_XXXXXX", sizeof sfn);
+    if (mkstemp(sfn)==-1)
+    	REPORT_ERROR(ERR_IO_NOTOPEN,"Cannot create temporary file");
+    MetaData mdBig;
+    std::vector<double> v(3);
+    size_t nRows = 2000;
+    for (size_t i = 0; i < nRows; ++i)
+    {
+        id = mdBig.addObject();
+        mdBig.setValue(MDL_IMAGE, formatString("%06lu@images.stk", i + 1), id);
+        mdBig.setValue(MDL_ANGLE_ROT, 0.5 * i, id);
+        mdBig.setValue(MDL_ANGLE_TILT, 0.25 * i, id);
+        mdBig.setValue(MDL_SHIFT_X, -1.5, id);
+        mdBig.setValue(MDL_REF, (int)(i % 7), id);
+        mdBig.setValue(MDL_ENABLED, 1, id);
+        mdBig.setValue(MDL_ORDER, i, id);
+        v[0] = i;
+        mdBig.setValue(MDL_CLASSIFICATION_DATA, v, id);
+    }
+    mdBig.write(sfn);
+
+    MetaData mdStream, mdFast;
+    mdStream.setStreamStarReader();
+    mdStream.read(sfn);
+    mdFast.read(sfn);
+    EXPECT_EQ(mdStream, mdFast);
+    EXPECT_EQ(mdBig, mdFast);
+
+    //only the desired labels should be read
+    std::vector<MDLabel> labels;
+    labels.push_back(MDL_IMAGE);
+    labels.push_back(MDL_ANGLE_TILT);
+    MetaData mdLabels;
+    mdLabels.read(sfn, &labels);
+    EXPECT_EQ(nRows, mdLabels.size());
+    EXPECT_TRUE(mdLabels.containsLabel(MDL_ANGLE_TILT));
+    EXPECT_FALSE(mdLabels.containsLabel(MDL_ANGLE_ROT));
+    double tilt;
+    mdLabels.getValue(MDL_ANGLE_TILT, tilt, mdLabels.lastObject());
+    EXPECT_DOUBLE_EQ(0.25 * (nRows - 1), tilt);
+
+    //the last row may end the file without newline
+    std::ofstream fh(sfn, std::ios::trunc);
+    fh << "# XMIPP_STAR_1 *\ndata_noNewline\nloop_\n _image\n _shiftX\n"
+    << "a.spi 1.5\nb.spi -2.25";
+    fh.close();
+    MetaData mdNoNewline;
+    mdNoNewline.read(sfn);
+    EXPECT_EQ((size_t)2, mdNoNewline.size());
+    double shiftX;
+    mdNoNewline.getValue(MDL_SHIFT_X, shiftX, mdNoNewline.lastObject());
+    EXPECT_DOUBLE_EQ(-2.25, shiftX);
+    unlink(sfn);
+}
+
 TEST_F( MetadataTest, WriteIntermediateBlock)
 {
     //read metadata block between another two
@@ -1411,6 +1517,48 @@ TEST_F( MetadataTest, setGetValue)
     std::cerr << "TEST COMMENT: you should get the ERROR: Mismatch Label (order_) and value type(INT)" <<std::endl;
     EXPECT_THROW(auxMetadata.getValue(MDL_ORDER, i, id), XmippError);
 }
+
+TEST_F( MetadataTest, columnStore)
+{
+    MetaData auxMetadata(mDsource);
+    double x, y;
+    String fn;
+    auxMetadata.setColumnStore();
+    EXPECT_TRUE(auxMetadata.hasColumnStore());
+    id = auxMetadata.firstObject();
+    auxMetadata.getValue(MDL_Y, y, id);
+    EXPECT_EQ(2., y);
+    //values set on the metadata should be seen by the store
+    auxMetadata.setValue(MDL_X, 5., id);
+    auxMetadata.getValue(MDL_X, x, id);
+    EXPECT_EQ(5., x);
+    id1 = auxMetadata.addObject();
+    auxMetadata.setValue(MDL_X, 7., id1);
+    auxMetadata.getValue(MDL_X, x, id1);
+    EXPECT_EQ(7., x);
+    //a new label is added to the store, an sql operation leaves it outdated
+    auxMetadata.setValue(MDL_IMAGE, (String)"image.xmp", id);
+    EXPECT_TRUE(auxMetadata.hasColumnStore());
+    auxMetadata.getValue(MDL_IMAGE, fn, id);
+    EXPECT_EQ("image.xmp", fn);
+    auxMetadata.getValue(MDL_IMAGE, fn, id1);
+    EXPECT_EQ("", fn);
+    auxMetadata.operate((String)"X=2*X");
+    EXPECT_FALSE(auxMetadata.hasColumnStore());
+    std::cerr << "TEST COMMENT: you should get the ERROR: the column store is outdated" <<std::endl;
+    EXPECT_THROW(auxMetadata.getValue(MDL_X, x, id1), XmippError);
+    auxMetadata.setColumnStore();
+    EXPECT_TRUE(auxMetadata.hasColumnStore());
+    auxMetadata.getValue(MDL_X, x, id1);
+    EXPECT_EQ(14., x);
+    MDRow row;
+    EXPECT_TRUE(auxMetadata.getRow(row, id));
+    row.getValue(MDL_X, x);
+    EXPECT_EQ(10., x);
+    auxMetadata.removeObject(id);
+    auxMetadata.setColumnStore();
+    EXPECT_FALSE(auxMetadata.getValue(MDL_X, x, id));
+}
 TEST_F( MetadataTest, Comment)
 {
     XMIPP_TRY
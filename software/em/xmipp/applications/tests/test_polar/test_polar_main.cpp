@@ -39,6 +39,82 @@ TEST_F( PolarTest, computeAverageAndStddev)
     EXPECT_NEAR(stddev,0.49643800057938808,XMIPP_EQUAL_ACCURACY);
 }
 
+TEST_F( PolarTest, polarSampling)
+{
+    MultidimArray<double> I(32,32), Icoeffs;
+    I.setXmippOrigin();
+    I.initRandom(0,1);
+    produceSplineCoefficients(3,Icoeffs,I);
+    for (int order=1; order<=3; order+=2)
+    {
+        const MultidimArray<double> &M = (order==1) ? I : Icoeffs;
+        Polar<double> P1, P2;
+        PolarSampling sampling;
+        P1.getPolarFromCartesianBSpline(M,2,15,order,1.5,-2.3);
+        sampling.initialize(M,2,15,order,1.5,-2.3);
+        P2.getPolarFromCartesianBSpline(M,sampling);
+        ASSERT_EQ(P1.getRingNo(),P2.getRingNo());
+        for (int i=0; i<P1.getRingNo(); i++)
+        {
+            ASSERT_EQ(P1.getSampleNo(i),P2.getSampleNo(i));
+            for (int j=0; j<P1.getSampleNo(i); j++)
+                EXPECT_NEAR(P1(i,j),P2(i,j),1e-12);
+        }
+    }
+}
+
+TEST_F( PolarTest, batchRotationalCorrelation)
+{
+    XMIPP_TRY
+    // Rotated copies of a random image
+    const int N = 64;
+    MultidimArray<double> I(64,64), Irot;
+    I.setXmippOrigin();
+    I.initRandom(0,1);
+    Polar_fftw_plans *plans = NULL;
+    Polar< std::complex<double> > polarRef;
+    std::vector< Polar< std::complex<double> > > polarI(N);
+    normalizedPolarFourierTransform(I, polarRef, false, XSIZE(I) / 5, XSIZE(I) / 2, plans);
+    for (int n = 0; n < N; n++)
+    {
+        rotate(BSPLINE3, Irot, I, n * 5.0, 'Z', WRAP);
+        normalizedPolarFourierTransform(Irot, polarI[n], true, XSIZE(I) / 5, XSIZE(I) / 2, plans);
+    }
+
+    RotationalCorrelationAux aux;
+    MultidimArray<double> rotationalCorr;
+    rotationalCorr.resize(2 * polarRef.getSampleNoOuterRing() - 1);
+    aux.local_transformer.setReal(rotationalCorr);
+
+    // Same rotations as one call per image
+    std::vector<double> expected(N), rotations, rotationsFloat;
+    for (int n = 0; n < N; n++)
+        expected[n] = best_rotation(polarRef, polarI[n], aux);
+
+    BatchRotationalCorrelation<double> batch;
+    BatchRotationalCorrelation<float> batchFloat;
+    batch.setReference(polarRef);
+    batchFloat.setReference(polarRef);
+    for (int n = 0; n < N; n++)
+    {
+        batch.addImage(polarI[n]);
+        batchFloat.addImage(polarI[n]);
+    }
+    batch.bestRotations(rotations, aux);
+    batchFloat.bestRotations(rotationsFloat, aux);
+
+    ASSERT_EQ(N, (int)rotations.size());
+    ASSERT_EQ(N, (int)rotationsFloat.size());
+    double step = 360. / XSIZE(rotationalCorr);
+    for (int n = 0; n < N; n++)
+    {
+        EXPECT_NEAR(expected[n], rotations[n], XMIPP_EQUAL_ACCURACY);
+        EXPECT_NEAR(expected[n], rotationsFloat[n], step + XMIPP_EQUAL_ACCURACY);
+    }
+    delete plans;
+    XMIPP_CATCH
+}
+
 GTEST_API_ int main(int argc, char **argv)
 {
     testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,96 @@
+#include <data/xmipp_image.h>
+#include <data/projection.h>
+#include <reconstruction/fourier_projection.h>
+#include <iostream>
+#include <gtest/gtest.h>
+// MORE INFO HERE: http://code.google.com/p/googletest/wiki/AdvancedGuide
+class ProjectionTest : public ::testing::Test
+{
+protected:
+    // Synthetic phantom and some projection directions
+    virtual void SetUp()
+    {
+        size = 32;
+        V.initZeros(size, size, size);
+        V.setXmippOrigin();
+        FOR_ALL_ELEMENTS_IN_ARRAY3D(V)
+        {
+            double r1 = (k - 3) * (k - 3) + i * i + (j + 4) * (j + 4);
+            double r2 = (k + 5) * (k + 5) + (i - 6) * (i - 6) + j * j;
+            A3D_ELEM(V, k, i, j) = (r1 < 36 ? 1. : 0.) + (r2 < 16 ? 2. : 0.);
+        }
+        for (int n = 0; n < 13; ++n)
+        {
+            rot.push_back((n * 137) % 360);
+            tilt.push_back((n * 13) % 180);
+            psi.push_back((n * 53) % 360);
+        }
+    }
+
+    int size;
+    MultidimArray<double> V;
+    std::vector<double> rot, tilt, psi;
+};
+
+TEST_F( ProjectionTest, projectVolumeThreads)
+{
+    XMIPP_TRY
+    Projection P, Pthreads;
+    for (size_t n = 0; n < rot.size(); ++n)
+    {
+        projectVolume(V, P, size, size, rot[n], tilt[n], psi[n]);
+        for (int threads = 2; threads <= 5; threads += 3)
+        {
+            projectVolume(V, Pthreads, size, size, rot[n], tilt[n], psi[n], NULL, threads);
+            EXPECT_TRUE(P().equal(Pthreads(), 1e-10)) << "direction " << n << ", " << threads << " threads";
+        }
+    }
+    XMIPP_CATCH
+}
+
+TEST_F( ProjectionTest, projectVolumes)
+{
+    XMIPP_TRY
+    std::vector<Projection> projections;
+    Projection P;
+    for (int threads = 1; threads <= 4; threads += 3)
+    {
+        projectVolumes(V, projections, size, size, rot, tilt, psi, threads);
+        ASSERT_EQ(rot.size(), projections.size());
+        for (size_t n = 0; n < rot.size(); ++n)
+        {
+            projectVolume(V, P, size, size, rot[n], tilt[n], psi[n]);
+            EXPECT_TRUE(P().equal(projections[n](), 1e-10)) << "direction " << n << ", " << threads << " threads";
+        }
+    }
+    XMIPP_CATCH
+}
+
+TEST_F( ProjectionTest, fourierProjectorBatch)
+{
+    XMIPP_TRY
+    // The projector takes the volume and clears it
+    MultidimArray<double> Vaux = V;
+    FourierProjector projector(Vaux, 2, 0.5, BSPLINE3);
+    MultidimArray<double> stack;
+    for (int threads = 1; threads <= 4; threads += 3)
+    {
+        projector.project(rot, tilt, psi, stack, threads);
+        ASSERT_EQ(rot.size(), NSIZE(stack));
+        MultidimArray<double> slice;
+        for (size_t n = 0; n < rot.size(); ++n)
+        {
+            projector.project(rot[n], tilt[n], psi[n]);
+            slice.aliasImageInStack(stack, n);
+            slice.setXmippOrigin();
+            EXPECT_TRUE(slice.equal(projector.projection(), 1e-10)) << "direction " << n << ", " << threads << " threads";
+        }
+    }
+    XMIPP_CATCH
+}
+
+GTEST_API_ int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
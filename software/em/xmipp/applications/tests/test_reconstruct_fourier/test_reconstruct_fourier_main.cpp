@@ -0,0 +1,291 @@
+#include <data/xmipp_image.h>
+#include <data/projection.h>
+#include <data/metadata.h>
+#include <reconstruction/reconstruct_fourier.h>
+#include <iostream>
+#include <gtest/gtest.h>
+// MORE INFO HERE: http://code.google.com/p/googletest/wiki/AdvancedGuide
+class ReconstructFourierTest : public ::testing::Test
+{
+protected:
+    // Projections of a synthetic phantom
+    virtual void SetUp()
+    {
+        int size = 32;
+        MultidimArray<double> V(size, size, size);
+        V.setXmippOrigin();
+        FOR_ALL_ELEMENTS_IN_ARRAY3D(V)
+        {
+            double r1 = (k - 3) * (k - 3) + i * i + (j + 4) * (j + 4);
+            double r2 = (k + 5) * (k + 5) + (i - 6) * (i - 6) + j * j;
+            A3D_ELEM(V, k, i, j) = (r1 < 36 ? 1. : 0.) + (r2 < 16 ? 2. : 0.);
+        }
+
+        fnRoot.initUniqueName("/tmp/temp_recfourier_XXXXXX");
+        fnStack = fnRoot + ".stk";
+        fnSel = fnRoot + ".xmd";
+        Projection P;
+        FileName fnImg;
+        size_t id;
+        for (int n = 0; n < 60; ++n)
+        {
+            double rot = (n * 137) % 360, tilt = (n * 3) % 180, psi = (n * 53) % 360;
+            projectVolume(V, P, size, size, rot, tilt, psi);
+            P.write(fnStack, ALL_IMAGES, true, WRITE_APPEND);
+            fnImg.compose(n + 1, fnStack);
+            id = md.addObject();
+            md.setValue(MDL_IMAGE, fnImg, id);
+            md.setValue(MDL_ANGLE_ROT, rot, id);
+            md.setValue(MDL_ANGLE_TILT, tilt, id);
+            md.setValue(MDL_ANGLE_PSI, psi, id);
+        }
+        md.write(fnSel);
+    }
+
+    virtual void TearDown()
+    {
+        fnStack.deleteFile();
+        fnSel.deleteFile();
+        fnRoot.deleteFile();
+    }
+
+    /* Reconstruct with a number of threads */
+    void reconstruct(int threads, const FileName &fnVol, const String &extraArgs="")
+    {
+        ProgRecFourier prog;
+        prog.read(formatString("xmipp_reconstruct_fourier -i %s -o %s --thr %d -v 0 %s",
+                               fnSel.c_str(), fnVol.c_str(), threads, extraArgs.c_str()));
+        prog.run();
+    }
+
+    /* Gridding of all the images as it was done before the blob kernel was
+     * reworked: one pass per symmetry and a distance test for every voxel
+     * of the footprint of each coefficient. The sums are not normalized.
+     */
+    void referenceGridding(const ProgRecFourier &prog, MultidimArray< std::complex<double> > &VoutFourier,
+                           MultidimArray<double> &weights)
+    {
+        VoutFourier.initZeros(prog.VoutFourier);
+        weights.initZeros(prog.FourierWeights);
+        int xsize_1 = XSIZE(VoutFourier) - 1;
+        int zsize_1 = ZSIZE(VoutFourier) - 1;
+        double blobRadius = prog.blob.radius;
+        size_t paddedSize = (size_t)(prog.imgSize * prog.padding_factor_proj);
+
+        MultidimArray<double> paddedImg;
+        MultidimArray< std::complex<double> > paddedFourier;
+        FourierTransformer transformer;
+        ApplyGeoParams params;
+        params.only_apply_shifts = true;
+        Projection proj;
+        Matrix2D<double> A, A_SL;
+        Matrix1D<double> freq(3), symFreq(3), position(3);
+        FOR_ALL_OBJECTS_IN_METADATA(prog.SF)
+        {
+            proj.readApplyGeo(prog.SF, __iter.objId, params);
+            proj().setXmippOrigin();
+            paddedImg.initZeros(paddedSize, paddedSize);
+            paddedImg.setXmippOrigin();
+            const MultidimArray<double> &mProj = proj();
+            FOR_ALL_ELEMENTS_IN_ARRAY2D(mProj)
+            A2D_ELEM(paddedImg, i, j) = A2D_ELEM(mProj, i, j);
+            CenterFFT(paddedImg, true);
+            transformer.FourierTransform(paddedImg, paddedFourier, false);
+            Euler_angles2matrix(proj.rot(), proj.tilt(), proj.psi(), A);
+
+            size_t conserveRows = (size_t)ceil((double)YSIZE(paddedFourier) * prog.maxResolution * 2.0);
+            conserveRows = (size_t)ceil((double)conserveRows / 2.0);
+            for (size_t isym = 0; isym < prog.R_repository.size(); ++isym)
+            {
+                A_SL = prog.R_repository[isym] * A.transpose();
+                for (size_t i = 0; i < YSIZE(paddedFourier); ++i)
+                {
+                    if (i >= conserveRows && i < YSIZE(paddedFourier) - conserveRows)
+                        continue;
+                    for (size_t j = 0; j < XSIZE(paddedFourier); ++j)
+                    {
+                        FFT_IDX2DIGFREQ(j, XSIZE(prog.paddedImg), XX(freq));
+                        FFT_IDX2DIGFREQ(i, YSIZE(prog.paddedImg), YY(freq));
+                        ZZ(freq) = 0;
+                        if (XX(freq) * XX(freq) + YY(freq) * YY(freq) > prog.maxResolution2)
+                            continue;
+                        symFreq = A_SL * freq;
+                        DIGFREQ2FFT_IDX_DOUBLE(XX(symFreq), prog.volPadSizeX, XX(position));
+                        DIGFREQ2FFT_IDX_DOUBLE(YY(symFreq), prog.volPadSizeY, YY(position));
+                        DIGFREQ2FFT_IDX_DOUBLE(ZZ(symFreq), prog.volPadSizeZ, ZZ(position));
+                        std::complex<double> coeff = DIRECT_A2D_ELEM(paddedFourier, i, j);
+
+                        for (int intz = CEIL(ZZ(position) - blobRadius); intz <= FLOOR(ZZ(position) + blobRadius); ++intz)
+                            for (int inty = CEIL(YY(position) - blobRadius); inty <= FLOOR(YY(position) + blobRadius); ++inty)
+                                for (int intx = CEIL(XX(position) - blobRadius); intx <= FLOOR(XX(position) + blobRadius); ++intx)
+                                {
+                                    double d2 = (intx - XX(position)) * (intx - XX(position)) +
+                                                (inty - YY(position)) * (inty - YY(position)) +
+                                                (intz - ZZ(position)) * (intz - ZZ(position));
+                                    if (d2 > blobRadius * blobRadius)
+                                        continue;
+                                    int iz, iy, ix;
+                                    fastIntWRAP(iz, intz, 0, zsize_1);
+                                    fastIntWRAP(iy, inty, 0, zsize_1);
+                                    fastIntWRAP(ix, intx, 0, zsize_1);
+                                    bool conjugate = ix > xsize_1;
+                                    if (conjugate)
+                                    {
+                                        int miz = -iz, miy = -iy, mix = -ix;
+                                        fastIntWRAP(iz, miz, 0, zsize_1);
+                                        fastIntWRAP(iy, miy, 0, zsize_1);
+                                        fastIntWRAP(ix, mix, 0, zsize_1);
+                                    }
+                                    double w = VEC_ELEM(prog.blobTableSqrt, (int)(d2 * prog.iDeltaSqrt + 0.5));
+                                    DIRECT_A3D_ELEM(VoutFourier, iz, iy, ix) += w * (conjugate ? std::conj(coeff) : coeff);
+                                    DIRECT_A3D_ELEM(weights, iz, iy, ix) += w;
+                                }
+                    }
+                }
+            }
+        }
+    }
+
+    /* Compare the gridding of the program with the reference one */
+    void checkGridding(const String &extraArgs)
+    {
+        ProgRecFourier prog;
+        prog.read(formatString("xmipp_reconstruct_fourier -i %s -o %s.vol --thr 3 -v 0 %s",
+                               fnSel.c_str(), fnRoot.c_str(), extraArgs.c_str()));
+        prog.produceSideinfo();
+        prog.createThreads();
+        prog.processSelFile(false);
+        prog.destroyThreads();
+
+        MultidimArray< std::complex<double> > expectedFourier;
+        MultidimArray<double> expectedWeights;
+        referenceGridding(prog, expectedFourier, expectedWeights);
+        ASSERT_TRUE(expectedWeights.sameShape(prog.FourierWeights));
+        double tolerance = 1e-6 * expectedWeights.computeMax();
+        FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(expectedWeights)
+        EXPECT_NEAR(DIRECT_MULTIDIM_ELEM(expectedWeights, n), DIRECT_MULTIDIM_ELEM(prog.FourierWeights, n), tolerance);
+        double maxAbs = 0;
+        FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(expectedFourier)
+        maxAbs = XMIPP_MAX(maxAbs, abs(DIRECT_MULTIDIM_ELEM(expectedFourier, n)));
+        tolerance = 1e-6 * maxAbs;
+        FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(expectedFourier)
+        EXPECT_NEAR(abs(DIRECT_MULTIDIM_ELEM(expectedFourier, n) - DIRECT_MULTIDIM_ELEM(prog.VoutFourier, n)), 0, tolerance);
+    }
+
+    FileName fnRoot, fnStack, fnSel;
+    MetaData md;
+};
+
+TEST_F( ReconstructFourierTest, threads)
+{
+    XMIPP_TRY
+    Image<double> expected, result;
+    FileName fnVol = fnRoot + "_1.vol";
+    reconstruct(1, fnVol);
+    expected.read(fnVol);
+    fnVol.deleteFile();
+
+    // Threads own different planes of the volume, so the result does not
+    // depend on their number
+    int threads[] = {2, 3, 8};
+    for (int t = 0; t < 3; ++t)
+    {
+        fnVol = fnRoot + formatString("_%d.vol", threads[t]);
+        reconstruct(threads[t], fnVol);
+        result.read(fnVol);
+        fnVol.deleteFile();
+        ASSERT_TRUE(expected().sameShape(result()));
+        FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(expected())
+        EXPECT_NEAR(DIRECT_MULTIDIM_ELEM(expected(), n), DIRECT_MULTIDIM_ELEM(result(), n), XMIPP_EQUAL_ACCURACY);
+    }
+    XMIPP_CATCH
+}
+
+TEST_F( ReconstructFourierTest, blobGridding)
+{
+    XMIPP_TRY
+    checkGridding("");
+    XMIPP_CATCH
+}
+
+TEST_F( ReconstructFourierTest, blobGriddingSymmetry)
+{
+    XMIPP_TRY
+    checkGridding("--sym c4");
+    XMIPP_CATCH
+}
+
+TEST_F( ReconstructFourierTest, stream)
+{
+    XMIPP_TRY
+    Image<double> expected, result;
+    FileName fnVol = fnRoot + "_double.vol";
+    reconstruct(2, fnVol);
+    expected.read(fnVol);
+    fnVol.deleteFile();
+
+    // Binary selfile read in chunks and single precision accumulator
+    FileName fnSelDouble = fnSel;
+    fnSel = fnRoot + ".xmdb";
+    md.write(fnSel);
+    fnVol = fnRoot + "_stream.vol";
+    reconstruct(2, fnVol, "--stream 7");
+    result.read(fnVol);
+    fnVol.deleteFile();
+    fnSel.deleteFile();
+    fnSel = fnSelDouble;
+
+    // Other selfiles cannot be read in chunks
+    ProgRecFourier prog;
+    prog.read(formatString("xmipp_reconstruct_fourier -i %s -o %s -v 0 --stream 7",
+                           fnSel.c_str(), fnVol.c_str()));
+    EXPECT_FALSE(prog.doRun);
+
+    double tolerance = 1e-4 * expected().computeMax();
+    ASSERT_TRUE(expected().sameShape(result()));
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(expected())
+    EXPECT_NEAR(DIRECT_MULTIDIM_ELEM(expected(), n), DIRECT_MULTIDIM_ELEM(result(), n), tolerance);
+    XMIPP_CATCH
+}
+
+TEST_F( ReconstructFourierTest, imagesInMemory)
+{
+    XMIPP_TRY
+    Image<double> expected, result;
+    FileName fnVol = fnRoot + "_file.vol";
+    reconstruct(3, fnVol);
+    expected.read(fnVol);
+    fnVol.deleteFile();
+
+    // The same images in memory, in reverse order so that MDL_REF is needed
+    MetaData mdMemory(md);
+    std::vector< Image<double> > images(mdMemory.size());
+    FileName fnImg;
+    int ref = (int)images.size();
+    FOR_ALL_OBJECTS_IN_METADATA(mdMemory)
+    {
+        mdMemory.getValue(MDL_IMAGE, fnImg, __iter.objId);
+        images[ref - 1].read(fnImg);
+        mdMemory.setValue(MDL_REF, ref, __iter.objId);
+        --ref;
+    }
+    fnVol = fnRoot + "_memory.vol";
+    ProgRecFourier prog;
+    prog.read(formatString("xmipp_reconstruct_fourier -i %s -o %s --thr 3 -v 0",
+                           fnSel.c_str(), fnVol.c_str()));
+    prog.setInputImages(mdMemory, images);
+    prog.run();
+    result.read(fnVol);
+    fnVol.deleteFile();
+
+    ASSERT_TRUE(expected().sameShape(result()));
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(expected())
+    EXPECT_NEAR(DIRECT_MULTIDIM_ELEM(expected(), n), DIRECT_MULTIDIM_ELEM(result(), n), XMIPP_EQUAL_ACCURACY);
+    XMIPP_CATCH
+}
+
+GTEST_API_ int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -194,6 +194,39 @@ TEST_F(SamplingTest, computeNeighborsC1)
     XMIPP_CATCH
 }
 
+TEST_F(SamplingTest, directionIndex)
+{
+    XMIPP_TRY
+    const std::vector< Matrix1D<double> > &points = mysampling.sampling_points_vector;
+    double cosRadius = cos(DEG2RAD(5.));
+    DirectionIndex index;
+    index.build(points, DirectionIndex::chordLength(cosRadius));
+
+    std::vector<size_t> neighbors, exhaustiveNeighbors;
+    for (size_t i = 0; i < mysampling.exp_data_projection_direction_by_L_R.size(); ++i)
+    {
+        const Matrix1D<double> &direction = mysampling.exp_data_projection_direction_by_L_R[i];
+        double bestDotProduct = -2, dotProduct;
+        int best = -1;
+        exhaustiveNeighbors.clear();
+        for (size_t j = 0; j < points.size(); ++j)
+        {
+            double aux = direction.dotProduct(points[j]);
+            if (aux > bestDotProduct)
+            {
+                bestDotProduct = aux;
+                best = j;
+            }
+            if (aux > cosRadius)
+                exhaustiveNeighbors.push_back(j);
+        }
+        EXPECT_EQ(best, index.findClosest(direction, dotProduct));
+        index.findWithin(direction, cosRadius, neighbors);
+        EXPECT_TRUE(neighbors == exhaustiveNeighbors);
+    }
+    XMIPP_CATCH
+}
+
 GTEST_API_ int main(int argc, char **argv)
 {
     testing::InitGoogleTest(&argc, argv);
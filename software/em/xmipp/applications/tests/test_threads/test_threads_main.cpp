@@ -0,0 +1,88 @@
+#include <data/xmipp_threads.h>
+#include <data/xmipp_error.h>
+#include <unistd.h>
+#include <iostream>
+#include <gtest/gtest.h>
+// MORE INFO HERE: http://code.google.com/p/googletest/wiki/AdvancedGuide
+class ThreadsTest : public ::testing::Test
+{
+protected:
+    //init metadatas
+    virtual void SetUp()
+    {}
+
+    // virtual void TearDown() {}//Destructor
+};
+
+// Count how many times each item is processed, some items are slow
+class CountItems: public ParallelForBody
+{
+public:
+    std::vector<int> count;
+    Mutex mutex;
+
+    void run(size_t first, size_t last, int thread_id)
+    {
+        for (size_t n = first; n <= last; ++n)
+        {
+            if (n % 5 == 0)
+                usleep(1000);
+            mutex.lock();
+            count[n]++;
+            mutex.unlock();
+        }
+    }
+};
+
+class SetValue: public PoolTask
+{
+public:
+    int value;
+
+    void run(int thread_id)
+    {
+        usleep(500);
+        value = 1;
+    }
+};
+
+TEST_F( ThreadsTest, parallelFor)
+{
+    XMIPP_TRY
+    ThreadPool pool(4);
+    // Same pool for several loops, with any block size and first item
+    for (size_t N = 1; N < 40; N += 3)
+    {
+        CountItems body;
+        body.count.assign(N, 0);
+        pool.parallelFor(N, 1 + N % 4, body, N / 2);
+        for (size_t n = 0; n < N; ++n)
+            EXPECT_EQ(1, body.count[n]);
+    }
+    XMIPP_CATCH
+}
+
+TEST_F( ThreadsTest, taskFuture)
+{
+    XMIPP_TRY
+    ThreadPool pool(3);
+    std::vector<SetValue> tasks(50);
+    TaskFuture future;
+    EXPECT_TRUE(future.isReady());
+    for (size_t n = 0; n < tasks.size(); ++n)
+    {
+        tasks[n].value = 0;
+        pool.submit(&tasks[n], future);
+    }
+    future.wait();
+    EXPECT_TRUE(future.isReady());
+    for (size_t n = 0; n < tasks.size(); ++n)
+        EXPECT_EQ(1, tasks[n].value);
+    XMIPP_CATCH
+}
+
+GTEST_API_ int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -37,6 +37,8 @@
  {
     { "projectVolume", (PyCFunction) FourierProjector_projectVolume,
       METH_VARARGS, "projects Volume" },
+    { "projectVolumes", (PyCFunction) FourierProjector_projectVolumes,
+      METH_VARARGS, "projects Volume in a list of (rot, tilt, psi) directions into a stack" },
     { NULL } /* Sentinel */
  };//FourierProjector_methods
 
@@ -143,8 +145,38 @@ PyObject * FourierProjector_projectVolume(PyObject * obj, PyObject *args, PyObje
       }
 }
 
+/* projectVolumes */
 
-
-
-
-
+PyObject * FourierProjector_projectVolumes(PyObject * obj, PyObject *args, PyObject *kwargs)
+{
+    FourierProjectorObject *self = (FourierProjectorObject*) obj;
+    PyObject *projection_image = NULL;
+    PyObject *angles = NULL;
+    int threads = 1;
+    if (self != NULL && PyArg_ParseTuple(args, "OO|i", &projection_image, &angles, &threads))
+    {
+        if (!PyList_Check(angles))
+        {
+            PyErr_SetString(PyExc_TypeError, "FourierProjector::projectVolumes: Expecting a list of (rot, tilt, psi)");
+            return NULL;
+        }
+        size_t size = PyList_Size(angles);
+        std::vector<double> rot(size), tilt(size), psi(size);
+        for (size_t i = 0; i < size; ++i)
+            if (!PyArg_ParseTuple(PyList_GetItem(angles, i), "ddd", &rot[i], &tilt[i], &psi[i]))
+                return NULL;
+        try
+        {
+            MultidimArray<double> projections;
+            FourierProjector_Value(self).project(rot, tilt, psi, projections, threads);
+            Image_Value(projection_image).data->setImage(projections);
+        }
+        catch (XmippError &xe)
+        {
+            PyErr_SetString(PyXmippError, xe.msg.c_str());
+            return NULL;
+        }
+        Py_RETURN_NONE;
+    }
+    return NULL;
+}
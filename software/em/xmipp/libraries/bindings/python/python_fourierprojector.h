@@ -57,6 +57,10 @@ void FourierProjector_dealloc(FourierProjectorObject* self);
 
 PyObject * FourierProjector_projectVolume(PyObject * obj, PyObject *args, PyObject *kwargs);
 
+/* Project a volume in several directions into a stack.
+ */
+PyObject * FourierProjector_projectVolumes(PyObject * obj, PyObject *args, PyObject *kwargs);
+
 /* FourierProjector methods */
 extern PyMethodDef FourierProjector_methods[];
 /*FourierProjectorType Type */
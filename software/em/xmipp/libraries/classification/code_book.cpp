@@ -30,6 +30,7 @@
 
 #include "code_book.h"
 #include <data/xmipp_funcs.h>
+#include "feature_matrix.h"
 
 /**
  * This class implements a codebook.
@@ -239,8 +240,20 @@ void CodeBook::classify(const ClassicTrainingVectors* _ts)
     classifVectors.resize(size());
     aveDistances.clear(); // clear previous classification.
     aveDistances.resize(size());
+
+    // The code vectors are packed once for the search of all the winners
+    FeatureMatrix codeMatrix;
+    codeMatrix.fromVectors(theItems);
+    std::vector<floatFeature> x(codeMatrix.stride(), 0.);
+    double dist2;
     for (unsigned j = 0 ; j < _ts->size() ; j++)
-        classifVectors[testIndex(_ts->theItems[j])].push_back(j);
+    {
+        const FeatureVector &v = _ts->theItems[j];
+        if (v.size() != codeMatrix.dimension())
+            throw std::runtime_error("vector of different size in CodeBook::classify");
+        std::copy(v.begin(), v.end(), x.begin());
+        classifVectors[codeMatrix.closestRow(&x[0], dist2)].push_back(j);
+    }
 
     for (unsigned i = 0 ; i < size() ; i++)
     {
@@ -0,0 +1,115 @@
+/***************************************************************************
+ *
+ * Authors:     agent (agent@local)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#include <cstdlib>
+#include <cstring>
+#include <data/xmipp_error.h>
+#include <data/xmipp_macros.h>
+#include "feature_matrix.h"
+
+// Bytes of the tiles of the second matrix in squaredDistances, a part of the L2 cache
+#define FEATURE_MATRIX_TILE_BYTES (128 * 1024)
+
+FeatureMatrix::FeatureMatrix()
+{
+    data = NULL;
+    rows = dim = rowStride = 0;
+}
+
+FeatureMatrix::~FeatureMatrix()
+{
+    clear();
+}
+
+void FeatureMatrix::resize(size_t _rows, size_t _dim)
+{
+    clear();
+    const size_t align = FEATURE_MATRIX_ALIGNMENT / sizeof(floatFeature);
+    rowStride = ((_dim + align - 1) / align) * align;
+    size_t bytes = _rows * rowStride * sizeof(floatFeature);
+    if (bytes > 0)
+    {
+        void * ptr;
+        if (posix_memalign(&ptr, FEATURE_MATRIX_ALIGNMENT, bytes) != 0)
+            REPORT_ERROR(ERR_MEM_NOTENOUGH, "FeatureMatrix: cannot allocate the feature matrix");
+        data = (floatFeature *) ptr;
+        memset(data, 0, bytes);
+    }
+    rows = _rows;
+    dim = _dim;
+}
+
+void FeatureMatrix::clear()
+{
+    free(data);
+    data = NULL;
+    rows = dim = rowStride = 0;
+}
+
+void FeatureMatrix::fromVectors(const std::vector<FeatureVector> &_v)
+{
+    size_t n = _v.size();
+    resize(n, n > 0 ? _v[0].size() : 0);
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (_v[i].size() != dim)
+            REPORT_ERROR(ERR_MULTIDIM_SIZE, "FeatureMatrix: the vectors have different sizes");
+        if (dim > 0)
+            memcpy(row(i), &_v[i][0], dim * sizeof(floatFeature));
+    }
+}
+
+void FeatureMatrix::squaredDistances(size_t _first, size_t _n, const FeatureMatrix &_B, double *_D) const
+{
+    if (_B.rowStride != rowStride)
+        REPORT_ERROR(ERR_MULTIDIM_SIZE, "FeatureMatrix: the matrices have different dimensions");
+    size_t nB = _B.size();
+    size_t tile = XMIPP_MAX((size_t)1, FEATURE_MATRIX_TILE_BYTES / XMIPP_MAX((size_t)1, rowStride * sizeof(floatFeature)));
+    for (size_t j0 = 0; j0 < nB; j0 += tile)
+    {
+        size_t j1 = XMIPP_MIN(nB, j0 + tile);
+        for (size_t i = 0; i < _n; ++i)
+        {
+            const floatFeature * a = row(_first + i);
+            double * ptrD = _D + i * nB;
+            for (size_t j = j0; j < j1; ++j)
+                ptrD[j] = squaredDistance(a, _B.row(j), rowStride);
+        }
+    }
+}
+
+size_t FeatureMatrix::closestRow(const floatFeature *_x, double &_dist2) const
+{
+    size_t best = 0;
+    _dist2 = MAXDOUBLE;
+    for (size_t i = 0; i < rows; ++i)
+    {
+        double d = squaredDistance(_x, row(i), rowStride);
+        if (d < _dist2)
+        {
+            _dist2 = d;
+            best = i;
+        }
+    }
+    return best;
+}
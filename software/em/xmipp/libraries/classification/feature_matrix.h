@@ -0,0 +1,145 @@
+/***************************************************************************
+ *
+ * Authors:     agent (agent@local)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#ifndef XMIPP_FEATURE_MATRIX_H
+#define XMIPP_FEATURE_MATRIX_H
+
+#include <vector>
+#include "data_types.h"
+
+/**@defgroup FeatureMatrix Feature matrix
+   @ingroup ClassificationLibrary */
+//@{
+
+/// Rows of a FeatureMatrix start at multiples of this number of bytes
+#define FEATURE_MATRIX_ALIGNMENT 32
+
+/**
+ * Squared euclidean distance between two rows of a FeatureMatrix.
+ * n must be a multiple of 4, as the stride of the matrix rows is.
+ * The partial sums are independent so that the loop can be vectorized.
+ */
+inline double squaredDistance(const floatFeature *_a, const floatFeature *_b, size_t _n)
+{
+    double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (size_t j = 0; j < _n; j += 4)
+    {
+        double d0 = (double)_a[j] - (double)_b[j];
+        double d1 = (double)_a[j + 1] - (double)_b[j + 1];
+        double d2 = (double)_a[j + 2] - (double)_b[j + 2];
+        double d3 = (double)_a[j + 3] - (double)_b[j + 3];
+        s0 += d0 * d0;
+        s1 += d1 * d1;
+        s2 += d2 * d2;
+        s3 += d3 * d3;
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+/**
+ * Feature vectors stored as a dense row-major matrix.
+ * All the vectors are kept in a single aligned block, instead of one
+ * allocation per vector, and each row is padded with zeros up to
+ * FEATURE_MATRIX_ALIGNMENT bytes. The distance kernels run over the whole
+ * rows, padding included, so that they do not need any remainder loop.
+ * @code
+ * FeatureMatrix X, V;
+ * X.fromVectors(ts.theItems);
+ * V.fromVectors(codeBook.theItems);
+ * std::vector<double> D(X.size() * V.size());
+ * X.squaredDistances(0, X.size(), V, &D[0]);
+ * @endcode
+ */
+class FeatureMatrix
+{
+public:
+    /// Empty constructor
+    FeatureMatrix();
+
+    /// Destructor
+    ~FeatureMatrix();
+
+    /// Set the size, all the features are zero
+    void resize(size_t _rows, size_t _dim);
+
+    /// Free the memory
+    void clear();
+
+    /// Copy the vectors, all of them must have the same size
+    void fromVectors(const std::vector<FeatureVector> &_v);
+
+    /// Number of rows
+    size_t size() const
+    {
+        return rows;
+    }
+
+    /// Number of features of each row
+    size_t dimension() const
+    {
+        return dim;
+    }
+
+    /// Distance between the start of two consecutive rows, in features
+    size_t stride() const
+    {
+        return rowStride;
+    }
+
+    /// Row i
+    floatFeature * row(size_t _i)
+    {
+        return data + _i * rowStride;
+    }
+
+    /// Row i
+    const floatFeature * row(size_t _i) const
+    {
+        return data + _i * rowStride;
+    }
+
+    /**
+     * Squared distances of the rows from first to first+n-1 to all the rows of B.
+     * The distance of row i to the row j of B is stored in D[(i-first)*B.size()+j].
+     * B is traversed in tiles that fit in the cache, so that each tile is
+     * read once from memory for all the rows.
+     */
+    void squaredDistances(size_t _first, size_t _n, const FeatureMatrix &_B, double *_D) const;
+
+    /**
+     * Index of the row closest to x, that must have stride() features,
+     * with the padding set to zero. Its squared distance is returned in dist2.
+     */
+    size_t closestRow(const floatFeature *_x, double &_dist2) const;
+
+private:
+    floatFeature * data;
+    size_t rows, dim, rowStride;
+
+    // Not copyable
+    FeatureMatrix(const FeatureMatrix &);
+    FeatureMatrix & operator=(const FeatureMatrix &);
+};
+//@}
+
+#endif
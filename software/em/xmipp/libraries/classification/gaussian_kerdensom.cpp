@@ -60,6 +60,8 @@ void GaussianKerDenSOM::train(FuzzyMap& _som, TS& _examples, FileName& _fn,
         tmpMap[i].resize(dim, 0.);
     tmpD.resize(numNeurons);
     tmpD1.resize(numNeurons);
+    examplesMatrix.fromVectors(_examples.theItems);
+    packedExamples = &_examples;
     double stopError;
 
     int verbosity = listener->getVerbosity();
@@ -234,6 +236,10 @@ void GaussianKerDenSOM::train(FuzzyMap& _som, TS& _examples, FileName& _fn,
     tmpMap.clear();
     tmpD.clear();
     tmpD1.clear();
+    tmpDists.clear();
+    examplesMatrix.clear();
+    codeMatrix.clear();
+    packedExamples = NULL;
 
 }
 
@@ -255,20 +261,18 @@ double GaussianKerDenSOM::updateU(FuzzyMap* _som, const TS* _examples,
     double *ptrTmpD=&tmpD[0];
     double *ptrTmpD1=&tmpD1[0];
     double idim=1.0/dim;
+    codeMatrix.fromVectors(_som->theItems);
     for (size_t k = 0; k < numVectors; k++)
     {
+        // Distances of a block of examples to all the code vectors
+        size_t kBlock = k % KERDENSOM_BLOCK;
+        if (kBlock == 0)
+            exampleDistances(_examples, k, XMIPP_MIN((size_t)KERDENSOM_BLOCK, numVectors - k));
+        const double *ptrDists=&tmpDists[kBlock * numNeurons];
         max1 = -MAXFLOAT;
-        const floatFeature *ptrExample=&(_examples->theItems[k][0]);
         for (size_t i = 0; i < numNeurons; i ++)
         {
-            auxDist = 0;
-            const floatFeature *ptrCodeVector=&(_som->theItems[i][0]);
-            for (size_t j = 0; j < dim; j++)
-            {
-                double tmp=((double)ptrExample[j] - (double)ptrCodeVector[j]);
-                auxDist += tmp * tmp;
-            }
-            auxDist*=idim;
+            auxDist = ptrDists[i] * idim;
             ptrTmpD[i] = auxDist;
             rr2 = -auxDist * irr1;
             ptrTmpD1[i] = rr2;
@@ -327,6 +331,22 @@ double GaussianKerDenSOM::updateSigmaII(FuzzyMap* _som, const TS* _examples, con
 /**
  * Estimate the PD (Method 1: Using the code vectors)
  */
+double GaussianKerDenSOM::codeDensFromDistances(const double* _dists, double _sigma) const
+{
+    double s = 0;
+    double K=-1.0/(2*_sigma);
+    for (size_t cc = 0; cc < numNeurons; cc++)
+    {
+        double t = _dists[cc] * K;
+        if (t < MAXZ)
+            t = 0;
+        else
+            t = exp(t);
+        s += t;
+    }
+    return std::pow(2*PI*_sigma, -0.5*dim)*s / numNeurons;
+}
+
 double GaussianKerDenSOM::codeDens(const FuzzyMap* _som, const FeatureVector* _example, double _sigma) const
 {
     double s = 0;
@@ -390,9 +410,13 @@ double GaussianKerDenSOM::functional(const TS* _examples, const FuzzyMap* _som,
     unsigned j, vv, cc;
     double t;
     _likelihood = 0;
+    codeMatrix.fromVectors(_som->theItems);
     for (vv = 0; vv < numVectors; vv++)
     {
-        t = codeDens(_som, &(_examples->theItems[vv]), _sigma);
+        size_t vBlock = vv % KERDENSOM_BLOCK;
+        if (vBlock == 0)
+            exampleDistances(_examples, vv, XMIPP_MIN((size_t)KERDENSOM_BLOCK, numVectors - vv));
+        t = codeDensFromDistances(&tmpDists[vBlock * numNeurons], _sigma);
         if (t == 0)
         {
             t = 1e-300;
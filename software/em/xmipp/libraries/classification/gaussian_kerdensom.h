@@ -95,6 +95,9 @@ protected:
     // Estimate the PD (Method 1: Using the code vectors)
     virtual double codeDens(const FuzzyMap* _som, const FeatureVector* _example, double _sigma) const;
 
+    // Estimate the PD from the squared distances of the example to the code vectors
+    double codeDensFromDistances(const double* _dists, double _sigma) const;
+
     // Estimate the PD (Method 2: Using the data)
     virtual double dataDens(const TS* _examples, const FeatureVector* _example, double _sigma) const;
 
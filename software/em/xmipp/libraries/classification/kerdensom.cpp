@@ -119,18 +119,22 @@ void KerDenSOM::updateV(FuzzyMap* _som, const TS* _examples, const double& _reg)
     // Calculate Temporal scratch values
     for (size_t cc = 0; cc < numNeurons; cc++)
     {
-    	double *ptrTmpMap_cc=&(tmpMap[cc][0]);
-    	memset(ptrTmpMap_cc,0,dim*sizeof(double));
-    	double &tmpDens_cc=tmpDens[cc];
+    	memset(&(tmpMap[cc][0]),0,dim*sizeof(double));
         if (_reg != 0)
-        	tmpDens_cc = _reg * _som->getLayout().numNeig(_som, (SomPos) _som->indexToPos(cc));
+        	tmpDens[cc] = _reg * _som->getLayout().numNeig(_som, (SomPos) _som->indexToPos(cc));
         else
-        	tmpDens_cc = 0.;
-        for (size_t vv = 0; vv < numVectors; vv++)
+        	tmpDens[cc] = 0.;
+    }
+    // Each example is read once for all the code vectors
+    for (size_t vv = 0; vv < numVectors; vv++)
+    {
+        const floatFeature * ptrExample=&(_examples->theItems[vv][0]);
+        const floatFeature * ptrMemb_vv=&(_som->memb[vv][0]);
+        for (size_t cc = 0; cc < numNeurons; cc++)
         {
-            double tmpU = (double) _som->memb[vv][cc];
-            tmpDens_cc += tmpU;
-            const floatFeature * ptrExample=&(_examples->theItems[vv][0]);
+            double tmpU = (double) ptrMemb_vv[cc];
+            tmpDens[cc] += tmpU;
+            double *ptrTmpMap_cc=&(tmpMap[cc][0]);
             for (size_t j = 0; j < dim; j++)
             	ptrTmpMap_cc[j] +=  tmpU * ptrExample[j];
         }
@@ -208,26 +212,33 @@ double KerDenSOM::updateSigmaI(FuzzyMap* _som, const TS* _examples)
     double t = 0;
 
     // Computing Sigma (Part I)
+    codeMatrix.fromVectors(_som->theItems);
     for (size_t vv = 0; vv < numVectors; vv++)
     {
-    	const FeatureVector &example=_examples->theItems[vv];
-    	const floatFeature *ptrExample0=&example[0];
+        size_t vBlock = vv % KERDENSOM_BLOCK;
+        if (vBlock == 0)
+            exampleDistances(_examples, vv, XMIPP_MIN((size_t)KERDENSOM_BLOCK, numVectors - vv));
+        const double *ptrDists=&tmpDists[vBlock * numNeurons];
         for (size_t cc = 0; cc < numNeurons; cc++)
-        {
-            double r = 0.0;
-        	const floatFeature *ptrExample=ptrExample0;
-        	const floatFeature *ptrCodeVector=&(_som->theItems[cc][0]);
-            for (size_t j = 0; j < dim; j++)
-            {
-            	double diff=(double)(*ptrExample++) - (double)(*ptrCodeVector++);
-                r += diff*diff;
-            }
-            t += r * (double)(_som->memb[vv][cc]);
-        }
+            t += ptrDists[cc] * (double)(_som->memb[vv][cc]);
     }
     return (double)(t / (double)(numVectors*dim));
 }
 
+//-----------------------------------------------------------------------------
+
+// Distances of a block of examples to the code vectors
+void KerDenSOM::exampleDistances(const TS* _examples, size_t _first, size_t _n)
+{
+    if (packedExamples != _examples || examplesMatrix.size() != _examples->size())
+    {
+        examplesMatrix.fromVectors(_examples->theItems);
+        packedExamples = _examples;
+    }
+    tmpDists.resize(_n * codeMatrix.size());
+    examplesMatrix.squaredDistances(_first, _n, codeMatrix, &tmpDists[0]);
+}
+
 //-----------------------------------------------------------------------------
 /**************** Necessary stuff ***************************************/
 //-----------------------------------------------------------------------------
@@ -282,20 +293,27 @@ void KerDenSOM::updateV1(FuzzyMap* _som, const TS* _examples)
 void KerDenSOM::updateU1(FuzzyMap* _som, const TS* _examples)
 {
 
-    double auxProd, auxDist, tmp;
+    double auxProd, auxDist;
     size_t k, j, i;
 
     // Update Membership matrix
+    codeMatrix.fromVectors(_som->theItems);
     for (k = 0; k < numVectors; k++)
     {
+        // Squared distances of the example to the code vectors
+        size_t kBlock = k % KERDENSOM_BLOCK;
+        if (kBlock == 0)
+            exampleDistances(_examples, k, XMIPP_MIN((size_t)KERDENSOM_BLOCK, numVectors - k));
+        const double *ptrDists=&tmpDists[kBlock * numNeurons];
+
         auxProd = 1;
         for (j = 0; j < numNeurons; j++)
-            auxProd *= euclideanDistance(_som->theItems[j], _examples->theItems[k]);
+            auxProd *= sqrt(ptrDists[j]);
 
         if (auxProd == 0.)
         { // Apply k-means criterion (Data-CB) must be > 0
             for (j = 0; j < numNeurons; j ++)
-                if (euclideanDistance(_som->theItems[j], _examples->theItems[k]) == 0.)
+                if (ptrDists[j] == 0.)
                     _som->memb[k][j] = 1.0;
                 else
                     _som->memb[k][j] =  0.0;
@@ -306,11 +324,7 @@ void KerDenSOM::updateU1(FuzzyMap* _som, const TS* _examples)
             {
                 auxDist = 0;
                 for (j = 0; j < numNeurons; j ++)
-                {
-                    tmp = euclideanDistance(_som->theItems[i], _examples->theItems[k]) /
-                    		euclideanDistance(_som->theItems[j], _examples->theItems[k]);
-                    auxDist += pow(tmp, 2);
-                } // for j
+                    auxDist += ptrDists[i] / ptrDists[j];
                 _som->memb[k][i] = (floatFeature) 1.0 / auxDist;
             } // for i
         } // if auxProd
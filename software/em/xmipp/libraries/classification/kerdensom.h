@@ -34,6 +34,10 @@
 
 #include "base_algorithm.h"
 #include "map.h"
+#include "feature_matrix.h"
+
+// Number of examples whose distances to the code vectors are computed at a time
+#define KERDENSOM_BLOCK 256
 
 /**@defgroup Kendersom Kendersom: Smoothly Distributed Kernel Probability Density Estimator Self Organizing Map
    @ingroup ClassificationLibrary */
@@ -56,7 +60,7 @@ public:
     KerDenSOM(double _reg0, double _reg1, unsigned long _annSteps,
                    double _epsilon, unsigned long _nSteps)
             : ClassificationAlgorithm<FuzzyMap>(), annSteps(_annSteps), reg0(_reg0), reg1(_reg1),
-            epsilon(_epsilon), somNSteps(_nSteps)
+            epsilon(_epsilon), somNSteps(_nSteps), packedExamples(NULL)
     {};
 
     /**
@@ -133,6 +137,15 @@ protected:
     std::vector < std::vector<double> > tmpMap;
     std::vector<double> tmpD, tmpD1, tmpDens, tmpV;
 
+    // Examples and code vectors as dense matrices, for the distance kernels
+    FeatureMatrix examplesMatrix, codeMatrix;
+    const TS* packedExamples;
+    std::vector<double> tmpDists;
+
+    // Squared distances of the examples first to first+n-1 to the rows of codeMatrix,
+    // into tmpDists. The examples are packed into examplesMatrix the first time.
+    void exampleDistances(const TS* _examples, size_t _first, size_t _n);
+
 
     /** Declaration of virtual method */
     virtual void train(FuzzyMap& _som, const TS& _examples) const
@@ -433,6 +433,285 @@ void CTFDescription::precomputeValues(const MultidimArray<double> &cont_x_freq,
     }
 }
 
+/* Precompute the frequencies of a grid ------------------------------------ */
+void PrecomputedForCTFGrid::compute(int Ydim, int Xdim, bool halfComplex, double Ts)
+{
+    this->Ydim = Ydim;
+    this->Xdim = Xdim;
+    this->Ts = Ts;
+    XdimGrid = halfComplex ? Xdim / 2 + 1 : Xdim;
+    size_t N = (size_t)Ydim * XdimGrid;
+    u.resize(N);
+    u2.resize(N);
+    u4.resize(N);
+    cos2ang.resize(N);
+    sin2ang.resize(N);
+
+    double iTs = 1.0 / Ts;
+    size_t n = 0;
+    for (int i = 0; i < Ydim; ++i)
+    {
+        double wy;
+        FFT_IDX2DIGFREQ(i, Ydim, wy);
+        double fy = wy * iTs;
+        for (int j = 0; j < XdimGrid; ++j, ++n)
+        {
+            double wx;
+            FFT_IDX2DIGFREQ(j, Xdim, wx);
+            double fx = wx * iTs;
+            double fu2 = fx * fx + fy * fy;
+            u2[n] = fu2;
+            u[n] = sqrt(fu2);
+            u4[n] = fu2 * fu2;
+            // cos(2*ang) and sin(2*ang), with ang=atan2(fy,fx)
+            if (fu2 > 0)
+            {
+                double ifu2 = 1.0 / fu2;
+                cos2ang[n] = (fx * fx - fy * fy) * ifu2;
+                sin2ang[n] = 2 * fx * fy * ifu2;
+            }
+            else
+                cos2ang[n] = sin2ang[n] = 0;
+        }
+    }
+}
+
+/* CTF on a grid ----------------------------------------------------------- */
+void CTFDescription::getCTFGrid(int Ydim, int Xdim, MultidimArray<double> &values,
+                                bool halfComplex, bool withDamping, double Ts)
+{
+    if (Ts < 0)
+        Ts = Tm;
+    if (!precomputedGrid.isComputed(Ydim, Xdim, halfComplex, Ts))
+    {
+        precomputedGrid.compute(Ydim, Xdim, halfComplex, Ts);
+        gridEnvelope.clear();
+    }
+    values.resizeNoCopy(Ydim, precomputedGrid.XdimGrid);
+    size_t N = precomputedGrid.u.size();
+    gridDeltaf.resize(N);
+
+    const double *ptrU = &precomputedGrid.u[0];
+    const double *ptrU2 = &precomputedGrid.u2[0];
+    const double *ptrU4 = &precomputedGrid.u4[0];
+    const double *ptrCos2ang = &precomputedGrid.cos2ang[0];
+    const double *ptrSin2ang = &precomputedGrid.sin2ang[0];
+    double *ptrDeltaf = &gridDeltaf[0];
+    double *ptrValues = MULTIDIM_ARRAY(values);
+
+    // Defocus and phase. These loops have no calls and are vectorized
+    // by the compiler.
+    // cos(2*(ang-azimuth))=cos(2*ang)*cos(2*azimuth)+sin(2*ang)*sin(2*azimuth)
+    double cos2azimuth = cos(2 * rad_azimuth);
+    double sin2azimuth = sin(2 * rad_azimuth);
+    for (size_t n = 0; n < N; ++n)
+        ptrDeltaf[n] = defocus_average + defocus_deviation *
+                       (ptrCos2ang[n] * cos2azimuth + ptrSin2ang[n] * sin2azimuth);
+    for (size_t n = 0; n < N; ++n)
+        ptrValues[n] = K1 * ptrDeltaf[n] * ptrU2[n] + K2 * ptrU4[n];
+
+    for (size_t n = 0; n < N; ++n)
+    {
+        double sine_part, cosine_part;
+        sincos(ptrValues[n], &sine_part, &cosine_part);
+        ptrValues[n] = -(Ksin * sine_part - Kcos * cosine_part);
+    }
+    if (!withDamping)
+        return;
+
+    // The radial part of the envelope only depends on the microscope,
+    // that is usually the same for all images
+    if (gridEnvelope.size() != N || gridK3 != K3 || gridK5 != K5 || gridDeltaR != DeltaR)
+    {
+        gridEnvelope.resize(N);
+        for (size_t n = 0; n < N; ++n)
+            gridEnvelope[n] = exp(-K3 * ptrU4[n]) * bessj0(K5 * ptrU2[n]) * SINC(ptrU[n] * DeltaR);
+        gridK3 = K3;
+        gridK5 = K5;
+        gridDeltaR = DeltaR;
+    }
+    const double *ptrEnvelope = &gridEnvelope[0];
+    if (K6 == 0)
+        for (size_t n = 0; n < N; ++n)
+            ptrValues[n] *= K * (ptrEnvelope[n] + envR0 + envR1 * ptrU[n] + envR2 * ptrU2[n]);
+    else
+        for (size_t n = 0; n < N; ++n)
+        {
+            double aux = (K7 * ptrU2[n] + ptrDeltaf[n]) * ptrU[n];
+            double Ealpha = exp(-K6 * aux * aux);
+            ptrValues[n] *= K * (ptrEnvelope[n] * Ealpha + envR0 + envR1 * ptrU[n] + envR2 * ptrU2[n]);
+        }
+}
+
+/* Phase flip -------------------------------------------------------------- */
+void CTFDescription::applyPhaseFlip(MultidimArray< std::complex<double> > &FFTI,
+                                    int Ydim, int Xdim, double Ts)
+{
+    getCTFGrid(Ydim, Xdim, gridCTF, true, true, Ts);
+    if (YSIZE(gridCTF) != YSIZE(FFTI) || XSIZE(gridCTF) != XSIZE(FFTI))
+        REPORT_ERROR(ERR_MULTIDIM_SIZE, "applyPhaseFlip: the Fourier transform is not the one of the image size");
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(FFTI)
+    if (DIRECT_MULTIDIM_ELEM(gridCTF, n) < 0)
+        DIRECT_MULTIDIM_ELEM(FFTI, n) = -DIRECT_MULTIDIM_ELEM(FFTI, n);
+}
+
+/* Wiener filter ----------------------------------------------------------- */
+void CTFDescription::applyWienerFilter(MultidimArray< std::complex<double> > &FFTI,
+                                       int Ydim, int Xdim, double wienerConstant, bool phaseFlipped,
+                                       bool withDamping, double Ts)
+{
+    getWienerFilter(Ydim, Xdim, gridCTF, wienerConstant, phaseFlipped, withDamping, Ts);
+    if (YSIZE(gridCTF) != YSIZE(FFTI) || XSIZE(gridCTF) != XSIZE(FFTI))
+        REPORT_ERROR(ERR_MULTIDIM_SIZE, "applyWienerFilter: the Fourier transform is not the one of the image size");
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(FFTI)
+    DIRECT_MULTIDIM_ELEM(FFTI, n) *= DIRECT_MULTIDIM_ELEM(gridCTF, n);
+}
+
+void CTFDescription::getWienerFilter(int Ydim, int Xdim, MultidimArray<double> &filter,
+                                     double wienerConstant, bool phaseFlipped,
+                                     bool withDamping, double Ts)
+{
+    getCTFGrid(Ydim, Xdim, filter, true, withDamping, Ts);
+    if (phaseFlipped)
+        FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(filter)
+        DIRECT_MULTIDIM_ELEM(filter, n) = fabs(DIRECT_MULTIDIM_ELEM(filter, n));
+
+    if (wienerConstant < 0)
+    {
+        // Average of CTF^2 over the whole image. The columns that are not
+        // in the half transform are the ones of the opposite frequencies,
+        // where the CTF is the same, so columns 1..lastDouble count twice.
+        double sum2 = 0;
+        size_t lastDouble = (Xdim % 2 == 0) ? Xdim / 2 - 1 : Xdim / 2;
+        FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY2D(filter)
+        {
+            double ctf = DIRECT_A2D_ELEM(filter, i, j);
+            sum2 += (j > 0 && j <= lastDouble) ? 2 * ctf * ctf : ctf * ctf;
+        }
+        // With an even Ydim, the opposite of the row of frequency 0.5 is
+        // not in the grid, those coefficients are evaluated at -0.5
+        if (Ydim % 2 == 0)
+        {
+            size_t iNyquist = Ydim / 2;
+            double iTs = 1.0 / (Ts < 0 ? Tm : Ts);
+            for (size_t j = 1; j <= lastDouble; ++j)
+            {
+                double wx, ctf = DIRECT_A2D_ELEM(filter, iNyquist, j);
+                FFT_IDX2DIGFREQ(j, Xdim, wx);
+                precomputeValues(wx * iTs, -0.5 * iTs);
+                double ctfOpposite = withDamping ? getValuePureAt() : getValuePureWithoutDampingAt();
+                sum2 += ctfOpposite * ctfOpposite - ctf * ctf;
+            }
+        }
+        wienerConstant = 0.1 * sum2 / ((double)Ydim * Xdim);
+    }
+
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(filter)
+    {
+        double ctf = DIRECT_MULTIDIM_ELEM(filter, n);
+        DIRECT_MULTIDIM_ELEM(filter, n) = ctf / (ctf * ctf + wienerConstant);
+    }
+}
+
+/* CTF image cache --------------------------------------------------------- */
+CTFImageCache::CTFImageCache(size_t maxImages, double defocusStep, double angleStep)
+{
+    this->maxImages = XMIPP_MAX(maxImages, (size_t)1);
+    this->defocusStep = defocusStep;
+    this->angleStep = angleStep;
+    hits = misses = 0;
+}
+
+void CTFImageCache::clear()
+{
+    entries.clear();
+    index.clear();
+    hits = misses = 0;
+}
+
+bool CTFImageCache::getImage(const CTFDescription &ctf, int Ydim, int Xdim, MultidimArray<double> *&img)
+{
+    Key key;
+    double *v = key.values;
+    *v++ = round(ctf.DeltafU / defocusStep);
+    *v++ = round(ctf.DeltafV / defocusStep);
+    *v++ = round(ctf.azimuthal_angle / angleStep);
+    *v++ = Ydim;
+    *v++ = Xdim;
+    // Pure CTF
+    *v++ = ctf.enable_CTF;
+    *v++ = ctf.K;
+    *v++ = ctf.Tm;
+    *v++ = ctf.kV;
+    *v++ = ctf.Cs;
+    *v++ = ctf.Ca;
+    *v++ = ctf.espr;
+    *v++ = ctf.ispr;
+    *v++ = ctf.alpha;
+    *v++ = ctf.DeltaF;
+    *v++ = ctf.DeltaR;
+    *v++ = ctf.Q0;
+    *v++ = ctf.envR0;
+    *v++ = ctf.envR1;
+    *v++ = ctf.envR2;
+    // Background noise
+    *v++ = ctf.enable_CTFnoise;
+    *v++ = ctf.base_line;
+    *v++ = ctf.gaussian_K;
+    *v++ = ctf.sigmaU;
+    *v++ = ctf.sigmaV;
+    *v++ = ctf.cU;
+    *v++ = ctf.cV;
+    *v++ = ctf.gaussian_angle;
+    *v++ = ctf.sqrt_K;
+    *v++ = ctf.sqU;
+    *v++ = ctf.sqV;
+    *v++ = ctf.sqrt_angle;
+    *v++ = ctf.gaussian_K2;
+    *v++ = ctf.sigmaU2;
+    *v++ = ctf.sigmaV2;
+    *v++ = ctf.cU2;
+    *v++ = ctf.cV2;
+    *v++ = ctf.gaussian_angle2;
+    *v++ = ctf.bgR1;
+    *v++ = ctf.bgR2;
+    *v++ = ctf.bgR3;
+
+    std::map<Key, std::list<Entry>::iterator>::iterator it = index.find(key);
+    if (it != index.end())
+    {
+        ++hits;
+        entries.splice(entries.begin(), entries, it->second);
+        img = &(entries.front().img);
+        return true;
+    }
+
+    ++misses;
+    if (entries.size() < maxImages)
+        entries.push_front(Entry());
+    else
+    {
+        // Reuse the least recently used entry
+        index.erase(entries.back().key);
+        entries.splice(entries.begin(), entries, --entries.end());
+    }
+    Entry &entry = entries.front();
+    entry.key = key;
+    index[key] = entries.begin();
+    img = &(entry.img);
+    return false;
+}
+
+std::ostream & operator << (std::ostream &out, const CTFImageCache &cache)
+{
+    size_t total = cache.hits + cache.misses;
+    out << "CTF image cache: " << cache.hits << " hits, " << cache.misses << " misses";
+    if (total > 0)
+        out << " (" << 100.0 * cache.hits / total << "% hits)";
+    out << std::endl;
+    return out;
+}
+
 /* Look for zeroes, maxima or minima ------------------------------------------------------------ */
 //#define DEBUG
 void CTFDescription::lookFor(int n, const Matrix1D<double> &u, Matrix1D<double> &freq, int iwhat)
@@ -531,6 +810,17 @@ void CTFDescription::applyCTF(MultidimArray < std::complex<double> > &FFTI, cons
     if ( ZSIZE(FFTI) > 1 )
         REPORT_ERROR(ERR_MULTIDIM_DIM,"ERROR: Apply_CTF only works on 2D images, not 3D.");
 
+    if (enable_CTF && !enable_CTFnoise && YSIZE(FFTI) == YSIZE(I) && XSIZE(FFTI) == XSIZE(I) / 2 + 1)
+    {
+        getCTFGrid(YSIZE(I), XSIZE(I), gridCTF, true, true, Ts);
+        FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(FFTI)
+        {
+            double ctf = DIRECT_MULTIDIM_ELEM(gridCTF, n);
+            DIRECT_MULTIDIM_ELEM(FFTI, n) *= absPhase ? fabs(ctf) : ctf;
+        }
+        return;
+    }
+
     double iTs=1.0/Ts;
     FOR_ALL_ELEMENTS_IN_ARRAY2D(FFTI)
     {
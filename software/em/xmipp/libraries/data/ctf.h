@@ -30,6 +30,7 @@
 #include "xmipp_filename.h"
 #include "metadata.h"
 #include "xmipp_fft.h"
+#include <list>
 
 
 const int CTF_BASIC_LABELS_SIZE = 5;
@@ -85,6 +86,36 @@ public:
     double deltaf;
 };
 
+/** Frequency tables of a 2D grid in FFT order.
+    They only depend on the grid size and the sampling rate, so that the
+    CTFs of all the images with the same size are evaluated with the same
+    tables. If halfComplex, only the Xdim/2+1 columns of the Fourier
+    transforms of FourierTransformer are in the grid. */
+class PrecomputedForCTFGrid
+{
+public:
+    int Ydim, Xdim, XdimGrid;
+    double Ts;
+    // Frequency module and its powers
+    std::vector<double> u, u2, u4;
+    // Cosine and sine of twice the frequency angle
+    std::vector<double> cos2ang, sin2ang;
+
+    /// Empty constructor
+    PrecomputedForCTFGrid(): Ydim(0), Xdim(0), XdimGrid(0), Ts(0)
+    {}
+
+    /// True if the tables are the ones of this grid
+    bool isComputed(int Ydim, int Xdim, bool halfComplex, double Ts) const
+    {
+        return this->Ydim == Ydim && this->Xdim == Xdim && this->Ts == Ts &&
+               XdimGrid == (halfComplex ? Xdim / 2 + 1 : Xdim);
+    }
+
+    /// Compute the tables of a grid
+    void compute(int Ydim, int Xdim, bool halfComplex, double Ts);
+};
+
 /** CTF class.
     Here goes how to compute the radial average of a parametric CTF:
 
@@ -237,6 +268,15 @@ public:
     std::vector<PrecomputedForCTF> precomputedImage;
     // Xdim size of the image
     int precomputedImageXdim;
+    // Frequency tables of the last grid evaluated as a whole
+    PrecomputedForCTFGrid precomputedGrid;
+    // Defocus on the grid
+    std::vector<double> gridDeltaf;
+    // Radial part of the envelope on the grid, and the constants it was computed with
+    std::vector<double> gridEnvelope;
+    double gridK3, gridK5, gridDeltaR;
+    // CTF on the grid, for the filters applied in Fourier space
+    MultidimArray<double> gridCTF;
 public:
     /// Global gain. By default, 1
     double K;
@@ -659,6 +699,40 @@ public:
     /// Apply CTF to an image
     void applyCTF(MultidimArray <double> &I, double Ts, bool absPhase=false);
 
+    /** Pure CTF of a whole 2D grid in FFT order.
+        The CTF is evaluated at all the frequencies of a Ydim x Xdim image
+        with sampling rate Ts (Tm if negative), or at the Xdim/2+1 columns of
+        its Fourier transform if halfComplex. The frequency tables and the
+        radial part of the envelope are reused while the grid and the
+        constants of the microscope do not change, so evaluating the CTFs
+        of many images of the same size only costs a sine, a cosine and an
+        exponential per frequency. Without damping the CTF is
+        -(Ksin*sin - Kcos*cos) as in getValuePureWithoutDampingAt.
+        Call produceSideInfo before. */
+    void getCTFGrid(int Ydim, int Xdim, MultidimArray<double> &values,
+                    bool halfComplex = false, bool withDamping = true, double Ts = -1);
+
+    /** Phase flip in Fourier space.
+        FFTI is the Fourier transform given by FourierTransformer of an image of
+        size Ydim x Xdim. Each coefficient is multiplied by the sign of the CTF. */
+    void applyPhaseFlip(MultidimArray< std::complex<double> > &FFTI, int Ydim, int Xdim, double Ts = -1);
+
+    /** Wiener filter in Fourier space.
+        FFTI is as in applyPhaseFlip. Each coefficient is multiplied by
+        CTF/(CTF^2+wienerConstant). If wienerConstant is negative, 10% of the
+        average of CTF^2 over the whole image is taken (Grigorieff, JSB 157(1) 2006).
+        If the images are phase flipped, the absolute value of the CTF is used. */
+    void applyWienerFilter(MultidimArray< std::complex<double> > &FFTI, int Ydim, int Xdim,
+                           double wienerConstant, bool phaseFlipped = false,
+                           bool withDamping = true, double Ts = -1);
+
+    /** Wiener filter of applyWienerFilter.
+        The filter is evaluated at the Xdim/2+1 columns of the Fourier
+        transform of a Ydim x Xdim image. */
+    void getWienerFilter(int Ydim, int Xdim, MultidimArray<double> &filter,
+                         double wienerConstant, bool phaseFlipped = false,
+                         bool withDamping = true, double Ts = -1);
+
     /** Generate CTF image.
         The sample image is used only to take its dimensions. */
     template <class T1, class T2>
@@ -696,6 +770,14 @@ public:
 			std::cout << "CTF:\n" << *this << std::endl;
 		#endif
 
+        if (enable_CTF && !enable_CTFnoise)
+        {
+            getCTFGrid(Ydim, Xdim, gridCTF, false, true, Ts);
+            FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(CTF)
+            DIRECT_MULTIDIM_ELEM(CTF, n) = (T) DIRECT_MULTIDIM_ELEM(gridCTF, n);
+            return;
+        }
+
         double iTs=1.0/Ts;
         for (int i=0; i<Ydim; ++i)
         {
@@ -723,32 +805,9 @@ public:
     void generateCTFWithoutDamping(int Ydim, int Xdim, MultidimArray < T > &CTF, double Ts=-1)
     {
         CTF.resizeNoCopy(Ydim, Xdim);
-        if (Ts<0)
-        	Ts=Tm;
-		#ifdef DEBUG
-			std::cout << "CTF:\n" << *this << std::endl;
-		#endif
-
-        double iTs=1.0/Ts;
-        for (int i=0; i<Ydim; ++i)
-        {
-        	double wy;
-        	FFT_IDX2DIGFREQ(i, YSIZE(CTF), wy);
-            double fy=wy*iTs;
-        	for (int j=0; j<Xdim; ++j)
-        	{
-            	double wx;
-            	FFT_IDX2DIGFREQ(j, XSIZE(CTF), wx);
-                double fx=wx*iTs;
-				precomputeValues(fx, fy);
-				A2D_ELEM(CTF, i, j) = (T) getValuePureWithoutDampingAt();
-				#ifdef DEBUG
-						if (i == 0)
-							std::cout << i << " " << j << " " << YY(freq) << " " << XX(freq)
-							<< " " << CTF(i, j) << std::endl;
-				#endif
-        	}
-        }
+        getCTFGrid(Ydim, Xdim, gridCTF, false, false, Ts);
+        FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(CTF)
+        DIRECT_MULTIDIM_ELEM(CTF, n) = (T) DIRECT_MULTIDIM_ELEM(gridCTF, n);
     }
     #undef DEBUG
 
@@ -761,6 +820,76 @@ public:
     void forcePhysicalMeaning();
 };
 
+/** Cache of CTF images.
+    Images generated from a CTF (the CTF itself, its Wiener filter, ...) are
+    kept in memory, so that the particles of the same micrograph or defocus
+    group do not generate them again. The images are identified by all the
+    parameters of the CTF that change its value (the defocus and astigmatism
+    angle quantized with the given steps, the rest exactly) and by the image
+    size. The way the images are generated from the CTF must be the same for
+    all the images in the cache. When the cache is full, the least recently
+    used image is replaced. The cache is not thread safe.
+    @code
+    CTFImageCache cache(100);
+    MultidimArray<double> *filter;
+    if (!cache.getImage(ctf, Ydim, Xdim, filter))
+        ctf.getWienerFilter(Ydim, Xdim, *filter, 0.1);
+    @endcode
+ */
+class CTFImageCache
+{
+public:
+    /// Maximum number of images
+    size_t maxImages;
+    /// Quantization step of the defocus (Angstroms)
+    double defocusStep;
+    /// Quantization step of the astigmatism angle (degrees)
+    double angleStep;
+    /// Number of images found in the cache
+    size_t hits;
+    /// Number of images that were not in the cache
+    size_t misses;
+
+protected:
+    // CTF parameters and image size
+    struct Key
+    {
+        static const int size = 41;
+        double values[size];
+        bool operator<(const Key &other) const
+        {
+            for (int i = 0; i < size; ++i)
+                if (values[i] != other.values[i])
+                    return values[i] < other.values[i];
+            return false;
+        }
+    };
+    struct Entry
+    {
+        Key key;
+        MultidimArray<double> img;
+    };
+    // Most recently used first
+    std::list<Entry> entries;
+    std::map<Key, std::list<Entry>::iterator> index;
+
+public:
+    /// Empty constructor
+    CTFImageCache(size_t maxImages = 256, double defocusStep = 1, double angleStep = 0.1);
+
+    /// Remove all images and reset the counters
+    void clear();
+
+    /** Image for this CTF and size.
+        Returns true if the image was in the cache. Otherwise the returned
+        image has to be generated by the caller. The pointer is valid until
+        the next call. */
+    bool getImage(const CTFDescription &ctf, int Ydim, int Xdim, MultidimArray<double> *&img);
+
+    /// Show hits and misses
+    friend std::ostream & operator << (std::ostream &out, const CTFImageCache &cache);
+};
+
 /** Generate CTF 2D image with two CTFs.
  * The two CTFs are in fn1 and fn2. The output image is written to the file fnOut and has size Xdim x Xdim. */
 void generateCTFImageWith2CTFs(const MetaData &MD1, const MetaData &MD2, int Xdim, MultidimArray<double> &imgOut);
@@ -1227,6 +1227,34 @@ double bestShift(const MultidimArray< std::complex<double> > &FFTI1,
 	return bestShift(Mcorr, shiftX, shiftY, mask, maxShift);
 }
 
+double bestShift(const MultidimArray< std::complex<float> > &FFTI1,
+                 const MultidimArray< std::complex<float> > &FFTI2,
+                 MultidimArray<double> &Mcorr,
+                 double &shiftX, double &shiftY, CorrelationAuxFloat &aux,
+                 const MultidimArray<int> *mask, int maxShift)
+{
+    aux.Mcorr.resizeNoCopy(Mcorr);
+    correlation_matrix(FFTI1, FFTI2, aux.Mcorr, aux);
+    typeCast(aux.Mcorr, Mcorr);
+    return bestShift(Mcorr, shiftX, shiftY, mask, maxShift);
+}
+
+double bestShift(const MultidimArray<double> &I1, const MultidimArray<double> &I2,
+                 double &shiftX, double &shiftY, CorrelationAuxFloat &aux,
+                 const MultidimArray<int> *mask, int maxShift)
+{
+    I1.checkDimension(2);
+    I2.checkDimension(2);
+
+    typeCast(I1, aux.I1);
+    typeCast(I2, aux.I2);
+    aux.transformer1.FourierTransform(aux.I1, aux.FFT1, false);
+    correlation_matrix(aux.FFT1, aux.I2, aux.Mcorr, aux);
+    MultidimArray<double> Mcorr;
+    typeCast(aux.Mcorr, Mcorr);
+    return bestShift(Mcorr, shiftX, shiftY, mask, maxShift);
+}
+
 /* Best shift -------------------------------------------------------------- */
 void bestShift(const MultidimArray<double> &I1, const MultidimArray<double> &I2,
                double &shiftX, double &shiftY, double &shiftZ, CorrelationAux &aux,
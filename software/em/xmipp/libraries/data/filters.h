@@ -483,6 +483,26 @@ double bestShift(const MultidimArray< std::complex<double> > &FFTI1,
                double &shiftX, double &shiftY, CorrelationAux &aux,
                const MultidimArray<int> *mask=NULL, int maxShift=-1);
 
+/** Translational search in single precision.
+ * Assumes that FFTI1 and FFTI2 are already computed. The correlation is computed
+ * in single precision and the maximum is searched in Mcorr, that must already have
+ * the right size.
+ */
+double bestShift(const MultidimArray< std::complex<float> > &FFTI1,
+                 const MultidimArray< std::complex<float> > &FFTI2,
+                 MultidimArray<double> &Mcorr,
+                 double &shiftX, double &shiftY, CorrelationAuxFloat &aux,
+                 const MultidimArray<int> *mask=NULL, int maxShift=-1);
+
+/** Translational search in single precision.
+ * The images are converted to single precision and their correlation is
+ * computed with single precision transforms. The maximum is searched
+ * as in the double precision version.
+ */
+double bestShift(const MultidimArray<double> &I1, const MultidimArray<double> &I2,
+                 double &shiftX, double &shiftY, CorrelationAuxFloat &aux,
+                 const MultidimArray<int> *mask=NULL, int maxShift=-1);
+
 /** Translational search (3D)
  * @ingroup Filters
  *
@@ -231,6 +231,7 @@ void reset(Image<double> &op)
 void ProgOperate::defineParams()
 {
     each_image_produces_an_output = true;
+    allow_io_threads = true;
     save_metadata_stack = true;
     keep_input_columns = true;
     addUsageLine("A simple Xmipp images calculator. Binary and unary operations");
@@ -446,7 +447,7 @@ void ProgOperate::readParams()
 void ProgOperate::processImage(const FileName &fnImg, const FileName &fnImgOut, const MDRow &rowIn, MDRow &rowOut)
 {
     Image<double> img;
-    img.readApplyGeo(fnImg, rowIn);
+    readImageApplyGeo(fnImg, rowIn, img);
 
     if (unaryOperator != NULL)
         unaryOperator(img);
@@ -459,5 +460,5 @@ void ProgOperate::processImage(const FileName &fnImg, const FileName &fnImgOut,
         }
         binaryOperator(img, img2);
     }
-    img.write(fnImgOut);
+    writeImage(img, fnImgOut);
 }
@@ -37,6 +37,7 @@ void ProgImageResize::defineParams()
     save_metadata_stack = true;
     keep_input_columns = true;
     allow_apply_geo = true;
+    allow_threads = true;
     temporaryOutput = false;
     XmippMetadataProgram::defineParams();
     //usage
@@ -185,6 +186,7 @@ void ProgImageResize::preProcess()
 void ProgImageResize::processImage(const FileName &fnImg, const FileName &fnImgOut, const MDRow &rowIn, MDRow &rowOut)
 {
     double aux;
+    ImageGeneric img, imgOut;
     if (apply_geo)
     {
         SCALE_SHIFT(MDL_SHIFT_X, XX(resizeFactor));
@@ -215,12 +217,16 @@ void ProgImageResize::processImage(const FileName &fnImg, const FileName &fnImgO
         break;
     case RESIZE_FOURIER:
         selfScaleToSizeFourier(zdimOut, ydimOut, xdimOut, img(), fourier_threads);
+        writeMutex.lock();
         img.write(fnImgOut);
+        writeMutex.unlock();
         return;
     case RESIZE_NONE:
     	break;
     }
+    writeMutex.lock();
     imgOut.write(fnImgOut);
+    writeMutex.unlock();
 }
 
 void ProgImageResize::postProcess()
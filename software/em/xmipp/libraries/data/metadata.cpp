@@ -28,6 +28,7 @@
 #include <algorithm>
 #include <malloc.h>
 #include "metadata.h"
+#include "metadata_columns.h"
 #include "xmipp_image.h"
 #include "xmipp_program_sql.h"
 
@@ -47,6 +48,13 @@ void getBlocksInMetaDataFile(const FileName &inFile, StringVector& blockList)
     {
         getBlocksInMetaDataFileDB(inFile,blockList);
     }
+    else if(extFile=="xmdb")
+    {
+        size_t nrows;
+        String blockName;
+        MDColumns::readBinaryInfo(inFile, nrows, blockName);
+        blockList.push_back(blockName);
+    }
     else
     {    //map file
         int fd;
@@ -139,6 +147,7 @@ void MetaData::init(const std::vector<MDLabel> *labelsVector)
     _clear();
     _maxRows = 0; //by default read all rows
     _parsedLines = 0; //no parsed line;
+    _streamStarReader = false;
     if (labelsVector != NULL)
         this->activeLabels = *labelsVector;
     //Create table in database
@@ -190,7 +199,10 @@ bool MetaData::setValue(const MDObject &mdValueIn, size_t id)
     }
     //add label if not exists, this is checked in addlabel
     addLabel(mdValueIn.label);
-    return myMDSql->setObjectValue(id, mdValueIn);
+    bool result = myMDSql->setObjectValue(id, mdValueIn);
+    if (result && myColumns != NULL && myColumns->isValid())
+        myColumns->setValue(mdValueIn, id);
+    return result;
 }
 
 bool MetaData::setValueCol(const MDObject &mdValueIn)
@@ -208,6 +220,13 @@ bool MetaData::getValue(MDObject &mdValueOut, size_t id) const
     if (id == BAD_OBJID)
         REPORT_ERROR(ERR_MD_NOACTIVE, "getValue: please provide objId other than -1");
 
+    if (myColumns != NULL)
+    {
+        // Threads may be reading the store, it is not rebuilt behind them
+        if (!myColumns->isValid())
+            REPORT_ERROR(ERR_MD, "getValue: the column store is outdated, call setColumnStore again after modifying the metadata");
+        return myColumns->getValue(mdValueOut, id);
+    }
     return myMDSql->getObjectValue(id, mdValueOut);
 }
 
@@ -259,6 +278,27 @@ bool MetaData::getRow(MDRow &row, size_t id) const
     return true;
 }
 
+void MetaData::setColumnStore(bool enable)
+{
+    if (enable)
+    {
+        if (myColumns == NULL)
+            myColumns = new MDColumns();
+        if (!myColumns->isValid())
+            myColumns->build(*myMDSql, activeLabels);
+    }
+    else
+    {
+        delete myColumns;
+        myColumns = NULL;
+    }
+}
+
+bool MetaData::hasColumnStore() const
+{
+    return myColumns != NULL && myColumns->isValid();
+}
+
 //TODO: could be improve in a query for update the entire row
 #define SET_ROW_VALUES(row) \
     for (int i = 0; i < row._size; ++i){\
@@ -282,18 +322,21 @@ size_t MetaData::addRow(const MDRow &row)
 MetaData::MetaData()
 {
     myMDSql = new MDSql(this);
+    myColumns = NULL;
     init(NULL);
 }//close MetaData default Constructor
 
 MetaData::MetaData(const std::vector<MDLabel> *labelsVector)
 {
     myMDSql = new MDSql(this);
+    myColumns = NULL;
     init(labelsVector);
 }//close MetaData default Constructor
 
 MetaData::MetaData(const FileName &fileName, const std::vector<MDLabel> *desiredLabels)
 {
     myMDSql = new MDSql(this);
+    myColumns = NULL;
     init(desiredLabels);
     read(fileName, desiredLabels);
 }//close MetaData from file Constructor
@@ -301,6 +344,7 @@ MetaData::MetaData(const FileName &fileName, const std::vector<MDLabel> *desired
 MetaData::MetaData(const MetaData &md)
 {
     myMDSql = new MDSql(this);
+    myColumns = NULL;
     copyMetadata(md);
 }//close MetaData copy Constructor
 
@@ -314,6 +358,7 @@ MetaData::~MetaData()
 {
     _clear();
     delete myMDSql;
+    delete myColumns;
 }//close MetaData Destructor
 
 //-------- Getters and Setters ----------
@@ -392,7 +437,10 @@ bool MetaData::setValueFromStr(const MDLabel label, const String &value, size_t
     }
     MDObject mdValue(label);
     mdValue.fromString(value);
-    return myMDSql->setObjectValue(id, mdValue);
+    bool result = myMDSql->setObjectValue(id, mdValue);
+    if (result && myColumns != NULL && myColumns->isValid())
+        myColumns->setValue(mdValue, id);
+    return result;
 }
 
 bool MetaData::getStrFromValue(const MDLabel label, String &strOut, size_t id) const
@@ -428,6 +476,9 @@ bool MetaData::addLabel(const MDLabel label, int pos)
     else
         activeLabels.insert(activeLabels.begin() + pos, label);
     myMDSql->addColumn(label);
+    // The new column is empty, it is added to the store without reading the table
+    if (myColumns != NULL && myColumns->isValid())
+        myColumns->addColumn(label);
     return true;
 }
 
@@ -459,7 +510,10 @@ bool MetaData::keepLabels(const std::vector<MDLabel> &labels)
 
 size_t MetaData::addObject()
 {
-    return (size_t)myMDSql->addRow();
+    size_t id = (size_t)myMDSql->addRow();
+    if (myColumns != NULL && myColumns->isValid() && id != BAD_OBJID)
+        myColumns->addRow(id);
+    return id;
 }
 
 void MetaData::importObject(const MetaData &md, const size_t id, bool doClear)
@@ -584,6 +638,11 @@ void MetaData::findObjects(std::vector<size_t> &objectsOut, const MDQuery &query
 void MetaData::findObjects(std::vector<size_t> &objectsOut, int limit) const
 {
     objectsOut.clear();
+    if (myColumns != NULL && myColumns->isValid())
+    {
+        myColumns->getObjIds(objectsOut, limit);
+        return;
+    }
     MDQuery query(limit);
     myMDSql->selectObjects(objectsOut, &query);
 }
@@ -634,6 +693,10 @@ void MetaData::write(const FileName &_outFile, WriteModeMetaData mode) const
     {
         writeDB(outFile, blockName, mode);
     }
+    else if(extFile=="xmdb")
+    {
+        writeBinary(outFile, blockName, mode);
+    }
     else
     {
         writeStar(outFile, blockName, mode);
@@ -1071,9 +1134,188 @@ void MetaData::_readRows(std::istream& is, std::vector<MDObject*> & columnValues
     }
 }
 
-/* This function will be used to parse the rows data in START format
+/* Return the end of the STAR token starting at iter, iter should not be a space.
+ * Quoted tokens end after the closing quote, tokens never go beyond the end of line.
+ */
+static char * _starTokenEnd(char * iter, char * lineEnd)
+{
+    char chr = *iter;
+    if ((chr == _QUOT || chr == _DQUOT) && iter + 1 < lineEnd)
+    {
+        char * close = (char*) memchr(iter + 1, chr, lineEnd - iter - 1);
+        if (close != NULL)
+            return close + 1;
+    }
+    while (iter < lineEnd && !isspace(*iter))
+        ++iter;
+    return iter;
+}
+
+/* Parse the value of a STAR token into an object.
+ * The token should be followed by a space, a newline or a null
+ * character, so strtod and strtoul stop at its end. Int, bool and size_t are read as double for
+ * compatibility with old doc files, as in MDObject::fromStream.
+ */
+static bool _parseStarValue(char * iter, char * tokenEnd, MDObject &object)
+{
+    char * next = iter;
+    double d;
+    char chr = *iter;
+    bool quoted = (chr == _QUOT || chr == _DQUOT) && tokenEnd - iter >= 2 && tokenEnd[-1] == chr;
+
+    switch (object.type)
+    {
+    case LABEL_BOOL:
+        d = strtod(iter, &next);
+        object.data.boolValue = (bool) ((int)d);
+        break;
+    case LABEL_INT:
+        d = strtod(iter, &next);
+        object.data.intValue = (int) d;
+        break;
+    case LABEL_SIZET:
+        d = strtod(iter, &next);
+        object.data.longintValue = (size_t) d;
+        break;
+    case LABEL_DOUBLE:
+        object.data.doubleValue = strtod(iter, &next);
+        break;
+    case LABEL_STRING:
+        if (quoted)
+            object.data.stringValue->assign(iter + 1, tokenEnd - iter - 2);
+        else
+            object.data.stringValue->assign(iter, tokenEnd - iter);
+        return true;
+    case LABEL_VECTOR_DOUBLE:
+    case LABEL_VECTOR_SIZET:
+        {
+            if (quoted)
+            {
+                ++iter;
+                --tokenEnd;
+            }
+            if (object.type == LABEL_VECTOR_DOUBLE)
+                object.data.vectorValue->clear();
+            else
+                object.data.vectorValueLong->clear();
+            while (iter < tokenEnd)
+            {
+                if (object.type == LABEL_VECTOR_DOUBLE)
+                {
+                    d = strtod(iter, &next);
+                    if (next == iter || next > tokenEnd)
+                        break;
+                    object.data.vectorValue->push_back(d);
+                }
+                else
+                {
+                    size_t value = strtoul(iter, &next, 10);
+                    if (next == iter || next > tokenEnd)
+                        break;
+                    object.data.vectorValueLong->push_back(value);
+                }
+                iter = next;
+            }
+            return true;
+        }
+    default:
+        return false;
+    }
+    return next != iter;
+}
+
+/* This function will be used to parse the rows data in START format.
+ * The lines are tokenized in place in the mapped file, only the desired
+ * columns are converted and their values are inserted with a single
+ * prepared statement.
  */
 void MetaData::_readRowsStar(mdBlock &block, std::vector<MDObject*> & columnValues, const std::vector<MDLabel> *desiredLabels)
+{
+    size_t nCol = columnValues.size();
+    size_t n = block.end - block.loop;
+    bool firstTime = true;
+
+    if (n==0)
+        return;
+
+    if (_streamStarReader)
+    {
+        _readRowsStarStream(block, columnValues, desiredLabels);
+        return;
+    }
+
+    // Columns to be stored, the others are skipped without being parsed
+    std::vector<MDObject*> rowValues;
+    std::vector<bool> keepColumn(nCol);
+    for (size_t i = 0; i < nCol; ++i)
+    {
+        MDLabel label = columnValues[i]->label;
+        keepColumn[i] = label != MDL_UNDEFINED &&
+                        (desiredLabels == NULL || vectorContainsLabel(*desiredLabels, label));
+        if (keepColumn[i])
+            rowValues.push_back(columnValues[i]);
+    }
+
+    // Numbers are parsed directly from the mapped file, every token is
+    // followed by a space or a newline that stops strtod
+    char *iter = block.loop, *end = iter + n, * newline = NULL, * tokenEnd;
+    // Null terminated copy of a last line without newline, it may end
+    // the mapped file
+    std::vector<char> lastLine;
+    _parsedLines = 0; //Check how many lines the md have
+    while (iter < end) //while there are data lines
+    {
+        //Assing \n position and check if NULL at the same time
+        if (!(newline = END_OF_LINE()))
+        {
+            lastLine.assign(iter, end);
+            lastLine.push_back('\0');
+            iter = &lastLine[0];
+            end = newline = iter + lastLine.size() - 1;
+        }
+        while (iter < newline && isspace(*iter))
+            ++iter;
+
+        if (iter < newline && iter[0] != '#')
+        {
+            //_maxRows would be > 0 if we only want to read some
+            // rows from the md for performance reasons...
+            // anyway the number of lines will be counted in _parsedLines
+            if (_maxRows == 0 || _parsedLines < _maxRows)
+            {
+                for (size_t i = 0; i < nCol; ++i)
+                {
+                    while (iter < newline && isspace(*iter))
+                        ++iter;
+                    tokenEnd = _starTokenEnd(iter, newline);
+                    if (keepColumn[i])
+                    {
+                        MDObject &object = *(columnValues[i]);
+                        object.failed = iter == tokenEnd || !_parseStarValue(iter, tokenEnd, object);
+                        if (object.failed)
+                            std::cerr << "WARNING: " << formatString("MetaData: Error parsing column '%s' value.",
+                                      MDL::label2Str(object.label).c_str()) << std::endl;
+                    }
+                    iter = tokenEnd;
+                }
+                if (rowValues.empty())
+                    addObject();
+                else
+                {
+                    myMDSql->setObjectValues(rowValues, NULL, firstTime);
+                    firstTime = false;
+                }
+            }
+            _parsedLines++;
+        }
+        iter = newline + 1; //go to next line
+    }
+
+    // Finalize statement.
+    myMDSql->finalizePreparedStmt();
+}
+
+void MetaData::_readRowsStarStream(mdBlock &block, std::vector<MDObject*> & columnValues, const std::vector<MDLabel> *desiredLabels)
 {
     String line;
     std::stringstream ss;
@@ -1165,6 +1407,8 @@ void MetaData::read(const FileName &_filename,
         readXML(inFile, desiredLabels, blockName, decomposeStack);
     else if(extFile=="sqlite")
         readDB(inFile, desiredLabels, blockName, decomposeStack);
+    else if(extFile=="xmdb")
+        readBinary(_filename, desiredLabels, 0, _maxRows);
     else
         readStar(_filename, desiredLabels, blockName, decomposeStack);
 
@@ -1284,6 +1528,40 @@ void MetaData::readDB(const FileName &filename,
 {
     myMDSql->copyTableFromFileDB(blockRegExp, filename, desiredLabels, _maxRows);
 }
+void MetaData::readBinary(const FileName &filename,
+                          const std::vector<MDLabel> *desiredLabels,
+                          size_t firstRow, size_t numberOfRows)
+{
+    FileName inFile = filename.removeBlockName();
+    String blockName = filename.getBlockName(), fileBlockName;
+    size_t fileRows;
+    MDColumns::readBinaryInfo(inFile, fileRows, fileBlockName);
+    if (!blockName.empty() && blockName != fileBlockName)
+        REPORT_ERROR(ERR_MD_BADBLOCK, formatString("Block: '%s': %s",
+                     blockName.c_str(), inFile.c_str()));
+
+    MDColumns columns;
+    std::vector<MDLabel> labels;
+    columns.readBinary(inFile, labels, desiredLabels, firstRow, numberOfRows);
+
+    _clear();
+    myMDSql->createMd();
+    for (size_t i = 0; i < labels.size(); ++i)
+        addLabel(labels[i]);
+    // The rows are inserted in bulk, several per statement
+    if (labels.empty())
+    {
+        size_t nrows = columns.size();
+        for (size_t id = 1; id <= nrows; ++id)
+            addObject();
+    }
+    else
+        myMDSql->writeColumns(columns, labels);
+
+    _parsedLines = fileRows;
+    isMetadataFile = true;
+}
+
 void MetaData::readStar(const FileName &filename,
                         const std::vector<MDLabel> *desiredLabels,
                         const String & blockRegExp,
@@ -2031,6 +2309,20 @@ void MetaData::writeDB(const FileName fn, const FileName blockname, WriteModeMet
     myMDSql->copyTableToFileDB(blockname,fn);
 }
 
+void MetaData::writeBinary(const FileName fn, const FileName blockname, WriteModeMetaData mode) const
+{
+    if(mode!=MD_OVERWRITE)
+        REPORT_ERROR(ERR_NOT_IMPLEMENTED,"Binary metadata is only implemented for overwrite mode");
+    if (myColumns != NULL && myColumns->isValid())
+        myColumns->writeBinary(fn, activeLabels, blockname);
+    else
+    {
+        MDColumns columns;
+        columns.build(*myMDSql, activeLabels);
+        columns.writeBinary(fn, activeLabels, blockname);
+    }
+}
+
 void MetaData::writeXML(const FileName fn, const FileName blockname, WriteModeMetaData mode) const
 {
     //fixme
@@ -117,6 +117,7 @@ bool existsBlockInMetaDataFile(const FileName &inFileWithBlock);
 
 class MDQuery;
 class MDSql;
+class MDColumns;
 class MDValueGenerator;
 
 /** Struct to hold a char * pointer and a size
@@ -233,6 +234,11 @@ protected:
     /** The table id to do db operations */
     MDSql * myMDSql;
 
+    /** In-memory copy of the columns, NULL if not used.
+     * See setColumnStore.
+     */
+    MDColumns * myColumns;
+
     /** Init, do some initializations tasks, used in constructors
      * @ingroup MetaDataConstructors
      */
@@ -286,12 +292,19 @@ protected:
      * @param maxRows if this number if greater than 0, only this number of rows will be parsed.
      */
     void _readRowsStar(mdBlock &block, std::vector<MDObject*> & columnValues, const std::vector<MDLabel> *desiredLabels);
+    /** Previous implementation of _readRowsStar, parsing each line through a stream.
+     * It is used instead of the tokenizer after setStreamStarReader(true),
+     * to compare both readers.
+     */
+    void _readRowsStarStream(mdBlock &block, std::vector<MDObject*> & columnValues, const std::vector<MDLabel> *desiredLabels);
     void _readRowFormat(std::istream& is);
 
     /** This two variables will be used to read the metadata information (labels and size)
      * or maybe a few rows only
      */
     size_t _maxRows, _parsedLines;
+    /// Parse the rows of STAR files with the stream based reader
+    bool _streamStarReader;
 
 public:
     /** @name Constructors
@@ -354,6 +367,16 @@ public:
       _maxRows = maxRows;
     }
 
+    /** Parse the rows of STAR files line by line through a stream, as
+     * done by previous versions, instead of with the tokenizer.
+     * Both readers give the same metadata, this is only meant to compare
+     * them in tests and benchmarks.
+     */
+    void setStreamStarReader(bool stream=true)
+    {
+        _streamStarReader = stream;
+    }
+
     /** Return the number of lines in the metadata file.
      * Serves to know the number of items even is read with
      * maxRows != 0
@@ -399,6 +422,11 @@ public:
      */
     void writeDB(const FileName fn, const FileName blockname, WriteModeMetaData mode) const;
 
+    /** Write metadata in binary columnar file (.xmdb).
+     * Only overwrite mode is supported, each file holds a single block.
+     */
+    void writeBinary(const FileName fn, const FileName blockname, WriteModeMetaData mode) const;
+
     /** Write metadata in text file as plain data without header.
      *
      */
@@ -608,6 +636,28 @@ public:
     /** Get all values of an MetaData row of an specified objId*/
     bool getRow(MDRow &row, size_t id) const;
 
+    /** Keep a columnar copy of the values in memory.
+     * When enabled, getValue and getRow are served from typed column
+     * vectors indexed by objId instead of running one SQL statement
+     * per value, which is much faster in loops over many objects.
+     * setValue, addObject and new labels update both the table and the
+     * columns. Any other modification leaves the columns outdated, and
+     * getValue reports an error until this function is called again or
+     * the store is disabled. Queries, sorting and set operations are
+     * still done in SQL.
+     * Use it only for metadata that are mostly read, as the input of a
+     * program: the whole table is copied in memory.
+     * Once the columns are built, getValue, getRow, containsLabel and
+     * findObjects (without query) do not access the SQL connection, so
+     * several threads can share the same metadata and read it at the
+     * same time as long as nobody modifies it meanwhile. The columns
+     * are built by this call, do it before starting the threads.
+     */
+    void setColumnStore(bool enable = true);
+
+    /** True if the values are kept in memory by columns and they are up to date */
+    bool hasColumnStore() const;
+
     /** Copy all the values in the input row in the current metadata*/
     void setRow(const MDRow &row, size_t id);
 
@@ -810,6 +860,15 @@ public:
                 const String & blockRegExp=DEFAULT_BLOCK_NAME,
                 bool decomposeStack=true);
 
+    /** Read metadata from binary columnar file (.xmdb).
+     * Only the rows [firstRow, firstRow+numberOfRows) are read, all of them
+     * if numberOfRows is 0, so that each MPI node can read its own part.
+     * The columns not in desiredLabels are not read from disk.
+     */
+    void readBinary(const FileName &inFile,
+                    const std::vector<MDLabel> *desiredLabels= NULL,
+                    size_t firstRow=0, size_t numberOfRows=0);
+
     /** Read data from file. Guess the blockname from the filename
      * @code
      * inFilename="first@md1.doc" -> filename = md1.doc, blockname = first
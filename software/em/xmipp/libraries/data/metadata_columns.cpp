@@ -0,0 +1,596 @@
+/***************************************************************************
+ *
+ * Authors:     agent (agent@local)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#include <stdint.h>
+#include "metadata_columns.h"
+#include "metadata_sql.h"
+
+/* Binary metadata format */
+#define MDBINARY_MAGIC "XMDB"
+#define MDBINARY_VERSION 2
+#define MDBINARY_BYTE_ORDER 0x01020304
+
+/* Type tags of the columns in the binary format. They are part of the
+ * format, so they must not change if MDLabelType is reordered.
+ */
+#define MDBINARY_BOOL 1
+#define MDBINARY_INT 2
+#define MDBINARY_SIZET 3
+#define MDBINARY_DOUBLE 4
+#define MDBINARY_STRING 5
+#define MDBINARY_VECTOR_DOUBLE 6
+#define MDBINARY_VECTOR_SIZET 7
+
+MDColumn::MDColumn(MDLabel label)
+{
+    this->label = label;
+    type = MDL::labelType(label);
+}
+
+void MDColumn::resize(size_t nrows)
+{
+    switch (type)
+    {
+    case LABEL_BOOL:
+        boolValues.resize(nrows, 0);
+        break;
+    case LABEL_INT:
+        intValues.resize(nrows, 0);
+        break;
+    case LABEL_SIZET:
+        sizetValues.resize(nrows, 0);
+        break;
+    case LABEL_DOUBLE:
+        doubleValues.resize(nrows, 0.);
+        break;
+    case LABEL_STRING:
+        stringValues.resize(nrows);
+        break;
+    case LABEL_VECTOR_DOUBLE:
+        vectorValues.resize(nrows);
+        break;
+    case LABEL_VECTOR_SIZET:
+        vectorSizetValues.resize(nrows);
+        break;
+    default:
+        REPORT_ERROR(ERR_ARG_INCORRECT, "MDColumn: do not know how to store this type");
+    }
+}
+
+void MDColumn::get(size_t row, MDObject &value) const
+{
+    switch (type)
+    {
+    case LABEL_BOOL:
+        value.data.boolValue = boolValues[row] != 0;
+        break;
+    case LABEL_INT:
+        value.data.intValue = intValues[row];
+        break;
+    case LABEL_SIZET:
+        value.data.longintValue = sizetValues[row];
+        break;
+    case LABEL_DOUBLE:
+        value.data.doubleValue = doubleValues[row];
+        break;
+    case LABEL_STRING:
+        value.data.stringValue->assign(stringValues[row]);
+        break;
+    case LABEL_VECTOR_DOUBLE:
+        *(value.data.vectorValue) = vectorValues[row];
+        break;
+    case LABEL_VECTOR_SIZET:
+        *(value.data.vectorValueLong) = vectorSizetValues[row];
+        break;
+    default:
+        break;
+    }
+}
+
+void MDColumn::set(size_t row, const MDObject &value)
+{
+    switch (type)
+    {
+    case LABEL_BOOL:
+        boolValues[row] = value.data.boolValue ? 1 : 0;
+        break;
+    case LABEL_INT:
+        intValues[row] = value.data.intValue;
+        break;
+    case LABEL_SIZET:
+        sizetValues[row] = value.data.longintValue;
+        break;
+    case LABEL_DOUBLE:
+        doubleValues[row] = value.data.doubleValue;
+        break;
+    case LABEL_STRING:
+        stringValues[row] = *(value.data.stringValue);
+        break;
+    case LABEL_VECTOR_DOUBLE:
+        vectorValues[row] = *(value.data.vectorValue);
+        break;
+    case LABEL_VECTOR_SIZET:
+        vectorSizetValues[row] = *(value.data.vectorValueLong);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Size of each element of a column in the binary format */
+static size_t binaryElementSize(MDLabelType type)
+{
+    switch (type)
+    {
+    case LABEL_BOOL:
+    case LABEL_STRING:
+        return 1;
+    case LABEL_INT:
+        return sizeof(int);
+    case LABEL_SIZET:
+    case LABEL_VECTOR_SIZET:
+        return sizeof(size_t);
+    case LABEL_DOUBLE:
+    case LABEL_VECTOR_DOUBLE:
+        return sizeof(double);
+    default:
+        REPORT_ERROR(ERR_MD_BADTYPE, "MDColumn: do not know how to store this type");
+    }
+    return 0;
+}
+
+/* Tag of a column type in the binary format */
+static int32_t binaryTypeTag(MDLabelType type)
+{
+    switch (type)
+    {
+    case LABEL_BOOL:
+        return MDBINARY_BOOL;
+    case LABEL_INT:
+        return MDBINARY_INT;
+    case LABEL_SIZET:
+        return MDBINARY_SIZET;
+    case LABEL_DOUBLE:
+        return MDBINARY_DOUBLE;
+    case LABEL_STRING:
+        return MDBINARY_STRING;
+    case LABEL_VECTOR_DOUBLE:
+        return MDBINARY_VECTOR_DOUBLE;
+    case LABEL_VECTOR_SIZET:
+        return MDBINARY_VECTOR_SIZET;
+    default:
+        REPORT_ERROR(ERR_MD_BADTYPE, "MDColumn: do not know how to store this type");
+    }
+    return 0;
+}
+
+/* Fill the index of a variable size column with the offset of each row */
+template<typename T>
+static void binaryIndex(const std::vector<T> &values, std::vector<uint64_t> &index)
+{
+    size_t nrows = values.size();
+    index.resize(nrows + 1);
+    index[0] = 0;
+    for (size_t i = 0; i < nrows; ++i)
+        index[i + 1] = index[i] + values[i].size();
+}
+
+/* Variable size columns are stored as an index of nrows+1 offsets
+ * followed by the elements of all the rows.
+ */
+template<typename T>
+static void writeVariableColumn(FILE * fp, const std::vector<T> &values)
+{
+    std::vector<uint64_t> index;
+    binaryIndex(values, index);
+    fwrite(&index[0], sizeof(uint64_t), index.size(), fp);
+    for (size_t i = 0; i < values.size(); ++i)
+        if (!values[i].empty())
+            fwrite(&(values[i][0]), sizeof(values[i][0]), values[i].size(), fp);
+}
+
+template<typename T>
+static void readVariableColumn(FILE * fp, size_t offset, size_t firstRow, size_t nrows,
+                               size_t totalRows, bool swap, std::vector<T> &values)
+{
+    typedef typename T::value_type E;
+    std::vector<uint64_t> index(nrows + 1);
+    fseek(fp, offset + firstRow * sizeof(uint64_t), SEEK_SET);
+    if (xmippFREAD(&index[0], sizeof(uint64_t), nrows + 1, fp, swap) != nrows + 1)
+        REPORT_ERROR(ERR_IO_NOREAD, "MDColumn: cannot read the column index");
+    std::vector<E> elements(index[nrows] - index[0]);
+    fseek(fp, offset + (totalRows + 1) * sizeof(uint64_t) + index[0] * sizeof(E), SEEK_SET);
+    if (!elements.empty() &&
+        xmippFREAD(&elements[0], sizeof(E), elements.size(), fp, swap && sizeof(E) > 1) != elements.size())
+        REPORT_ERROR(ERR_IO_NOREAD, "MDColumn: cannot read the column values");
+    values.resize(nrows);
+    for (size_t i = 0; i < nrows; ++i)
+        values[i].assign(elements.begin() + (index[i] - index[0]),
+                         elements.begin() + (index[i + 1] - index[0]));
+}
+
+template<typename T>
+static void readFixedColumn(FILE * fp, size_t offset, size_t firstRow, size_t nrows,
+                            bool swap, std::vector<T> &values)
+{
+    values.resize(nrows);
+    if (nrows == 0)
+        return;
+    fseek(fp, offset + firstRow * sizeof(T), SEEK_SET);
+    if (xmippFREAD(&values[0], sizeof(T), nrows, fp, swap && sizeof(T) > 1) != nrows)
+        REPORT_ERROR(ERR_IO_NOREAD, "MDColumn: cannot read the column values");
+}
+
+size_t MDColumn::binarySize() const
+{
+    std::vector<uint64_t> index;
+    switch (type)
+    {
+    case LABEL_BOOL:
+        return boolValues.size();
+    case LABEL_INT:
+        return intValues.size() * sizeof(int);
+    case LABEL_SIZET:
+        return sizetValues.size() * sizeof(size_t);
+    case LABEL_DOUBLE:
+        return doubleValues.size() * sizeof(double);
+    case LABEL_STRING:
+        binaryIndex(stringValues, index);
+        break;
+    case LABEL_VECTOR_DOUBLE:
+        binaryIndex(vectorValues, index);
+        break;
+    case LABEL_VECTOR_SIZET:
+        binaryIndex(vectorSizetValues, index);
+        break;
+    default:
+        return 0;
+    }
+    return index.size() * sizeof(uint64_t) + index.back() * binaryElementSize(type);
+}
+
+void MDColumn::writeBinary(FILE * fp) const
+{
+    switch (type)
+    {
+    case LABEL_BOOL:
+        if (!boolValues.empty())
+            fwrite(&boolValues[0], 1, boolValues.size(), fp);
+        break;
+    case LABEL_INT:
+        if (!intValues.empty())
+            fwrite(&intValues[0], sizeof(int), intValues.size(), fp);
+        break;
+    case LABEL_SIZET:
+        if (!sizetValues.empty())
+            fwrite(&sizetValues[0], sizeof(size_t), sizetValues.size(), fp);
+        break;
+    case LABEL_DOUBLE:
+        if (!doubleValues.empty())
+            fwrite(&doubleValues[0], sizeof(double), doubleValues.size(), fp);
+        break;
+    case LABEL_STRING:
+        writeVariableColumn(fp, stringValues);
+        break;
+    case LABEL_VECTOR_DOUBLE:
+        writeVariableColumn(fp, vectorValues);
+        break;
+    case LABEL_VECTOR_SIZET:
+        writeVariableColumn(fp, vectorSizetValues);
+        break;
+    default:
+        break;
+    }
+}
+
+void MDColumn::readBinary(FILE * fp, size_t offset, size_t firstRow, size_t nrows,
+                          size_t totalRows, bool swap)
+{
+    switch (type)
+    {
+    case LABEL_BOOL:
+        readFixedColumn(fp, offset, firstRow, nrows, swap, boolValues);
+        break;
+    case LABEL_INT:
+        readFixedColumn(fp, offset, firstRow, nrows, swap, intValues);
+        break;
+    case LABEL_SIZET:
+        readFixedColumn(fp, offset, firstRow, nrows, swap, sizetValues);
+        break;
+    case LABEL_DOUBLE:
+        readFixedColumn(fp, offset, firstRow, nrows, swap, doubleValues);
+        break;
+    case LABEL_STRING:
+        readVariableColumn(fp, offset, firstRow, nrows, totalRows, swap, stringValues);
+        break;
+    case LABEL_VECTOR_DOUBLE:
+        readVariableColumn(fp, offset, firstRow, nrows, totalRows, swap, vectorValues);
+        break;
+    case LABEL_VECTOR_SIZET:
+        readVariableColumn(fp, offset, firstRow, nrows, totalRows, swap, vectorSizetValues);
+        break;
+    default:
+        break;
+    }
+}
+
+MDColumns::MDColumns()
+{
+    for (int i = 0; i < MDL_LAST_LABEL; ++i)
+        columns[i] = NULL;
+    valid = false;
+}
+
+MDColumns::~MDColumns()
+{
+    clear();
+}
+
+void MDColumns::clear()
+{
+    for (int i = 0; i < MDL_LAST_LABEL; ++i)
+    {
+        delete columns[i];
+        columns[i] = NULL;
+    }
+    activeColumns.clear();
+    objIds.clear();
+    rowOf.clear();
+    valid = false;
+}
+
+void MDColumns::build(MDSql &sql, const std::vector<MDLabel> &labels)
+{
+    buildMutex.lock();
+    clear();
+    for (size_t i = 0; i < labels.size(); ++i)
+        addColumn(labels[i]);
+    sql.readColumns(*this, labels);
+    valid = true;
+    buildMutex.unlock();
+}
+
+void MDColumns::addColumn(MDLabel label)
+{
+    if (columns[label] != NULL || MDL::labelType(label) == LABEL_NOTYPE)
+        return;
+    columns[label] = new MDColumn(label);
+    columns[label]->resize(objIds.size());
+    activeColumns.push_back(columns[label]);
+}
+
+void MDColumns::addRow(size_t id)
+{
+    if (id >= rowOf.size())
+        rowOf.resize(id + 1, MDCOLUMNS_NO_ROW);
+    rowOf[id] = objIds.size();
+    objIds.push_back(id);
+    size_t nrows = objIds.size();
+    for (size_t i = 0; i < activeColumns.size(); ++i)
+        activeColumns[i]->resize(nrows);
+}
+
+void MDColumns::getObjIds(std::vector<size_t> &ids, int limit) const
+{
+    if (limit < 0 || (size_t)limit >= objIds.size())
+        ids = objIds;
+    else
+        ids.assign(objIds.begin(), objIds.begin() + limit);
+}
+
+bool MDColumns::getValue(MDObject &value, size_t id) const
+{
+    const MDColumn * column = columns[value.label];
+    if (column == NULL || id >= rowOf.size() || rowOf[id] == MDCOLUMNS_NO_ROW)
+        return false;
+    column->get(rowOf[id], value);
+    return true;
+}
+
+bool MDColumns::setValue(const MDObject &value, size_t id)
+{
+    MDColumn * column = columns[value.label];
+    if (column == NULL || id >= rowOf.size() || rowOf[id] == MDCOLUMNS_NO_ROW)
+        return false;
+    column->set(rowOf[id], value);
+    return true;
+}
+
+/* Header of a binary metadata file */
+struct MDBinaryHeader
+{
+    bool swap;
+    uint64_t nrows;
+    String blockName;
+    std::vector<String> names;
+    std::vector<int32_t> types;
+    std::vector<uint64_t> offsets;
+    std::vector<uint64_t> sizes;
+};
+
+/* Closes the file when it goes out of scope, also when an error is reported */
+class MDBinaryFile
+{
+public:
+    FILE * fp;
+    MDBinaryFile(const FileName &fn, const char * mode)
+    {
+        fp = fopen(fn.c_str(), mode);
+    }
+    ~MDBinaryFile()
+    {
+        if (fp != NULL)
+            fclose(fp);
+    }
+private:
+    MDBinaryFile(const MDBinaryFile &);
+    MDBinaryFile & operator=(const MDBinaryFile &);
+};
+
+static void writeBinaryString(FILE * fp, const String &str)
+{
+    uint32_t length = str.size();
+    fwrite(&length, sizeof(uint32_t), 1, fp);
+    fwrite(str.c_str(), 1, length, fp);
+}
+
+static void readBinaryString(FILE * fp, bool swap, String &str)
+{
+    uint32_t length;
+    if (xmippFREAD(&length, sizeof(uint32_t), 1, fp, swap) != 1)
+        REPORT_ERROR(ERR_IO_NOREAD, "MDColumns: cannot read binary metadata header");
+    std::vector<char> buffer(length + 1, 0);
+    if (fread(&buffer[0], 1, length, fp) != length)
+        REPORT_ERROR(ERR_IO_NOREAD, "MDColumns: cannot read binary metadata header");
+    str = &buffer[0];
+}
+
+static void readBinaryHeader(FILE * fp, const FileName &fn, MDBinaryHeader &header)
+{
+    char magic[4];
+    uint32_t byteOrder, version, ncols;
+    if (fread(magic, 1, 4, fp) != 4 || strncmp(magic, MDBINARY_MAGIC, 4) != 0)
+        REPORT_ERROR(ERR_IO_NOREAD, formatString("MDColumns: %s is not a binary metadata file", fn.c_str()));
+    if (fread(&byteOrder, sizeof(uint32_t), 1, fp) != 1)
+        REPORT_ERROR(ERR_IO_NOREAD, formatString("MDColumns: cannot read header of %s", fn.c_str()));
+    header.swap = byteOrder != MDBINARY_BYTE_ORDER;
+    xmippFREAD(&version, sizeof(uint32_t), 1, fp, header.swap);
+    // Version 1 stored the values of MDLabelType as column types
+    if (version != MDBINARY_VERSION)
+        REPORT_ERROR(ERR_IO_NOREAD, formatString("MDColumns: unsupported binary metadata version %d in %s",
+                     version, fn.c_str()));
+    xmippFREAD(&ncols, sizeof(uint32_t), 1, fp, header.swap);
+    if (xmippFREAD(&header.nrows, sizeof(uint64_t), 1, fp, header.swap) != 1)
+        REPORT_ERROR(ERR_IO_NOREAD, formatString("MDColumns: cannot read header of %s", fn.c_str()));
+    readBinaryString(fp, header.swap, header.blockName);
+    header.names.resize(ncols);
+    header.types.resize(ncols);
+    header.offsets.resize(ncols);
+    header.sizes.resize(ncols);
+    for (size_t i = 0; i < ncols; ++i)
+    {
+        readBinaryString(fp, header.swap, header.names[i]);
+        xmippFREAD(&header.types[i], sizeof(int32_t), 1, fp, header.swap);
+        xmippFREAD(&header.offsets[i], sizeof(uint64_t), 1, fp, header.swap);
+        if (xmippFREAD(&header.sizes[i], sizeof(uint64_t), 1, fp, header.swap) != 1)
+            REPORT_ERROR(ERR_IO_NOREAD, formatString("MDColumns: cannot read header of %s", fn.c_str()));
+    }
+}
+
+void MDColumns::writeBinary(const FileName &fn, const std::vector<MDLabel> &labels,
+                            const String &blockName) const
+{
+    std::vector<const MDColumn*> toWrite;
+    for (size_t i = 0; i < labels.size(); ++i)
+        if (columns[labels[i]] != NULL)
+            toWrite.push_back(columns[labels[i]]);
+
+    MDBinaryFile file(fn, "wb");
+    FILE * fp = file.fp;
+    if (fp == NULL)
+        REPORT_ERROR(ERR_IO_NOTOPEN, formatString("MDColumns: cannot open %s for writing", fn.c_str()));
+
+    uint32_t byteOrder = MDBINARY_BYTE_ORDER, version = MDBINARY_VERSION, ncols = toWrite.size();
+    uint64_t nrows = objIds.size();
+    fwrite(MDBINARY_MAGIC, 1, 4, fp);
+    fwrite(&byteOrder, sizeof(uint32_t), 1, fp);
+    fwrite(&version, sizeof(uint32_t), 1, fp);
+    fwrite(&ncols, sizeof(uint32_t), 1, fp);
+    fwrite(&nrows, sizeof(uint64_t), 1, fp);
+    writeBinaryString(fp, blockName);
+
+    // The columns start right after the header
+    uint64_t offset = ftell(fp);
+    std::vector<String> names(ncols);
+    for (size_t i = 0; i < ncols; ++i)
+    {
+        names[i] = MDL::label2Str(toWrite[i]->label);
+        offset += sizeof(uint32_t) + names[i].size() + sizeof(int32_t) + 2 * sizeof(uint64_t);
+    }
+    for (size_t i = 0; i < ncols; ++i)
+    {
+        int32_t type = binaryTypeTag(toWrite[i]->type);
+        uint64_t size = toWrite[i]->binarySize();
+        writeBinaryString(fp, names[i]);
+        fwrite(&type, sizeof(int32_t), 1, fp);
+        fwrite(&offset, sizeof(uint64_t), 1, fp);
+        fwrite(&size, sizeof(uint64_t), 1, fp);
+        offset += size;
+    }
+    for (size_t i = 0; i < ncols; ++i)
+        toWrite[i]->writeBinary(fp);
+
+    if (ferror(fp))
+        REPORT_ERROR(ERR_IO_NOWRITE, formatString("MDColumns: error writing %s", fn.c_str()));
+}
+
+void MDColumns::readBinary(const FileName &fn, std::vector<MDLabel> &labels,
+                           const std::vector<MDLabel> *desiredLabels,
+                           size_t firstRow, size_t nrows)
+{
+    MDBinaryFile file(fn, "rb");
+    FILE * fp = file.fp;
+    if (fp == NULL)
+        REPORT_ERROR(ERR_IO_NOTOPEN, formatString("MDColumns: cannot open %s", fn.c_str()));
+    MDBinaryHeader header;
+    readBinaryHeader(fp, fn, header);
+
+    clear();
+    labels.clear();
+    if (firstRow > header.nrows)
+        firstRow = header.nrows;
+    if (nrows == 0 || firstRow + nrows > header.nrows)
+        nrows = header.nrows - firstRow;
+    for (size_t i = 1; i <= nrows; ++i)
+        addRow(i);
+
+    for (size_t i = 0; i < header.names.size(); ++i)
+    {
+        MDLabel label = MDL::str2Label(header.names[i]);
+        if (label == MDL_UNDEFINED)
+        {
+            std::cout << "WARNING: Ignoring unknown column: " + header.names[i] << std::endl;
+            continue;
+        }
+        if (desiredLabels != NULL && !vectorContainsLabel(*desiredLabels, label))
+            continue;
+        if (binaryTypeTag(MDL::labelType(label)) != header.types[i])
+            REPORT_ERROR(ERR_MD_BADTYPE, formatString("MDColumns: column %s of %s does not have the expected type",
+                         header.names[i].c_str(), fn.c_str()));
+        addColumn(label);
+        columns[label]->readBinary(fp, header.offsets[i], firstRow, nrows, header.nrows, header.swap);
+        labels.push_back(label);
+    }
+    valid = true;
+}
+
+void MDColumns::readBinaryInfo(const FileName &fn, size_t &nrows, String &blockName)
+{
+    MDBinaryFile file(fn, "rb");
+    if (file.fp == NULL)
+        REPORT_ERROR(ERR_IO_NOTOPEN, formatString("MDColumns: cannot open %s", fn.c_str()));
+    MDBinaryHeader header;
+    readBinaryHeader(file.fp, fn, header);
+    nrows = header.nrows;
+    blockName = header.blockName;
+}
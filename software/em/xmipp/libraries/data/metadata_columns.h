@@ -0,0 +1,179 @@
+/***************************************************************************
+ *
+ * Authors:     agent (agent@local)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#ifndef METADATACOLUMNS_H
+#define METADATACOLUMNS_H
+
+#include <vector>
+#include "metadata_label.h"
+#include "xmipp_filename.h"
+#include "xmipp_threads.h"
+
+class MDSql;
+
+#define MDCOLUMNS_NO_ROW ((size_t)-1)
+
+/** @addtogroup MetaData
+ * @{
+ */
+
+/** Values of one label for all the objects of a MetaData.
+ * Only the vector matching the label type is used.
+ */
+class MDColumn
+{
+public:
+    MDLabel label;
+    MDLabelType type;
+
+    std::vector<char> boolValues;
+    std::vector<int> intValues;
+    std::vector<size_t> sizetValues;
+    std::vector<double> doubleValues;
+    std::vector<String> stringValues;
+    std::vector< std::vector<double> > vectorValues;
+    std::vector< std::vector<size_t> > vectorSizetValues;
+
+    /** Empty column for this label */
+    MDColumn(MDLabel label);
+
+    /** Change the number of rows, new rows get the default value of the type */
+    void resize(size_t nrows);
+
+    /** Copy the value at a given row into the object */
+    void get(size_t row, MDObject &value) const;
+
+    /** Set the value at a given row */
+    void set(size_t row, const MDObject &value);
+
+    /** Number of bytes used by the column in the binary format */
+    size_t binarySize() const;
+
+    /** Write the column in the binary format */
+    void writeBinary(FILE * fp) const;
+
+    /** Read the rows [firstRow, firstRow+nrows) of a column in binary format.
+     * The column starts at offset in the file, which has totalRows rows.
+     * If swap, the file was written with the other byte order.
+     */
+    void readBinary(FILE * fp, size_t offset, size_t firstRow, size_t nrows,
+                    size_t totalRows, bool swap);
+}
+;//class MDColumn
+
+/** In-memory columnar copy of the values of a MetaData.
+ * Rows are addressed through a dense objId to row table, so that
+ * getValue is a couple of vector lookups instead of an SQL statement.
+ * The store is filled from the SQL table with a single SELECT and it is
+ * kept coherent by MetaData: single value updates, new objects and new
+ * labels are applied in place, any other modification invalidates the
+ * store until it is built again. Once valid, the store may be read by
+ * several threads at the same time.
+ */
+class MDColumns
+{
+protected:
+    std::vector<size_t> objIds; // row -> objId
+    std::vector<size_t> rowOf; // objId -> row, MDCOLUMNS_NO_ROW if not present
+    MDColumn * columns[MDL_LAST_LABEL];
+    std::vector<MDColumn*> activeColumns;
+    bool valid;
+    Mutex buildMutex;
+
+public:
+    /** Empty constructor */
+    MDColumns();
+
+    /** Destructor */
+    ~MDColumns();
+
+    /** Remove all rows and columns */
+    void clear();
+
+    /** True if the store reflects the current content of the table */
+    bool isValid() const
+    {
+        return valid;
+    }
+
+    /** Mark the store as outdated */
+    void invalidate()
+    {
+        valid = false;
+    }
+
+    /** Fill the store from the SQL table.
+     * The store is built under a lock, but it must not be read meanwhile:
+     * build it before starting the threads that read it.
+     */
+    void build(MDSql &sql, const std::vector<MDLabel> &labels);
+
+    /** Add an empty column, nothing is done if it already exists */
+    void addColumn(MDLabel label);
+
+    /** Add a row for this object, all columns get the default values.
+     * Object ids are expected in increasing order as given by sqlite.
+     */
+    void addRow(size_t id);
+
+    /** Number of rows */
+    size_t size() const
+    {
+        return objIds.size();
+    }
+
+    /** Object ids in increasing order, at most limit of them if limit is not -1 */
+    void getObjIds(std::vector<size_t> &ids, int limit = -1) const;
+
+    /** Get a value, false if the object or the label are not present */
+    bool getValue(MDObject &value, size_t id) const;
+
+    /** Set a value, false if the object or the label are not present */
+    bool setValue(const MDObject &value, size_t id);
+
+    /** Write the columns of these labels in the binary metadata format.
+     * The file starts with a header holding the number of rows, the block name
+     * and, for each column, its label name, type tag, offset and size. Then the
+     * columns follow one after the other, so that a column or a range of rows
+     * can be read without going through the rest of the file.
+     */
+    void writeBinary(const FileName &fn, const std::vector<MDLabel> &labels,
+                     const String &blockName) const;
+
+    /** Read a binary metadata file.
+     * Only the rows [firstRow, firstRow+nrows) are read, all of them if nrows is 0,
+     * and only the desiredLabels if they are given. The rows are numbered from 1
+     * on and labels is filled with the columns read.
+     */
+    void readBinary(const FileName &fn, std::vector<MDLabel> &labels,
+                    const std::vector<MDLabel> *desiredLabels = NULL,
+                    size_t firstRow = 0, size_t nrows = 0);
+
+    /** Number of rows and block name of a binary metadata file */
+    static void readBinaryInfo(const FileName &fn, size_t &nrows, String &blockName);
+}
+;//class MDColumns
+
+/** @} */
+
+#endif
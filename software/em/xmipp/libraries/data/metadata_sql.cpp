@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include "metadata_sql.h"
 #include "xmipp_threads.h"
+#include "metadata_columns.h"
 #include <sys/time.h>
 #include <regex.h>
 //#define DEBUG
@@ -130,6 +131,7 @@ bool MDSql::createMd()
     sqlMutex.lock();
     //std::cerr << "creating md" <<std::endl;
     bool result = createTable(&(myMd->activeLabels));
+    invalidateColumns();
     //std::cerr << "leave creating md" <<std::endl;
     sqlMutex.unlock();
 
@@ -142,6 +144,7 @@ bool MDSql::clearMd()
     //std::cerr << "clearing md" <<std::endl;
     myCache->clear();
     bool result = dropTable();
+    invalidateColumns();
     //std::cerr << "leave clearing md" <<std::endl;
     sqlMutex.unlock();
 
@@ -225,6 +228,7 @@ bool MDSql::renameColumn(const std::vector<MDLabel> oldLabel, const std::vector<
         std::replace(v1.begin(), v1.end(), *itOld, *itNew);
 
     int oldTableId = tableId;
+    invalidateColumns();
     sqlMutex.lock();
     tableId = getUniqueId();
     createTable(&v1);
@@ -274,6 +278,8 @@ bool MDSql::setObjectValues(const std::vector<MDObject*> & columnValues, const s
     bool r = true;			// Return value.
     int i=0, j=0;			// Loop indexes.
 
+    invalidateColumns();
+
     if (firstTime)
     {
     	// Clear preparedStream.
@@ -388,6 +394,7 @@ bool MDSql::setObjectValue(const MDObject &value)
     MDLabel column = value.label;
     std::stringstream ss;
     sqlite3_stmt * stmt;
+    invalidateColumns();
     ss << "UPDATE " << tableName(tableId)
     << " SET " << MDL::label2StrSql(column) << "=?;";
     rc = sqlite3_prepare_v2(db, ss.str().c_str(), -1, &stmt, &zLeftover);
@@ -558,6 +565,107 @@ bool MDSql::getObjectValue(const int objId, MDObject  &value)
     return true;
 }
 
+void MDSql::readColumns(MDColumns &columns, const std::vector<MDLabel> &labels)
+{
+    std::stringstream ss;
+    sqlite3_stmt *stmt;
+    std::vector<MDObject*> values;
+
+    ss << "SELECT objID";
+    for (size_t i = 0; i < labels.size(); ++i)
+    {
+        ss << ", " << MDL::label2StrSql(labels[i]);
+        values.push_back(new MDObject(labels[i]));
+    }
+    ss << " FROM " << tableName(tableId) << " ORDER BY objID;";
+    rc = sqlite3_prepare_v2(db, ss.str().c_str(), -1, &stmt, &zLeftover);
+#ifdef DEBUG
+
+    std::cerr << "readColumns: " << ss.str() <<std::endl;
+#endif
+
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        size_t id = sqlite3_column_int64(stmt, 0);
+        columns.addRow(id);
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            extractValue(stmt, i + 1, *values[i]);
+            columns.setValue(*values[i], id);
+        }
+    }
+    rc = sqlite3_finalize(stmt);
+    for (size_t i = 0; i < values.size(); ++i)
+        delete values[i];
+}
+
+void MDSql::writeColumns(const MDColumns &columns, const std::vector<MDLabel> &labels)
+{
+    std::stringstream ss;
+    sqlite3_stmt *stmt = NULL;
+    std::vector<MDObject*> values;
+    size_t ncols = labels.size(), nrows = columns.size();
+
+    invalidateColumns();
+    String columnList = MDL::label2StrSql(labels[0]);
+    String rowParams = "(?";
+    values.push_back(new MDObject(labels[0]));
+    for (size_t i = 1; i < ncols; ++i)
+    {
+        columnList += "," + MDL::label2StrSql(labels[i]);
+        rowParams += ",?";
+        values.push_back(new MDObject(labels[i]));
+    }
+    rowParams += ")";
+
+    // SQLite accepts up to 999 parameters in a statement
+    size_t rowsPerStmt = XMIPP_MAX((size_t)1, XMIPP_MIN((size_t)100, 999 / ncols));
+    size_t stmtRows = 0;
+    for (size_t first = 1; first <= nrows; first += rowsPerStmt)
+    {
+        size_t n = XMIPP_MIN(rowsPerStmt, nrows - first + 1);
+        if (n != stmtRows)
+        {
+            if (stmt != NULL)
+                sqlite3_finalize(stmt);
+            ss.str(std::string());
+            ss << "INSERT INTO " << tableName(tableId) << " (" << columnList << ") VALUES " << rowParams;
+            for (size_t r = 1; r < n; ++r)
+                ss << "," << rowParams;
+            ss << ";";
+            rc = sqlite3_prepare_v2(db, ss.str().c_str(), -1, &stmt, &zLeftover);
+            stmtRows = n;
+        }
+        int position = 1;
+        for (size_t id = first; id < first + n; ++id)
+            for (size_t i = 0; i < ncols; ++i)
+            {
+                columns.getValue(*values[i], id);
+                bindValue(stmt, position++, *values[i]);
+            }
+        rc = sqlite3_step(stmt);
+        if (rc != SQLITE_DONE)
+        {
+            String msg = formatString("MDSql::writeColumns: code %d error: %s", rc, sqlite3_errmsg(db));
+            sqlite3_finalize(stmt);
+            for (size_t i = 0; i < values.size(); ++i)
+                delete values[i];
+            REPORT_ERROR(ERR_MD_SQL, msg);
+        }
+        sqlite3_reset(stmt);
+    }
+    if (stmt != NULL)
+        sqlite3_finalize(stmt);
+    for (size_t i = 0; i < values.size(); ++i)
+        delete values[i];
+}
+
+void MDSql::invalidateColumns()
+{
+    if (myMd != NULL && myMd->myColumns != NULL)
+        myMd->myColumns->invalidate();
+}
+
 void MDSql::selectObjects(std::vector<size_t> &objectsOut, const MDQuery *queryPtr)
 {
     std::stringstream ss;
@@ -587,6 +695,7 @@ void MDSql::selectObjects(std::vector<size_t> &objectsOut, const MDQuery *queryP
 size_t MDSql::deleteObjects(const MDQuery *queryPtr)
 {
     std::stringstream ss;
+    invalidateColumns();
     ss << "DELETE FROM " << tableName(tableId);
     if (queryPtr != NULL)
         ss << queryPtr->whereString();
@@ -610,6 +719,7 @@ size_t MDSql::copyObjects(MDSql * sqlOut, const MDQuery *queryPtr) const
     // the same columns that the source table, if not
     // the INSERT will fail
     std::stringstream ss, ss2;
+    sqlOut->invalidateColumns();
     ss << "INSERT INTO " << tableName(sqlOut->tableId);
     //Add columns names to the insert and also to select
     //* couldn't be used because maybe are duplicated objID's
@@ -643,6 +753,7 @@ void MDSql::aggregateMd(MetaData *mdPtrOut,
     std::stringstream ss;
     std::stringstream ss2;
     std::string aggregateStr = MDL::label2StrSql(mdPtrOut->activeLabels[0]);
+    mdPtrOut->myMDSql->invalidateColumns();
     ss << "INSERT INTO " << tableName(mdPtrOut->myMDSql->tableId)
     << "(" << aggregateStr;
     ss2 << aggregateStr;
@@ -694,6 +805,7 @@ void MDSql::aggregateMdGroupBy(MetaData *mdPtrOut,
     std::stringstream ss2;
     std::stringstream groupByStr;
 
+    mdPtrOut->myMDSql->invalidateColumns();
     groupByStr << MDL::label2StrSql(groupByLabels[0]);
     for (size_t i = 1; i < groupByLabels.size(); i++)
         groupByStr << ", " << MDL::label2StrSql(groupByLabels[i]);
@@ -875,6 +987,7 @@ void MDSql::setOperate(MetaData *mdPtrOut, const std::vector<MDLabel> &columns,
     int size;
     std::string sep = " ";
 
+    mdPtrOut->myMDSql->invalidateColumns();
     switch (operation)
     {
     case UNION:
@@ -1010,6 +1123,7 @@ void MDSql::setOperate(const MetaData *mdInLeft,
     std::stringstream ss, ss2, ss3;
     size_t size;
     std::string join_type = "", sep = "";
+    invalidateColumns();
     switch (operation)
     {
     case INNER_JOIN:
@@ -1122,6 +1236,7 @@ void MDSql::setOperate(const MetaData *mdInLeft,
 bool MDSql::operate(const String &expression)
 {
     std::stringstream ss;
+    invalidateColumns();
     ss << "UPDATE " << tableName(tableId) << " SET " << expression;
 
     return execSingleStmt(ss);
@@ -1161,6 +1276,7 @@ void MDSql::copyTableFromFileDB(const FileName blockname,
     int columns;
     char *Labels;
 
+    invalidateColumns();
     sqlite3 *db1;
     if (sqlite3_open(filename.c_str(), &db1))
         REPORT_ERROR(ERR_MD_SQL,formatString("Error opening database code: %d message: %s",rc,sqlite3_errmsg(db1)));
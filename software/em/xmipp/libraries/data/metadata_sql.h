@@ -36,6 +36,7 @@ class MDSqlStaticInit;
 class MDQuery;
 class MetaData;
 class MDCache;
+class MDColumns;
 
 /** @addtogroup MetaData
  * @{
@@ -169,6 +170,17 @@ private:
      */
     bool getObjectValue(const int objId, MDObject  &value);
 
+    /** Read all the objects of the table into an in-memory column store.
+     * Only a SELECT statement is executed for the whole table.
+     */
+    void readColumns(MDColumns &columns, const std::vector<MDLabel> &labels);
+
+    /** Insert all the rows of a column store at the end of the table.
+     * Several rows are inserted by each INSERT statement, the objIds are
+     * assigned by the table. There must be at least one label.
+     */
+    void writeColumns(const MDColumns &columns, const std::vector<MDLabel> &labels);
+
     /** This function will select some elements from table.
      * The 'limit' is the maximum number of object
      * returned, if is -1, all will be returned
@@ -271,6 +283,9 @@ private:
      */
     int getUniqueId();
 
+    /** Tell the metadata that its column store (if any) is outdated */
+    void invalidateColumns();
+
     bool dropTable();
     bool createTable(const std::vector<MDLabel> * labelsVector = NULL, bool withObjID=true);
     bool insertValues(double a, double b);
@@ -302,6 +317,7 @@ private:
     friend class MDSqlStaticInit;
     friend class MetaData;
     friend class MDIterator;
+    friend class MDColumns;
     ///similar to "operator"
     bool equals(const MDSql &op);
 
@@ -358,6 +358,34 @@ void MultidimArray< std::complex< double > >::maxIndex(size_t &lmax, int& kmax,
     REPORT_ERROR(ERR_NOT_IMPLEMENTED,"MultidimArray::maxIndex not implemented for complex.");
 }
 
+template<>
+void MultidimArray< std::complex< float > >::computeDoubleMinMax(double& minval, double& maxval) const
+{
+    REPORT_ERROR(ERR_NOT_IMPLEMENTED,"MultidimArray::computeDoubleMinMax not implemented for complex.");
+}
+template<>
+void MultidimArray< std::complex< float > >::computeDoubleMinMaxRange(double& minval, double& maxval, size_t pos, size_t size) const
+{
+    REPORT_ERROR(ERR_NOT_IMPLEMENTED,"MultidimArray::computeDoubleMinMax not implemented for complex.");
+}
+template<>
+void MultidimArray< std::complex< float > >::rangeAdjust(std::complex< float > minF, std::complex< float > maxF)
+{
+    REPORT_ERROR(ERR_NOT_IMPLEMENTED,"MultidimArray::rangeAdjust not implemented for complex.");
+}
+
+template<>
+double MultidimArray< std::complex< float > >::computeAvg() const
+{
+    REPORT_ERROR(ERR_NOT_IMPLEMENTED,"MultidimArray::computeAvg not implemented for complex.");
+}
+
+template<>
+void MultidimArray< std::complex< float > >::maxIndex(size_t &lmax, int& kmax, int& imax, int& jmax) const
+{
+    REPORT_ERROR(ERR_NOT_IMPLEMENTED,"MultidimArray::maxIndex not implemented for complex.");
+}
+
 template<>
 void MultidimArray<double>::computeAvgStdev(double& avg, double& stddev) const
 {
@@ -425,6 +453,23 @@ bool operator==(const MultidimArray< std::complex< double > >& op1, const Multid
     return true;
 }
 
+template<>
+bool operator==(const MultidimArray< std::complex< float > >& op1, const MultidimArray< std::complex< float > >& op2)
+{
+    double accuracy = XMIPP_EQUAL_ACCURACY;
+    if (! op1.sameShape(op2) || op1.data==NULL || op2.data == NULL)
+        return false;
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(op1)
+    if (   fabs(DIRECT_MULTIDIM_ELEM(op1,n).real() -
+                DIRECT_MULTIDIM_ELEM(op2,n).real()) > accuracy
+           ||
+           fabs(DIRECT_MULTIDIM_ELEM(op1,n).imag() -
+                DIRECT_MULTIDIM_ELEM(op2,n).imag()) > accuracy
+       )
+        return false;
+    return true;
+}
+
 template<>
 void MultidimArray< std::complex< double > >::getReal(MultidimArray<double> & realImg) const
 {
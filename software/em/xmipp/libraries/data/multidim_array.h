@@ -1523,6 +1523,18 @@ public:
         this->destroyData = false;
     }
 
+    /** Alias a memory buffer.
+     * The array works on the given buffer, that is not freed by the array.
+     */
+    void aliasMemory(T * buffer, size_t Ndim, size_t Zdim, size_t Ydim, size_t Xdim)
+    {
+        coreDeallocate();
+        setDimensions(Xdim, Ydim, Zdim, Ndim);
+        this->data = buffer;
+        this->nzyxdimAlloc = this->nzyxdim;
+        this->destroyData = false;
+    }
+
 
 
     //@}
@@ -5549,6 +5561,19 @@ template<>
 void MultidimArray< std::complex< double > >::getReal(MultidimArray<double> & realImg) const;
 template<>
 void MultidimArray< std::complex< double > >::getImag(MultidimArray<double> & imagImg) const;
+template<>
+void MultidimArray< std::complex< float > >::computeDoubleMinMax(double& minval, double& maxval) const;
+template<>
+void MultidimArray< std::complex< float > >::computeDoubleMinMaxRange(double& minval, double& maxval, size_t pos, size_t size) const;
+template<>
+void MultidimArray< std::complex< float > >::rangeAdjust(std::complex< float > minF, std::complex< float > maxF);
+template<>
+double MultidimArray< std::complex< float > >::computeAvg() const;
+template<>
+void MultidimArray< std::complex< float > >::maxIndex(size_t &lmax, int& kmax, int& imax, int& jmax) const;
+template<>
+bool operator==(const MultidimArray< std::complex< float > >& op1,
+                const MultidimArray< std::complex< float > >& op2);
 
 //@}
 #endif
@@ -395,6 +395,7 @@ void ProgNormalize::defineParams()
 {
     each_image_produces_an_output = true;
     allow_apply_geo = true;
+    allow_io_threads = true;
     save_metadata_stack = true;
     keep_input_columns = true;
     addUsageLine("Change the range of intensity values of pixels.");
@@ -700,9 +701,9 @@ void ProgNormalize::processImage(const FileName &fnImg, const FileName &fnImgOut
 {
     Image<double> I;
     if (apply_geo)
-        I.readApplyGeo(fnImg, rowIn);
+        readImageApplyGeo(fnImg, rowIn, I);
     else
-        I.read(fnImg);
+        readImage(fnImg, I);
     I().setXmippOrigin();
 
     MultidimArray<double> &img=I();
@@ -798,5 +799,5 @@ void ProgNormalize::processImage(const FileName &fnImg, const FileName &fnImgOut
     case NONE:
     	break;
     }
-    I.write(fnImgOut);
+    writeImage(I, fnImgOut);
 }
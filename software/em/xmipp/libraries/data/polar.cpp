@@ -24,11 +24,179 @@
  ***************************************************************************/
 #include "polar.h"
 
+// Polar sampling ----------------------------------------------------------
+PolarSampling::PolarSampling() {
+	Xdim = Ydim = 0;
+	x0 = y0 = firstRing = lastRing = BsplineOrder = mode = 0;
+	xoff = yoff = oversample = 0.;
+}
+
+bool PolarSampling::isInitialized(const MultidimArray<double> &M, int first_ring,
+		int last_ring, int BsplineOrder, double xoff, double yoff,
+		double oversample, int mode) const {
+	return !ringOffset.empty() && Xdim == XSIZE(M) && Ydim == YSIZE(M)
+			&& x0 == STARTINGX(M) && y0 == STARTINGY(M)
+			&& firstRing == first_ring && lastRing == last_ring
+			&& this->BsplineOrder == BsplineOrder && this->xoff == xoff
+			&& this->yoff == yoff && this->oversample == oversample
+			&& this->mode == mode;
+}
+
+void PolarSampling::initialize(const MultidimArray<double> &M, int first_ring,
+		int last_ring, int BsplineOrder, double xoff, double yoff,
+		double oversample, int mode) {
+	if (BsplineOrder != 1 && BsplineOrder != 3)
+		REPORT_ERROR(ERR_VALUE_INCORRECT,
+				"PolarSampling: only linear and cubic B-spline interpolation are supported");
+	double twopi;
+	if (mode == FULL_CIRCLES)
+		twopi = 2. * PI;
+	else if (mode == HALF_CIRCLES)
+		twopi = PI;
+	else
+		REPORT_ERROR(ERR_VALUE_INCORRECT, "Incorrect mode for PolarSampling");
+
+	Xdim = XSIZE(M);
+	Ydim = YSIZE(M);
+	x0 = STARTINGX(M);
+	y0 = STARTINGY(M);
+	firstRing = first_ring;
+	lastRing = last_ring;
+	this->BsplineOrder = BsplineOrder;
+	this->xoff = xoff;
+	this->yoff = yoff;
+	this->oversample = oversample;
+	this->mode = mode;
+
+	// Number of samples of each ring, as in getPolarFromCartesianBSpline
+	ringRadius.clear();
+	ringOffset.assign(1, 0);
+	for (int iring = first_ring; iring <= last_ring; iring++) {
+		double radius = (double) iring;
+		int nsam = 2 * (int) (0.5 * oversample * twopi * radius);
+		nsam = XMIPP_MAX(1, nsam);
+		ringRadius.push_back(radius);
+		ringOffset.push_back(ringOffset.back() + nsam);
+	}
+	size_t Nsamples = ringOffset.back();
+	rowIdx.resize(4 * Nsamples);
+	colIdx.resize(4 * Nsamples);
+	rowWeight.resize(4 * Nsamples);
+	colWeight.resize(4 * Nsamples);
+
+	// Limits of the matrix (not oversized!)
+	double minxp = FIRST_XMIPP_INDEX(Xdim);
+	double minyp = FIRST_XMIPP_INDEX(Ydim);
+	double maxxp = LAST_XMIPP_INDEX(Xdim);
+	double maxyp = LAST_XMIPP_INDEX(Ydim);
+	double minxp_e = minxp - XMIPP_EQUAL_ACCURACY;
+	double minyp_e = minyp - XMIPP_EQUAL_ACCURACY;
+	double maxxp_e = maxxp + XMIPP_EQUAL_ACCURACY;
+	double maxyp_e = maxyp + XMIPP_EQUAL_ACCURACY;
+
+	for (int iring = 0; iring < getRingNo(); iring++) {
+		double radius = ringRadius[iring];
+		size_t nsam = getSampleNo(iring);
+		double dphi = twopi / (double) nsam;
+		for (size_t iphi = 0; iphi < nsam; iphi++) {
+			// from polar to original cartesian coordinates
+			double sine, cosine;
+			sincos(iphi * dphi, &sine, &cosine);
+			double xp = sine * radius + xoff;
+			double yp = cosine * radius + yoff;
+
+			// Wrap coordinates
+			if (xp < minxp_e || xp > maxxp_e)
+				xp = realWRAP(xp, minxp - 0.5, maxxp + 0.5);
+			if (yp < minyp_e || yp > maxyp_e)
+				yp = realWRAP(yp, minyp - 0.5, maxyp + 0.5);
+
+			size_t s = 4 * (ringOffset[iring] + iphi);
+			int *ptrRow = &rowIdx[s], *ptrCol = &colIdx[s];
+			double *ptrRowWeight = &rowWeight[s], *ptrColWeight = &colWeight[s];
+			if (BsplineOrder == 1) {
+				// As in MultidimArray::interpolatedElement2D
+				int xl = (int) floor(xp);
+				int yl = (int) floor(yp);
+				for (int n = 0; n < 2; n++) {
+					int j = xl + n - x0;
+					int i = yl + n - y0;
+					ptrCol[n] = (j < 0 || j >= (int) Xdim) ? -1 : j;
+					ptrRow[n] = (i < 0 || i >= (int) Ydim) ? -1 : i;
+				}
+				ptrColWeight[0] = xp - xl;
+				ptrRowWeight[0] = yp - yl;
+			} else {
+				// As in MultidimArray::interpolatedElementBSpline2D, with mirrored borders
+				double x = xp - x0;
+				double y = yp - y0;
+				int l1 = (int) ceil(x - 2);
+				int m1 = (int) ceil(y - 2);
+				for (int n = 0; n < 4; n++) {
+					int l = l1 + n;
+					int m = m1 + n;
+					double aux;
+					BSPLINE03(aux, x - (double) l);
+					ptrColWeight[n] = aux;
+					BSPLINE03(aux, y - (double) m);
+					ptrRowWeight[n] = aux;
+					if (l < 0)
+						l = -l - 1;
+					else if (l >= (int) Xdim)
+						l = 2 * Xdim - l - 1;
+					if (m < 0)
+						m = -m - 1;
+					else if (m >= (int) Ydim)
+						m = 2 * Ydim - m - 1;
+					ptrCol[n] = l;
+					ptrRow[n] = m;
+				}
+			}
+		}
+	}
+}
+
+void PolarSampling::sampleRing(const MultidimArray<double> &M, int iring,
+		double *ring) const {
+	size_t s0 = ringOffset[iring];
+	size_t nsam = getSampleNo(iring);
+	const int *ptrRow = &rowIdx[4 * s0], *ptrCol = &colIdx[4 * s0];
+	const double *ptrRowWeight = &rowWeight[4 * s0], *ptrColWeight =
+			&colWeight[4 * s0];
+	if (BsplineOrder == 1)
+		for (size_t iphi = 0; iphi < nsam; iphi++, ptrRow += 4, ptrCol += 4,
+				ptrRowWeight += 4, ptrColWeight += 4) {
+			double d[2][2];
+			for (int m = 0; m < 2; m++)
+				for (int l = 0; l < 2; l++)
+					d[m][l] = (ptrRow[m] < 0 || ptrCol[l] < 0) ?
+							0. : DIRECT_A2D_ELEM(M, ptrRow[m], ptrCol[l]);
+			double fx = ptrColWeight[0];
+			double d0 = LIN_INTERP(fx, d[0][0], d[0][1]);
+			double d1 = LIN_INTERP(fx, d[1][0], d[1][1]);
+			ring[iphi] = LIN_INTERP(ptrRowWeight[0], d0, d1);
+		}
+	else
+		for (size_t iphi = 0; iphi < nsam; iphi++, ptrRow += 4, ptrCol += 4,
+				ptrRowWeight += 4, ptrColWeight += 4) {
+			double columns = 0.0;
+			for (int m = 0; m < 4; m++) {
+				const double *ptrM = &DIRECT_A2D_ELEM(M, ptrRow[m], 0);
+				double rows = 0.0;
+				for (int l = 0; l < 4; l++)
+					rows += ptrM[ptrCol[l]] * ptrColWeight[l];
+				columns += rows * ptrRowWeight[m];
+			}
+			ring[iphi] = columns;
+		}
+}
+
 void fourierTransformRings(Polar<double> & in,
 		Polar<std::complex<double> > &out, Polar_fftw_plans &plans,
 		bool conjugated) {
 	MultidimArray<std::complex<double> > Fring;
-	out.clear();
+	// The rings of out are reused when they have the right size
+	out.rings.resize(in.getRingNo());
 	for (int iring = 0; iring < in.getRingNo(); iring++) {
 
 		plans.arrays[iring] = in.rings[iring];
@@ -40,7 +208,7 @@ void fourierTransformRings(Polar<double> & in,
 			for (size_t i = 0; i < XSIZE(Fring); ++i, ptrFring_i += 2)
 				(*ptrFring_i) *= -1;
 		}
-		out.rings.push_back(Fring);
+		out.rings[iring] = Fring;
 	}
 	out.mode = in.mode;
 	out.ring_radius = in.ring_radius;
@@ -109,26 +277,161 @@ void rotationalCorrelation(const Polar<std::complex<double> > &M1,
 		DIRECT_A1D_ELEM(angles,i) = (double) i * Kaux;
 }
 
+// Rotational correlation of a reference with many images -----------------
+template<typename T>
+BatchRotationalCorrelation<T>::BatchRotationalCorrelation() {
+	Nimages = 0;
+}
+
+template<typename T>
+void BatchRotationalCorrelation<T>::setReference(
+		const Polar<std::complex<double> > &M1) {
+	int nrings = M1.getRingNo();
+	ringOffset.resize(nrings + 1);
+	ringOffset[0] = 0;
+	for (int iring = 0; iring < nrings; iring++)
+		ringOffset[iring + 1] = ringOffset[iring] + M1.getSampleNo(iring);
+	size_t Nsamples = ringOffset[nrings];
+	refRe.resize(Nsamples);
+	refIm.resize(Nsamples);
+	for (int iring = 0; iring < nrings; iring++) {
+		double w = (2. * PI * M1.ring_radius[iring]);
+		const std::complex<double> *ptr = MULTIDIM_ARRAY(M1.rings[iring]);
+		for (size_t i = ringOffset[iring]; i < ringOffset[iring + 1]; ++i, ++ptr) {
+			refRe[i] = (T) (w * ptr->real());
+			refIm[i] = (T) (w * ptr->imag());
+		}
+	}
+	clearImages();
+}
+
+template<typename T>
+void BatchRotationalCorrelation<T>::addImage(
+		const Polar<std::complex<double> > &M2) {
+	int nrings = (int) ringOffset.size() - 1;
+	if (nrings != M2.getRingNo())
+		REPORT_ERROR(ERR_VALUE_INCORRECT,
+				formatString("BatchRotationalCorrelation: the image has %d rings and the reference %d",
+						M2.getRingNo(), nrings));
+	size_t Nsamples = ringOffset[nrings];
+	imgRe.resize((Nimages + 1) * Nsamples);
+	imgIm.resize((Nimages + 1) * Nsamples);
+	T *ptrRe = &imgRe[Nimages * Nsamples];
+	T *ptrIm = &imgIm[Nimages * Nsamples];
+	for (int iring = 0; iring < nrings; iring++) {
+		size_t nsam = ringOffset[iring + 1] - ringOffset[iring];
+		if ((size_t) M2.getSampleNo(iring) != nsam)
+			REPORT_ERROR(ERR_VALUE_INCORRECT,
+					"BatchRotationalCorrelation: the rings of the image and the reference have different sizes");
+		const std::complex<double> *ptr = MULTIDIM_ARRAY(M2.rings[iring]);
+		for (size_t i = 0; i < nsam; ++i, ++ptr) {
+			*ptrRe++ = (T) ptr->real();
+			*ptrIm++ = (T) ptr->imag();
+		}
+	}
+	Nimages++;
+}
+
+template<typename T>
+void BatchRotationalCorrelation<T>::clearImages() {
+	imgRe.clear();
+	imgIm.clear();
+	Nimages = 0;
+}
+
+/* Accumulate the product of a ring of the reference and a ring of an image */
+template<typename T>
+static void accumulateRingProduct(const T *refRe, const T *refIm,
+		const T *imgRe, const T *imgIm, T *FsumRe, T *FsumIm, size_t nsam) {
+	for (size_t i = 0; i < nsam; ++i) {
+		FsumRe[i] += refRe[i] * imgRe[i] - refIm[i] * imgIm[i];
+		FsumIm[i] += refIm[i] * imgRe[i] + refRe[i] * imgIm[i];
+	}
+}
+
+template<typename T>
+void BatchRotationalCorrelation<T>::bestRotations(
+		std::vector<double> &rotations, RotationalCorrelationAux &aux) {
+	// Fsum should already be set with the right size in the local_transformer
+	aux.local_transformer.getFourierAlias(aux.Fsum);
+	size_t FsumSize = XSIZE(aux.Fsum);
+	int nrings = (int) ringOffset.size() - 1;
+	size_t Nsamples = ringOffset[nrings];
+	for (int iring = 0; iring < nrings; iring++)
+		if (ringOffset[iring + 1] - ringOffset[iring] > FsumSize)
+			REPORT_ERROR(ERR_VALUE_INCORRECT,
+					"BatchRotationalCorrelation: the correlation function is too short for the rings");
+
+	// Multiply the reference and all images over all rings and sum
+	FsumRe.assign(Nimages * FsumSize, (T) 0);
+	FsumIm.assign(Nimages * FsumSize, (T) 0);
+	for (int iring = 0; iring < nrings; iring++) {
+		size_t offset = ringOffset[iring];
+		size_t nsam = ringOffset[iring + 1] - offset;
+		for (size_t n = 0; n < Nimages; ++n)
+			accumulateRingProduct(&refRe[offset], &refIm[offset],
+					&imgRe[n * Nsamples + offset], &imgIm[n * Nsamples + offset],
+					&FsumRe[n * FsumSize], &FsumIm[n * FsumSize], nsam);
+	}
+
+	// Inverse FFT and maximum of each correlation
+	const MultidimArray<double> &corr = aux.local_transformer.getReal();
+	double Kaux = 360. / XSIZE(corr);
+	rotations.resize(Nimages);
+	for (size_t n = 0; n < Nimages; ++n) {
+		double *ptrFsum = (double *) MULTIDIM_ARRAY(aux.Fsum);
+		const T *ptrRe = &FsumRe[n * FsumSize];
+		const T *ptrIm = &FsumIm[n * FsumSize];
+		for (size_t i = 0; i < FsumSize; ++i) {
+			*(ptrFsum++) = ptrRe[i];
+			*(ptrFsum++) = ptrIm[i];
+		}
+		aux.local_transformer.inverseFourierTransform();
+
+		int imax = 0;
+		double maxval = DIRECT_MULTIDIM_ELEM(corr,0);
+		double* ptr = NULL;
+		unsigned long int nn;
+		FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY_ptr(corr,nn,ptr)
+			if (*ptr > maxval) {
+				maxval = *ptr;
+				imax = nn;
+			}
+		rotations[n] = imax * Kaux;
+	}
+}
+
+template class BatchRotationalCorrelation<double>;
+template class BatchRotationalCorrelation<float>;
+
 // Compute the normalized Polar Fourier transform --------------------------
 void normalizedPolarFourierTransform(const MultidimArray<double> &in,
 		Polar<std::complex<double> > &out, bool flag, int first_ring,
 		int last_ring, Polar_fftw_plans *&plans, int BsplineOrder) {
 	Polar<double> polarIn;
-	if (BsplineOrder == 1)
-		polarIn.getPolarFromCartesianBSpline(in, first_ring, last_ring, 1);
-	else {
-		MultidimArray<double> Maux;
+	MultidimArray<double> Maux;
+	const MultidimArray<double> *coeffs = &in;
+	if (BsplineOrder != 1) {
 		produceSplineCoefficients(3, Maux, in);
-		polarIn.getPolarFromCartesianBSpline(Maux, first_ring, last_ring,
-				BsplineOrder);
+		coeffs = &Maux;
 	}
+	bool newPlans = (plans == NULL);
+	if (newPlans)
+		plans = new Polar_fftw_plans();
+	if (BsplineOrder == 1 || BsplineOrder == 3) {
+		// The sampling is computed once and kept with the plans
+		PolarSampling &sampling = plans->sampling;
+		if (!sampling.isInitialized(*coeffs, first_ring, last_ring, BsplineOrder))
+			sampling.initialize(*coeffs, first_ring, last_ring, BsplineOrder);
+		polarIn.getPolarFromCartesianBSpline(*coeffs, sampling);
+	} else
+		polarIn.getPolarFromCartesianBSpline(*coeffs, first_ring, last_ring,
+				BsplineOrder);
 	double mean, stddev;
 	polarIn.computeAverageAndStddev(mean, stddev);
 	polarIn.normalize(mean, stddev);
-	if (plans == NULL) {
-		plans = new Polar_fftw_plans();
+	if (newPlans)
 		polarIn.calculateFftwPlans(*plans);
-	}
 	fourierTransformRings(polarIn, out, *plans, flag);
 }
 
@@ -47,11 +47,96 @@
 /// @ingroup DataLibrary
 //@{
 
-/** Structure for fftw plans */
+/** Sampling of cartesian images in polar coordinates.
+ *
+ * The interpolation indexes and weights of all polar samples are computed
+ * once for an image size and a polar geometry, and then used to convert
+ * any number of images of that size without computing sines, cosines or
+ * interpolation weights again. The samples of all rings are packed one
+ * ring after another, the samples of ring i start at ringOffset[i].
+ * Linear (BsplineOrder=1) and cubic B-spline (BsplineOrder=3)
+ * interpolation are supported, in the B-spline case the images to sample
+ * are the spline coefficients.
+ *
+ * @code
+ * PolarSampling sampling;
+ * sampling.initialize(Maux, first_ring, last_ring);
+ * Polar<double> P;
+ * P.getPolarFromCartesianBSpline(Maux, sampling);
+ * @endcode
+ */
+class PolarSampling
+{
+public:
+    /// Radius of each ring
+    std::vector<double> ringRadius;
+    /// First sample of each ring, the last element is the number of samples
+    std::vector<size_t> ringOffset;
+
+public:
+    /// Empty constructor
+    PolarSampling();
+
+    /** Compute the sampling for images of the size and origin of M.
+     * The parameters are those of Polar::getPolarFromCartesianBSpline. */
+    void initialize(const MultidimArray<double> &M, int first_ring, int last_ring,
+                    int BsplineOrder=3, double xoff=0., double yoff=0.,
+                    double oversample=1., int mode=FULL_CIRCLES);
+
+    /// True if the sampling was initialized with these parameters
+    bool isInitialized(const MultidimArray<double> &M, int first_ring, int last_ring,
+                       int BsplineOrder=3, double xoff=0., double yoff=0.,
+                       double oversample=1., int mode=FULL_CIRCLES) const;
+
+    /// Number of rings
+    int getRingNo() const
+    {
+        return (int)ringRadius.size();
+    }
+
+    /// Number of samples of a ring
+    size_t getSampleNo(int iring) const
+    {
+        return ringOffset[iring + 1] - ringOffset[iring];
+    }
+
+    /// Full or half circles
+    int getMode() const
+    {
+        return mode;
+    }
+
+    /// Oversampling of the rings
+    double getOversample() const
+    {
+        return oversample;
+    }
+
+    /// Interpolate the samples of a ring of M, ring must have getSampleNo(iring) elements
+    void sampleRing(const MultidimArray<double> &M, int iring, double *ring) const;
+
+private:
+    // Geometry of the sampling
+    size_t Xdim, Ydim;
+    int x0, y0, firstRing, lastRing, BsplineOrder, mode;
+    double xoff, yoff, oversample;
+
+    // Physical rows and columns of the 4 x 4 interpolation support of each sample
+    // and their weights. In linear interpolation only 2 x 2 indexes are used,
+    // -1 stands for a pixel outside the image, and the weight is the fraction
+    // of the pixel in that direction.
+    std::vector<int> rowIdx, colIdx;
+    std::vector<double> rowWeight, colWeight;
+};
+
+/** Structure for fftw plans.
+ * The polar sampling of the images transformed with these plans is kept
+ * with them. */
 typedef struct Polar_Fftw_Plans
 {
     std::vector<FourierTransformer>          transformers;
     std::vector<MultidimArray<double> >  arrays;
+    PolarSampling                        sampling;
 }
 Polar_fftw_plans;
 
@@ -690,6 +775,34 @@ public:
         }
     }
 
+    /** Convert cartesian MultidimArray to Polar with a precomputed sampling
+     *
+     * The result is the one of the previous function with the parameters
+     * used to initialize the sampling. The rings of the polar are reused
+     * when they have the right size.
+     *
+     * @code
+     * PolarSampling sampling;
+     * sampling.initialize(Maux, 1, 15);
+     * P.getPolarFromCartesianBSpline(Maux, sampling);
+     * @endcode
+     */
+    void getPolarFromCartesianBSpline(const MultidimArray<double> &M1,
+                                      const PolarSampling &sampling)
+    {
+        int nrings = sampling.getRingNo();
+        rings.resize(nrings);
+        ring_radius = sampling.ringRadius;
+        mode = sampling.getMode();
+        oversample = sampling.getOversample();
+        for (int iring = 0; iring < nrings; iring++)
+        {
+            MultidimArray<T> &ring = rings[iring];
+            ring.resizeNoCopy(sampling.getSampleNo(iring));
+            sampling.sampleRing(M1, iring, MULTIDIM_ARRAY(ring));
+        }
+    }
+
     /** Precalculate a vector with FFTW plans for all rings
      *
      */
@@ -799,6 +912,65 @@ void rotationalCorrelation(const Polar<std::complex<double> > &M1,
                            MultidimArray<double> &angles,
                            RotationalCorrelationAux &aux);
 
+/** Rotational correlation of a reference with many images.
+ *
+ * The ring spectra of the reference are weighted by the ring perimeters
+ * and stored once, the ring spectra of the images are stored when they
+ * are added. Real and imaginary parts are kept in separate contiguous
+ * arrays. The products of the reference with all images are accumulated
+ * in a single pass over the rings, so that each reference ring is read
+ * once for all images and the inner loop is vectorized by the compiler.
+ * T is the precision of the accumulation: float halves the memory
+ * traffic and doubles the vector width, at the cost of precision.
+ *
+ * The rotations are those of best_rotation for each image.
+ *
+ * @code
+ * BatchRotationalCorrelation<float> batch;
+ * batch.setReference(polarFourierRef);
+ * for (size_t n = 0; n < N; ++n)
+ *     batch.addImage(polarFourierI[n]); // Complex conjugated
+ * std::vector<double> rotations;
+ * batch.bestRotations(rotations, aux);
+ * @endcode
+ */
+template<typename T>
+class BatchRotationalCorrelation
+{
+public:
+    /// Empty constructor
+    BatchRotationalCorrelation();
+
+    /// Set the reference, the images already added are removed
+    void setReference(const Polar<std::complex<double> > &M1);
+
+    /// Add an image, with the rings of the reference
+    void addImage(const Polar<std::complex<double> > &M2);
+
+    /// Remove all images, the reference is kept
+    void clearImages();
+
+    /// Number of images
+    size_t size() const
+    {
+        return Nimages;
+    }
+
+    /** Best rotation of each image.
+     * As in best_rotation, the local_transformer of aux must have
+     * the correlation function as its real array. */
+    void bestRotations(std::vector<double> &rotations, RotationalCorrelationAux &aux);
+
+private:
+    // First sample of each ring, the last element is the number of samples
+    std::vector<size_t> ringOffset;
+    // Weighted reference spectrum and spectra of the images
+    std::vector<T> refRe, refIm, imgRe, imgIm;
+    // Accumulated spectra
+    std::vector<T> FsumRe, FsumIm;
+    size_t Nimages;
+};
+
 /** Compute a normalized polar Fourier transform of the input image.
     If plans is NULL, they are computed and returned. */
 void normalizedPolarFourierTransform(const MultidimArray<double> &in,
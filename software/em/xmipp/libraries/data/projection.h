@@ -257,10 +257,23 @@ void project_SimpleGrid(Image<T> *vol, const SimpleGrid *grid,
     rproj=E*r+roffset => r=E^t (rproj-roffset)
 
     Set it to NULL if you don't want to use it
+
+    The rows of the projection can be computed by several threads.
  */
 void projectVolume(MultidimArray<double> &V, Projection &P, int Ydim, int Xdim,
                    double rot, double tilt, double psi,
-                   const Matrix1D<double> *roffset=NULL);
+                   const Matrix1D<double> *roffset=NULL, int threads=1);
+
+/** From voxel volumes, in several directions.
+    The voxel volume is projected onto the planes defined by the triplets
+    (rot[n], tilt[n], psi[n]). The vector of projections is resized to the
+    number of directions and each projection is Ydim x Xdim. The projections
+    are distributed among the threads, that share the volume.
+ */
+void projectVolumes(MultidimArray<double> &V, std::vector<Projection> &P,
+                    int Ydim, int Xdim, const std::vector<double> &rot,
+                    const std::vector<double> &tilt, const std::vector<double> &psi,
+                    int threads=1);
 
 /** From voxel volumes, off-centered tilt axis.
     This routine projects a volume that is rotating (angle) degrees
@@ -22,9 +22,145 @@
  *  All comments concerning this program package may be sent to the
  *  e-mail address 'xmipp@cnb.csic.es'
  ***************************************************************************/
+#include <algorithm>
 #include "sampling.h"
 #include "matrix2d.h"
 
+// Maximum number of cells per dimension of a DirectionIndex
+#define DIRECTION_INDEX_MAX_CELLS 64
+// Tolerance for the rounding errors in the distances between directions
+#define DIRECTION_INDEX_MARGIN 1e-6
+
+/* Build the direction index ----------------------------------------------- */
+void DirectionIndex::build(const std::vector< Matrix1D<double> > &directions, double cellSize)
+{
+    n = (int)ceil(2.0 / XMIPP_MAX(cellSize, 2.0 / DIRECTION_INDEX_MAX_CELLS));
+    n = XMIPP_MAX(n, 1);
+    this->cellSize = 2.0 / n;
+
+    size_t N = directions.size();
+    x.resize(N);
+    y.resize(N);
+    z.resize(N);
+    std::vector<size_t> cell(N);
+    cellStart.assign(n * n * n + 1, 0);
+    for (size_t i = 0; i < N; ++i)
+    {
+        x[i] = XX(directions[i]);
+        y[i] = YY(directions[i]);
+        z[i] = ZZ(directions[i]);
+        cell[i] = ((size_t)cellIndex(z[i]) * n + cellIndex(y[i])) * n + cellIndex(x[i]);
+        cellStart[cell[i] + 1]++;
+    }
+    for (size_t c = 1; c < cellStart.size(); ++c)
+        cellStart[c] += cellStart[c - 1];
+
+    // The directions of each cell keep their order
+    std::vector<size_t> next(cellStart.begin(), cellStart.end() - 1);
+    cellDirections.resize(N);
+    for (size_t i = 0; i < N; ++i)
+        cellDirections[next[cell[i]]++] = i;
+}
+
+int DirectionIndex::cellIndex(double v) const
+{
+    int c = (int)floor((v + 1) / cellSize);
+    return CLIP(c, 0, n - 1);
+}
+
+double DirectionIndex::chordLength(double cosAngle)
+{
+    return sqrt(XMIPP_MAX(0.0, 2.0 - 2.0 * cosAngle));
+}
+
+/* Directions within a radius ---------------------------------------------- */
+void DirectionIndex::findWithin(const Matrix1D<double> &direction, double cosRadius,
+                                std::vector<size_t> &result) const
+{
+    result.clear();
+    double qx = XX(direction), qy = YY(direction), qz = ZZ(direction);
+    double r = chordLength(cosRadius) + DIRECTION_INDEX_MARGIN;
+    int x0 = cellIndex(qx - r), xF = cellIndex(qx + r);
+    int y0 = cellIndex(qy - r), yF = cellIndex(qy + r);
+    int z0 = cellIndex(qz - r), zF = cellIndex(qz + r);
+    for (int kz = z0; kz <= zF; ++kz)
+        for (int ky = y0; ky <= yF; ++ky)
+            for (int kx = x0; kx <= xF; ++kx)
+            {
+                size_t c = ((size_t)kz * n + ky) * n + kx;
+                for (size_t p = cellStart[c]; p < cellStart[c + 1]; ++p)
+                {
+                    size_t i = cellDirections[p];
+                    if (qx * x[i] + qy * y[i] + qz * z[i] > cosRadius)
+                        result.push_back(i);
+                }
+            }
+    std::sort(result.begin(), result.end());
+}
+
+bool DirectionIndex::anyWithin(const Matrix1D<double> &direction, double cosRadius) const
+{
+    double qx = XX(direction), qy = YY(direction), qz = ZZ(direction);
+    double r = chordLength(cosRadius) + DIRECTION_INDEX_MARGIN;
+    int x0 = cellIndex(qx - r), xF = cellIndex(qx + r);
+    int y0 = cellIndex(qy - r), yF = cellIndex(qy + r);
+    int z0 = cellIndex(qz - r), zF = cellIndex(qz + r);
+    for (int kz = z0; kz <= zF; ++kz)
+        for (int ky = y0; ky <= yF; ++ky)
+            for (int kx = x0; kx <= xF; ++kx)
+            {
+                size_t c = ((size_t)kz * n + ky) * n + kx;
+                for (size_t p = cellStart[c]; p < cellStart[c + 1]; ++p)
+                {
+                    size_t i = cellDirections[p];
+                    if (qx * x[i] + qy * y[i] + qz * z[i] > cosRadius)
+                        return true;
+                }
+            }
+    return false;
+}
+
+/* Closest direction ------------------------------------------------------- */
+int DirectionIndex::findClosest(const Matrix1D<double> &direction, double &dotProduct,
+                                double minDotProduct) const
+{
+    double qx = XX(direction), qy = YY(direction), qz = ZZ(direction);
+    int cx = cellIndex(qx), cy = cellIndex(qy), cz = cellIndex(qz);
+    int best = -1;
+    double bestDotProduct = minDotProduct;
+
+    // Visit the shells of cells around the query cell. The directions
+    // in the shell s are at least (s-1)*cellSize away from the query.
+    for (int s = 0; s < n; ++s)
+    {
+        if (s > 0 && chordLength(bestDotProduct) + DIRECTION_INDEX_MARGIN < (s - 1) * cellSize)
+            break;
+        int z0 = XMIPP_MAX(cz - s, 0), zF = XMIPP_MIN(cz + s, n - 1);
+        int y0 = XMIPP_MAX(cy - s, 0), yF = XMIPP_MIN(cy + s, n - 1);
+        int x0 = XMIPP_MAX(cx - s, 0), xF = XMIPP_MIN(cx + s, n - 1);
+        for (int kz = z0; kz <= zF; ++kz)
+            for (int ky = y0; ky <= yF; ++ky)
+                for (int kx = x0; kx <= xF; ++kx)
+                {
+                    if (abs(kz - cz) != s && abs(ky - cy) != s && abs(kx - cx) != s)
+                        continue;
+                    size_t c = ((size_t)kz * n + ky) * n + kx;
+                    for (size_t p = cellStart[c]; p < cellStart[c + 1]; ++p)
+                    {
+                        size_t i = cellDirections[p];
+                        double d = qx * x[i] + qy * y[i] + qz * z[i];
+                        if (d > bestDotProduct || (d == bestDotProduct && best != -1 && (int)i < best))
+                        {
+                            bestDotProduct = d;
+                            best = (int)i;
+                        }
+                    }
+                }
+    }
+    dotProduct = bestDotProduct;
+    return best;
+}
+
 /* Default Constructor */
 Sampling::Sampling()
 {
@@ -1712,7 +1848,6 @@ void Sampling::computeNeighbors(bool only_winner)
 
     // calculate some sizes only once
     size_t exp_data_projection_direction_by_L_R_size = exp_data_projection_direction_by_L_R.size();
-    size_t no_redundant_sampling_points_vector_size = no_redundant_sampling_points_vector.size();
 
     if (verbose)
     {
@@ -1722,6 +1857,13 @@ void Sampling::computeNeighbors(bool only_winner)
     size_t ratio = exp_data_projection_direction_by_L_R_size / 60;
     ratio = XMIPP_MAX(ratio, 1);
 
+    // Only the sampling points in the neighborhood are compared
+    DirectionIndex index;
+    std::vector<size_t> candidates;
+    if (cos_neighborhood_radius > -1.0)
+        index.build(no_redundant_sampling_points_vector,
+                    DirectionIndex::chordLength(cos_neighborhood_radius));
+
     for(size_t j = 0; j < exp_data_projection_direction_by_L_R_size;)
     {
         if ((j%ratio) == 0 && verbose)
@@ -1744,8 +1886,11 @@ void Sampling::computeNeighbors(bool only_winner)
 			for (size_t k = 0; k < R_repository.size(); k++,j++)
 			{
 				winner_dotProduct = -1.;
-				for (size_t i = 0; i < no_redundant_sampling_points_vector_size; ++i)
+				index.findWithin(exp_data_projection_direction_by_L_R[j],
+								 cos_neighborhood_radius, candidates);
+				for (size_t c = 0; c < candidates.size(); ++c)
 				{
+					size_t i = candidates[c];
 					my_dotProduct = dotProduct(no_redundant_sampling_points_vector[i],
 											   exp_data_projection_direction_by_L_R[j]);
 
@@ -1911,22 +2056,19 @@ void Sampling::computeNeighbors(bool only_winner)
 
 void Sampling::removePointsFarAwayFromExperimentalData()
 {
-    double my_dotProduct;
     Matrix1D<double>  row(3),direction(3);
     Matrix2D<double>  L(4, 4), R(4, 4);
 
     size_t my_end = no_redundant_sampling_points_vector.size() - 1;
 
+    DirectionIndex index;
+    index.build(exp_data_projection_direction_by_L_R,
+                DirectionIndex::chordLength(cos_neighborhood_radius));
+
     for (size_t i = 0; i <= my_end; i++)
     {
-        bool my_delete=true;
-        for (size_t j=0; my_delete && j< exp_data_projection_direction_by_L_R.size();j++)
-        {
-            my_dotProduct = dotProduct(no_redundant_sampling_points_vector[i],
-                                       exp_data_projection_direction_by_L_R[j]);
-            if (my_dotProduct > cos_neighborhood_radius)
-                my_delete=false;
-        }//for j
+        bool my_delete = !index.anyWithin(no_redundant_sampling_points_vector[i],
+                                          cos_neighborhood_radius);
         if(my_delete)
         {
             REMOVE_LAST(no_redundant_sampling_points_vector);
@@ -1999,6 +2141,10 @@ void Sampling::findClosestSamplingPoint(MetaData &DFi,
     int exp_image=1;
 #endif
 
+    DirectionIndex index;
+    index.build(no_redundant_sampling_points_vector,
+                DirectionIndex::chordLength(cos(sampling_rate_rad)));
+
     MDIterator iter(DFi);
     for(size_t i=0;i< exp_data_projection_direction_by_L_R.size();)
     {
@@ -2014,23 +2160,18 @@ void Sampling::findClosestSamplingPoint(MetaData &DFi,
                 <<  " .019"      << std::endl;
             }
 #endif
-            for(size_t j=0;j< no_redundant_sampling_points_vector.size();j++)
+            int j = index.findClosest(exp_data_projection_direction_by_L_R[i],
+                                      my_dotProduct_aux, my_dotProduct);
+            if (j >= 0)
             {
-                my_dotProduct_aux =
-                    dotProduct(exp_data_projection_direction_by_L_R[i],
-                               no_redundant_sampling_points_vector[j]);
-
-                if ( my_dotProduct_aux > my_dotProduct)
-                {
-                    my_dotProduct = my_dotProduct_aux;
-                    winner_sampling = j;
+                my_dotProduct = my_dotProduct_aux;
+                winner_sampling = j;
 #if defined(CHIMERA) || defined(MYPSI)
 
-                    winner_exp_L_R  = i;
+                winner_exp_L_R  = i;
 #endif
 
-                }
-            }//for j
+            }
         }//for k
 #ifdef  DEBUG3
         if( i==  ((exp_image+1)*R_repository.size()) )
@@ -2098,29 +2239,28 @@ void Sampling::findClosestExperimentalPoint()
     aux_my_exp_img_per_sampling_point.resize(
         no_redundant_sampling_points_vector.size());
 
+    DirectionIndex index;
+    index.build(no_redundant_sampling_points_vector,
+                DirectionIndex::chordLength(cos(sampling_rate_rad)));
+
     for(size_t i=0,l=0;i< exp_data_projection_direction_by_L_R.size();l++)
     {
         my_dotProduct=-2;
         for (size_t k = 0; k < R_repository.size(); k++,i++)
         {
-            for(size_t j=0;j< no_redundant_sampling_points_vector.size();j++)
+            int j = index.findClosest(exp_data_projection_direction_by_L_R[i],
+                                      my_dotProduct_aux, my_dotProduct);
+            if (j >= 0)
             {
-                my_dotProduct_aux =
-                    dotProduct(exp_data_projection_direction_by_L_R[i],
-                               no_redundant_sampling_points_vector[j]);
-
-                if ( my_dotProduct_aux > my_dotProduct)
-                {
-                    my_dotProduct = my_dotProduct_aux;
-                    winner_sampling = j;
+                my_dotProduct = my_dotProduct_aux;
+                winner_sampling = j;
 #ifdef CHIMERA
 
-                    winner_exp_L_R  = i;
+                winner_exp_L_R  = i;
 #endif
 
-                    winner_exp = l;
-                }
-            }//for j
+                winner_exp = l;
+            }
         }//for k
         aux_my_exp_img_per_sampling_point[winner_sampling].push_back(winner_exp);
 #ifdef CHIMERA
@@ -38,6 +38,59 @@
 /**@defgroup SphereSampling sampling (Sampling the projection sphere)
    @ingroup DataLibrary */
 //@{
+
+/** Index of directions on the unit sphere.
+    The directions are classified in the cells of a regular grid covering
+    the cube [-1,1]^3. The directions closer than a given angle to a query,
+    or the closest one, are found visiting the cells around the query
+    instead of comparing the query with all directions. The results are
+    those of the exhaustive search.
+    @code
+    DirectionIndex index;
+    index.build(directions, DirectionIndex::chordLength(cos(radius)));
+    std::vector<size_t> neighbors;
+    index.findWithin(direction, cos(radius), neighbors);
+    @endcode
+*/
+class DirectionIndex
+{
+public:
+    /** Classify the directions.
+        The cell size is best set to the distance between two directions
+        separated by the typical angle of the queries. The directions are
+        copied, so the vector can be modified after building the index. */
+    void build(const std::vector< Matrix1D<double> > &directions, double cellSize);
+
+    /** Directions whose dot product with the given one is larger than cosRadius.
+        The indexes of the directions are returned in increasing order. */
+    void findWithin(const Matrix1D<double> &direction, double cosRadius,
+                    std::vector<size_t> &result) const;
+
+    /** True if the dot product of any direction with the given one is larger than cosRadius */
+    bool anyWithin(const Matrix1D<double> &direction, double cosRadius) const;
+
+    /** Closest direction to the given one.
+        Only the directions whose dot product is larger than minDotProduct
+        are considered, -1 is returned if there is none. Among directions
+        with the same dot product, the one with the lowest index is chosen. */
+    int findClosest(const Matrix1D<double> &direction, double &dotProduct,
+                    double minDotProduct=-2) const;
+
+    /** Distance between two unit vectors whose dot product is cosAngle */
+    static double chordLength(double cosAngle);
+
+private:
+    // Cells per dimension and cell size
+    int n;
+    double cellSize;
+    // Coordinates of the directions
+    std::vector<double> x, y, z;
+    // Directions of the cell c are cellDirections[cellStart[c]...cellStart[c+1]-1]
+    std::vector<size_t> cellStart, cellDirections;
+
+    // Cell of a coordinate
+    int cellIndex(double v) const;
+};
 /** Routines with sampling the direction Sphere
     A triangular grid based on an icosahedron was first introduced in a
     meteorological model by Sadourny et al. (1968) and Williamson (1969). The
@@ -34,6 +34,7 @@ ProgTransformGeometry::~ProgTransformGeometry()
 void ProgTransformGeometry::defineParams()
 {
     each_image_produces_an_output = true;
+    allow_threads = true;
     save_metadata_stack = true;
     keep_input_columns = true;
     allow_apply_geo = true;
@@ -101,6 +102,11 @@ void ProgTransformGeometry::readParams()
     else if (degree == "linear")
         splineDegree = LINEAR;
     flip = checkParam("--flip");
+    // The options are parsed here, processImage may run in several threads
+    useMatrix = checkParam("--matrix");
+    if (useMatrix)
+        string2TransformationMatrix(getParam("--matrix"), matrixT);
+    writeMatrix = checkParam("--write_matrix");
 
     /** In most cases output "-o" is a metadata with the new geometry keeping the names of input images
      *  so we set the flags to keep the same image names in the output metadata
@@ -194,13 +200,14 @@ void ProgTransformGeometry::preProcess()
 
 void ProgTransformGeometry::processImage(const FileName &fnImg, const FileName &fnImgOut, const MDRow &rowIn, MDRow &rowOut)
 {
+    Matrix2D<double> B, T;
+    ImageGeneric img, imgOut;
 
-    if (checkParam("--matrix"))
+    if (useMatrix)
     {
-      // In this case we are directly reading the transformation matrix
+      // In this case we are directly using the transformation matrix
       // from the arguments passed
-      matrixStr = getParam("--matrix");
-      string2TransformationMatrix(matrixStr, T);
+      T = matrixT;
     }
     else
     {
@@ -213,8 +220,12 @@ void ProgTransformGeometry::processImage(const FileName &fnImg, const FileName &
       T = A * B;
     }
 
-    if (checkParam("--write_matrix"))
+    if (writeMatrix)
+    {
+        writeMutex.lock();
         std::cerr << T << std::endl;
+        writeMutex.unlock();
+    }
 
     if (applyTransform || fnImg != fnImgOut)
         img.read(fnImg);
@@ -226,13 +237,19 @@ void ProgTransformGeometry::processImage(const FileName &fnImg, const FileName &
         imgOut().resize(1, zdimOut, ydimOut, xdimOut, false);
         imgOut().setXmippOrigin();
         applyGeometry(splineDegree, imgOut(), img(), T, IS_NOT_INV, wrap, 0.);
+        writeMutex.lock();
         imgOut.write(fnImgOut);
+        writeMutex.unlock();
         rowOut.resetGeo(false);
     }
     else
     {
         transformationMatrix2Geo(T, rowOut);
         if (fnImg != fnImgOut )
+        {
+            writeMutex.lock();
             img.write(fnImgOut);
+            writeMutex.unlock();
+        }
     }
 }
@@ -45,9 +45,10 @@ public:
 protected:
     int             splineDegree, dim;
     bool            applyTransform, inverse, wrap, isVol, flip, mdVol;
-    Matrix2D<double> R, A, B, T;
-    ImageGeneric img, imgOut;
-    String matrixStr; // To read directly the matrix
+    Matrix2D<double> R, A;
+    /// Transformation matrix given with --matrix
+    Matrix2D<double> matrixT;
+    bool            useMatrix, writeMatrix;
 
     void defineParams();
     void readParams();
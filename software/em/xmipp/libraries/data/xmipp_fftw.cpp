@@ -29,8 +29,355 @@
 #include <string.h>
 #include <pthread.h>
 
+#include <map>
+
 static pthread_mutex_t fftw_plan_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+// Plan cache --------------------------------------------------------------
+bool FFTWPlanKey::operator<(const FFTWPlanKey &other) const
+{
+    if (rank!=other.rank)
+        return rank<other.rank;
+    if (howmany!=other.howmany)
+        return howmany<other.howmany;
+    for (int d=0; d<rank; ++d)
+        if (N[d]!=other.N[d])
+            return N[d]<other.N[d];
+    if (isReal!=other.isReal)
+        return isReal<other.isReal;
+    if (sign!=other.sign)
+        return sign<other.sign;
+    if (aligned!=other.aligned)
+        return aligned<other.aligned;
+    return nthreads<other.nthreads;
+}
+
+/* All the cache state lives in a single static object, so that the wisdom
+ * file (if any) is written when the program exits. Every member is protected
+ * by fftw_plan_mutex. */
+class FFTWPlanCacheData
+{
+public:
+    std::map<FFTWPlanKey, fftw_plan> plans;
+    std::map<FFTWPlanKey, fftwf_plan> plansFloat;
+    unsigned plannerFlags;
+    bool threadsInitialized;
+    bool envRead;
+    bool newWisdom;
+    FileName fnWisdom;
+
+    FFTWPlanCacheData()
+    {
+        plannerFlags=FFTW_ESTIMATE;
+        threadsInitialized=false;
+        envRead=false;
+        newWisdom=false;
+    }
+
+    ~FFTWPlanCacheData()
+    {
+        if (newWisdom && !fnWisdom.empty())
+        {
+            fftw_export_wisdom_to_filename(fnWisdom.c_str());
+            fftwf_export_wisdom_to_filename(floatWisdom(fnWisdom).c_str());
+        }
+        destroyPlans();
+    }
+
+    void destroyPlans()
+    {
+        for (std::map<FFTWPlanKey, fftw_plan>::iterator it=plans.begin(); it!=plans.end(); ++it)
+            fftw_destroy_plan(it->second);
+        plans.clear();
+        for (std::map<FFTWPlanKey, fftwf_plan>::iterator it=plansFloat.begin(); it!=plansFloat.end(); ++it)
+            fftwf_destroy_plan(it->second);
+        plansFloat.clear();
+    }
+
+    /* Single precision wisdom is kept in a separate file */
+    static FileName floatWisdom(const FileName &fn)
+    {
+        return fn+"_float";
+    }
+
+    /* Read XMIPP_FFTW_PLANNER and XMIPP_FFTW_WISDOM the first time a plan is needed */
+    void readEnvironment()
+    {
+        if (envRead)
+            return;
+        envRead=true;
+        const char * planner = getenv("XMIPP_FFTW_PLANNER");
+        if (planner!=NULL)
+        {
+            String value=planner;
+            toLower(value);
+            if (value=="estimate")
+                plannerFlags=FFTW_ESTIMATE;
+            else if (value=="measure")
+                plannerFlags=FFTW_MEASURE;
+            else if (value=="patient")
+                plannerFlags=FFTW_PATIENT;
+            else if (value=="exhaustive")
+                plannerFlags=FFTW_EXHAUSTIVE;
+            else
+                std::cerr << "Warning: XMIPP_FFTW_PLANNER=" << planner
+                << " not recognized, using estimate" << std::endl;
+        }
+        const char * wisdom = getenv("XMIPP_FFTW_WISDOM");
+        if (wisdom!=NULL)
+        {
+            fnWisdom=wisdom;
+            if (fnWisdom.exists())
+                fftw_import_wisdom_from_filename(fnWisdom.c_str());
+            if (floatWisdom(fnWisdom).exists())
+                fftwf_import_wisdom_from_filename(floatWisdom(fnWisdom).c_str());
+        }
+    }
+};
+
+static FFTWPlanCacheData fftw_plan_cache;
+
+fftw_plan FFTWPlanCache::getPlan(const FFTWPlanKey &key)
+{
+    pthread_mutex_lock(&fftw_plan_mutex);
+    std::map<FFTWPlanKey, fftw_plan>::iterator it=fftw_plan_cache.plans.find(key);
+    if (it!=fftw_plan_cache.plans.end())
+    {
+        fftw_plan plan=it->second;
+        pthread_mutex_unlock(&fftw_plan_mutex);
+        return plan;
+    }
+
+    fftw_plan_cache.readEnvironment();
+    size_t realSize=1;
+    for (int d=0; d<key.rank; ++d)
+        realSize*=key.N[d];
+    size_t fourierSize=realSize;
+    if (key.isReal)
+        fourierSize=(realSize/key.N[key.rank-1])*(key.N[key.rank-1]/2+1);
+    size_t howmany=key.howmany;
+
+    // Plan on scratch buffers, planners other than ESTIMATE overwrite the arrays
+    unsigned flags=fftw_plan_cache.plannerFlags;
+    if (!key.aligned)
+        flags|=FFTW_UNALIGNED;
+    if (fftw_plan_cache.threadsInitialized)
+        fftw_plan_with_nthreads(key.nthreads);
+    else if (key.nthreads!=1)
+    {
+        pthread_mutex_unlock(&fftw_plan_mutex);
+        REPORT_ERROR(ERR_THREADS_NOTINIT, "FFTW threads have not been initialized (FFTWPlanCache::getPlan)");
+    }
+    fftw_complex *scratchFourier=(fftw_complex*) fftw_malloc(howmany*fourierSize*sizeof(fftw_complex));
+    fftw_plan plan=NULL;
+    if (key.isReal)
+    {
+        double *scratchReal=(double*) fftw_malloc(howmany*realSize*sizeof(double));
+        if (key.howmany>1 && key.sign==FFTW_FORWARD)
+            plan=fftw_plan_many_dft_r2c(key.rank, key.N, key.howmany,
+                                        scratchReal, NULL, 1, realSize,
+                                        scratchFourier, NULL, 1, fourierSize, flags);
+        else if (key.howmany>1)
+            plan=fftw_plan_many_dft_c2r(key.rank, key.N, key.howmany,
+                                        scratchFourier, NULL, 1, fourierSize,
+                                        scratchReal, NULL, 1, realSize, flags);
+        else if (key.sign==FFTW_FORWARD)
+            plan=fftw_plan_dft_r2c(key.rank, key.N, scratchReal, scratchFourier, flags);
+        else
+            plan=fftw_plan_dft_c2r(key.rank, key.N, scratchFourier, scratchReal, flags);
+        fftw_free(scratchReal);
+    }
+    else
+    {
+        if (key.howmany!=1)
+        {
+            fftw_free(scratchFourier);
+            pthread_mutex_unlock(&fftw_plan_mutex);
+            REPORT_ERROR(ERR_NOT_IMPLEMENTED, "Batched plans are only available for real transforms");
+        }
+        fftw_complex *scratchComplex=(fftw_complex*) fftw_malloc(realSize*sizeof(fftw_complex));
+        if (key.sign==FFTW_FORWARD)
+            plan=fftw_plan_dft(key.rank, key.N, scratchComplex, scratchFourier, FFTW_FORWARD, flags);
+        else
+            plan=fftw_plan_dft(key.rank, key.N, scratchFourier, scratchComplex, FFTW_BACKWARD, flags);
+        fftw_free(scratchComplex);
+    }
+    fftw_free(scratchFourier);
+    if (plan==NULL)
+    {
+        pthread_mutex_unlock(&fftw_plan_mutex);
+        REPORT_ERROR(ERR_PLANS_NOCREATE, "FFTW plans cannot be created");
+    }
+    fftw_plan_cache.plans[key]=plan;
+    if (!(flags & FFTW_ESTIMATE))
+        fftw_plan_cache.newWisdom=true;
+    pthread_mutex_unlock(&fftw_plan_mutex);
+    return plan;
+}
+
+fftwf_plan FFTWPlanCache::getPlanFloat(const FFTWPlanKey &key)
+{
+    pthread_mutex_lock(&fftw_plan_mutex);
+    std::map<FFTWPlanKey, fftwf_plan>::iterator it=fftw_plan_cache.plansFloat.find(key);
+    if (it!=fftw_plan_cache.plansFloat.end())
+    {
+        fftwf_plan plan=it->second;
+        pthread_mutex_unlock(&fftw_plan_mutex);
+        return plan;
+    }
+
+    fftw_plan_cache.readEnvironment();
+    if (!key.isReal || key.howmany!=1)
+    {
+        pthread_mutex_unlock(&fftw_plan_mutex);
+        REPORT_ERROR(ERR_NOT_IMPLEMENTED, "Single precision plans are only available for single real transforms");
+    }
+    size_t realSize=1;
+    for (int d=0; d<key.rank; ++d)
+        realSize*=key.N[d];
+    size_t fourierSize=(realSize/key.N[key.rank-1])*(key.N[key.rank-1]/2+1);
+
+    unsigned flags=fftw_plan_cache.plannerFlags;
+    if (!key.aligned)
+        flags|=FFTW_UNALIGNED;
+    if (fftw_plan_cache.threadsInitialized)
+        fftwf_plan_with_nthreads(key.nthreads);
+    else if (key.nthreads!=1)
+    {
+        pthread_mutex_unlock(&fftw_plan_mutex);
+        REPORT_ERROR(ERR_THREADS_NOTINIT, "FFTW threads have not been initialized (FFTWPlanCache::getPlanFloat)");
+    }
+    fftwf_complex *scratchFourier=(fftwf_complex*) fftwf_malloc(fourierSize*sizeof(fftwf_complex));
+    float *scratchReal=(float*) fftwf_malloc(realSize*sizeof(float));
+    fftwf_plan plan=NULL;
+    if (key.sign==FFTW_FORWARD)
+        plan=fftwf_plan_dft_r2c(key.rank, key.N, scratchReal, scratchFourier, flags);
+    else
+        plan=fftwf_plan_dft_c2r(key.rank, key.N, scratchFourier, scratchReal, flags);
+    fftwf_free(scratchReal);
+    fftwf_free(scratchFourier);
+    if (plan==NULL)
+    {
+        pthread_mutex_unlock(&fftw_plan_mutex);
+        REPORT_ERROR(ERR_PLANS_NOCREATE, "FFTW plans cannot be created");
+    }
+    fftw_plan_cache.plansFloat[key]=plan;
+    if (!(flags & FFTW_ESTIMATE))
+        fftw_plan_cache.newWisdom=true;
+    pthread_mutex_unlock(&fftw_plan_mutex);
+    return plan;
+}
+
+void FFTWPlanCache::clear()
+{
+    pthread_mutex_lock(&fftw_plan_mutex);
+    fftw_plan_cache.destroyPlans();
+    pthread_mutex_unlock(&fftw_plan_mutex);
+}
+
+void FFTWPlanCache::setPlannerFlags(unsigned flags)
+{
+    pthread_mutex_lock(&fftw_plan_mutex);
+    fftw_plan_cache.readEnvironment();
+    fftw_plan_cache.plannerFlags=flags;
+    pthread_mutex_unlock(&fftw_plan_mutex);
+}
+
+unsigned FFTWPlanCache::getPlannerFlags()
+{
+    pthread_mutex_lock(&fftw_plan_mutex);
+    fftw_plan_cache.readEnvironment();
+    unsigned flags=fftw_plan_cache.plannerFlags;
+    pthread_mutex_unlock(&fftw_plan_mutex);
+    return flags;
+}
+
+void FFTWPlanCache::initThreads()
+{
+    pthread_mutex_lock(&fftw_plan_mutex);
+    if (!fftw_plan_cache.threadsInitialized)
+    {
+        if(fftw_init_threads()==0 || fftwf_init_threads()==0)
+        {
+            pthread_mutex_unlock(&fftw_plan_mutex);
+            REPORT_ERROR(ERR_THREADS_NOTINIT, (std::string)"FFTW cannot init threads (setThreadsNumber)");
+        }
+        fftw_plan_cache.threadsInitialized=true;
+    }
+    pthread_mutex_unlock(&fftw_plan_mutex);
+}
+
+void FFTWPlanCache::cleanupThreads()
+{
+    pthread_mutex_lock(&fftw_plan_mutex);
+    fftw_plan_cache.destroyPlans();
+    if (fftw_plan_cache.threadsInitialized)
+    {
+        fftw_cleanup_threads();
+        fftwf_cleanup_threads();
+    }
+    fftw_plan_cache.threadsInitialized=false;
+    pthread_mutex_unlock(&fftw_plan_mutex);
+}
+
+bool FFTWPlanCache::loadWisdom(const FileName &fn)
+{
+    pthread_mutex_lock(&fftw_plan_mutex);
+    bool ok=fftw_import_wisdom_from_filename(fn.c_str())!=0;
+    FileName fnFloat=FFTWPlanCacheData::floatWisdom(fn);
+    if (fnFloat.exists())
+        ok=ok && fftwf_import_wisdom_from_filename(fnFloat.c_str())!=0;
+    pthread_mutex_unlock(&fftw_plan_mutex);
+    return ok;
+}
+
+void FFTWPlanCache::saveWisdom(const FileName &fn)
+{
+    pthread_mutex_lock(&fftw_plan_mutex);
+    int ok=fftw_export_wisdom_to_filename(fn.c_str()) &&
+           fftwf_export_wisdom_to_filename(FFTWPlanCacheData::floatWisdom(fn).c_str());
+    pthread_mutex_unlock(&fftw_plan_mutex);
+    if (!ok)
+        REPORT_ERROR(ERR_IO_NOWRITE, formatString("Cannot write FFTW wisdom to %s", fn.c_str()));
+}
+
+size_t FFTWPlanCache::size()
+{
+    pthread_mutex_lock(&fftw_plan_mutex);
+    size_t n=fftw_plan_cache.plans.size()+fftw_plan_cache.plansFloat.size();
+    pthread_mutex_unlock(&fftw_plan_mutex);
+    return n;
+}
+
+/* Fill the logical dimensions of a plan key from an array */
+template <typename T>
+void fillPlanKey(const MultidimArray<T> &input, FFTWPlanKey &key)
+{
+    key.howmany=1;
+    key.rank=3;
+    if (ZSIZE(input)==1)
+    {
+        key.rank=2;
+        if (YSIZE(input)==1)
+            key.rank=1;
+    }
+    switch (key.rank)
+    {
+    case 1:
+        key.N[0]=XSIZE(input);
+        break;
+    case 2:
+        key.N[0]=YSIZE(input);
+        key.N[1]=XSIZE(input);
+        break;
+    case 3:
+        key.N[0]=ZSIZE(input);
+        key.N[1]=YSIZE(input);
+        key.N[2]=XSIZE(input);
+        break;
+    }
+}
+
 // Constructors and destructors --------------------------------------------
 FourierTransformer::FourierTransformer()
 {
@@ -56,18 +403,13 @@ void FourierTransformer::init()
     fPlanBackward    = NULL;
     dataPtr          = NULL;
     complexDataPtr   = NULL;
+    fourierDataPtr   = NULL;
 }
 
 void FourierTransformer::clear()
 {
     fFourier.clear();
-    // Anything to do with plans has to be protected for threads!
-    pthread_mutex_lock(&fftw_plan_mutex);
-    if (fPlanForward !=NULL)
-        fftw_destroy_plan(fPlanForward);
-    if (fPlanBackward!=NULL)
-        fftw_destroy_plan(fPlanBackward);
-    pthread_mutex_unlock(&fftw_plan_mutex);
+    // Plans belong to the plan cache
     init();
 }
 
@@ -99,49 +441,24 @@ void FourierTransformer::setReal(MultidimArray<double> &input)
         recomputePlan=!(fReal->sameShape(input));
     fFourier.resizeNoCopy(ZSIZE(input),YSIZE(input),XSIZE(input)/2+1);
     fReal=&input;
+    fComplex=NULL;
+    if (fourierDataPtr!=MULTIDIM_ARRAY(fFourier))
+        recomputePlan=true;
 
     if (recomputePlan)
     {
-        int ndim=3;
-        if (ZSIZE(input)==1)
-        {
-            ndim=2;
-            if (YSIZE(input)==1)
-                ndim=1;
-        }
-        int N[3];
-        switch (ndim)
-        {
-        case 1:
-            N[0]=XSIZE(input);
-            break;
-        case 2:
-            N[0]=YSIZE(input);
-            N[1]=XSIZE(input);
-            break;
-        case 3:
-            N[0]=ZSIZE(input);
-            N[1]=YSIZE(input);
-            N[2]=XSIZE(input);
-            break;
-        }
-
-        pthread_mutex_lock(&fftw_plan_mutex);
-        if (fPlanForward!=NULL)
-            fftw_destroy_plan(fPlanForward);
-        fPlanForward=NULL;
-        fPlanForward = fftw_plan_dft_r2c(ndim, N, MULTIDIM_ARRAY(*fReal),
-                                         (fftw_complex*) MULTIDIM_ARRAY(fFourier), FFTW_ESTIMATE);
-        if (fPlanBackward!=NULL)
-            fftw_destroy_plan(fPlanBackward);
-        fPlanBackward=NULL;
-        fPlanBackward = fftw_plan_dft_c2r(ndim, N,
-                                          (fftw_complex*) MULTIDIM_ARRAY(fFourier), MULTIDIM_ARRAY(*fReal),
-                                          FFTW_ESTIMATE);
-        if (fPlanForward == NULL || fPlanBackward == NULL)
-            REPORT_ERROR(ERR_PLANS_NOCREATE, "FFTW plans cannot be created");
+        FFTWPlanKey key;
+        fillPlanKey(input, key);
+        key.isReal=true;
+        key.aligned=fftw_alignment_of(MULTIDIM_ARRAY(*fReal))==0 &&
+                    fftw_alignment_of((double*) MULTIDIM_ARRAY(fFourier))==0;
+        key.nthreads=nthreads;
+        key.sign=FFTW_FORWARD;
+        fPlanForward=FFTWPlanCache::getPlan(key);
+        key.sign=FFTW_BACKWARD;
+        fPlanBackward=FFTWPlanCache::getPlan(key);
         dataPtr=MULTIDIM_ARRAY(*fReal);
-        pthread_mutex_unlock(&fftw_plan_mutex);
+        fourierDataPtr=MULTIDIM_ARRAY(fFourier);
     }
 }
 
@@ -156,49 +473,24 @@ void FourierTransformer::setReal(MultidimArray<std::complex<double> > &input)
         recomputePlan=!(fComplex->sameShape(input));
     fFourier.resizeNoCopy(input);
     fComplex=&input;
+    fReal=NULL;
+    if (fourierDataPtr!=MULTIDIM_ARRAY(fFourier))
+        recomputePlan=true;
 
     if (recomputePlan)
     {
-        int ndim=3;
-        if (ZSIZE(input)==1)
-        {
-            ndim=2;
-            if (YSIZE(input)==1)
-                ndim=1;
-        }
-        int *N = new int[ndim];
-        switch (ndim)
-        {
-        case 1:
-            N[0]=XSIZE(input);
-            break;
-        case 2:
-            N[0]=YSIZE(input);
-            N[1]=XSIZE(input);
-            break;
-        case 3:
-            N[0]=ZSIZE(input);
-            N[1]=YSIZE(input);
-            N[2]=XSIZE(input);
-            break;
-        }
-
-        pthread_mutex_lock(&fftw_plan_mutex);
-        if (fPlanForward!=NULL)
-            fftw_destroy_plan(fPlanForward);
-        fPlanForward=NULL;
-        fPlanForward = fftw_plan_dft(ndim, N, (fftw_complex*) MULTIDIM_ARRAY(*fComplex),
-                                     (fftw_complex*) MULTIDIM_ARRAY(fFourier), FFTW_FORWARD, FFTW_ESTIMATE);
-        if (fPlanBackward!=NULL)
-            fftw_destroy_plan(fPlanBackward);
-        fPlanBackward=NULL;
-        fPlanBackward = fftw_plan_dft(ndim, N, (fftw_complex*) MULTIDIM_ARRAY(fFourier),
-                                      (fftw_complex*) MULTIDIM_ARRAY(*fComplex), FFTW_BACKWARD, FFTW_ESTIMATE);
-        if (fPlanForward == NULL || fPlanBackward == NULL)
-            REPORT_ERROR(ERR_PLANS_NOCREATE, "FFTW plans cannot be created");
-        delete [] N;
+        FFTWPlanKey key;
+        fillPlanKey(input, key);
+        key.isReal=false;
+        key.aligned=fftw_alignment_of((double*) MULTIDIM_ARRAY(*fComplex))==0 &&
+                    fftw_alignment_of((double*) MULTIDIM_ARRAY(fFourier))==0;
+        key.nthreads=nthreads;
+        key.sign=FFTW_FORWARD;
+        fPlanForward=FFTWPlanCache::getPlan(key);
+        key.sign=FFTW_BACKWARD;
+        fPlanBackward=FFTWPlanCache::getPlan(key);
         complexDataPtr=MULTIDIM_ARRAY(*fComplex);
-        pthread_mutex_unlock(&fftw_plan_mutex);
+        fourierDataPtr=MULTIDIM_ARRAY(fFourier);
     }
 }
 
@@ -213,7 +505,12 @@ void FourierTransformer::Transform(int sign)
 {
     if (sign == FFTW_FORWARD)
     {
-        fftw_execute(fPlanForward);
+        if (fReal!=NULL)
+            fftw_execute_dft_r2c(fPlanForward, MULTIDIM_ARRAY(*fReal),
+                                 (fftw_complex*) MULTIDIM_ARRAY(fFourier));
+        else
+            fftw_execute_dft(fPlanForward, (fftw_complex*) MULTIDIM_ARRAY(*fComplex),
+                             (fftw_complex*) MULTIDIM_ARRAY(fFourier));
 
         if (sign == normSign)
         {
@@ -248,7 +545,12 @@ void FourierTransformer::Transform(int sign)
     }
     else if (sign == FFTW_BACKWARD)
     {
-        fftw_execute(fPlanBackward);
+        if (fReal!=NULL)
+            fftw_execute_dft_c2r(fPlanBackward, (fftw_complex*) MULTIDIM_ARRAY(fFourier),
+                                 MULTIDIM_ARRAY(*fReal));
+        else
+            fftw_execute_dft(fPlanBackward, (fftw_complex*) MULTIDIM_ARRAY(fFourier),
+                             (fftw_complex*) MULTIDIM_ARRAY(*fComplex));
 
         if (sign == normSign)
         {
@@ -288,11 +590,11 @@ void FourierTransformer::inverseFourierTransform()
 }
 
 // Inforce Hermitian symmetry ---------------------------------------------
-void FourierTransformer::enforceHermitianSymmetry()
+/* Hermitian symmetry of the Fourier transform of a real array of Zdim x Ydim */
+template<typename T>
+static void enforceHermitianSymmetryT(MultidimArray< std::complex<T> > &fFourier, int Zdim, int Ydim)
 {
     int ndim=3;
-    int Zdim=ZSIZE(*fReal);
-    int Ydim=YSIZE(*fReal);
     if (Zdim==1)
     {
         ndim=2;
@@ -311,7 +613,7 @@ void FourierTransformer::enforceHermitianSymmetry()
         for (int i=1; i<=yHalf; i++)
         {
             int isym=intWRAP(-i,0,Ydim-1);
-            std::complex<double> mean=0.5*(
+            std::complex<T> mean=(T)0.5*(
                                           DIRECT_A2D_ELEM(fFourier,i,0)+
                                           conj(DIRECT_A2D_ELEM(fFourier,isym,0)));
             DIRECT_A2D_ELEM(fFourier,i,0)=mean;
@@ -325,7 +627,7 @@ void FourierTransformer::enforceHermitianSymmetry()
             for (int i=1; i<=yHalf; i++)
             {
                 int isym=intWRAP(-i,0,Ydim-1);
-                std::complex<double> mean=0.5*(
+                std::complex<T> mean=(T)0.5*(
                                               DIRECT_A3D_ELEM(fFourier,k,i,0)+
                                               conj(DIRECT_A3D_ELEM(fFourier,ksym,isym,0)));
                 DIRECT_A3D_ELEM(fFourier,k,i,0)=mean;
@@ -335,7 +637,7 @@ void FourierTransformer::enforceHermitianSymmetry()
         for (int k=1; k<=zHalf; k++)
         {
             int ksym=intWRAP(-k,0,Zdim-1);
-            std::complex<double> mean=0.5*(
+            std::complex<T> mean=(T)0.5*(
                                           DIRECT_A3D_ELEM(fFourier,k,0,0)+
                                           conj(DIRECT_A3D_ELEM(fFourier,ksym,0,0)));
             DIRECT_A3D_ELEM(fFourier,k,0,0)=mean;
@@ -345,6 +647,239 @@ void FourierTransformer::enforceHermitianSymmetry()
     }
 }
 
+void FourierTransformer::enforceHermitianSymmetry()
+{
+    enforceHermitianSymmetryT(fFourier, ZSIZE(*fReal), YSIZE(*fReal));
+}
+
+// Single precision transformer -------------------------------------------
+FourierTransformerFloat::FourierTransformerFloat()
+{
+    fReal=NULL;
+    fPlanForward=NULL;
+    fPlanBackward=NULL;
+    dataPtr=NULL;
+    fourierDataPtr=NULL;
+    nthreads=1;
+    normSign=FFTW_FORWARD;
+}
+
+FourierTransformerFloat::FourierTransformerFloat(int _normSign)
+{
+    fReal=NULL;
+    fPlanForward=NULL;
+    fPlanBackward=NULL;
+    dataPtr=NULL;
+    fourierDataPtr=NULL;
+    nthreads=1;
+    normSign=_normSign;
+}
+
+FourierTransformerFloat::~FourierTransformerFloat()
+{
+    clear();
+}
+
+void FourierTransformerFloat::clear()
+{
+    fFourier.clear();
+    fReal=NULL;
+    fPlanForward=NULL;
+    fPlanBackward=NULL;
+    dataPtr=NULL;
+    fourierDataPtr=NULL;
+}
+
+void FourierTransformerFloat::setReal(MultidimArray<float> &input)
+{
+    bool recomputePlan=false;
+    if (fReal==NULL)
+        recomputePlan=true;
+    else if (dataPtr!=MULTIDIM_ARRAY(input))
+        recomputePlan=true;
+    else
+        recomputePlan=!(fReal->sameShape(input));
+    fFourier.resizeNoCopy(ZSIZE(input),YSIZE(input),XSIZE(input)/2+1);
+    fReal=&input;
+    if (fourierDataPtr!=MULTIDIM_ARRAY(fFourier))
+        recomputePlan=true;
+
+    if (recomputePlan)
+    {
+        FFTWPlanKey key;
+        fillPlanKey(input, key);
+        key.isReal=true;
+        key.aligned=fftwf_alignment_of(MULTIDIM_ARRAY(*fReal))==0 &&
+                    fftwf_alignment_of((float*) MULTIDIM_ARRAY(fFourier))==0;
+        key.nthreads=nthreads;
+        key.sign=FFTW_FORWARD;
+        fPlanForward=FFTWPlanCache::getPlanFloat(key);
+        key.sign=FFTW_BACKWARD;
+        fPlanBackward=FFTWPlanCache::getPlanFloat(key);
+        dataPtr=MULTIDIM_ARRAY(*fReal);
+        fourierDataPtr=MULTIDIM_ARRAY(fFourier);
+    }
+}
+
+void FourierTransformerFloat::setFourier(const MultidimArray<std::complex<float> > &inputFourier)
+{
+    memcpy(MULTIDIM_ARRAY(fFourier),MULTIDIM_ARRAY(inputFourier),
+           MULTIDIM_SIZE(inputFourier)*2*sizeof(float));
+}
+
+void FourierTransformerFloat::Transform(int sign)
+{
+    if (fReal==NULL)
+        REPORT_ERROR(ERR_UNCLASSIFIED,"No real data defined");
+    if (sign == FFTW_FORWARD)
+    {
+        fftwf_execute_dft_r2c(fPlanForward, MULTIDIM_ARRAY(*fReal),
+                              (fftwf_complex*) MULTIDIM_ARRAY(fFourier));
+        if (sign == normSign)
+        {
+            float isize=1.0f/MULTIDIM_SIZE(*fReal);
+            float *ptr=(float*)MULTIDIM_ARRAY(fFourier);
+            for (size_t n=0; n<2*fFourier.nzyxdim; ++n)
+                ptr[n] *= isize;
+        }
+    }
+    else if (sign == FFTW_BACKWARD)
+    {
+        fftwf_execute_dft_c2r(fPlanBackward, (fftwf_complex*) MULTIDIM_ARRAY(fFourier),
+                              MULTIDIM_ARRAY(*fReal));
+        if (sign == normSign)
+        {
+            float isize=1.0f/MULTIDIM_SIZE(*fReal);
+            FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(*fReal)
+            DIRECT_MULTIDIM_ELEM(*fReal,n) *= isize;
+        }
+    }
+}
+
+void FourierTransformerFloat::FourierTransform()
+{
+    Transform(FFTW_FORWARD);
+}
+
+void FourierTransformerFloat::enforceHermitianSymmetry()
+{
+    enforceHermitianSymmetryT(fFourier, ZSIZE(*fReal), YSIZE(*fReal));
+}
+
+void FourierTransformerFloat::inverseFourierTransform()
+{
+    Transform(FFTW_BACKWARD);
+}
+
+// Batched transformer -----------------------------------------------------
+BatchFourierTransformer::BatchFourierTransformer()
+{
+    fReal=NULL;
+    fPlanForward=NULL;
+    fPlanBackward=NULL;
+    dataPtr=NULL;
+    fourierDataPtr=NULL;
+    nthreads=1;
+    normSign=FFTW_FORWARD;
+}
+
+BatchFourierTransformer::BatchFourierTransformer(int _normSign)
+{
+    fReal=NULL;
+    fPlanForward=NULL;
+    fPlanBackward=NULL;
+    dataPtr=NULL;
+    fourierDataPtr=NULL;
+    nthreads=1;
+    normSign=_normSign;
+}
+
+BatchFourierTransformer::~BatchFourierTransformer()
+{
+    clear();
+}
+
+void BatchFourierTransformer::clear()
+{
+    fFourier.clear();
+    fReal=NULL;
+    fPlanForward=NULL;
+    fPlanBackward=NULL;
+    dataPtr=NULL;
+    fourierDataPtr=NULL;
+}
+
+void BatchFourierTransformer::setReal(MultidimArray<double> &input)
+{
+    bool recomputePlan=false;
+    if (fReal==NULL)
+        recomputePlan=true;
+    else if (dataPtr!=MULTIDIM_ARRAY(input))
+        recomputePlan=true;
+    else
+        recomputePlan=!(fReal->sameShape(input));
+    fFourier.resizeNoCopy(NSIZE(input),ZSIZE(input),YSIZE(input),XSIZE(input)/2+1);
+    fReal=&input;
+    if (fourierDataPtr!=MULTIDIM_ARRAY(fFourier))
+        recomputePlan=true;
+
+    if (recomputePlan)
+    {
+        FFTWPlanKey key;
+        fillPlanKey(input, key);
+        key.howmany=NSIZE(input);
+        key.isReal=true;
+        key.aligned=fftw_alignment_of(MULTIDIM_ARRAY(*fReal))==0 &&
+                    fftw_alignment_of((double*) MULTIDIM_ARRAY(fFourier))==0;
+        key.nthreads=nthreads;
+        key.sign=FFTW_FORWARD;
+        fPlanForward=FFTWPlanCache::getPlan(key);
+        key.sign=FFTW_BACKWARD;
+        fPlanBackward=FFTWPlanCache::getPlan(key);
+        dataPtr=MULTIDIM_ARRAY(*fReal);
+        fourierDataPtr=MULTIDIM_ARRAY(fFourier);
+    }
+}
+
+void BatchFourierTransformer::Transform(int sign)
+{
+    if (fReal==NULL)
+        REPORT_ERROR(ERR_UNCLASSIFIED,"No real data defined");
+    // Normalization is done by the size of each image, not of the whole stack
+    double isize=1.0/(ZSIZE(*fReal)*YXSIZE(*fReal));
+    if (sign == FFTW_FORWARD)
+    {
+        fftw_execute_dft_r2c(fPlanForward, MULTIDIM_ARRAY(*fReal),
+                             (fftw_complex*) MULTIDIM_ARRAY(fFourier));
+        if (sign == normSign)
+        {
+            double *ptr=(double*)MULTIDIM_ARRAY(fFourier);
+            for (size_t n=0; n<2*fFourier.nzyxdim; ++n)
+                ptr[n] *= isize;
+        }
+    }
+    else if (sign == FFTW_BACKWARD)
+    {
+        fftw_execute_dft_c2r(fPlanBackward, (fftw_complex*) MULTIDIM_ARRAY(fFourier),
+                             MULTIDIM_ARRAY(*fReal));
+        if (sign == normSign)
+        {
+            FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(*fReal)
+            DIRECT_MULTIDIM_ELEM(*fReal,n) *= isize;
+        }
+    }
+}
+
+void BatchFourierTransformer::FourierTransform()
+{
+    Transform(FFTW_FORWARD);
+}
+
+void BatchFourierTransformer::inverseFourierTransform()
+{
+    Transform(FFTW_BACKWARD);
+}
+
 /* FFT Magnitude  ------------------------------------------------------- */
 void FFT_magnitude(const MultidimArray< std::complex<double> > &v,
                    MultidimArray<double> &mag)
@@ -823,6 +1358,52 @@ void correlation_matrix(const MultidimArray< std::complex< double > > & FFT1,
         CenterFFT(R, true);
 }
 
+void correlationInFourier(const MultidimArray< std::complex< float > > & FF1, MultidimArray< std::complex< float > > & FF2, float dSize)
+{
+    // Multiply FFT1 * FFT2'
+    float mdSize=-dSize;
+    float a, b, c, d; // a+bi, c+di
+    float *ptrFFT2=(float*)MULTIDIM_ARRAY(FF2);
+    float *ptrFFT1=(float*)MULTIDIM_ARRAY(FF1);
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(FF1)
+    {
+        a=*ptrFFT1++;
+        b=*ptrFFT1++;
+        c=(*ptrFFT2)*dSize;
+        d=(*(ptrFFT2+1))*mdSize;
+        *ptrFFT2++ = a*c-b*d;
+        *ptrFFT2++ = b*c+a*d;
+    }
+}
+
+void correlation_matrix(const MultidimArray< std::complex< float > > & FFT1,
+                        const MultidimArray< std::complex< float > > & FFT2,
+                        MultidimArray<float>& R,
+                        CorrelationAuxFloat &aux,
+                        bool center)
+{
+    aux.transformer2.setReal(R);
+    aux.transformer2.setFourier(FFT2);
+    correlationInFourier(FFT1,aux.transformer2.fFourier,MULTIDIM_SIZE(R));
+    aux.transformer2.inverseFourierTransform();
+    if (center)
+        CenterFFT(R, true);
+}
+
+void correlation_matrix(const MultidimArray< std::complex< float > > & FF1,
+                        const MultidimArray<float> & m2,
+                        MultidimArray<float>& R,
+                        CorrelationAuxFloat &aux,
+                        bool center)
+{
+    R=m2;
+    aux.transformer2.FourierTransform(R, aux.FFT2, false);
+    correlationInFourier(FF1,aux.FFT2,MULTIDIM_SIZE(R));
+    aux.transformer2.inverseFourierTransform();
+    if (center)
+        CenterFFT(R, true);
+}
+
 void fast_correlation_vector(const MultidimArray< std::complex<double> > & FFT1,
                         const MultidimArray< std::complex<double> > & FFT2,
                         MultidimArray< double >& R,
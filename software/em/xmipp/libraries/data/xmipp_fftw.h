@@ -39,6 +39,84 @@
   *@{
   */
 
+/** Key identifying an FFTW plan in the plan cache.
+ * @ingroup FourierW
+ *
+ * Two transforms can share a plan if they have the same logical size,
+ * number of transforms in a batch, kind (real or complex), direction,
+ * memory alignment and number of threads.
+ */
+struct FFTWPlanKey
+{
+    /// Rank of the transform (1, 2 or 3)
+    int rank;
+    /// Logical dimensions (slowest varying first)
+    int N[3];
+    /// Number of contiguous transforms computed by the plan
+    int howmany;
+    /// True for real to complex (and complex to real) transforms
+    bool isReal;
+    /// FFTW_FORWARD or FFTW_BACKWARD
+    int sign;
+    /// True if input and output arrays are SIMD aligned
+    bool aligned;
+    /// Number of threads used by the plan
+    int nthreads;
+
+    bool operator<(const FFTWPlanKey &other) const;
+};
+
+/** Process-wide cache of FFTW plans.
+ * @ingroup FourierW
+ *
+ * Plans are created once for each (size, kind, direction, alignment, threads)
+ * and shared by all FourierTransformer objects, which execute them on their own
+ * arrays through the FFTW new-array execute interface. Plans are created on
+ * scratch buffers so that MEASURE or PATIENT planning never overwrites user data.
+ * The planner mutex is therefore only held for a lookup once a plan exists.
+ *
+ * The planner rigor and a wisdom file can be set programmatically or through
+ * the environment variables XMIPP_FFTW_PLANNER (estimate, measure, patient or
+ * exhaustive) and XMIPP_FFTW_WISDOM (file loaded at first use and saved at exit).
+ * Single precision wisdom is stored next to it with the suffix _float.
+ */
+class FFTWPlanCache
+{
+public:
+    /** Get a plan from the cache, creating it if needed. */
+    static fftw_plan getPlan(const FFTWPlanKey &key);
+
+    /** Get a single precision plan from the cache, creating it if needed.
+     * Only real to complex (and complex to real) transforms are supported. */
+    static fftwf_plan getPlanFloat(const FFTWPlanKey &key);
+
+    /** Destroy all cached plans.
+     * Plans held by existing transformers are no longer valid after this call. */
+    static void clear();
+
+    /** Set the planner flags (FFTW_ESTIMATE, FFTW_MEASURE, FFTW_PATIENT, ...)
+     * used for plans created from now on. */
+    static void setPlannerFlags(unsigned flags);
+
+    /** Planner flags currently in use */
+    static unsigned getPlannerFlags();
+
+    /** Initialize FFTW threads. It is safe to call it several times. */
+    static void initThreads();
+
+    /** Release FFTW threads. All cached plans are destroyed. */
+    static void cleanupThreads();
+
+    /** Import FFTW wisdom from a file. Returns false if it cannot be read. */
+    static bool loadWisdom(const FileName &fn);
+
+    /** Export the accumulated FFTW wisdom to a file. */
+    static void saveWisdom(const FileName &fn);
+
+    /** Number of plans currently stored */
+    static size_t size();
+};
+
 /** Fourier Transformer class.
  * @ingroup FourierW
  *
@@ -69,10 +147,10 @@ public:
     /** Fourier array  */
     MultidimArray< std::complex<double> > fFourier;
 
-    /* fftw Forawrd plan */
+    /* fftw Forward plan (owned by FFTWPlanCache) */
     fftw_plan fPlanForward;
 
-    /* fftw Backward plan */
+    /* fftw Backward plan (owned by FFTWPlanCache) */
     fftw_plan fPlanBackward;
 
     /* number of threads*/
@@ -101,12 +179,8 @@ public:
      *
      *  The nthreads argument indicates the number of threads you
      *  want FFTW to use (or actually, the maximum number). All
-     *  plans subsequently created with any planner routine will use
-     *  that many threads. You can call fftw_plan_with_nthreads,
-     *  create some plans, call fftw_plan_with_nthreads again with a
-     *  different argument, and create some more plans for a new
-     *  number of threads. Plans already created before a call to
-     *  fftw_plan_with_nthreads are unaffected. If you pass an
+     *  plans subsequently taken from the plan cache by this
+     *  transformer will use that many threads. If you pass an
      *  nthreads argument of 1 (the default), threads are
      *  disabled for subsequent plans. */
     void setThreadsNumber(int tNumber)
@@ -115,27 +189,29 @@ public:
         {
             threadsSetOn=true;
             nthreads = tNumber;
-            if(fftw_init_threads()==0)
-                REPORT_ERROR(ERR_THREADS_NOTINIT, (std::string)"FFTW cannot init threads (setThreadsNumber)");
-            fftw_plan_with_nthreads(nthreads);
+            FFTWPlanCache::initThreads();
+            dataPtr=NULL;
+            complexDataPtr=NULL;
         }
     }
     /** Change Number of threads.
      *
      *  The nthreads argument indicates the number of threads you want FFTW to use
-     *  (or actually, the maximum number). All plans subsequently
-     *  created with any planner routine will use that many
-     *  threads. You can call fftw_plan_with_nthreads, create
-     *  some plans, call fftw_plan_with_nthreads again with a
-     *  different argument, and create some more plans for a new
-     *  number of threads. Plans already created before a call to
-     *  fftw_plan_with_nthreads are unaffected. If you pass an
+     *  (or actually, the maximum number). The plans are taken from the
+     *  plan cache, so changing the number of threads selects a different
+     *  cached plan the next time the real array is set. If you pass an
      *  nthreads argument of 1 (the default), threads are
      *  disabled for subsequent plans. */
     void changeThreadsNumber(int tNumber)
     {
         nthreads = tNumber;
-        fftw_plan_with_nthreads(nthreads);
+        if (nthreads!=1)
+        {
+            threadsSetOn=true;
+            FFTWPlanCache::initThreads();
+        }
+        dataPtr=NULL;
+        complexDataPtr=NULL;
     }
 
     /** Destroy Threads. Do not execute any previously created
@@ -144,7 +220,7 @@ public:
     {
         nthreads = 1;
         if(threadsSetOn)
-            fftw_cleanup_threads();
+            FFTWPlanCache::cleanupThreads();
 
         threadsSetOn=false;
     }
@@ -341,6 +417,9 @@ public:
     /* Pointer to the array of complex<double> with which the plan was computed */
     std::complex<double> * complexDataPtr;
 
+    /* Pointer to the Fourier array with which the plan was computed */
+    std::complex<double> * fourierDataPtr;
+
     /* Init object*/
     void init();
     /** Clear object */
@@ -350,9 +429,11 @@ public:
      * in the current configuration. If you want to deallocate all of that
      * and reset FFTW to the pristine state it was in when
      * you started your program, you can call:
+     * Cached plans are destroyed as well.
      */
     void cleanup(void)
     {
+        FFTWPlanCache::clear();
         fftw_cleanup();
     }
     /** Computes the transform, specified in Init() function
@@ -398,6 +479,273 @@ public:
 
 };
 
+/** Single precision Fourier Transformer class.
+ * @ingroup FourierW
+ *
+ * Same interface as FourierTransformer for real to complex transforms of
+ * MultidimArray<float>. The Fourier coefficients are std::complex<float>,
+ * so that the memory needed (and moved) by the transform is halved.
+ * Use it where the single precision accuracy is enough, for instance,
+ * to keep many Fourier transforms in memory.
+ *
+ * @code
+ * FourierTransformerFloat transformer;
+ * MultidimArray<float> I;
+ * MultidimArray< std::complex<float> > Ifft;
+ * transformer.FourierTransform(I,Ifft,false);
+ * @endcode
+ */
+class FourierTransformerFloat
+{
+public:
+    /** Real array, in fact a pointer to the user array is stored. */
+    MultidimArray<float> *fReal;
+
+    /** Fourier array  */
+    MultidimArray< std::complex<float> > fFourier;
+
+    /* fftw Forward plan (owned by FFTWPlanCache) */
+    fftwf_plan fPlanForward;
+
+    /* fftw Backward plan (owned by FFTWPlanCache) */
+    fftwf_plan fPlanBackward;
+
+    /* number of threads*/
+    int nthreads;
+
+    /* Sign where the normalization is applied */
+    int normSign;
+
+    /* Pointer to the array of floats with which the plan was computed */
+    float * dataPtr;
+
+    /* Pointer to the Fourier array with which the plan was computed */
+    std::complex<float> * fourierDataPtr;
+
+public:
+    /** Default constructor */
+    FourierTransformerFloat();
+
+    /* Constructor setting the sign of normalization application*/
+    FourierTransformerFloat(int _normSign);
+
+    /** Destructor */
+    ~FourierTransformerFloat();
+
+    /** Set Number of threads */
+    void setThreadsNumber(int tNumber)
+    {
+        if (tNumber!=1)
+            FFTWPlanCache::initThreads();
+        nthreads = tNumber;
+        dataPtr=NULL;
+    }
+
+    /** Compute the Fourier transform of a MultidimArray, 1D, 2D and 3D.
+        If getCopy is false, an alias to the transformed data is returned. */
+    template <typename T, typename T1>
+    void FourierTransform(T& v, T1& V, bool getCopy=true)
+    {
+        setReal(v);
+        Transform(FFTW_FORWARD);
+        if (getCopy)
+            getFourierCopy(V);
+        else
+            getFourierAlias(V);
+    }
+
+    /** Compute the Fourier transform.
+        The data is taken from the matrix with which the object was
+        created. */
+    void FourierTransform();
+
+    /** Compute the inverse Fourier transform.
+        The result is stored in the same real data that was passed for
+        the forward transform. The Fourier coefficients are taken from
+        the internal Fourier coefficients */
+    void inverseFourierTransform();
+
+    /** Enforce Hermitian symmetry.
+        If the Fourier transform risks of losing Hermitian symmetry,
+        use this function to renforce it before the inverse transform. */
+    void enforceHermitianSymmetry();
+
+    /** Compute the inverse Fourier transform.
+        The output matrix must already have the right size. */
+    template <typename T, typename T1>
+    void inverseFourierTransform(T& V, T1& v)
+    {
+        setReal(v);
+        setFourier(V);
+        Transform(FFTW_BACKWARD);
+    }
+
+    /** Get Fourier coefficients. */
+    template <typename T>
+    void getFourierAlias(T& V)
+    {
+        V.alias(fFourier);
+    }
+
+    /** Get Fourier coefficients. */
+    template <typename T>
+    void getFourierCopy(T& V)
+    {
+        V.resizeNoCopy(fFourier);
+        memcpy(MULTIDIM_ARRAY(V),MULTIDIM_ARRAY(fFourier),
+               MULTIDIM_SIZE(fFourier)*2*sizeof(float));
+    }
+
+    /** Clear object */
+    void clear();
+
+    /** Release the single precision FFTW persistent data. Cached plans are destroyed. */
+    void cleanup(void)
+    {
+        FFTWPlanCache::clear();
+        fftwf_cleanup();
+    }
+
+    /** Computes the transform in the direction given by sign. */
+    void Transform(int sign);
+
+    /** Set a Multidimarray for input.
+        In backward transforms the result will be stored in img. */
+    void setReal(MultidimArray<float> &img);
+
+    /** Set a Multidimarray for the Fourier transform.
+        The values of the input array are copied in the internal array. */
+    void setFourier(const MultidimArray<std::complex<float> > &imgFourier);
+
+    /* Set normalization sign. */
+    void setNormalizationSign(int _normSign)
+    {
+        normSign = _normSign;
+    }
+};
+
+/** Batched Fourier Transformer class.
+ * @ingroup FourierW
+ *
+ * Computes the Fourier transform of all the images (or volumes) of a stack
+ * with a single FFTW advanced interface plan. The real stack must be
+ * contiguous in memory (as any MultidimArray with NSIZE>1) and its Fourier
+ * transform is a stack with the same number of images and XSIZE/2+1 columns.
+ * If several threads are given, FFTW distributes the batch among them.
+ *
+ * @code
+ * BatchFourierTransformer transformer;
+ * MultidimArray<double> stack(N,Ydim,Xdim);
+ * MultidimArray< std::complex<double> > stackFourier, Ifft;
+ * transformer.FourierTransform(stack,stackFourier,false);
+ * transformer.getFourierImage(5,Ifft); // Alias to the transform of the 6th image
+ * @endcode
+ */
+class BatchFourierTransformer
+{
+public:
+    /** Real stack, in fact a pointer to the user array is stored. */
+    MultidimArray<double> *fReal;
+
+    /** Fourier stack */
+    MultidimArray< std::complex<double> > fFourier;
+
+    /* fftw Forward plan (owned by FFTWPlanCache) */
+    fftw_plan fPlanForward;
+
+    /* fftw Backward plan (owned by FFTWPlanCache) */
+    fftw_plan fPlanBackward;
+
+    /* number of threads*/
+    int nthreads;
+
+    /* Sign where the normalization is applied */
+    int normSign;
+
+    /* Pointer to the real stack with which the plan was computed */
+    double * dataPtr;
+
+    /* Pointer to the Fourier stack with which the plan was computed */
+    std::complex<double> * fourierDataPtr;
+
+public:
+    /** Default constructor */
+    BatchFourierTransformer();
+
+    /* Constructor setting the sign of normalization application*/
+    BatchFourierTransformer(int _normSign);
+
+    /** Destructor */
+    ~BatchFourierTransformer();
+
+    /** Set Number of threads used to transform the batch */
+    void setThreadsNumber(int tNumber)
+    {
+        if (tNumber!=1)
+            FFTWPlanCache::initThreads();
+        nthreads = tNumber;
+        dataPtr=NULL;
+    }
+
+    /** Compute the Fourier transform of all the images of a stack.
+        If getCopy is false, an alias to the transformed stack is returned. */
+    template <typename T, typename T1>
+    void FourierTransform(T& v, T1& V, bool getCopy=true)
+    {
+        setReal(v);
+        Transform(FFTW_FORWARD);
+        if (getCopy)
+            getFourierCopy(V);
+        else
+            getFourierAlias(V);
+    }
+
+    /** Compute the Fourier transform of the stack given in setReal. */
+    void FourierTransform();
+
+    /** Compute the inverse Fourier transform of the internal Fourier stack.
+        The result is stored in the real stack given in setReal. */
+    void inverseFourierTransform();
+
+    /** Get Fourier coefficients of the whole stack. */
+    template <typename T>
+    void getFourierAlias(T& V)
+    {
+        V.alias(fFourier);
+    }
+
+    /** Get Fourier coefficients of the whole stack. */
+    template <typename T>
+    void getFourierCopy(T& V)
+    {
+        V.resizeNoCopy(fFourier);
+        memcpy(MULTIDIM_ARRAY(V),MULTIDIM_ARRAY(fFourier),
+               MULTIDIM_SIZE(fFourier)*2*sizeof(double));
+    }
+
+    /** Alias to the Fourier transform of the n-th image (starting at 0) of a 2D stack. */
+    void getFourierImage(size_t n, MultidimArray< std::complex<double> > &V)
+    {
+        V.aliasImageInStack(fFourier,n);
+    }
+
+    /** Clear object */
+    void clear();
+
+    /** Computes the transform in the direction given by sign. */
+    void Transform(int sign);
+
+    /** Set the real stack.
+        In backward transforms the result will be stored in it. */
+    void setReal(MultidimArray<double> &stack);
+
+    /* Set normalization sign. */
+    void setNormalizationSign(int _normSign)
+    {
+        normSign = _normSign;
+    }
+};
+
 /** FFT Magnitude 1D
  * @ingroup FourierOperations
  */
@@ -523,6 +871,17 @@ public:
     FourierTransformer transformer1, transformer2;
 };
 
+/** Correlation auxiliary for single precision transforms. */
+class CorrelationAuxFloat
+{
+public:
+    MultidimArray< std::complex< float > > FFT1, FFT2;
+    MultidimArray<float> Mcorr;
+    // Single precision copies of double precision images
+    MultidimArray<float> I1, I2;
+    FourierTransformerFloat transformer1, transformer2;
+};
+
 /** Correlation of two nD images
  * @ingroup FourierOperations
  *
@@ -552,6 +911,24 @@ void correlation_matrix(const MultidimArray< std::complex< double > > & FFT1,
                         CorrelationAux &aux,
                         bool center=true);
 
+/** Correlation matrix in single precision.
+ * R must already be with the right size.
+ */
+void correlation_matrix(const MultidimArray< std::complex< float > > & FFT1,
+                        const MultidimArray< std::complex< float > > & FFT2,
+                        MultidimArray<float>& R,
+                        CorrelationAuxFloat &aux,
+                        bool center=true);
+
+/** Correlation matrix in single precision.
+ * Assumes that FFT1 is already computed, R gets the size of m2.
+ */
+void correlation_matrix(const MultidimArray< std::complex< float > > & FFT1,
+                        const MultidimArray<float> & m2,
+                        MultidimArray<float>& R,
+                        CorrelationAuxFloat &aux,
+                        bool center=true);
+
 /** Autocorrelation function of an image
  * @ingroup FourierOperations
  *
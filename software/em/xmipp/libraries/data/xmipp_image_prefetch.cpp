@@ -0,0 +1,274 @@
+/***************************************************************************
+ *
+ * Authors:     agent (agent@local)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#include "xmipp_image_prefetch.h"
+
+// ================= IMAGE PREFETCHER =======================
+
+ImagePrefetcher::ImagePrefetcher(MetaData &md, MDLabel image_label,
+                                 const std::vector<size_t> &ids, int threads, size_t lookahead)
+{
+    this->md = &md;
+    this->image_label = image_label;
+    this->lookahead = XMIPP_MAX(lookahead, (size_t)1);
+    cursor = nextToRead = 0;
+    applyGeo = false;
+    stop = false;
+
+    size_t n = ids.size();
+    slots.resize(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        Slot &slot = slots[i];
+        slot.objId = ids[i];
+        slot.status = SLOT_PENDING;
+        slot.applyGeo = false;
+        slot.img = NULL;
+        positions[ids[i]] = i;
+    }
+
+    // The reading threads access the metadata at the same time,
+    // this is only safe if the values are served from memory
+    ownColumnStore = !md.hasColumnStore();
+    md.setColumnStore();
+
+    readers.resize(XMIPP_MAX(threads, 1));
+    for (size_t i = 0; i < readers.size(); ++i)
+    {
+        readers[i] = new ReaderThread();
+        readers[i]->prefetcher = this;
+        readers[i]->start();
+    }
+}
+
+ImagePrefetcher::~ImagePrefetcher()
+{
+    condition.lock();
+    stop = true;
+    condition.broadcast();
+    condition.unlock();
+
+    // Thread destructor waits for the thread to finish
+    for (size_t i = 0; i < readers.size(); ++i)
+        delete readers[i];
+
+    for (size_t i = 0; i < slots.size(); ++i)
+        delete slots[i].img;
+
+    if (ownColumnStore)
+        md->setColumnStore(false);
+}
+
+void ImagePrefetcher::readImages()
+{
+    MDRow row;
+    FileName fnImg;
+
+    while (true)
+    {
+        condition.lock();
+        while (!stop && (nextToRead >= slots.size() || nextToRead >= cursor + lookahead))
+            condition.wait();
+        if (stop)
+        {
+            condition.unlock();
+            return;
+        }
+        size_t pos = nextToRead++;
+        Slot &slot = slots[pos];
+        slot.status = SLOT_READING;
+        slot.applyGeo = applyGeo;
+        condition.unlock();
+
+        Image<double> * img = new Image<double>();
+        bool ok = true;
+        fnImg = "";
+        try
+        {
+            md->getRow(row, slot.objId);
+            row.getValue(image_label, fnImg);
+            if (slot.applyGeo)
+                img->readApplyGeo(fnImg, row);
+            else
+                img->read(fnImg);
+        }
+        catch (XmippError &XE)
+        {
+            // The image will be read again by the caller, that will report the error
+            ok = false;
+        }
+
+        condition.lock();
+        slot.fnImg = fnImg;
+        if (ok && pos >= cursor)
+        {
+            slot.img = img;
+            slot.status = SLOT_READY;
+        }
+        else
+        {
+            delete img;
+            slot.status = ok ? SLOT_TAKEN : SLOT_FAILED;
+        }
+        condition.broadcast();
+        condition.unlock();
+    }
+}
+
+bool ImagePrefetcher::get(size_t objId, const FileName &fnImg, bool applyGeo, Image<double> &img)
+{
+    std::map<size_t, size_t>::const_iterator it = positions.find(objId);
+    if (it == positions.end())
+        return false;
+    size_t pos = it->second;
+    Image<double> * readImg = NULL;
+
+    condition.lock();
+    // Free the images that were skipped
+    for (size_t i = cursor; i < pos; ++i)
+        if (slots[i].status == SLOT_READY)
+        {
+            delete slots[i].img;
+            slots[i].img = NULL;
+            slots[i].status = SLOT_TAKEN;
+        }
+    cursor = pos;
+
+    Slot &slot = slots[pos];
+    if (nextToRead <= pos) // Not read yet, the caller will do it
+    {
+        nextToRead = pos + 1;
+        slot.status = SLOT_TAKEN;
+    }
+    else
+    {
+        while (slot.status == SLOT_READING)
+            condition.wait();
+        if (slot.status == SLOT_READY && slot.applyGeo == applyGeo && slot.fnImg == fnImg)
+            readImg = slot.img;
+        else
+            delete slot.img;
+        slot.img = NULL;
+        slot.status = SLOT_TAKEN;
+    }
+    // Next images are read the way the caller does
+    this->applyGeo = applyGeo;
+    condition.broadcast();
+    condition.unlock();
+
+    if (readImg == NULL)
+        return false;
+    img = *readImg;
+    delete readImg;
+    return true;
+}
+
+// ================= IMAGE WRITER =======================
+
+ImageWriter::ImageWriter(size_t maxJobs)
+{
+    this->maxJobs = XMIPP_MAX(maxJobs, (size_t)1);
+    writing = stop = failed = false;
+    errorCode = ERR_IO_NOWRITE;
+    thread = new WriterThread();
+    thread->writer = this;
+    thread->start();
+}
+
+ImageWriter::~ImageWriter()
+{
+    condition.lock();
+    stop = true;
+    condition.broadcast();
+    condition.unlock();
+    // The thread writes the pending images before exiting
+    delete thread;
+}
+
+void ImageWriter::writeImages()
+{
+    while (true)
+    {
+        condition.lock();
+        while (!stop && jobs.empty())
+            condition.wait();
+        if (jobs.empty())
+        {
+            condition.unlock();
+            return;
+        }
+        Job job = jobs.front();
+        jobs.pop_front();
+        writing = true;
+        bool skip = failed;
+        condition.broadcast();
+        condition.unlock();
+
+        try
+        {
+            if (!skip)
+                job.img->write(job.fnImg);
+        }
+        catch (XmippError &XE)
+        {
+            condition.lock();
+            failed = true;
+            errorCode = XE.__errno;
+            errorMsg = XE.msg;
+            condition.unlock();
+        }
+        delete job.img;
+
+        condition.lock();
+        writing = false;
+        condition.broadcast();
+        condition.unlock();
+    }
+}
+
+void ImageWriter::write(const Image<double> &img, const FileName &fnImg)
+{
+    Job job;
+    job.img = new Image<double>(img);
+    job.fnImg = fnImg;
+
+    condition.lock();
+    while (jobs.size() >= maxJobs)
+        condition.wait();
+    jobs.push_back(job);
+    condition.broadcast();
+    condition.unlock();
+}
+
+void ImageWriter::flush()
+{
+    condition.lock();
+    while (writing || !jobs.empty())
+        condition.wait();
+    bool error = failed;
+    failed = false;
+    condition.unlock();
+
+    if (error)
+        REPORT_ERROR(errorCode, errorMsg);
+}
@@ -0,0 +1,169 @@
+/***************************************************************************
+ *
+ * Authors:     agent (agent@local)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#ifndef XMIPP_IMAGE_PREFETCH_H_
+#define XMIPP_IMAGE_PREFETCH_H_
+
+#include <map>
+#include <deque>
+#include "xmipp_image.h"
+#include "xmipp_threads.h"
+#include "metadata.h"
+
+/** @defgroup ImagePrefetch Asynchronous image reading and writing
+ *  @ingroup Images
+ *  @{
+ */
+
+/** Read ahead the images of a metadata with several I/O threads.
+ * The images are read in the order of the given object ids, at most
+ * lookahead images after the last one requested with get. Images that
+ * are requested out of order, or whose reading failed, are not served
+ * and the caller should read them by itself.
+ * @code
+ * ImagePrefetcher prefetcher(md, MDL_IMAGE, ids, 2, 8);
+ * ...
+ * if (!prefetcher.get(objId, fnImg, false, img))
+ *     img.read(fnImg);
+ * @endcode
+ */
+class ImagePrefetcher
+{
+private:
+    enum SlotStatus { SLOT_PENDING, SLOT_READING, SLOT_READY, SLOT_FAILED, SLOT_TAKEN };
+
+    struct Slot
+    {
+        size_t objId;
+        SlotStatus status;
+        bool applyGeo;
+        FileName fnImg;
+        Image<double> * img;
+    };
+
+    class ReaderThread: public Thread
+    {
+    public:
+        ImagePrefetcher * prefetcher;
+        void run()
+        {
+            prefetcher->readImages();
+        }
+    };
+
+    MetaData * md;
+    bool ownColumnStore; // The column store of md was enabled by the prefetcher
+    MDLabel image_label;
+    std::vector<Slot> slots;
+    std::map<size_t, size_t> positions; // objId -> slot
+    std::vector<ReaderThread*> readers;
+    Condition condition;
+    size_t lookahead;
+    size_t cursor; // Slot of the last requested image
+    size_t nextToRead;
+    bool applyGeo; // Read with readApplyGeo and the default parameters
+    bool stop;
+
+    /** Main function of the reading threads */
+    void readImages();
+
+public:
+    /** Start the reading threads.
+     * The images of the objects in ids are read from the image_label
+     * column of md, which should not be modified while reading.
+     */
+    ImagePrefetcher(MetaData &md, MDLabel image_label, const std::vector<size_t> &ids,
+                    int threads, size_t lookahead);
+
+    /** Stop the reading threads and free the images not requested.
+     * The column store of md is disabled if it was enabled by the constructor.
+     */
+    ~ImagePrefetcher();
+
+    /** Get the image of an object.
+     * The call waits for the image if it is being read. It returns false
+     * if the image was not read in advance with this filename and mode,
+     * then the caller should read it.
+     */
+    bool get(size_t objId, const FileName &fnImg, bool applyGeo, Image<double> &img);
+}
+;//class ImagePrefetcher
+
+/** Write images in a separate thread.
+ * The images are copied in a bounded queue and written in order by the
+ * writer thread. Writing errors are reported by flush.
+ */
+class ImageWriter
+{
+private:
+    struct Job
+    {
+        Image<double> * img;
+        FileName fnImg;
+    };
+
+    class WriterThread: public Thread
+    {
+    public:
+        ImageWriter * writer;
+        void run()
+        {
+            writer->writeImages();
+        }
+    };
+
+    std::deque<Job> jobs;
+    WriterThread * thread;
+    Condition condition;
+    size_t maxJobs;
+    bool writing;
+    bool stop;
+    bool failed;
+    ErrorType errorCode;
+    String errorMsg;
+
+    /** Main function of the writer thread */
+    void writeImages();
+
+public:
+    /** Start the writer thread, at most maxJobs images are kept in memory */
+    ImageWriter(size_t maxJobs);
+
+    /** Write the pending images and stop the thread */
+    ~ImageWriter();
+
+    /** Queue a copy of the image to be written.
+     * If the queue is full, the call waits until an image is written.
+     */
+    void write(const Image<double> &img, const FileName &fnImg);
+
+    /** Wait until all queued images are written.
+     * The first writing error, if any, is thrown here.
+     */
+    void flush();
+}
+;//class ImageWriter
+
+/** @} */
+
+#endif /* XMIPP_IMAGE_PREFETCH_H_ */
@@ -0,0 +1,168 @@
+/***************************************************************************
+ *
+ * Authors:     agent (agent@local)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "xmipp_image_stack_map.h"
+
+/* Formats that can be mapped, the SPIDER and MRC extensions of ImageBase::_read.
+ * Unlike _read, the extension must be one of them, so that other formats
+ * containing these letters are read from disk. */
+static bool isMappableFormat(const String &ext, bool &isSpider)
+{
+    isSpider = ext == "spi" || ext == "xmp" || ext == "stk" || ext == "vol";
+    return isSpider || ext == "mrc" || ext == "mrcs" || ext == "st" || ext == "map";
+}
+
+ImageStackMap::ImageStackMap()
+{
+    fd = -1;
+    map = NULL;
+    mapSize = 0;
+    xdim = ydim = zdim = ndim = 0;
+    datatype = DT_Unknown;
+    offset = pad = imageBytes = 0;
+    swap = 0;
+}
+
+ImageStackMap::~ImageStackMap()
+{
+    close();
+}
+
+void ImageStackMap::open(const FileName &fn)
+{
+    close();
+
+    bool isSpider;
+    if (!isMappableFormat(fn.getFileFormat(), isSpider))
+        REPORT_ERROR(ERR_NOT_IMPLEMENTED,
+                     formatString("ImageStackMap: only MRC and SPIDER files can be mapped, not %s", fn.c_str()));
+
+    Image<float> header;
+    header.read(fn, HEADER);
+    header.getDimensions(xdim, ydim, zdim, ndim);
+    header.getOffsetAndSwap(offset, swap);
+    datatype = header.datatype();
+    if (datatype == DT_Unknown || datatype >= DT_CShort)
+        REPORT_ERROR(ERR_NOT_IMPLEMENTED,
+                     formatString("ImageStackMap: datatype of %s cannot be mapped", fn.c_str()));
+
+    // In SPIDER stacks each image has its own header, as long as the main one,
+    // and offset already skips the main header and the header of the first image
+    pad = (isSpider && ndim > 1) ? offset / 2 : 0;
+    imageBytes = xdim * ydim * zdim * gettypesize(datatype);
+
+    fnStack = fn.removeFileFormat();
+    if ((fd = ::open(fnStack.c_str(), O_RDONLY)) == -1)
+        REPORT_ERROR(ERR_IO_NOTOPEN, formatString("ImageStackMap: cannot open %s", fnStack.c_str()));
+
+    struct stat info;
+    if (fstat(fd, &info) == -1)
+    {
+        ::close(fd);
+        fd = -1;
+        REPORT_ERROR(ERR_IO_NOTOPEN, formatString("ImageStackMap: cannot get the size of %s", fnStack.c_str()));
+    }
+    mapSize = info.st_size;
+    if (offset + ndim * imageBytes + (ndim - 1) * pad > mapSize)
+    {
+        ::close(fd);
+        fd = -1;
+        REPORT_ERROR(ERR_IO_SIZE, formatString("ImageStackMap: %s is shorter than expected", fnStack.c_str()));
+    }
+
+    // Private mapping, so that aliased images can be modified in memory
+    map = (char *) mmap(0, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        map = NULL;
+        ::close(fd);
+        fd = -1;
+        REPORT_ERROR(ERR_MMAP, formatString("ImageStackMap: mmap of %s failed. Error: %s",
+                                            fnStack.c_str(), strerror(errno)));
+    }
+}
+
+void ImageStackMap::close()
+{
+    if (map != NULL)
+        munmap(map, mapSize);
+    if (fd != -1)
+        ::close(fd);
+    map = NULL;
+    fd = -1;
+    mapSize = 0;
+    ndim = 0;
+}
+
+char * ImageStackMap::getImageData(size_t n) const
+{
+    if (n < FIRST_IMAGE || n > ndim)
+        REPORT_ERROR(ERR_INDEX_OUTOFBOUNDS,
+                     formatString("ImageStackMap: image %lu out of the %lu images of %s", n, ndim, fnStack.c_str()));
+    return map + offset + (n - FIRST_IMAGE) * (imageBytes + pad);
+}
+
+ImageStackMaps::~ImageStackMaps()
+{
+    for (std::map<FileName, ImageStackMap*>::iterator it = stacks.begin(); it != stacks.end(); ++it)
+        delete it->second;
+}
+
+ImageStackMap * ImageStackMaps::getStack(const FileName &fnImg, size_t &n)
+{
+    String fnStack;
+    bool isSpider;
+    fnImg.decompose(n, fnStack);
+    if (n == ALL_IMAGES || !isMappableFormat(FileName(fnStack).getFileFormat(), isSpider))
+        return NULL;
+
+    ImageStackMap * stack;
+    mutex.lock();
+    std::map<FileName, ImageStackMap*>::iterator it = stacks.find(fnStack);
+    if (it == stacks.end())
+    {
+        stack = new ImageStackMap();
+        try
+        {
+            stack->open(fnStack);
+        }
+        catch (XmippError &XE)
+        {
+            // The images of this stack will be read from disk
+            delete stack;
+            stack = NULL;
+        }
+        stacks[fnStack] = stack;
+    }
+    else
+        stack = it->second;
+    mutex.unlock();
+
+    return stack;
+}
@@ -0,0 +1,180 @@
+/***************************************************************************
+ *
+ * Authors:     agent (agent@local)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#ifndef XMIPP_IMAGE_STACK_MAP_H_
+#define XMIPP_IMAGE_STACK_MAP_H_
+
+#include <map>
+#include "xmipp_image.h"
+#include "xmipp_threads.h"
+
+/** @defgroup ImageStackMap Mapped image stacks
+ *  @ingroup Images
+ *  @{
+ */
+
+/** MRC or SPIDER stack mapped in memory.
+ * The file is opened and mapped once, then any image of the stack can be
+ * taken without reading from disk. If the file datatype is the one of
+ * the array and no byte swapping is needed, the array is an alias of the
+ * mapped image, otherwise the image is swapped and cast into the array.
+ * The mapping is private: aliased images can be modified, but the changes
+ * are not written to the file. Once open, several threads may take images
+ * at the same time.
+ * @code
+ * ImageStackMap stack;
+ * stack.open("particles.mrcs");
+ * MultidimArray<float> I;
+ * stack.getImage(10, I); // Image 10 without copy
+ * @endcode
+ */
+class ImageStackMap
+{
+protected:
+    FileName fnStack;
+    int fd;
+    char * map;
+    size_t mapSize;
+    size_t xdim, ydim, zdim, ndim;
+    DataType datatype;
+    size_t offset; // Start of the first image
+    size_t pad; // Header bytes before each image after the first one
+    int swap;
+    size_t imageBytes;
+
+public:
+    /** Empty constructor */
+    ImageStackMap();
+
+    /** Destructor, the file is unmapped */
+    ~ImageStackMap();
+
+    /** Map a MRC or SPIDER stack */
+    void open(const FileName &fn);
+
+    /** Unmap the file. Aliased images are no longer valid. */
+    void close();
+
+    /** True if a file is mapped */
+    bool isOpen() const
+    {
+        return map != NULL;
+    }
+
+    /** Number of images */
+    size_t size() const
+    {
+        return ndim;
+    }
+
+    /** Dimensions of the images */
+    void getDimensions(size_t &Xdim, size_t &Ydim, size_t &Zdim) const
+    {
+        Xdim = xdim;
+        Ydim = ydim;
+        Zdim = zdim;
+    }
+
+    /** Datatype of the file */
+    DataType getDatatype() const
+    {
+        return datatype;
+    }
+
+    /** Raw data of the image n, from 1 to size() */
+    char * getImageData(size_t n) const;
+
+    /** Get the image n, from 1 to size().
+     * The array is an alias of the mapped data when possible.
+     */
+    template<typename T>
+    void getImage(size_t n, MultidimArray<T> &img) const
+    {
+        Image<T> aux;
+        char * page = getImageData(n);
+        if (swap == 0 && aux.checkMmapT(datatype))
+            img.aliasMemory((T *) page, 1, zdim, ydim, xdim);
+        else
+        {
+            size_t nElems = xdim * ydim * zdim;
+            // Do not overwrite a previous alias
+            if (!img.destroyData)
+                img.coreDeallocate();
+            img.resizeNoCopy(1, zdim, ydim, xdim);
+            if (swap != 0)
+            {
+                std::vector<char> buffer(page, page + imageBytes);
+                aux.swapPage(&buffer[0], imageBytes, datatype, swap);
+                aux.castPage2T(&buffer[0], MULTIDIM_ARRAY(img), datatype, nElems);
+            }
+            else
+                aux.castPage2T(page, MULTIDIM_ARRAY(img), datatype, nElems);
+        }
+    }
+}
+;//class ImageStackMap
+
+/** Stacks mapped on demand.
+ * Images given as n@stack of MRC and SPIDER stacks are taken from the
+ * mapped stacks, that are opened the first time they are used. Any other
+ * image is read from disk.
+ */
+class ImageStackMaps
+{
+protected:
+    std::map<FileName, ImageStackMap*> stacks;
+    Mutex mutex;
+
+    /** Mapped stack for this image, NULL if the image should be read */
+    ImageStackMap * getStack(const FileName &fnImg, size_t &n);
+
+public:
+    /** Destructor, all stacks are unmapped */
+    ~ImageStackMaps();
+
+    /** Get the image data.
+     * As in ImageStackMap::getImage, the array is an alias of the mapped
+     * data only if the stack is stored in the type T, otherwise it is a copy.
+     */
+    template<typename T>
+    void read(const FileName &fnImg, MultidimArray<T> &img)
+    {
+        size_t n;
+        ImageStackMap * stack = getStack(fnImg, n);
+        if (stack == NULL)
+        {
+            Image<T> aux;
+            aux.read(fnImg);
+            if (!img.destroyData)
+                img.coreDeallocate();
+            img = aux();
+        }
+        else
+            stack->getImage(n, img);
+    }
+}
+;//class ImageStackMaps
+
+/** @} */
+
+#endif /* XMIPP_IMAGE_STACK_MAP_H_ */
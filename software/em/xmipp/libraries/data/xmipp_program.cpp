@@ -505,6 +505,15 @@ XmippMetadataProgram::XmippMetadataProgram()
     save_metadata_stack = false;
     keep_input_columns = false;
     track_origin = false;
+    allow_io_threads = false;
+    io_threads = 0;
+    io_queue = 8;
+    prefetcher = NULL;
+    writer = NULL;
+    currentObjId = BAD_OBJID;
+    allow_threads = false;
+    numberOfThreads = 1;
+    taskDistributor = NULL;
 }
 
 void XmippMetadataProgram::init()
@@ -566,6 +575,16 @@ void XmippMetadataProgram::defineParams()
     {
         addParamsLine("  [--dont_apply_geo]   : for 2D-images: do not apply transformation stored in metadata");
     }
+
+    if (allow_io_threads)
+    {
+        addParamsLine("  [--io_threads+ <n=0>]  : Number of threads reading images in advance, 0 to read them one by one.");
+        addParamsLine("                         : If used, output images are written by another thread.");
+        addParamsLine("  [--io_queue+ <n=8>]    : Maximum number of images read in advance or waiting to be written.");
+    }
+
+    if (allow_threads)
+        addParamsLine("  [--thr <N=1>]          : Number of threads processing images at the same time");
 }//function defineParams
 
 void XmippMetadataProgram::defineLabelParam()
@@ -590,6 +609,15 @@ void XmippMetadataProgram::readParams()
     if (allow_apply_geo)
         apply_geo = !checkParam("--dont_apply_geo");
 
+    if (allow_io_threads)
+    {
+        io_threads = getIntParam("--io_threads");
+        io_queue = getIntParam("--io_queue");
+    }
+
+    if (allow_threads)
+        numberOfThreads = getIntParam("--thr");
+
     // The following flags are an "advanced" options to allow save metadata
     // when the -o is an stack, each program can define its default value
     // that's why the || construct before checkParam call
@@ -753,14 +781,132 @@ void XmippMetadataProgram::setupRowOut(const FileName &fnImgIn, const MDRow &row
         rowOut.setValue(MDL_IMAGE_ORIGINAL, fnImgIn);
 }
 
+void XmippMetadataProgram::readImage(const FileName &fnImg, Image<double> &img)
+{
+    if (prefetcher == NULL || !prefetcher->get(currentObjId, fnImg, false, img))
+        img.read(fnImg);
+}
+
+void XmippMetadataProgram::readImageApplyGeo(const FileName &fnImg, const MDRow &rowIn, Image<double> &img)
+{
+    if (prefetcher == NULL || !prefetcher->get(currentObjId, fnImg, true, img))
+        img.readApplyGeo(fnImg, rowIn);
+}
+
+void XmippMetadataProgram::writeImage(Image<double> &img, const FileName &fnImgOut)
+{
+    if (writer == NULL)
+        img.write(fnImgOut);
+    else
+        writer->write(img, fnImgOut);
+}
+
 void XmippMetadataProgram::wait()
 {
 	// In the serial implementation, we don't have to wait. This will be useful for MPI programs
 }
 
+bool XmippMetadataProgram::prepareImage(size_t objId, size_t objIndex, FileName &fnImg, FileName &fnImgOut,
+                                        MDRow &rowIn, MDRow &rowOut)
+{
+    mdIn->getRow(rowIn, objId);
+    rowIn.getValue(image_label, fnImg);
+
+    if (fnImg.empty())
+        return false;
+
+    fnImgOut = fnImg;
+
+    if (each_image_produces_an_output)
+    {
+        if (!oroot.empty()) // Compose out name to save as independent images
+        {
+            if (oext.empty()) // If oext is still empty, then use ext of indep input images
+            {
+                if (input_is_stack)
+                    oextBaseName = "spi";
+                else
+                    oextBaseName = fnImg.getFileFormat();
+            }
+
+            if (!baseName.empty() )
+                fnImgOut.compose(fullBaseName, objIndex, oextBaseName);
+            else if (fnImg.isInStack())
+                fnImgOut.compose(pathBaseName + (fnImg.withoutExtension()).getDecomposedFileName(), objIndex, oextBaseName);
+            else
+                fnImgOut = pathBaseName + fnImg.withoutExtension()+ "." + oextBaseName;
+        }
+        else if (!fn_out.empty() )
+        {
+            if (single_image)
+                fnImgOut = fn_out;
+            else
+                fnImgOut.compose(objIndex, fn_out); // Compose out name to save as stacks
+        }
+        else
+            fnImgOut = fnImg;
+        setupRowOut(fnImg, rowIn, fnImgOut, rowOut);
+    }
+    else if (produces_a_metadata)
+        setupRowOut(fnImg, rowIn, fnImgOut, rowOut);
+    return true;
+}
+
+void XmippMetadataProgram::processImageThread(ThreadArgument &thArg)
+{
+    XmippMetadataProgram * prog = (XmippMetadataProgram *) thArg.workClass;
+    size_t first, last;
+
+    while (prog->taskDistributor->getTasks(first, last))
+        for (size_t i = first; i <= last; ++i)
+        {
+            ImageTask &task = prog->tasks[i];
+            prog->processImage(task.fnImg, task.fnImgOut, task.rowIn, task.rowOut);
+        }
+}
+
+void XmippMetadataProgram::processImagesThreads()
+{
+    // Enough images for all the threads to be busy while keeping the memory bounded
+    size_t blockSize = 16 * numberOfThreads;
+    size_t objId, objIndex, n;
+    bool more = true;
+    tasks.resize(blockSize);
+    ThreadManager thMgr(numberOfThreads, this);
+
+    while (more)
+    {
+        n = 0;
+        while (n < blockSize && (more = getImageToProcess(objId, objIndex)))
+        {
+            ImageTask &task = tasks[n];
+            if (!prepareImage(objId, objIndex + 1, task.fnImg, task.fnImgOut, task.rowIn, task.rowOut))
+            {
+                more = false;
+                break;
+            }
+            ++n;
+            showProgress();
+        }
+
+        if (n == 0)
+            break;
+
+        taskDistributor = new ThreadTaskDistributor(n, 1);
+        thMgr.run(processImageThread);
+        delete taskDistributor;
+        taskDistributor = NULL;
+
+        if (each_image_produces_an_output || produces_a_metadata)
+            for (size_t i = 0; i < n; ++i)
+                mdOut.addRow(tasks[i].rowOut);
+    }
+    tasks.clear();
+}
+
 void XmippMetadataProgram::run()
 {
-    FileName fnImg, fnImgOut, fullBaseName;
+    FileName fnImg, fnImgOut;
     size_t objId;
     MDRow rowIn, rowOut;
     mdOut.clear(); //this allows multiple runs of the same Program object
@@ -782,59 +928,52 @@ void XmippMetadataProgram::run()
         pathBaseName   = fullBaseName.getDir();
     }
 
-    //FOR_ALL_OBJECTS_IN_METADATA(mdIn)
-    while (getImageToProcess(objId, objIndex))
+    /* Images are read ahead in the order of the input metadata. This is not
+     * done when the input is overwritten, since the threads would read the
+     * same files that are being written. */
+    if (io_threads > 0 && !single_image && !(fn_out.empty() && oroot.empty()))
     {
-        ++objIndex; //increment for composing starting at 1
+        // With several processing threads the images are already read at the same time
+        if (numberOfThreads <= 1)
+        {
+            std::vector<size_t> ids;
+            mdIn->findObjects(ids);
+            prefetcher = new ImagePrefetcher(*mdIn, image_label, ids, io_threads, io_queue);
+        }
+        writer = new ImageWriter(io_queue);
+    }
 
-        mdIn->getRow(rowIn, objId);
-        rowIn.getValue(image_label, fnImg);
+    if (numberOfThreads > 1)
+        processImagesThreads();
+    else
+    {
+        //FOR_ALL_OBJECTS_IN_METADATA(mdIn)
+        while (getImageToProcess(objId, objIndex))
+        {
+            ++objIndex; //increment for composing starting at 1
 
-        if (fnImg.empty())
-            break;
+            if (!prepareImage(objId, objIndex, fnImg, fnImgOut, rowIn, rowOut))
+                break;
 
-        fnImgOut = fnImg;
+            currentObjId = objId;
+            processImage(fnImg, fnImgOut, rowIn, rowOut);
 
-        if (each_image_produces_an_output)
-        {
-            if (!oroot.empty()) // Compose out name to save as independent images
-            {
-                if (oext.empty()) // If oext is still empty, then use ext of indep input images
-                {
-                    if (input_is_stack)
-                        oextBaseName = "spi";
-                    else
-                        oextBaseName = fnImg.getFileFormat();
-                }
+            if (each_image_produces_an_output || produces_a_metadata)
+                mdOut.addRow(rowOut);
 
-                if (!baseName.empty() )
-                    fnImgOut.compose(fullBaseName, objIndex, oextBaseName);
-                else if (fnImg.isInStack())
-                    fnImgOut.compose(pathBaseName + (fnImg.withoutExtension()).getDecomposedFileName(), objIndex, oextBaseName);
-                else
-                    fnImgOut = pathBaseName + fnImg.withoutExtension()+ "." + oextBaseName;
-            }
-            else if (!fn_out.empty() )
-            {
-                if (single_image)
-                    fnImgOut = fn_out;
-                else
-                    fnImgOut.compose(objIndex, fn_out); // Compose out name to save as stacks
-            }
-            else
-                fnImgOut = fnImg;
-            setupRowOut(fnImg, rowIn, fnImgOut, rowOut);
+            showProgress();
         }
-        else if (produces_a_metadata)
-            setupRowOut(fnImg, rowIn, fnImgOut, rowOut);
-
-        processImage(fnImg, fnImgOut, rowIn, rowOut);
-
-        if (each_image_produces_an_output || produces_a_metadata)
-            mdOut.addRow(rowOut);
+    }
 
-        showProgress();
+    delete prefetcher;
+    prefetcher = NULL;
+    if (writer != NULL)
+    {
+        writer->flush();
+        delete writer;
+        writer = NULL;
     }
+
     wait();
 
     //free iterator memory
@@ -31,6 +31,7 @@
 #include "xmipp_strings.h"
 #include "metadata.h"
 #include "xmipp_image.h"
+#include "xmipp_image_prefetch.h"
 #include "xmipp_program_sql.h"
 
 
@@ -286,7 +287,7 @@ public:
 public:
     //Image<double>   img;
     /// Filenames of input and output Metadata
-    FileName fn_in, fn_out, baseName, pathBaseName, oextBaseName;
+    FileName fn_in, fn_out, baseName, pathBaseName, fullBaseName, oextBaseName;
     /// Apply geo
     bool apply_geo;
     /// Output dimensions
@@ -336,6 +337,13 @@ protected:
     bool remove_disabled; // Default true
     /// Show process time bar
     bool allow_time_bar; // Default true
+    /// Provide the program with the param --io_threads to read images in advance
+    /// and write them in a separate thread. Images should be read and written
+    /// with readImage and writeImage
+    bool allow_io_threads; // Default false
+    /// Provide the program with the param --thr to process several images
+    /// at the same time. processImage should not modify the program members
+    bool allow_threads; // Default false
 
     // DEDUCED FLAGS
     /// Input is a metadata
@@ -354,6 +362,31 @@ protected:
     /// Some time bar related counters
     size_t time_bar_step, time_bar_size, time_bar_done;
 
+    /// Number of threads reading images in advance, 0 for synchronous I/O
+    int io_threads;
+    /// Maximum number of images read in advance or waiting to be written
+    size_t io_queue;
+    /// Asynchronous reading and writing of images, NULL if not used
+    ImagePrefetcher * prefetcher;
+    ImageWriter * writer;
+    /// Object being processed
+    size_t currentObjId;
+
+    /// Number of threads processing images
+    int numberOfThreads;
+
+    /// Image to be processed by one of the threads
+    struct ImageTask
+    {
+        FileName fnImg, fnImgOut;
+        MDRow rowIn, rowOut;
+    };
+    std::vector<ImageTask> tasks;
+    ThreadTaskDistributor * taskDistributor;
+    /// Serializes the writing of output images from several threads,
+    /// they may write into the same stack
+    Mutex writeMutex;
+
     virtual void initComments();
     virtual void defineParams();
     virtual void readParams();
@@ -378,6 +411,35 @@ protected:
     /** Define the label param */
     virtual void defineLabelParam();
 
+    /** Read the input row of an object and compose the output image name.
+     * It returns false if the object has no image.
+     */
+    bool prepareImage(size_t objId, size_t objIndex, FileName &fnImg, FileName &fnImgOut,
+                      MDRow &rowIn, MDRow &rowOut);
+
+    /** Process the images with several threads.
+     * The images are taken in blocks from getImageToProcess, so that this
+     * also works with the MPI task distribution, and the output rows are
+     * added to the output metadata in the input order.
+     */
+    void processImagesThreads();
+
+    /** Thread function calling processImage for the tasks of a block */
+    static void processImageThread(ThreadArgument &thArg);
+
+    /** Read the input image of the object being processed.
+     * If --io_threads is used, the image was probably read in advance.
+     */
+    void readImage(const FileName &fnImg, Image<double> &img);
+
+    /** Read the input image applying the geometry in rowIn */
+    void readImageApplyGeo(const FileName &fnImg, const MDRow &rowIn, Image<double> &img);
+
+    /** Write an output image.
+     * If --io_threads is used, the image is written by a separate thread.
+     */
+    void writeImage(Image<double> &img, const FileName &fnImgOut);
+
 public:
     XmippMetadataProgram();
 
@@ -29,6 +29,7 @@
 #include "xmipp_threads.h"
 #include "xmipp_error.h"
 #include "xmipp_log.h"
+#include "xmipp_macros.h"
 
 
 // ================= MUTEX ==========================
@@ -362,6 +363,221 @@ bool ThreadTaskDistributor::distribute(size_t &first, size_t &last)
     return result;
 }
 
+// =================== THREAD POOL ============================
+
+TaskFuture::TaskFuture()
+{
+    pending = 0;
+}
+
+bool TaskFuture::isReady()
+{
+    condition.lock();
+    bool ready = pending == 0;
+    condition.unlock();
+    return ready;
+}
+
+void TaskFuture::wait()
+{
+    condition.lock();
+    while (pending > 0)
+        condition.wait();
+    condition.unlock();
+}
+
+/* Task running the body of a parallelFor over a block of items */
+class ParallelForTask: public PoolTask
+{
+public:
+    ParallelForBody * body;
+    size_t first, last;
+
+    void run(int thread_id)
+    {
+        body->run(first, last, thread_id);
+    }
+};
+
+void * _poolThreadMain(void * data)
+{
+    ThreadPool::WorkerArgument * argument = (ThreadPool::WorkerArgument *) data;
+    ThreadPool * pool = argument->pool;
+    ThreadPool::QueuedTask queuedTask;
+
+    while (true)
+    {
+        if (pool->takeTask(argument->thread_id, queuedTask))
+        {
+            try
+            {
+                queuedTask.task->run(argument->thread_id);
+            }
+            catch (XmippError &xe)
+            {
+                std::cerr << xe << std::endl
+                << "In thread " << argument->thread_id << std::endl;
+                exit(-1);
+            }
+            TaskFuture * future = queuedTask.future;
+            future->condition.lock();
+            if (--future->pending == 0)
+                future->condition.broadcast();
+            future->condition.unlock();
+            continue;
+        }
+
+        //Wait for new tasks or leave
+        pool->condition.lock();
+        while (pool->queued == 0 && !pool->stopping)
+            pool->condition.wait();
+        bool exit = pool->queued == 0 && pool->stopping;
+        pool->condition.unlock();
+        if (exit)
+            break;
+    }
+    return NULL;
+}
+
+ThreadPool::ThreadPool(int numberOfThreads)
+{
+    threads = numberOfThreads < 1 ? 1 : numberOfThreads;
+    queued = 0;
+    stopping = false;
+    nextQueue = 0;
+    ids = new pthread_t[threads];
+    arguments = new WorkerArgument[threads];
+    queues = new WorkerQueue[threads];
+
+    for (int i = 0; i < threads; ++i)
+    {
+        arguments[i].pool = this;
+        arguments[i].thread_id = i;
+        if (pthread_create(ids + i, NULL, _poolThreadMain, (void*) (arguments + i)) != 0)
+            REPORT_ERROR(ERR_THREADS_NOTINIT, "ThreadPool: can't create threads.");
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    condition.lock();
+    stopping = true;
+    condition.broadcast();
+    condition.unlock();
+    for (int i = 0; i < threads; ++i)
+        pthread_join(ids[i], NULL);
+
+    delete[] queues;
+    delete[] arguments;
+    delete[] ids;
+}
+
+void ThreadPool::push(int queue, PoolTask * task, TaskFuture &future)
+{
+    QueuedTask queuedTask;
+    queuedTask.task = task;
+    queuedTask.future = &future;
+    WorkerQueue &workerQueue = queues[queue];
+    // The counter is updated under the same lock as the push, so that a
+    // worker taking this task cannot decrement it before it is incremented
+    condition.lock();
+    workerQueue.mutex.lock();
+    workerQueue.tasks.push_back(queuedTask);
+    workerQueue.mutex.unlock();
+    ++queued;
+    condition.unlock();
+}
+
+void ThreadPool::notify()
+{
+    condition.lock();
+    condition.broadcast();
+    condition.unlock();
+}
+
+bool ThreadPool::takeTask(int thread_id, QueuedTask &queuedTask)
+{
+    bool found = false;
+    // Own queue from the front, the others from the back
+    for (int i = 0; i < threads && !found; ++i)
+    {
+        WorkerQueue &workerQueue = queues[(thread_id + i) % threads];
+        workerQueue.mutex.lock();
+        if (!workerQueue.tasks.empty())
+        {
+            found = true;
+            if (i == 0)
+            {
+                queuedTask = workerQueue.tasks.front();
+                workerQueue.tasks.pop_front();
+            }
+            else
+            {
+                queuedTask = workerQueue.tasks.back();
+                workerQueue.tasks.pop_back();
+            }
+        }
+        workerQueue.mutex.unlock();
+    }
+    if (found)
+    {
+        condition.lock();
+        --queued;
+        condition.unlock();
+    }
+    return found;
+}
+
+void ThreadPool::submit(PoolTask * task, TaskFuture &future)
+{
+    future.condition.lock();
+    ++future.pending;
+    future.condition.unlock();
+
+    condition.lock();
+    int queue = nextQueue;
+    nextQueue = (nextQueue + 1) % threads;
+    condition.unlock();
+
+    push(queue, task, future);
+    notify();
+}
+
+void ThreadPool::parallelFor(size_t N, size_t blockSize, ParallelForBody &body, size_t start)
+{
+    if (N == 0)
+        return;
+    if (blockSize == 0)
+        blockSize = 1;
+    start %= N;
+
+    // Blocks from start to N-1 and then from 0 to start-1
+    std::vector<ParallelForTask> tasks;
+    ParallelForTask task;
+    task.body = &body;
+    for (size_t first = start; first < N; first += blockSize)
+    {
+        task.first = first;
+        task.last = XMIPP_MIN(first + blockSize, N) - 1;
+        tasks.push_back(task);
+    }
+    for (size_t first = 0; first < start; first += blockSize)
+    {
+        task.first = first;
+        task.last = XMIPP_MIN(first + blockSize, start) - 1;
+        tasks.push_back(task);
+    }
+
+    // Consecutive blocks go to the same thread
+    TaskFuture future;
+    size_t nTasks = tasks.size();
+    future.pending = nTasks;
+    for (size_t n = 0; n < nTasks; ++n)
+        push((n * threads) / nTasks, &tasks[n], future);
+    notify();
+    future.wait();
+}
+
 // =================== OLD THREADS IMPLEMENTATION ============================
 int barrier_init(barrier_t *barrier,int needed)
 {
@@ -29,6 +29,8 @@
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <deque>
+#include <vector>
 
 class ThreadManager;
 class ThreadArgument;
@@ -466,6 +468,183 @@ public:
 }
 ;//end of class ThreadTaskDistributor
 
+/** Task to be run by a ThreadPool.
+ * Subclasses implement run() with the work to do. The thread_id
+ * is the worker running the task, from 0 to the number of threads - 1.
+ */
+class PoolTask
+{
+public:
+    /** Destructor */
+    virtual ~PoolTask()
+    {}
+
+    /** Work of the task */
+    virtual void run(int thread_id) = 0;
+}
+;//end of class PoolTask
+
+/** Completion of the tasks submitted to a ThreadPool.
+ * A future can be used for a single task or for a group of them,
+ * it is ready when all the tasks submitted with it have finished.
+ * @code
+ *  TaskFuture future;
+ *  for (int n = 0; n < 10; ++n)
+ *      pool.submit(tasks[n], future);
+ *  //...Do other things in the main thread
+ *  future.wait();
+ * @endcode
+ */
+class TaskFuture
+{
+private:
+    Condition condition; ///< Signaled when the last task finishes
+    size_t pending; ///< Tasks not finished yet
+
+    // Futures are not copied
+    TaskFuture(const TaskFuture &);
+    TaskFuture & operator=(const TaskFuture &);
+
+public:
+    /** Empty constructor, the future is ready */
+    TaskFuture();
+
+    /** True if all the tasks have finished */
+    bool isReady();
+
+    /** Block the calling thread until all the tasks have finished */
+    void wait();
+
+    friend class ThreadPool;
+    friend void * _poolThreadMain(void * data);
+}
+;//end of class TaskFuture
+
+/** Body of a ThreadPool::parallelFor loop. */
+class ParallelForBody
+{
+public:
+    /** Destructor */
+    virtual ~ParallelForBody()
+    {}
+
+    /** Process the items from first to last, both included */
+    virtual void run(size_t first, size_t last, int thread_id) = 0;
+}
+;//end of class ParallelForBody
+
+/** This function is used in ThreadPool as the main function of the workers. */
+void * _poolThreadMain(void * data);
+
+/** Pool of threads with work stealing.
+ * The threads are created once, in the constructor, and wait for tasks
+ * until the pool is destroyed, so the same threads can be used in all
+ * the iterations of a program. Each thread has its own queue of tasks:
+ * it takes the tasks from the front of its queue and, when the queue is
+ * empty, it steals tasks from the back of the queue of another thread.
+ * This way no thread is idle while there are pending tasks, even if some
+ * tasks take much longer than others.
+ *
+ * The pool does not own the tasks, they should live until their future
+ * is ready. Tasks should not wait for other tasks of the same pool.
+ * @code
+ *  class ProcessImages: public ParallelForBody
+ *  {
+ *  public:
+ *      void run(size_t first, size_t last, int thread_id)
+ *      {
+ *          for (size_t n = first; n <= last; ++n)
+ *              processOneImage(n);
+ *      }
+ *  };
+ *
+ *  ThreadPool pool(4);
+ *  ProcessImages body;
+ *  //Process 1000 images in blocks of 10
+ *  pool.parallelFor(1000, 10, body);
+ * @endcode
+ */
+class ThreadPool
+{
+private:
+    /// Task in the queue of a thread
+    struct QueuedTask
+    {
+        PoolTask * task;
+        TaskFuture * future;
+    };
+
+    /// Queue of tasks of a thread
+    struct WorkerQueue
+    {
+        Mutex mutex;
+        std::deque<QueuedTask> tasks;
+    };
+
+    /// Argument of the main function of each thread
+    struct WorkerArgument
+    {
+        ThreadPool * pool;
+        int thread_id;
+    };
+
+    int threads; ///< Number of working threads
+    pthread_t * ids; ///< pthreads identifiers
+    WorkerArgument * arguments; ///< Arguments passed to threads
+    WorkerQueue * queues; ///< Queue of each thread
+    Condition condition; ///< Signaled when there are new tasks or the pool is destroyed
+    size_t queued; ///< Number of tasks in all the queues
+    bool stopping; ///< True when the threads should exit
+    int nextQueue; ///< Queue for the next submitted task
+
+    // Pools are not copied
+    ThreadPool(const ThreadPool &);
+    ThreadPool & operator=(const ThreadPool &);
+
+    /** Add a task to the queue of a thread and count it, without waking up the threads */
+    void push(int queue, PoolTask * task, TaskFuture &future);
+
+    /** Wake up the threads after pushing some tasks */
+    void notify();
+
+    /** Take a task from the queue of the thread or steal it from
+     * another thread. False if all the queues are empty.
+     */
+    bool takeTask(int thread_id, QueuedTask &queuedTask);
+
+public:
+    /** Constructor, number of working threads should be supplied */
+    ThreadPool(int numberOfThreads);
+
+    /** Destructor, the threads finish the pending tasks and exit */
+    ~ThreadPool();
+
+    /** Get number of threads */
+    int getNumberOfThreads() const
+    {
+        return threads;
+    }
+
+    /** Submit a task without blocking.
+     * The future is ready when this task and any other task
+     * submitted with the same future have finished.
+     */
+    void submit(PoolTask * task, TaskFuture &future);
+
+    /** Run the body for the N items in blocks, and wait until all are done.
+     * The blocks are distributed among the queues of the threads, each
+     * thread receiving consecutive blocks, and idle threads steal the
+     * blocks left by the others. The items are visited circularly from
+     * the item start, so the first thread begins with start, start+1, ...
+     * This is useful when the first items are expected to prune the work
+     * of the rest. No block goes beyond the item N-1.
+     */
+    void parallelFor(size_t N, size_t blockSize, ParallelForBody &body, size_t start = 0);
+
+    friend void * _poolThreadMain(void * data);
+}
+;//end of class ThreadPool
+
 /** @name Old parallel stuff. */
 /** Barrier structure */
 //@{
@@ -24,6 +24,7 @@
  ***************************************************************************/
 
 #include "mpi_ml_align2d.h"
+#include <climits>
 
 /* Some constast to message passing tags */
 #define TAG_SEED 1
@@ -306,7 +307,24 @@ void MpiProgMLRefine3D::createEmptyFiles(int type)
 void MpiProgMLRefine3D::projectVolumes(MetaData &mdProj)
 {
     ProgMLRefine3D::projectVolumes(mdProj);
-    //all nodes waiting until volumes are projected
+    //the directions not projected by a node are zero in its gallery,
+    //sum it in blocks so that the count fits in an int
+    MultidimArray<double> &stack = gallery.stack;
+    size_t total = MULTIDIM_SIZE(stack);
+    for (size_t first = 0; first < total; first += INT_MAX)
+    {
+        int count = (int)XMIPP_MIN(total - first, (size_t)INT_MAX);
+        MPI_Allreduce(MPI_IN_PLACE, MULTIDIM_ARRAY(stack) + first, count, MPI_DOUBLE,
+                      MPI_SUM, MPI_COMM_WORLD);
+    }
+}
+
+void MpiProgMLRefine3D::writeProjections(MetaData &mdProj)
+{
+    //only master writes the projections
+    if (node->isMaster())
+        ProgMLRefine3D::writeProjections(mdProj);
+    //all nodes waiting until projections are written
     node->barrierWait();
 }
 
@@ -106,8 +106,12 @@ public:
     void postProcessVolumes();
     /** Only master create empty files */
     virtual void createEmptyFiles(int type);
-    /** Project volumes, sync after projection */
+    /** Project volumes, each node projects some directions
+     * and then the galleries of all nodes are summed
+     */
     void projectVolumes(MetaData &mdProj);
+    /** Only master writes the projections */
+    void writeProjections(MetaData &mdProj);
     /** Make noise images, only master */
     void makeNoiseImages();
     /// Calculate 3D SSNR, only master and broadcast result
@@ -68,6 +68,8 @@ void ProgMPIRecFourier::readParams()
 {
     ProgRecFourier::readParams();
     mpi_job_size=getIntParam("--mpi_job_size");
+    if (streamChunk > 0)
+        REPORT_ERROR(ERR_ARG_INCORRECT, "--stream is not available in the MPI version");
 }
 
 /* Pre Run PreRun for all nodes but not for all works */
@@ -125,6 +127,7 @@ void ProgMPIRecFourier::run()
     MPI_Comm   new_comm;
     long int total_usecs;
     double total_time_processing=0., total_time_weightening=0., total_time_communicating=0., total_time;
+    double time_reduce_volume=0., time_reduce_weights=0.;
     int iter=0;
     int * ranks;
 
@@ -297,19 +300,7 @@ void ProgMPIRecFourier::run()
             sizeout = MULTIDIM_SIZE(FourierWeights);
 
             //First
-            barrier_init( &barrier, numThreads+1);
-            pthread_mutex_init( &workLoadMutex, NULL );
-            statusArray = NULL;
-            th_ids = (pthread_t *)malloc(numThreads * sizeof(pthread_t));
-            th_args = (ImageThreadParams *)malloc(numThreads * sizeof(ImageThreadParams));
-
-            for ( int nt = 0 ; nt < numThreads ; nt++ )
-            {
-                th_args[nt].parent=this;
-                th_args[nt].myThreadID = nt;
-                th_args[nt].selFile = new MetaData(SF);
-                pthread_create((th_ids+nt),NULL,processImageThread,(void*)(th_args+nt));
-            }
+            createThreads();
 
             while (1)
             {
@@ -332,58 +323,12 @@ void ProgMPIRecFourier::run()
                     //a posibility is a non-blocking send
                     MPI_Recv(0, 0, MPI_INT, 0, TAG_COLLECT_FOR_FSC, MPI_COMM_WORLD, &status);
 
+                    // Sum the first half of the data in worker 1
+                    time_reduce_volume += reduceInChunks( fourierVolume, 2*sizeout, new_comm );
+                    time_reduce_weights += reduceInChunks( fourierWeights, sizeout, new_comm );
+
                     if( node->rank == 1 )
                     {
-                        // Reserve memory for the receive buffer
-                        double * recBuffer = (double *) malloc (sizeof(double)*BUFFSIZE);
-                        int receivedSize;
-                        double * pointer;
-                        pointer = fourierVolume;
-                        int currentSource;
-
-                        if ( nProcs > 2 )
-                        {
-                            // Receive from other workers
-                            for ( size_t i = 2 ; i <= nProcs ; i++)
-                            {
-                                MPI_Recv(0,0, MPI_INT, MPI_ANY_SOURCE, TAG_FREEWORKER,
-                                         MPI_COMM_WORLD, &status);
-
-                                currentSource = status.MPI_SOURCE;
-
-                                pointer = fourierVolume;
-
-                                while (1)
-                                {
-                                    MPI_Probe( currentSource, MPI_ANY_TAG, MPI_COMM_WORLD, &status );
-
-                                    if ( status.MPI_TAG == TAG_FREEWORKER )
-                                    {
-                                        MPI_Recv(0,0, MPI_INT, currentSource, TAG_FREEWORKER, MPI_COMM_WORLD, &status );
-                                        break;
-                                    }
-
-                                    MPI_Recv( recBuffer,
-                                              BUFFSIZE,
-                                              MPI_DOUBLE,
-                                              currentSource,
-                                              MPI_ANY_TAG,
-                                              MPI_COMM_WORLD,
-                                              &status );
-
-                                    MPI_Get_count( &status, MPI_DOUBLE, &receivedSize );
-
-                                    for ( int i = 0 ; i < receivedSize ; i ++ )
-                                    {
-                                        pointer[i] += recBuffer[i];
-                                    }
-
-                                    pointer += receivedSize;
-                                }
-                            }
-                        }
-                        free( recBuffer );
-
                         Image<double> auxVolume1;
                         auxVolume1().alias( FourierWeights );
                         auxVolume1.write((std::string)fn_fsc + "_1_Weights.vol");
@@ -406,13 +351,6 @@ void ProgMPIRecFourier::run()
                     }
                     else
                     {
-
-                        MPI_Send( 0,0,MPI_INT,1,TAG_FREEWORKER, MPI_COMM_WORLD );
-
-                        sendDataInChunks( fourierVolume, 1, 2*sizeout, BUFFSIZE, MPI_COMM_WORLD );
-
-                        MPI_Send( 0,0,MPI_INT,1,TAG_FREEWORKER, MPI_COMM_WORLD );
-
                         Vout().initZeros(volPadSizeZ, volPadSizeY, volPadSizeX);
                         transformerVol.setReal(Vout());
                         Vout().clear();
@@ -431,9 +369,14 @@ void ProgMPIRecFourier::run()
                     std::cerr << "Wr" << node->rank << " " << "TAG_STOP" << std::endl;
 #endif
 
+                    gettimeofday(&start_time,NULL);
                     MPI_Allreduce(MPI_IN_PLACE, fourierWeights,
                                   sizeout, MPI_DOUBLE,
                                   MPI_SUM, new_comm);
+                    gettimeofday(&end_time,NULL);
+                    total_usecs = (end_time.tv_sec-start_time.tv_sec) * 1000000 + (end_time.tv_usec-start_time.tv_usec);
+                    time_reduce_weights += ((double)total_usecs/(double)1000000);
+                    time_reduce_volume += reduceInChunks( fourierVolume, 2*sizeout, new_comm );
                     /*if (iter != NiterWeight)
                 {
                         MPI_Allreduce(MPI_IN_PLACE, fourierWeights,
@@ -459,60 +402,12 @@ void ProgMPIRecFourier::run()
 
                     if ( node->rank == 1 )
                     {
-                        // Reserve memory for the receive buffer
-                        double * recBuffer = (double *) malloc (sizeof(double)*BUFFSIZE);
-                        int receivedSize;
-                        double * pointer;
-                        pointer = fourierVolume;
-                        int currentSource;
-
-                        gettimeofday(&start_time,NULL);
-
-                        if ( nProcs > 1 )
+                        if (verbose > 0)
                         {
-                            // Receive from other workers
-
-                            for (size_t i = 0 ; i <= (nProcs-2) ; i++)
-                            {
-                                MPI_Recv(0,0, MPI_INT, MPI_ANY_SOURCE, TAG_FREEWORKER,
-                                         MPI_COMM_WORLD, &status);
-
-                                currentSource = status.MPI_SOURCE;
-
-                                pointer = fourierVolume;
-
-                                while (1)
-                                {
-                                    MPI_Probe( currentSource, MPI_ANY_TAG, MPI_COMM_WORLD, &status );
-
-                                    if ( status.MPI_TAG == TAG_FREEWORKER )
-                                    {
-                                        MPI_Recv(0,0, MPI_INT, currentSource, TAG_FREEWORKER, MPI_COMM_WORLD, &status );
-
-                                        break;
-                                    }
-
-                                    MPI_Recv( recBuffer,
-                                              BUFFSIZE,
-                                              MPI_DOUBLE,
-                                              currentSource,
-                                              MPI_ANY_TAG,
-                                              MPI_COMM_WORLD,
-                                              &status );
-
-                                    MPI_Get_count( &status, MPI_DOUBLE, &receivedSize );
-
-                                    for ( int i = 0 ; i < receivedSize ; i ++ )
-                                    {
-                                        pointer[i] += recBuffer[i];
-                                    }
-
-                                    pointer += receivedSize;
-                                }
-                            }
+                            std::cout << "\nReduction of weights: " << time_reduce_weights << " secs." << std::endl;
+                            std::cout << "Reduction of volume: " << time_reduce_volume << " secs." << std::endl;
                         }
-
-                        free( recBuffer );
+                        gettimeofday(&start_time,NULL);
                         if (iter==0)
                         {
                             VoutFourierTmp=VoutFourier;
@@ -609,12 +504,6 @@ void ProgMPIRecFourier::run()
                     }
                     else
                     {
-                        MPI_Send( 0,0,MPI_INT,1,TAG_FREEWORKER, MPI_COMM_WORLD );
-
-                        sendDataInChunks( fourierVolume, 1, 2 * sizeout, BUFFSIZE, MPI_COMM_WORLD);
-
-                        MPI_Send( 0,0,MPI_INT,1,TAG_FREEWORKER, MPI_COMM_WORLD );
-
                         break;
                     }
                 }
@@ -624,8 +513,6 @@ void ProgMPIRecFourier::run()
                     MPI_Recv(&jobNumber, 1, MPI_INT, 0, TAG_WORKFORWORKER, MPI_COMM_WORLD, &status);
                     //LABEL
                     //(if jobNumber == -1) break;
-                    threadOpCode=PROCESS_IMAGE;
-
                     size_t min_i, max_i;
 
                     min_i = jobNumber*mpi_job_size;
@@ -648,50 +535,29 @@ void ProgMPIRecFourier::run()
 
         // Kill threads used on workers
         if ( node->active && !node->isMaster() )
-        {
-            threadOpCode = EXIT_THREAD;
-            barrier_wait( &barrier );
-
-            for ( int nt=0; nt<numThreads; nt++)
-            {
-                pthread_join(*(th_ids+nt),NULL);
-            }
-            barrier_destroy( &barrier );
-        }
+            destroyThreads();
         iter++;
     }
     while(iter<NiterWeight);
 }
 
-int  ProgMPIRecFourier::sendDataInChunks( double * pointer, int dest, int totalSize, int buffSize, MPI_Comm comm )
+double ProgMPIRecFourier::reduceInChunks( double * pointer, size_t totalSize, MPI_Comm comm )
 {
-    double * localPointer = pointer;
-
-    int numChunks =(int)ceil((double)totalSize/(double)buffSize);
-    int packetSize;
-    int err=0;
+    struct timeval start_time, end_time;
+    int rank;
+    MPI_Comm_rank(comm, &rank);
 
-    for ( int i = 0 ; i < numChunks ; i ++ )
+    gettimeofday(&start_time,NULL);
+    for (size_t done = 0 ; done < totalSize ; done += BUFFSIZE )
     {
-        if ( i == (numChunks-1))
-            packetSize = totalSize-i*buffSize;
+        int packetSize = (int)XMIPP_MIN((size_t)BUFFSIZE, totalSize - done);
+        if (rank == 0)
+            MPI_Reduce(MPI_IN_PLACE, pointer + done, packetSize, MPI_DOUBLE, MPI_SUM, 0, comm);
         else
-            packetSize = buffSize;
-
-        if ( (err = MPI_Send( localPointer, packetSize,
-                              MPI_DOUBLE, dest, 0, MPI_COMM_WORLD ))
-             != MPI_SUCCESS )
-        {
-            break;
-        }
-
-        localPointer += packetSize;
+            MPI_Reduce(pointer + done, NULL, packetSize, MPI_DOUBLE, MPI_SUM, 0, comm);
     }
+    gettimeofday(&end_time,NULL);
 
-    return err;
+    long int total_usecs = (end_time.tv_sec-start_time.tv_sec) * 1000000 + (end_time.tv_usec-start_time.tv_usec);
+    return (double)total_usecs/(double)1000000;
 }
-
-
-
-
-
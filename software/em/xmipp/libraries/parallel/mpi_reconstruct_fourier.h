@@ -96,7 +96,12 @@ public:
     /* Run --------------------------------------------------------------------- */
     void run();
 
-    int  sendDataInChunks( double * pointer, int dest, int totalSize, int buffSize, MPI_Comm comm );
+    /** Sum the data of all the processes of comm into its first process.
+     * The data is reduced in place with MPI_Reduce, in chunks of BUFFSIZE
+     * doubles, so that no intermediate copy of the volume is needed.
+     * Returns the time spent in seconds.
+     */
+    double reduceInChunks( double * pointer, size_t totalSize, MPI_Comm comm );
 
 };
 //@}
@@ -93,6 +93,7 @@ void ProgAngularProjectLibrary::readParams()
         FnexperimentalImages = getParam("--experimental_images");
     fn_groups = getParam("--groups");
     only_winner = checkParam("--only_winner");
+    Nthreads = getIntParam("--thr");
 }
 
 /* Usage ------------------------------------------------------------------- */
@@ -140,6 +141,7 @@ void ProgAngularProjectLibrary::defineParams()
     addParamsLine("  [--groups <selfile=\"\">]     : selfile with groups");
     addParamsLine("  [--only_winner]               : if set each experimental");
     addParamsLine("                                : point will have a unique neighbor");
+    addParamsLine("  [--thr <N=1>]                 : Number of threads for the real space and Fourier projections");
 
     addExampleLine("Sample at 2 degrees and use c6 symmetry:", false);
     addExampleLine("xmipp_angular_project_library -i in.vol -o out.stk --sym c6 --sampling_rate 2");
@@ -179,6 +181,7 @@ void ProgAngularProjectLibrary::show()
     }
     else if (projType == REALSPACE)
         std::cout << " realspace " <<std::endl;
+    std::cout << "threads:                   " << Nthreads << std::endl;
 
     if (angular_distance_bool)
         std::cout << "angular_distance:          " << angular_distance << std::endl;
@@ -226,6 +229,47 @@ void ProgAngularProjectLibrary::project_angle_vector (int my_init, int my_end, b
 
     for (double mypsi=0;mypsi<360;mypsi += psi_sampling)
     {
+        if ((projType == REALSPACE || projType == FOURIER) && Nthreads > 1)
+        {
+            // The projections of a block of directions are computed
+            // by several threads and then written in order
+            int blockSize = 4 * Nthreads;
+            std::vector<Projection> projections;
+            MultidimArray<double> stack;
+            std::vector<double> rots, tilts, psis;
+            for (int i0=my_init;i0<=my_end;i0 += blockSize)
+            {
+                int iF = XMIPP_MIN(i0 + blockSize - 1, my_end);
+                rots.clear();
+                tilts.clear();
+                psis.clear();
+                for (int i=i0;i<=iF;i++)
+                {
+                    psis.push_back(mypsi+ZZ(mysampling.no_redundant_sampling_points_angles[i]));
+                    tilts.push_back(YY(mysampling.no_redundant_sampling_points_angles[i]));
+                    rots.push_back(XX(mysampling.no_redundant_sampling_points_angles[i]));
+                }
+                if (projType == FOURIER)
+                {
+                    Vfourier->project(rots, tilts, psis, stack, Nthreads);
+                    projections.resize(rots.size());
+                    for (size_t n=0;n<rots.size();n++)
+                        stack.getImage(n, projections[n]());
+                }
+                else
+                    projectVolumes(inputVol(), projections, Ydim, Xdim, rots, tilts, psis, Nthreads);
+                for (int i=i0;i<=iF;i++)
+                {
+                    if (verbose)
+                        progress_bar(i-my_init);
+                    Projection &Pi = projections[i-i0];
+                    Pi.setEulerAngles(rots[i-i0],tilts[i-i0],psis[i-i0]);
+                    Pi.setDataMode(_DATA_ALL);
+                    Pi.write(output_file,(size_t) (numberStepsPsi * i + mypsi +1),true,WRITE_REPLACE);
+                }
+            }
+            continue;
+        }
         for (int i=my_init;i<=my_end;i++)
         {
             if (verbose)
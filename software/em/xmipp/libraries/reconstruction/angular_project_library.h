@@ -138,6 +138,9 @@ public:
      *  point, the closest */
     bool only_winner;
 
+    /** Number of threads for the real space and Fourier projections */
+    int Nthreads;
+
     /* Volume for shear projection */
     RealShearsInfo *Vshears;
 
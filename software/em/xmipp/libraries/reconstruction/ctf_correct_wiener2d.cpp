@@ -35,6 +35,7 @@ void ProgCorrectWiener2D::readParams()
     wiener_constant  = getDoubleParam("--wc");
     correct_envelope = checkParam("--correct_envelope");
     sampling_rate = getDoubleParam("--sampling_rate");
+    ctfCache.maxImages = XMIPP_MAX(1, getIntParam("--ctf_cache"));
 }
 
 // Define parameters ==========================================================
@@ -50,11 +51,15 @@ void ProgCorrectWiener2D::defineParams()
     addParamsLine("   [--wc <float=-1>]       : Wiener-filter constant (if < 0: use FREALIGN default)");
     addParamsLine("   [--pad <factor=2.> ]    : Padding factor for Wiener correction");
     addParamsLine("   [--correct_envelope]     : Correct the CTF envelope");
+    addParamsLine("   [--ctf_cache <n=256>]   : Number of Wiener filters kept in memory");
+    addParamsLine("                           : The particles with the same CTF share the filter");
 }
 
 // Define parameters ==========================================================
 void ProgCorrectWiener2D::postProcess()
 {
+	if (verbose)
+		std::cout << ctfCache;
 
 	MetaData &ptrMdOut=*getOutputMd();
 
@@ -92,21 +97,12 @@ void ProgCorrectWiener2D::postProcess()
 
 }
 
-void ProgCorrectWiener2D::generateWienerFilter(MultidimArray<double> &Mwien, CTFDescription & ctf)
+void ProgCorrectWiener2D::applyWienerFilter(MultidimArray<std::complex<double> > &Faux, CTFDescription &ctf)
 {
 	int paddim = Ydim*pad;
 	ctf.enable_CTF = true;
 	ctf.enable_CTFnoise = false;
-	ctf.produceSideInfo();
-
-	MultidimArray<std::complex<double> > ctfComplex;
-	MultidimArray<double> ctfIm;
-
-	Mwien.resize(paddim,paddim);
-
-	//NO entiendo esto:
 	ctf.Tm = sampling_rate;
-	//ctf.Tm /= pad;
 
 	if (isIsotropic)
 	{
@@ -115,86 +111,16 @@ void ProgCorrectWiener2D::generateWienerFilter(MultidimArray<double> &Mwien, CTF
 		ctf.DeltafV = avgdef;
 	}
 
-
-	ctfIm.resize(1, 1, paddim, paddim,false);
-	//Esto puede estar mal. Cuidado con el sampling de la ctf!!!
-
-	if (correct_envelope)
-		ctf.generateCTF(paddim, paddim, ctfComplex);
-
-	else
-		ctf.generateCTFWithoutDamping(paddim, paddim, ctfComplex);
-
-	FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY2D(ctfIm)
-	{
-		if (phase_flipped)
-			dAij(ctfIm, i, j) = fabs(dAij(ctfComplex, i, j).real());
-		else
-			dAij(ctfIm, i, j) = dAij(ctfComplex, i, j).real();
-	}
-
-#ifdef DEBUG
-	{
-		Image<double> save;
-		save()=ctfIm;
-		save.write("ctf2.spi");
-		exit(1);
-		//std::cout << "Press any key\n";
-		//char c;
-		//std::cin >> c;
-	}
-#endif
-#undef DEBUG
-
-	double result;
-	FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY2D(Mwien)
-	{
-		result = (DIRECT_N_YX_ELEM (ctfIm, 0, 0, i, j  ));
-		dAij(Mwien,i,j) = (result *result);
-	}
-
-#ifdef DEBUG
-
-{
-	Image<double> save;
-	save()=Mwien;
-	save.write("vienerB.spi");
-}
-#endif
-#undef DEBUG
-
-// Add Wiener constant
-if (wiener_constant < 0.)
-{
-
-	// Use Grigorieff's default for Wiener filter constant: 10% of average over all Mwien terms
-	// Grigorieff JSB 157(1) (2006), pp 117-125
-	double valueW = 0.1*Mwien.computeAvg();
-	FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY2D(Mwien)
+	// The filter is evaluated on the Fourier transform of the padded image,
+	// and only if it was not computed for a previous particle
+	MultidimArray<double> *Mwien;
+	if (!ctfCache.getImage(ctf, paddim, paddim, Mwien))
 	{
-		dAij(Mwien,i,j) += valueW;
-		dAij(Mwien,i,j) = dAij(ctfIm, i, j)/dAij(Mwien, i, j);
+		ctf.produceSideInfo();
+		ctf.getWienerFilter(paddim, paddim, *Mwien, wiener_constant, phase_flipped, correct_envelope);
 	}
-}
-else
-{
-	FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY2D(Mwien)
-    {
-		dAij(Mwien,i,j) += wiener_constant;
-		dAij(Mwien,i,j) = dAij(ctfIm, i, j)/dAij(Mwien, i, j);
-    }
-}
-
-#ifdef DEBUG
-
-{
-	Image<double> save;
-	save()=Mwien;
-	save.write("vienerC.spi");
-}
-#endif
-#undef DEBUG
-
+	FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(Faux)
+	DIRECT_MULTIDIM_ELEM(Faux,n) *= DIRECT_MULTIDIM_ELEM(*Mwien,n);
 }
 
 void ProgCorrectWiener2D::processImage(const FileName &fnImg, const FileName &fnImgOut, const MDRow &rowIn, MDRow &rowOut)
@@ -210,8 +136,6 @@ void ProgCorrectWiener2D::processImage(const FileName &fnImg, const FileName &fn
 	int paddim = Ydim*pad;
 	MultidimArray<std::complex<double> > Faux;
 
-	 generateWienerFilter(Mwien,ctf);
-
 #ifdef DEBUG
 
 {
@@ -231,10 +155,7 @@ void ProgCorrectWiener2D::processImage(const FileName &fnImg, const FileName &fn
     }
 
     FourierTransform(img(), Faux);
-    FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY2D(Mwien)
-    {
-        dAij(Faux,i,j) *= dAij(Mwien,i,j);
-    }
+    applyWienerFilter(Faux, ctf);
 
     InverseFourierTransform(Faux, img());
     if (paddim > Xdim)
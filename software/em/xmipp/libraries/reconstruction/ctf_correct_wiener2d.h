@@ -69,7 +69,8 @@ public:
 
     void processImage(const FileName &fnImg, const FileName &fnImgOut, const MDRow &rowIn, MDRow &rowOut);
 
-    void generateWienerFilter(MultidimArray<double> &Mwien, CTFDescription &ctf);
+    /// Multiply the Fourier transform of the padded image by the Wiener filter of its CTF
+    void applyWienerFilter(MultidimArray<std::complex<double> > &Faux, CTFDescription &ctf);
 
 	void postProcess();
 public:
@@ -77,9 +78,10 @@ public:
 
 	CTFDescription ctf;
 
-	size_t Ydim, Xdim;
+	/// Wiener filters of the last CTFs
+	CTFImageCache ctfCache;
 
-	MultidimArray<double> Mwien;
+	size_t Ydim, Xdim;
 };
 
 
@@ -41,12 +41,13 @@ ProgCTFEstimateFromMicrograph::ProgCTFEstimateFromMicrograph()
 {
     psd_mode = OnePerMicrograph; 
     PSDEstimator_mode = Periodogram;
+    Nthreads = 1;
 }
 void ProgCTFEstimateFromMicrograph::readParams()
 {
     fn_micrograph = getParam("--micrograph");
     fn_root = getParam("--oroot");
-    if (fn_root == "")
+    if (fn_root == "" && !fn_micrograph.isMetaData(false))
         fn_root = fn_micrograph.withoutExtension();
     pieceDim = getIntParam("--pieceDim");
     skipBorders = getIntParam("--skipBorders");
@@ -78,6 +79,7 @@ void ProgCTFEstimateFromMicrograph::readParams()
     if (estimate_ctf)
         prmEstimateCTFFromPSD.readBasicParams(this);
     bootstrapN = getIntParam("--bootstrapFit");
+    Nthreads = getIntParam("--thr");
 }
 
 void ProgCTFEstimateFromMicrograph::defineParams()
@@ -89,9 +91,13 @@ void ProgCTFEstimateFromMicrograph::defineParams()
     addUsageLine("And finally, the CTF is fitted to the PSD, being guided by the enhanced PSD ");
     addUsageLine("([[http://www.ncbi.nlm.nih.gov/pubmed/17911028][See article]]).");
     addParamsLine("   --micrograph <file>         : File with the micrograph");
+    addParamsLine("                               : or metadata with the micrographs (label micrograph)");
     addParamsLine("  [--oroot <rootname=\"\">]    : Rootname for output");
     addParamsLine("                               : If not given, the micrograph without extensions is taken");
+    addParamsLine("                               : If the input is a metadata, directory for the output of all micrographs");
     addParamsLine("                               :++ rootname.psd or .psdstk contains the PSD or PSDs");
+    addParamsLine("  [--thr <N=1>]                : Number of micrographs estimated at the same time");
+    addParamsLine("                               : if the input is a metadata");
     addParamsLine("==+ PSD estimation");
     addParamsLine("  [--psd_estimator <method=periodogram>] : Method for estimating the PSD");
     addParamsLine("         where <method>");
@@ -126,6 +132,8 @@ void ProgCTFEstimateFromMicrograph::defineParams()
     addExampleLine("xmipp_ctf_estimate_from_micrograph --micrograph micrograph.mrc --sampling_rate 1.4 --voltage 200 --spherical_aberration 2.5 --defocusU -15000");
     addExampleLine("Estimate a CTF per region", false);
     addExampleLine("xmipp_ctf_estimate_from_micrograph --micrograph micrograph.mrc --mode regions micrograph.pos --sampling_rate 1.4 --voltage 200 --spherical_aberration 2.5 --defocusU -15000");
+    addExampleLine("Estimate a single CTF for each micrograph of a set, 8 micrographs at a time", false);
+    addExampleLine("xmipp_ctf_estimate_from_micrograph --micrograph micrographs.xmd --oroot ctfs --sampling_rate 1.4 --voltage 200 --spherical_aberration 2.5 --thr 8");
     addExampleLine("Estimate a CTF per particle", false);
     addExampleLine("xmipp_ctf_estimate_from_micrograph --micrograph micrograph.mrc --mode particles micrograph.pos --sampling_rate 1.4 --voltage 200 --spherical_aberration 2.5 --defocusU -15000");
 }
@@ -272,7 +280,7 @@ void ProgCTFEstimateFromMicrograph::PSD_piece_by_averaging(
 
 /* Main ==================================================================== */
 //#define DEBUG
-void ProgCTFEstimateFromMicrograph::run()
+void ProgCTFEstimateFromMicrograph::processMicrograph()
 {
     // Open input files -----------------------------------------------------
     // Open coordinates
@@ -361,7 +369,8 @@ void ProgCTFEstimateFromMicrograph::run()
     for (size_t nIm = 1; nIm <= Ndim; nIm++)
 	{
         M_in.read(fn_micrograph,DATA,nIm);
-        std::cout << "Micrograph number: " << nIm << std::endl;
+        if (verbose)
+            std::cout << "Micrograph number: " << nIm << std::endl;
         while (N <= div_Number)
         {
         	bool skip = false;
@@ -748,6 +757,102 @@ void ProgCTFEstimateFromMicrograph::run()
     posFile.write(fn_pos);
 }
 
+/* Estimate a set of micrographs ------------------------------------------ */
+class ThreadProcessMicrographsParams
+{
+public:
+    const ProgCTFEstimateFromMicrograph *prm;
+    std::vector<FileName> *micrographs, *roots;
+    ThreadTaskDistributor *distributor;
+};
+
+void threadProcessMicrographs(ThreadArgument &thArg)
+{
+    ThreadProcessMicrographsParams *args =
+        (ThreadProcessMicrographsParams*) thArg.workClass;
+    const ProgCTFEstimateFromMicrograph &prm = *(args->prm);
+
+    // Each thread fits with its own copy of the parameters,
+    // that keeps the state of the fitting
+    ProgCTFEstimateFromMicrograph worker;
+    worker.prmEstimateCTFFromPSD = prm.prmEstimateCTFFromPSD;
+    worker.ARMA_prm = prm.ARMA_prm;
+    worker.psd_mode = prm.psd_mode;
+    worker.pieceDim = prm.pieceDim;
+    worker.overlap = prm.overlap;
+    worker.skipBorders = prm.skipBorders;
+    worker.Nsubpiece = prm.Nsubpiece;
+    worker.PSDEstimator_mode = prm.PSDEstimator_mode;
+    worker.bootstrapN = prm.bootstrapN;
+    worker.estimate_ctf = prm.estimate_ctf;
+    worker.verbose = 0;
+
+    size_t first, last;
+    while (args->distributor->getTasks(first, last))
+        for (size_t n = first; n <= last; ++n)
+        {
+            worker.fn_micrograph = (*(args->micrographs))[n];
+            worker.fn_root = (*(args->roots))[n];
+            worker.processMicrograph();
+            if (prm.verbose && thArg.thread_id == 0)
+                progress_bar(n);
+        }
+}
+
+void ProgCTFEstimateFromMicrograph::processMicrographs(const MetaData &mdMicrographs,
+        const FileName &fnDir)
+{
+    if (psd_mode == OnePerParticle)
+        REPORT_ERROR(ERR_ARG_INCORRECT,
+                     "There must be a position file for each micrograph, "
+                     "the particles mode cannot be used with a metadata of micrographs");
+
+    std::vector<FileName> micrographs, roots;
+    FileName fnMicrograph;
+    FOR_ALL_OBJECTS_IN_METADATA(mdMicrographs)
+    {
+        mdMicrographs.getValue(MDL_MICROGRAPH, fnMicrograph, __iter.objId);
+        micrographs.push_back(fnMicrograph);
+        if (fnDir == "")
+            roots.push_back(fnMicrograph.withoutExtension());
+        else
+            roots.push_back(fnDir + "/" + fnMicrograph.getBaseName());
+    }
+    size_t Nmicrographs = micrographs.size();
+    if (Nmicrographs == 0)
+        return;
+    if (fnDir != "" && !fnDir.exists())
+        fnDir.makePath();
+
+    ThreadProcessMicrographsParams args;
+    args.prm = this;
+    args.micrographs = &micrographs;
+    args.roots = &roots;
+    args.distributor = new ThreadTaskDistributor(Nmicrographs, 1);
+    if (verbose)
+    {
+        std::cerr << "Estimating the CTF of " << Nmicrographs << " micrographs ...\n";
+        init_progress_bar(Nmicrographs);
+    }
+    ThreadManager *thMgr = new ThreadManager(XMIPP_MAX(1, XMIPP_MIN(Nthreads, (int)Nmicrographs)), &args);
+    thMgr->run(threadProcessMicrographs);
+    if (verbose)
+        progress_bar(Nmicrographs);
+    delete thMgr;
+    delete args.distributor;
+}
+
+void ProgCTFEstimateFromMicrograph::run()
+{
+    if (fn_micrograph.isMetaData(false))
+    {
+        MetaData mdMicrographs(fn_micrograph);
+        processMicrographs(mdMicrographs, fn_root);
+    }
+    else
+        processMicrograph();
+}
+
 /* Fast estimate of PSD --------------------------------------------------- */
 class ThreadFastEstimateEnhancedPSDParams
 {
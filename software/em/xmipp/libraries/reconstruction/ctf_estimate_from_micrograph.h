@@ -70,6 +70,8 @@ public:
     int                     bootstrapN;
     /// Estimate a CTF for each PSD
     bool 					estimate_ctf;
+    /// Number of micrographs estimated at the same time when the input is a metadata
+    int                     Nthreads;
 public:
     /** constructor**/
     ProgCTFEstimateFromMicrograph();
@@ -86,6 +88,17 @@ public:
     void PSD_piece_by_averaging(MultidimArray<double> &piece,
                                 MultidimArray<double> &psd);
 
+    /** Estimate the PSDs and CTFs of fn_micrograph.
+        The results are written with the rootname fn_root. */
+    void processMicrograph();
+
+    /** Estimate the PSDs and CTFs of all micrographs in a metadata.
+        The micrographs are distributed among Nthreads threads, each one
+        with its own copy of the parameters. The results of each micrograph
+        are written in fnDir with its basename, or next to the micrograph
+        if fnDir is empty. */
+    void processMicrographs(const MetaData &mdMicrographs, const FileName &fnDir);
+
     /// Process the whole thing
     void run();
 };
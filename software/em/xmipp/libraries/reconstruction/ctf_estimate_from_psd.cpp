@@ -56,7 +56,7 @@ std::ofstream fhDebug;
 #define DEBUG_OPEN_TEXTFILE(fnRoot) fhDebug.open((fnRoot+"_debug.txt").c_str());
 #define DEBUG_CLOSE_TEXTFILE fhDebug.close();
 #define DEBUG_TEXTFILE(str) fhDebug << time (NULL) << " " << str << std::endl;
-#define DEBUG_MODEL_TEXTFILE fhDebug << global_ctfmodel << std::endl;
+#define DEBUG_MODEL_TEXTFILE fhDebug << current_ctfmodel << std::endl;
 #else
 #define DEBUG_OPEN_TEXTFILE(fnRoot);
 #define DEBUG_CLOSE_TEXTFILE ;
@@ -64,79 +64,16 @@ std::ofstream fhDebug;
 #define DEBUG_MODEL_TEXTFILE
 #endif
 
-/* Global variables -------------------------------------------------------- */
-namespace AdjustCTF
-{
-// Some aliases
-ProgCTFEstimateFromPSD *global_prm;
-MultidimArray<double> *f; // The CTF to model
-Matrix1D<double> *global_adjust; // Current theoretical adjustment
-double global_corr13; // Correlation with enhanced PSD between rings 1 and 3
-
-// Frequency of each point in digital units
-MultidimArray<double> global_x_digfreq;
-MultidimArray<double> global_y_digfreq;
-MultidimArray<double> global_w_digfreq;
-MultidimArray<int> global_w_digfreq_r;
-MultidimArray<double> global_w_digfreq_r_iN;
-MultidimArray<double> global_x_contfreq;
-MultidimArray<double> global_y_contfreq;
-MultidimArray<double> global_w_contfreq;
-MultidimArray<double> global_mask;
-MultidimArray<double> global_mask_between_zeroes;
-MultidimArray<double> global_w_count;
-
-MultidimArray<double> global_psd_exp_radial_derivative;
-MultidimArray<double> global_psd_theo_radial_derivative;
-MultidimArray<double> global_psd_exp_radial;
-MultidimArray<double> global_psd_theo_radial;
-
-// Penalization for forbidden values of the parameters
-double global_heavy_penalization;
-
-// Penalization factor for the background
-bool global_penalize;
-double global_current_penalty;
-const double global_penalty = 32; // Maximum penalization
-
-// Speed up factor
-int global_evaluation_reduction;
-
-// CTF model and noise model
-CTFDescription global_ctfmodel;
-CTFDescription global_ctfmodel_defoci;
-
-// Maximum of the gaussian
-double global_max_gauss_freq;
-
-// Autofocus
-double global_value_th;
-double global_min_freq;
-double global_max_freq;
-
-// Program status
-int global_action; // 0: Computing the background (sqrt)
-// 1: Computing the full background
-// 2: Computing the envelope
-// 3: Computing defoci
-// 4: Computing all CTF parameters
-// 5: Computing all CTF parameters + Gaussian2
-// 6: Computing all CTF parameters + Gaussian2
-// 7: Produce output
-int global_show; // 0: Do not show
-// 1: Partially detailed
-// 2: Very detailed
-}
-
-using namespace AdjustCTF;
+// Maximum penalization for the background
+const double global_penalty = 32;
 
 #define ASSIGN_CTF_PARAM(index, paramName) if (ia <= index && l > 0) { ctfmodel.paramName = p[index]; --l; }
 
 /* Assign ctfmodel from a vector and viceversa ----------------------------- */
-void assignCTFfromParameters(double *p, CTFDescription &ctfmodel, int ia,
+void ProgCTFEstimateFromPSD::assignCTFfromParameters(double *p, CTFDescription &ctfmodel, int ia,
                              int l, int modelSimplification)
 {
-    ctfmodel.Tm = global_prm->Tm;
+    ctfmodel.Tm = Tm;
 
     ASSIGN_CTF_PARAM(0, DeltafU);
     ASSIGN_CTF_PARAM(1, DeltafV);
@@ -301,9 +238,21 @@ void assignParametersFromCTF(CTFDescription &ctfmodel, double *p, int ia,
 }
 
 #define COPY_ctfmodel_TO_CURRENT_GUESS \
-    assignParametersFromCTF(global_ctfmodel, \
-                               MATRIX1D_ARRAY(*global_adjust),0,ALL_CTF_PARAMETERS, \
-                               global_prm->modelSimplification);
+    assignParametersFromCTF(current_ctfmodel, \
+                               MATRIX1D_ARRAY(*adjust_params),0,ALL_CTF_PARAMETERS, \
+                               modelSimplification);
+
+/* Constructor ------------------------------------------------------------- */
+ProgCTFEstimateFromPSD::ProgCTFEstimateFromPSD()
+{
+    f = NULL;
+    adjust_params = NULL;
+    corr13 = heavy_penalization = current_penalty = 0;
+    penalize = false;
+    evaluation_reduction = 1;
+    max_gauss_freq = value_th = min_freq_psd = max_freq_psd = 0;
+    action = show_inf = 0;
+}
 
 /* Read parameters --------------------------------------------------------- */
 void ProgCTFEstimateFromPSD::readBasicParams(XmippProgram *program)
@@ -459,8 +408,8 @@ void ProgCTFEstimateFromPSD::produceSideInfo()
 {
     adjust.resize(ALL_CTF_PARAMETERS);
     adjust.initZeros();
-    global_ctfmodel.clear();
-    global_ctfmodel_defoci.clear();
+    current_ctfmodel.clear();
+    ctfmodel_defoci.clear();
     assignParametersFromCTF(initial_ctfmodel, MATRIX1D_ARRAY(adjust), 0, ALL_CTF_PARAMETERS, true);
 
     // Read the CTF file, supposed to be the uncentered squared amplitudes
@@ -469,68 +418,68 @@ void ProgCTFEstimateFromPSD::produceSideInfo()
     f = &(ctftomodel());
 
     // Resize the frequency
-    global_x_digfreq.initZeros(YSIZE(*f), XSIZE(*f) / 2);
-    global_y_digfreq.initZeros(YSIZE(*f), XSIZE(*f) / 2);
-    global_w_digfreq.initZeros(YSIZE(*f), XSIZE(*f) / 2);
-    global_w_digfreq_r.initZeros(YSIZE(*f), XSIZE(*f) / 2);
-    global_x_contfreq.initZeros(YSIZE(*f), XSIZE(*f) / 2);
-    global_y_contfreq.initZeros(YSIZE(*f), XSIZE(*f) / 2);
-    global_w_contfreq.initZeros(YSIZE(*f), XSIZE(*f) / 2);
+    x_digfreq.initZeros(YSIZE(*f), XSIZE(*f) / 2);
+    y_digfreq.initZeros(YSIZE(*f), XSIZE(*f) / 2);
+    w_digfreq.initZeros(YSIZE(*f), XSIZE(*f) / 2);
+    w_digfreq_r.initZeros(YSIZE(*f), XSIZE(*f) / 2);
+    x_contfreq.initZeros(YSIZE(*f), XSIZE(*f) / 2);
+    y_contfreq.initZeros(YSIZE(*f), XSIZE(*f) / 2);
+    w_contfreq.initZeros(YSIZE(*f), XSIZE(*f) / 2);
 
     Matrix1D<int> idx(2); // Indexes for Fourier plane
     Matrix1D<double> freq(2); // Frequencies for Fourier plane
-    FOR_ALL_ELEMENTS_IN_ARRAY2D(global_x_digfreq)
+    FOR_ALL_ELEMENTS_IN_ARRAY2D(x_digfreq)
     {
         XX(idx) = j;
         YY(idx) = i;
 
         // Digital frequency
         FFT_idx2digfreq(*f, idx, freq);
-        global_x_digfreq(i, j) = XX(freq);
-        global_y_digfreq(i, j) = YY(freq);
-        global_w_digfreq(i, j) = freq.module();
-        global_w_digfreq_r(i, j) = (int)(global_w_digfreq(i,j) * (double)YSIZE(global_w_digfreq));
+        x_digfreq(i, j) = XX(freq);
+        y_digfreq(i, j) = YY(freq);
+        w_digfreq(i, j) = freq.module();
+        w_digfreq_r(i, j) = (int)(w_digfreq(i,j) * (double)YSIZE(w_digfreq));
 
         // Continuous frequency
-        digfreq2contfreq(freq, freq, global_prm->Tm);
-        global_x_contfreq(i, j) = XX(freq);
-        global_y_contfreq(i, j) = YY(freq);
-        global_w_contfreq(i, j) = freq.module();
+        digfreq2contfreq(freq, freq, Tm);
+        x_contfreq(i, j) = XX(freq);
+        y_contfreq(i, j) = YY(freq);
+        w_contfreq(i, j) = freq.module();
     }
 
     // Precompute frequency related terms in the CTF
-    global_ctfmodel.precomputeValues(global_x_contfreq, global_y_contfreq);
+    current_ctfmodel.precomputeValues(x_contfreq, y_contfreq);
 
     // Build frequency mask
-    global_mask.initZeros(global_w_digfreq);
-    global_w_count.initZeros(XSIZE(global_w_digfreq));
-    FOR_ALL_ELEMENTS_IN_ARRAY2D(global_w_digfreq)
+    freq_mask.initZeros(w_digfreq);
+    w_count.initZeros(XSIZE(w_digfreq));
+    FOR_ALL_ELEMENTS_IN_ARRAY2D(w_digfreq)
     {
-        if (global_w_digfreq(i, j) >= max_freq
-            || global_w_digfreq(i, j) <= min_freq)
+        if (w_digfreq(i, j) >= max_freq
+            || w_digfreq(i, j) <= min_freq)
             continue;
-        global_mask(i, j) = 1;
-        global_w_count(global_w_digfreq_r(i, j))++;
+        freq_mask(i, j) = 1;
+        w_count(w_digfreq_r(i, j))++;
     }
 
     // Bootstrap
     if (bootstrap)
     {
-        double N=global_mask.sum();
+        double N=freq_mask.sum();
         std::vector< Matrix1D<int> > positions;
-        FOR_ALL_ELEMENTS_IN_ARRAY2D(global_mask)
-        if (global_mask(i,j))
+        FOR_ALL_ELEMENTS_IN_ARRAY2D(freq_mask)
+        if (freq_mask(i,j))
         {
             Matrix1D<int> r(2);
             XX(r)=j;
             YY(r)=i;
             positions.push_back(r);
         }
-        global_mask.initZeros();
+        freq_mask.initZeros();
         for (int n=0; n<N; n++)
         {
             int idx=ROUND(rnd_unif(0,N-1));
-            global_mask(YY(positions[idx]),XX(positions[idx]))+=1;
+            freq_mask(YY(positions[idx]),XX(positions[idx]))+=1;
         }
     }
 
@@ -556,13 +505,13 @@ void ProgCTFEstimateFromPSD::produceSideInfo()
     enhanced_ctftomodel() = ctftomodel();
     prm.applyFilter(enhanced_ctftomodel());
     CenterFFT(enhanced_ctftomodel(), false);
-    enhanced_ctftomodel().resize(global_w_digfreq);
+    enhanced_ctftomodel().resize(w_digfreq);
 
     // Divide by the number of count at each frequency
     // and mask between min_freq and max_freq
     double min_val = enhanced_ctftomodel().computeMin();
-    FOR_ALL_ELEMENTS_IN_ARRAY2D(global_mask)
-    if (global_mask(i, j) <= 0)
+    FOR_ALL_ELEMENTS_IN_ARRAY2D(freq_mask)
+    if (freq_mask(i, j) <= 0)
         enhanced_ctftomodel(i, j) = min_val;
     MultidimArray<double> aux;
     medianFilter3x3(enhanced_ctftomodel(), aux);
@@ -580,66 +529,66 @@ void ProgCTFEstimateFromPSD::produceSideInfo()
     STARTINGX(enhanced_ctftomodel()) = STARTINGY(enhanced_ctftomodel()) = 0;
 
     // Compute now radial average of the enhanced_ctftomodel
-    global_psd_exp_radial_derivative.initZeros(XSIZE(enhanced_ctftomodel()));
-    global_psd_theo_radial_derivative.initZeros(global_psd_exp_radial_derivative);
-    global_psd_exp_radial.initZeros(global_psd_exp_radial_derivative);
-    global_psd_theo_radial.initZeros(global_psd_exp_radial_derivative);
-    global_w_digfreq_r_iN.initZeros(global_psd_exp_radial_derivative);
+    psd_exp_radial_derivative.initZeros(XSIZE(enhanced_ctftomodel()));
+    psd_theo_radial_derivative.initZeros(psd_exp_radial_derivative);
+    psd_exp_radial.initZeros(psd_exp_radial_derivative);
+    psd_theo_radial.initZeros(psd_exp_radial_derivative);
+    w_digfreq_r_iN.initZeros(psd_exp_radial_derivative);
     FOR_ALL_ELEMENTS_IN_ARRAY2D(enhanced_ctftomodel())
     {
-        if (global_w_digfreq(i,j)>min_freq && global_w_digfreq(i,j)<max_freq)
+        if (w_digfreq(i,j)>min_freq && w_digfreq(i,j)<max_freq)
         {
-            int r = global_w_digfreq_r(i, j);
-            global_w_digfreq_r_iN(r)+=1;
-            global_psd_exp_radial(r) += enhanced_ctftomodel(i, j);
+            int r = w_digfreq_r(i, j);
+            w_digfreq_r_iN(r)+=1;
+            psd_exp_radial(r) += enhanced_ctftomodel(i, j);
         }
     }
-    FOR_ALL_ELEMENTS_IN_ARRAY1D(global_w_digfreq_r_iN)
-    if (global_w_digfreq_r_iN(i)>0)
+    FOR_ALL_ELEMENTS_IN_ARRAY1D(w_digfreq_r_iN)
+    if (w_digfreq_r_iN(i)>0)
     {
-        global_w_digfreq_r_iN(i)=1.0/global_w_digfreq_r_iN(i);
-        global_psd_exp_radial(i)*=global_w_digfreq_r_iN(i);
+        w_digfreq_r_iN(i)=1.0/w_digfreq_r_iN(i);
+        psd_exp_radial(i)*=w_digfreq_r_iN(i);
     }
 
     // Compute its derivative
     int state=0;
     double maxDiff=0;
-    FOR_ALL_ELEMENTS_IN_ARRAY1D(global_psd_exp_radial)
+    FOR_ALL_ELEMENTS_IN_ARRAY1D(psd_exp_radial)
     {
         switch (state)
         {
         case 0:
-            if (global_w_digfreq(i,0)>min_freq)
+            if (w_digfreq(i,0)>min_freq)
                 state=1;
             break;
         case 1:
             state=2; // Skip first sample
             break;
         case 2:
-            if (global_w_digfreq(i,0)>max_freq)
+            if (w_digfreq(i,0)>max_freq)
                 state=3;
             else
             {
-                double diff=global_psd_exp_radial(i)-global_psd_exp_radial(i-1);
-                global_psd_exp_radial_derivative(i)=diff;
+                double diff=psd_exp_radial(i)-psd_exp_radial(i-1);
+                psd_exp_radial_derivative(i)=diff;
                 maxDiff=std::max(maxDiff,fabs(diff));
             }
             break;
         }
     }
-    global_psd_exp_radial_derivative/=maxDiff;
+    psd_exp_radial_derivative/=maxDiff;
 }
 
 /* Generate model so far ---------------------------------------------------- */
-/* The model is taken from global_adjust and global_ctfmodel is modified */
-void generateModelSoFar(Image<double> &I, bool apply_log = false)
+/* The model is taken from adjust_params and current_ctfmodel is modified */
+void ProgCTFEstimateFromPSD::generateModelSoFar(Image<double> &I, bool apply_log)
 {
     Matrix1D<int> idx(2); // Indexes for Fourier plane
     Matrix1D<double> freq(2); // Frequencies for Fourier plane
 
-    assignCTFfromParameters(MATRIX1D_ARRAY(*global_adjust), global_ctfmodel,
-                            0, ALL_CTF_PARAMETERS, global_prm->modelSimplification);
-    global_ctfmodel.produceSideInfo();
+    assignCTFfromParameters(MATRIX1D_ARRAY(*adjust_params), current_ctfmodel,
+                            0, ALL_CTF_PARAMETERS, modelSimplification);
+    current_ctfmodel.produceSideInfo();
 
     I().initZeros(*f);
     FOR_ALL_ELEMENTS_IN_ARRAY2D(I())
@@ -648,27 +597,27 @@ void generateModelSoFar(Image<double> &I, bool apply_log = false)
         YY(idx) = i;
         FFT_idx2digfreq(*f, idx, freq);
         double w=freq.module();
-        if (w>global_max_freq)
+        if (w>max_freq_psd)
         	continue;
-        digfreq2contfreq(freq, freq, global_prm->Tm);
+        digfreq2contfreq(freq, freq, Tm);
 
         // Decide what to save
-        global_ctfmodel.precomputeValues(XX(freq), YY(freq));
-        if (global_action <= 1)
-            I()(i, j) = global_ctfmodel.getValueNoiseAt();
-        else if (global_action == 2)
+        current_ctfmodel.precomputeValues(XX(freq), YY(freq));
+        if (action <= 1)
+            I()(i, j) = current_ctfmodel.getValueNoiseAt();
+        else if (action == 2)
         {
-            double E = global_ctfmodel.getValueDampingAt();
-            I()(i, j) = global_ctfmodel.getValueNoiseAt() + E * E;
+            double E = current_ctfmodel.getValueDampingAt();
+            I()(i, j) = current_ctfmodel.getValueNoiseAt() + E * E;
         }
-        else if (global_action >= 3 && global_action <= 6)
+        else if (action >= 3 && action <= 6)
         {
-            double ctf = global_ctfmodel.getValuePureAt();
-            I()(i, j) = global_ctfmodel.getValueNoiseAt() + ctf * ctf;
+            double ctf = current_ctfmodel.getValuePureAt();
+            I()(i, j) = current_ctfmodel.getValueNoiseAt() + ctf * ctf;
         }
         else
         {
-            double ctf = global_ctfmodel.getValuePureAt();
+            double ctf = current_ctfmodel.getValuePureAt();
             I()(i, j) = ctf;
         }
         if (apply_log)
@@ -681,22 +630,21 @@ void generateModelSoFar(Image<double> &I, bool apply_log = false)
  of cuts along X and Y.
 
  This function returns the fitting error.*/
-void saveIntermediateResults(const FileName &fn_root, bool generate_profiles =
-                                 true)
+void ProgCTFEstimateFromPSD::saveIntermediateResults(const FileName &fn_root, bool generate_profiles)
 {
     std::ofstream plotX, plotY, plot_radial;
     Image<double> save;
     generateModelSoFar(save, false);
 
     Image<double> save_ctf;
-    global_prm->generate_model_halfplane(global_prm->ctfmodelSize,
-                                         global_prm->ctfmodelSize, save_ctf());
+    generate_model_halfplane(ctfmodelSize,
+                                         ctfmodelSize, save_ctf());
     if (fn_root.find("@")==std::string::npos)
         save_ctf.write(fn_root + "_ctfmodel_halfplane.xmp");
     else
         save_ctf.write(fn_root + "_ctfmodel_halfplane.stk");
-    global_prm->generate_model_quadrant(global_prm->ctfmodelSize,
-                                        global_prm->ctfmodelSize, save_ctf());
+    generate_model_quadrant(ctfmodelSize,
+                                        ctfmodelSize, save_ctf());
     if (fn_root.find("@")==std::string::npos)
         save_ctf.write(fn_root + "_ctfmodel_quadrant.xmp");
     else
@@ -726,11 +674,11 @@ void saveIntermediateResults(const FileName &fn_root, bool generate_profiles =
     // Generate cut along X
     for (int i = STARTINGY(save()); i <= FINISHINGY(save()) / 2; i++)
     {
-        if (global_mask(i, 0) <= 0)
+        if (freq_mask(i, 0) <= 0)
             continue;
-        plotY << global_w_digfreq(i, 0) << " " << global_w_contfreq(i, 0) << " "
+        plotY << w_digfreq(i, 0) << " " << w_contfreq(i, 0) << " "
         << save()(i, 0) << " " << (*f)(i, 0) << " "
-        << global_prm->enhanced_ctftomodel()(i, 0) << " "
+        << enhanced_ctftomodel()(i, 0) << " "
 		<< log10(save()(i, 0)) << " " << log10((*f)(i, 0))
 		<< std::endl;
     }
@@ -738,11 +686,11 @@ void saveIntermediateResults(const FileName &fn_root, bool generate_profiles =
     // Generate cut along Y
     for (int j = STARTINGX(save()); j <= FINISHINGX(save()) / 2; j++)
     {
-        if (global_mask(0, j) <= 0)
+        if (freq_mask(0, j) <= 0)
             continue;
-        plotX << global_w_digfreq(0, j) << " " << global_w_contfreq(0, j) << " "
+        plotX << w_digfreq(0, j) << " " << w_contfreq(0, j) << " "
         << save()(0, j) << " " << (*f)(0, j) << " "
-        << global_prm->enhanced_ctftomodel()(0, j)
+        << enhanced_ctftomodel()(0, j)
 		<< log10(save()(0, j)) << " " << log10((*f)(0, j))
 		<< std::endl;
     }
@@ -756,16 +704,16 @@ void saveIntermediateResults(const FileName &fn_root, bool generate_profiles =
     radial_enhanced_avg.initZeros(YSIZE(save()) / 2);
     radial_N.initZeros(YSIZE(save()) / 2);
 
-    FOR_ALL_ELEMENTS_IN_ARRAY2D(global_w_digfreq)
+    FOR_ALL_ELEMENTS_IN_ARRAY2D(w_digfreq)
     {
-        if (global_mask(i, j) <= 0)
+        if (freq_mask(i, j) <= 0)
             continue;
         double model2 = save()(i, j);
 
-        int r = global_w_digfreq_r(i, j);
+        int r = w_digfreq_r(i, j);
         radial_CTFmodel_avg(r) += model2;
         radial_CTFampl_avg(r) += (*f)(i, j);
-        radial_enhanced_avg(r) += global_prm->enhanced_ctftomodel()(i, j);
+        radial_enhanced_avg(r) += enhanced_ctftomodel()(i, j);
         radial_N(r)++;
     }
 
@@ -773,7 +721,7 @@ void saveIntermediateResults(const FileName &fn_root, bool generate_profiles =
     {
         if (radial_N(i) == 0)
             continue;
-        plot_radial << global_w_digfreq(i, 0) << " " << global_w_contfreq(i, 0)
+        plot_radial << w_digfreq(i, 0) << " " << w_contfreq(i, 0)
         << " " << radial_CTFmodel_avg(i) / radial_N(i) << " " << radial_CTFampl_avg(i) / radial_N(i) << " "
 		<< radial_enhanced_avg(i) / radial_N(i)
         << " " << log10(radial_CTFmodel_avg(i) / radial_N(i)) << " " << log10(radial_CTFampl_avg(i) / radial_N(i)) << " "
@@ -794,15 +742,15 @@ void ProgCTFEstimateFromPSD::generate_model_quadrant(int Ydim, int Xdim,
 
     // Compute the scaled PSD
     MultidimArray<double> enhancedPSD;
-    enhancedPSD = global_prm->enhanced_ctftomodel_fullsize();
+    enhancedPSD = enhanced_ctftomodel_fullsize();
     CenterFFT(enhancedPSD, false);
     selfScaleToSize(BSPLINE3, enhancedPSD, Ydim, Xdim);
     CenterFFT(enhancedPSD, true);
 
     // Generate the CTF model
-    assignCTFfromParameters(MATRIX1D_ARRAY(*global_adjust), global_ctfmodel,
-                            0, ALL_CTF_PARAMETERS, global_prm->modelSimplification);
-    global_ctfmodel.produceSideInfo();
+    assignCTFfromParameters(MATRIX1D_ARRAY(*adjust_params), current_ctfmodel,
+                            0, ALL_CTF_PARAMETERS, modelSimplification);
+    current_ctfmodel.produceSideInfo();
 
     // Write the two model quadrants
     MultidimArray<int> mask;
@@ -818,11 +766,11 @@ void ProgCTFEstimateFromPSD::generate_model_quadrant(int Ydim, int Xdim,
             YY(idx) = i;
             FFT_idx2digfreq(model, idx, freq);
             if (fabs(XX(freq))>0.03 && fabs(YY(freq))>0.03)
-                mask(i,j)=(int)global_mask(i,j);
-            digfreq2contfreq(freq, freq, global_prm->Tm);
+                mask(i,j)=(int)freq_mask(i,j);
+            digfreq2contfreq(freq, freq, Tm);
 
-            global_ctfmodel.precomputeValues(XX(freq), YY(freq));
-            model(i, j) = global_ctfmodel.getValuePureAt();
+            current_ctfmodel.precomputeValues(XX(freq), YY(freq));
+            model(i, j) = current_ctfmodel.getValuePureAt();
             model(i, j) *= model(i, j);
         }
     }
@@ -842,7 +790,7 @@ void ProgCTFEstimateFromPSD::generate_model_quadrant(int Ydim, int Xdim,
             YY(idx) = i;
             FFT_idx2digfreq(model, idx, freq);
             double w=freq.module();
-            if (w>global_max_freq)
+            if (w>max_freq_psd)
             	model(i,j)=0;
 
 		}
@@ -860,15 +808,15 @@ void ProgCTFEstimateFromPSD::generate_model_halfplane(int Ydim, int Xdim,
 
     // Compute the scaled PSD
     MultidimArray<double> enhancedPSD;
-    enhancedPSD = global_prm->enhanced_ctftomodel_fullsize();
+    enhancedPSD = enhanced_ctftomodel_fullsize();
     CenterFFT(enhancedPSD, false);
     selfScaleToSize(BSPLINE3, enhancedPSD, Ydim, Xdim);
     CenterFFT(enhancedPSD, true);
 
     // The left part is the CTF model
-    assignCTFfromParameters(MATRIX1D_ARRAY(*global_adjust), global_ctfmodel,
-                            0, CTF_PARAMETERS, global_prm->modelSimplification);
-    global_ctfmodel.produceSideInfo();
+    assignCTFfromParameters(MATRIX1D_ARRAY(*adjust_params), current_ctfmodel,
+                            0, CTF_PARAMETERS, modelSimplification);
+    current_ctfmodel.produceSideInfo();
 
     MultidimArray<int> mask;
     STARTINGX(enhancedPSD)=STARTINGY(enhancedPSD)=0;
@@ -883,14 +831,14 @@ void ProgCTFEstimateFromPSD::generate_model_halfplane(int Ydim, int Xdim,
         YY(idx) = i;
         FFT_idx2digfreq(model, idx, freq);
         double w=freq.module();
-        if (w>global_max_freq)
+        if (w>max_freq_psd)
         	continue;
         if (fabs(XX(freq))>0.03 && fabs(YY(freq))>0.03)
-            mask(i,j)=(int)global_mask(i,j);
-        digfreq2contfreq(freq, freq, global_prm->Tm);
+            mask(i,j)=(int)freq_mask(i,j);
+        digfreq2contfreq(freq, freq, Tm);
 
-        global_ctfmodel.precomputeValues(XX(freq), YY(freq));
-        model(i, j) = global_ctfmodel.getValuePureAt();
+        current_ctfmodel.precomputeValues(XX(freq), YY(freq));
+        model(i, j) = current_ctfmodel.getValuePureAt();
         model(i, j) *= model(i, j);
     }
 
@@ -910,19 +858,19 @@ void ProgCTFEstimateFromPSD::generate_model_halfplane(int Ydim, int Xdim,
 /* CTF fitness ------------------------------------------------------------- */
 /* This function measures the distance between the estimated CTF and the
  measured CTF */
-double CTF_fitness(double *p, void *)
+double ProgCTFEstimateFromPSD::CTF_fitness_object(double *p)
 {
     double retval;
 
     // Generate CTF model
-    switch (global_action)
+    switch (action)
     {
         // Remind that p is a vector whose first element is at index 1
     case 0:
         assignCTFfromParameters(p - FIRST_SQRT_PARAMETER + 1,
-                                global_ctfmodel, FIRST_SQRT_PARAMETER, SQRT_CTF_PARAMETERS,
-                                global_prm->modelSimplification);
-        if (global_show >= 2)
+                                current_ctfmodel, FIRST_SQRT_PARAMETER, SQRT_CTF_PARAMETERS,
+                                modelSimplification);
+        if (show_inf >= 2)
         {
             std::cout << "Input vector:";
             for (int i = 1; i <= SQRT_CTF_PARAMETERS; i++)
@@ -932,9 +880,9 @@ double CTF_fitness(double *p, void *)
         break;
     case 1:
             assignCTFfromParameters(p - FIRST_SQRT_PARAMETER + 1,
-                                    global_ctfmodel, FIRST_SQRT_PARAMETER,
-                                    BACKGROUND_CTF_PARAMETERS, global_prm->modelSimplification);
-        if (global_show >= 2)
+                                    current_ctfmodel, FIRST_SQRT_PARAMETER,
+                                    BACKGROUND_CTF_PARAMETERS, modelSimplification);
+        if (show_inf >= 2)
         {
             std::cout << "Input vector:";
             for (int i = 1; i <= BACKGROUND_CTF_PARAMETERS; i++)
@@ -944,9 +892,9 @@ double CTF_fitness(double *p, void *)
         break;
     case 2:
             assignCTFfromParameters(p - FIRST_ENVELOPE_PARAMETER + 1,
-                                    global_ctfmodel, FIRST_ENVELOPE_PARAMETER, ENVELOPE_PARAMETERS,
-                                    global_prm->modelSimplification);
-        if (global_show >= 2)
+                                    current_ctfmodel, FIRST_ENVELOPE_PARAMETER, ENVELOPE_PARAMETERS,
+                                    modelSimplification);
+        if (show_inf >= 2)
         {
             std::cout << "Input vector:";
             for (int i = 1; i <= ENVELOPE_PARAMETERS; i++)
@@ -956,10 +904,10 @@ double CTF_fitness(double *p, void *)
         break;
     case 3:
             assignCTFfromParameters(p - FIRST_DEFOCUS_PARAMETER + 1,
-                                    global_ctfmodel, FIRST_DEFOCUS_PARAMETER, DEFOCUS_PARAMETERS,
-                                    global_prm->modelSimplification);
-        global_psd_theo_radial_derivative.initZeros();
-        if (global_show >= 2)
+                                    current_ctfmodel, FIRST_DEFOCUS_PARAMETER, DEFOCUS_PARAMETERS,
+                                    modelSimplification);
+        psd_theo_radial_derivative.initZeros();
+        if (show_inf >= 2)
         {
             std::cout << "Input vector:";
             for (int i = 1; i <= DEFOCUS_PARAMETERS; i++)
@@ -968,10 +916,10 @@ double CTF_fitness(double *p, void *)
         }
         break;
     case 4:
-            assignCTFfromParameters(p - 0 + 1, global_ctfmodel, 0,
-                                    CTF_PARAMETERS, global_prm->modelSimplification);
-        global_psd_theo_radial.initZeros();
-        if (global_show >= 2)
+            assignCTFfromParameters(p - 0 + 1, current_ctfmodel, 0,
+                                    CTF_PARAMETERS, modelSimplification);
+        psd_theo_radial.initZeros();
+        if (show_inf >= 2)
         {
             std::cout << "Input vector:";
             for (int i = 1; i <= CTF_PARAMETERS; i++)
@@ -982,10 +930,10 @@ double CTF_fitness(double *p, void *)
     case 5:
     case 6:
     case 7:
-		assignCTFfromParameters(p - 0 + 1, global_ctfmodel, 0,
-								ALL_CTF_PARAMETERS, global_prm->modelSimplification);
-        global_psd_theo_radial.initZeros();
-        if (global_show >= 2)
+		assignCTFfromParameters(p - 0 + 1, current_ctfmodel, 0,
+								ALL_CTF_PARAMETERS, modelSimplification);
+        psd_theo_radial.initZeros();
+        if (show_inf >= 2)
         {
             std::cout << "Input vector:";
             for (int i = 1; i <= ALL_CTF_PARAMETERS; i++)
@@ -994,42 +942,42 @@ double CTF_fitness(double *p, void *)
         }
         break;
     }
-    global_ctfmodel.produceSideInfo();
-    if (global_show >= 2)
-        std::cout << "Model:\n" << global_ctfmodel << std::endl;
-    if (!global_ctfmodel.hasPhysicalMeaning())
+    current_ctfmodel.produceSideInfo();
+    if (show_inf >= 2)
+        std::cout << "Model:\n" << current_ctfmodel << std::endl;
+    if (!current_ctfmodel.hasPhysicalMeaning())
     {
-        if (global_show >= 2)
+        if (show_inf >= 2)
             std::cout << "Does not have physical meaning\n";
-        return global_heavy_penalization;
+        return heavy_penalization;
     }
-    if (global_action > 3
+    if (action > 3
         && (fabs(
-                (global_ctfmodel.DeltafU - global_ctfmodel_defoci.DeltafU)
-                / global_ctfmodel_defoci.DeltafU) > 0.2
+                (current_ctfmodel.DeltafU - ctfmodel_defoci.DeltafU)
+                / ctfmodel_defoci.DeltafU) > 0.2
             || fabs(
-                (global_ctfmodel.DeltafV
-                 - global_ctfmodel_defoci.DeltafV)
-                / global_ctfmodel_defoci.DeltafU) > 0.2))
+                (current_ctfmodel.DeltafV
+                 - ctfmodel_defoci.DeltafV)
+                / ctfmodel_defoci.DeltafU) > 0.2))
     {
-        if (global_show >= 2)
+        if (show_inf >= 2)
             std::cout << "Too large defocus\n";
-        return global_heavy_penalization;
+        return heavy_penalization;
     }
-    if (global_prm->initial_ctfmodel.DeltafU != 0 && global_action >= 3)
+    if (initial_ctfmodel.DeltafU != 0 && action >= 3)
     {
         // If there is an initial model, the true solution
         // cannot be too far
-        if (fabs(global_prm->initial_ctfmodel.DeltafU - global_ctfmodel.DeltafU) > global_prm->defocus_range ||
-            fabs(global_prm->initial_ctfmodel.DeltafV - global_ctfmodel.DeltafV) > global_prm->defocus_range)
+        if (fabs(initial_ctfmodel.DeltafU - current_ctfmodel.DeltafU) > defocus_range ||
+            fabs(initial_ctfmodel.DeltafV - current_ctfmodel.DeltafV) > defocus_range)
         {
-            if (global_show >= 2)
+            if (show_inf >= 2)
             {
-                std::cout << "Too far from hint: Initial (" << global_prm->initial_ctfmodel.DeltafU << "," << global_prm->initial_ctfmodel.DeltafV << ")"
-                << " current guess (" << global_ctfmodel.DeltafU << "," << global_ctfmodel.DeltafV << ") max allowed difference: "
-                << global_prm->defocus_range << std::endl;
+                std::cout << "Too far from hint: Initial (" << initial_ctfmodel.DeltafU << "," << initial_ctfmodel.DeltafV << ")"
+                << " current guess (" << current_ctfmodel.DeltafU << "," << current_ctfmodel.DeltafV << ") max allowed difference: "
+                << defocus_range << std::endl;
             }
-            return global_heavy_penalization;
+            return heavy_penalization;
         }
     }
 
@@ -1041,35 +989,35 @@ double CTF_fitness(double *p, void *)
     double enhanced_model = 0;
     double enhanced2 = 0;
     double model2 = 0;
-    double lowerLimit = 1.1 * global_min_freq;
-    double upperLimit = 0.9 * global_max_freq;
+    double lowerLimit = 1.1 * min_freq_psd;
+    double upperLimit = 0.9 * max_freq_psd;
     const MultidimArray<double>& local_enhanced_ctf =
-        global_prm->enhanced_ctftomodel();
-    global_psd_exp_radial.initZeros();
-    int XdimW=XSIZE(global_w_digfreq);
-    int YdimW=YSIZE(global_w_digfreq);
-    global_corr13=0;
+        enhanced_ctftomodel();
+    psd_exp_radial.initZeros();
+    int XdimW=XSIZE(w_digfreq);
+    int YdimW=YSIZE(w_digfreq);
+    corr13=0;
     for (int i = 0; i < YdimW; i +=
-             global_evaluation_reduction)
+             evaluation_reduction)
         for (int j = 0; j < XdimW; j +=
-                 global_evaluation_reduction)
+                 evaluation_reduction)
         {
-            if (DIRECT_A2D_ELEM(global_mask, i, j) <= 0)
+            if (DIRECT_A2D_ELEM(freq_mask, i, j) <= 0)
                 continue;
 
             // Compute each component
-            global_ctfmodel.precomputeValues(i, j);
-            double bg = global_ctfmodel.getValueNoiseAt();
+            current_ctfmodel.precomputeValues(i, j);
+            double bg = current_ctfmodel.getValueNoiseAt();
             double envelope=0, ctf_without_damping, ctf_with_damping=0;
             double ctf2_th=0;
-            switch (global_action)
+            switch (action)
             {
             case 0:
             case 1:
                 ctf2_th = bg;
                 break;
             case 2:
-                envelope = global_ctfmodel.getValueDampingAt();
+                envelope = current_ctfmodel.getValueDampingAt();
                 ctf2_th = bg + envelope * envelope;
                 break;
             case 3:
@@ -1077,9 +1025,9 @@ double CTF_fitness(double *p, void *)
             case 5:
             case 6:
             case 7:
-                envelope = global_ctfmodel.getValueDampingAt();
+                envelope = current_ctfmodel.getValueDampingAt();
                 ctf_without_damping =
-                    global_ctfmodel.getValuePureWithoutDampingAt();
+                    current_ctfmodel.getValuePureWithoutDampingAt();
                 ctf_with_damping = envelope * ctf_without_damping;
                 ctf2_th = bg + ctf_with_damping * ctf_with_damping;
                 break;
@@ -1089,34 +1037,34 @@ double CTF_fitness(double *p, void *)
             double ctf2 = DIRECT_A2D_ELEM(*f, i, j);
             double dist = 0;
             double ctf_with_damping2;
-            switch (global_action)
+            switch (action)
             {
             case 0:
             case 1:
                 dist = fabs(ctf2 - bg);
-                if (global_penalize && bg > ctf2
-                    && DIRECT_A2D_ELEM(global_w_digfreq, i, j)
-                    > global_max_gauss_freq)
-                    dist *= global_current_penalty;
+                if (penalize && bg > ctf2
+                    && DIRECT_A2D_ELEM(w_digfreq, i, j)
+                    > max_gauss_freq)
+                    dist *= current_penalty;
                 break;
             case 2:
                 dist = fabs(ctf2 - ctf2_th);
-                if (global_penalize && ctf2_th < ctf2
-                    && DIRECT_A2D_ELEM(global_w_digfreq, i, j)
-                    > global_max_gauss_freq)
-                    dist *= global_current_penalty;
+                if (penalize && ctf2_th < ctf2
+                    && DIRECT_A2D_ELEM(w_digfreq, i, j)
+                    > max_gauss_freq)
+                    dist *= current_penalty;
                 break;
             case 3:
             case 4:
             case 5:
             case 6:
             case 7:
-                if (DIRECT_A2D_ELEM(global_w_digfreq,i, j) < upperLimit
-                    && DIRECT_A2D_ELEM(global_w_digfreq,i, j) > lowerLimit)
+                if (DIRECT_A2D_ELEM(w_digfreq,i, j) < upperLimit
+                    && DIRECT_A2D_ELEM(w_digfreq,i, j) > lowerLimit)
                 {
-                    if  (global_action == 3 ||
-                         (global_action == 4 && DIRECT_A2D_ELEM(global_mask_between_zeroes,i,j) == 1) ||
-                         (global_action == 7 && DIRECT_A2D_ELEM(global_mask_between_zeroes,i,j) == 1))
+                    if  (action == 3 ||
+                         (action == 4 && DIRECT_A2D_ELEM(mask_between_zeroes,i,j) == 1) ||
+                         (action == 7 && DIRECT_A2D_ELEM(mask_between_zeroes,i,j) == 1))
                     {
                         double enhanced_ctf =
                             DIRECT_A2D_ELEM(local_enhanced_ctf, i, j);
@@ -1127,10 +1075,10 @@ double CTF_fitness(double *p, void *)
                         enhanced_avg += enhanced_ctf;
                         model_avg += ctf_with_damping2;
                         Ncorr++;
-                        if (global_action==3)
+                        if (action==3)
                         {
-                            int r = A2D_ELEM(global_w_digfreq_r,i, j);
-                            A1D_ELEM(global_psd_theo_radial,r) += ctf2_th;
+                            int r = A2D_ELEM(w_digfreq_r,i, j);
+                            A1D_ELEM(psd_theo_radial,r) += ctf2_th;
                         }
                     }
                 }
@@ -1150,17 +1098,17 @@ double CTF_fitness(double *p, void *)
                 //    env^2     env^2     env^2
                 break;
             }
-            distsum += dist * DIRECT_A2D_ELEM(global_mask,i,j);
+            distsum += dist * DIRECT_A2D_ELEM(freq_mask,i,j);
             N++;
         }
     if (N > 0)
         retval = distsum / N;
     else
-        retval = global_heavy_penalization;
-    if (global_show >=2)
+        retval = heavy_penalization;
+    if (show_inf >=2)
         std::cout << "Fitness1=" << retval << std::endl;
-    if ( (((global_action >= 3) && (global_action <= 4)) || (global_action == 7))
-         && (Ncorr > 0) && (global_prm->enhanced_weight != 0) )
+    if ( (((action >= 3) && (action <= 4)) || (action == 7))
+         && (Ncorr > 0) && (enhanced_weight != 0) )
     {
         model_avg /= Ncorr;
         enhanced_avg /= Ncorr;
@@ -1171,20 +1119,20 @@ double CTF_fitness(double *p, void *)
         double sigma2 = sqrt(fabs(model2 / Ncorr - model_avg * model_avg));
         double maxSigma = std::max(sigma1, sigma2);
         if (sigma1 < XMIPP_EQUAL_ACCURACY || sigma2 < XMIPP_EQUAL_ACCURACY
-            || (fabs(sigma1 - sigma2) / maxSigma > 0.9 && global_action>=5))
+            || (fabs(sigma1 - sigma2) / maxSigma > 0.9 && action>=5))
         {
-            retval = global_heavy_penalization;
-            if (global_show>=2)
-                std::cout << "Fitness2=" << global_heavy_penalization << " sigma1=" << sigma1 << " sigma2=" << sigma2 << std::endl;
+            retval = heavy_penalization;
+            if (show_inf>=2)
+                std::cout << "Fitness2=" << heavy_penalization << " sigma1=" << sigma1 << " sigma2=" << sigma2 << std::endl;
         }
         else
         {
             correlation_coeff /= sigma1 * sigma2;
-            if (global_action == 7)
-                global_corr13 = correlation_coeff;
+            if (action == 7)
+                corr13 = correlation_coeff;
             else
-                retval -= global_prm->enhanced_weight * correlation_coeff;
-            if (global_show >= 2)
+                retval -= enhanced_weight * correlation_coeff;
+            if (show_inf >= 2)
             {
                 std::cout << "model_avg=" << model_avg << std::endl;
                 std::cout << "enhanced_avg=" << enhanced_avg << std::endl;
@@ -1193,24 +1141,24 @@ double CTF_fitness(double *p, void *)
                 std::cout << "sigma1=" << sigma1 << std::endl;
                 std::cout << "sigma2=" << sigma2 << std::endl;
                 std::cout << "Fitness2="
-                << -(global_prm->enhanced_weight * correlation_coeff)
+                << -(enhanced_weight * correlation_coeff)
                 << " (" << correlation_coeff << ")" << std::endl;
             }
         }
 
         // Correlation of the derivative of the radial profile
-        if (global_action==3 || global_evaluation_reduction==1)
+        if (action==3 || evaluation_reduction==1)
         {
             int state=0;
             double maxDiff=0;
-            global_psd_theo_radial_derivative.initZeros();
-            double lowerlimt=1.1*global_prm->min_freq;
-            double upperlimit=0.9*global_prm->max_freq;
-            FOR_ALL_ELEMENTS_IN_ARRAY1D(global_psd_theo_radial)
-            if (A1D_ELEM(global_w_digfreq_r_iN,i)>0)
+            psd_theo_radial_derivative.initZeros();
+            double lowerlimt=1.1*min_freq;
+            double upperlimit=0.9*max_freq;
+            FOR_ALL_ELEMENTS_IN_ARRAY1D(psd_theo_radial)
+            if (A1D_ELEM(w_digfreq_r_iN,i)>0)
             {
-                A1D_ELEM(global_psd_theo_radial,i)*=A1D_ELEM(global_w_digfreq_r_iN,i);
-                double freq=A2D_ELEM(global_w_digfreq,i,0);
+                A1D_ELEM(psd_theo_radial,i)*=A1D_ELEM(w_digfreq_r_iN,i);
+                double freq=A2D_ELEM(w_digfreq,i,0);
                 switch (state)
                 {
                 case 0:
@@ -1222,8 +1170,8 @@ double CTF_fitness(double *p, void *)
                         state=2;
                     else
                     {
-                        double diff=A1D_ELEM(global_psd_theo_radial,i)-A1D_ELEM(global_psd_theo_radial,i-1);
-                        A1D_ELEM(global_psd_theo_radial_derivative,i)=diff;
+                        double diff=A1D_ELEM(psd_theo_radial,i)-A1D_ELEM(psd_theo_radial,i-1);
+                        A1D_ELEM(psd_theo_radial_derivative,i)=diff;
                         maxDiff=std::max(maxDiff,fabs(diff));
                     }
                     break;
@@ -1231,11 +1179,11 @@ double CTF_fitness(double *p, void *)
             }
             double corrRadialDerivative=0,mux=0, muy=0, Ncorr=0, sigmax=0, sigmay=0;
             double iMaxDiff=1.0/maxDiff;
-            FOR_ALL_ELEMENTS_IN_ARRAY1D(global_psd_theo_radial)
+            FOR_ALL_ELEMENTS_IN_ARRAY1D(psd_theo_radial)
             {
-                A1D_ELEM(global_psd_theo_radial_derivative,i)*=iMaxDiff;
-                double x=A1D_ELEM(global_psd_exp_radial_derivative,i);
-                double y=A1D_ELEM(global_psd_theo_radial_derivative,i);
+                A1D_ELEM(psd_theo_radial_derivative,i)*=iMaxDiff;
+                double x=A1D_ELEM(psd_exp_radial_derivative,i);
+                double y=A1D_ELEM(psd_theo_radial_derivative,i);
                 corrRadialDerivative+=x*y;
                 mux+=x;
                 muy+=y;
@@ -1254,25 +1202,25 @@ double CTF_fitness(double *p, void *)
                 corrRadialDerivative=(corrRadialDerivative-mux*muy)/(sigmax*sigmay);
             }
             retval-=corrRadialDerivative;
-            if (global_show>=2)
+            if (show_inf>=2)
             {
                 std::cout << "Fitness3=" << -corrRadialDerivative << std::endl;
-                if (global_show==3)
+                if (show_inf==3)
                 {
-                    global_psd_exp_radial.write("PPPexpRadial.txt");
-                    global_psd_theo_radial.write("PPPtheoRadial.txt");
-                    global_psd_exp_radial_derivative.write("PPPexpRadialDerivative.txt");
-                    global_psd_theo_radial_derivative.write("PPPtheoRadialDerivative.txt");
+                    psd_exp_radial.write("PPPexpRadial.txt");
+                    psd_theo_radial.write("PPPtheoRadial.txt");
+                    psd_exp_radial_derivative.write("PPPexpRadialDerivative.txt");
+                    psd_theo_radial_derivative.write("PPPtheoRadialDerivative.txt");
                 }
             }
         }
     }
 
     // Show some debugging information
-    if (global_show >= 2)
+    if (show_inf >= 2)
     {
         std::cout << "Fitness=" << retval << std::endl;
-        if (global_show == 3)
+        if (show_inf == 3)
         {
             saveIntermediateResults("PPP");
             std::cout << "Press any key\n";
@@ -1284,66 +1232,70 @@ double CTF_fitness(double *p, void *)
     return retval;
 }
 
+double CTF_fitness(double *p, void *vprm)
+{
+    return ((ProgCTFEstimateFromPSD *) vprm)->CTF_fitness_object(p);
+}
+
 /* Compute central region -------------------------------------------------- */
-void compute_central_region(double &w1, double &w2, double ang)
+void ProgCTFEstimateFromPSD::compute_central_region(double &w1, double &w2, double ang)
 {
-    w1 = global_max_freq;
-    w2 = global_min_freq;
+    w1 = max_freq_psd;
+    w2 = min_freq_psd;
     Matrix1D<double> freq(2), dir(2);
 
     // Compute first and third zero in the given direction
     VECTOR_R2(dir, COSD(ang), SIND(ang));
 
     // Detect first zero
-    global_ctfmodel.lookFor(1, dir, freq, 0);
+    current_ctfmodel.lookFor(1, dir, freq, 0);
     if (XX(freq) == -1 && YY(freq) == -1)
-        w1 = global_min_freq;
+        w1 = min_freq_psd;
     else
     {
-        contfreq2digfreq(freq, freq, global_prm->Tm);
+        contfreq2digfreq(freq, freq, Tm);
         double w;
         if (XX(dir) > 0.1)
             w = XX(freq) / XX(dir);
         else
             w = YY(freq) / YY(dir);
-        w1 = XMIPP_MAX(global_min_freq, XMIPP_MIN(w1, w));
+        w1 = XMIPP_MAX(min_freq_psd, XMIPP_MIN(w1, w));
     }
 
     // Detect fifth zero
-    global_ctfmodel.lookFor(5, dir, freq, 0);
+    current_ctfmodel.lookFor(5, dir, freq, 0);
     if (XX(freq) == -1 && YY(freq) == -1)
-        w2 = global_max_freq;
+        w2 = max_freq_psd;
     else
     {
         double w;
-        contfreq2digfreq(freq, freq, global_prm->Tm);
+        contfreq2digfreq(freq, freq, Tm);
         if (XX(dir) > 0.1)
             w = XX(freq) / XX(dir);
         else
             w = YY(freq) / YY(dir);
-        w2 = XMIPP_MIN(global_max_freq, XMIPP_MAX(w2, w));
+        w2 = XMIPP_MIN(max_freq_psd, XMIPP_MAX(w2, w));
     }
 }
 
 /* Center focus ----------------------------------------------------------- */
-void center_optimization_focus(bool adjust_freq, bool adjust_th, double margin =
-                                   1)
+void ProgCTFEstimateFromPSD::center_optimization_focus(bool adjust_freq, bool adjust_th, double margin)
 {
-    if (global_prm->show_optimization)
-        std::cout << "Freq frame before focusing=" << global_min_freq << ","
-        << global_max_freq << std::endl << "Value_th before focusing="
-        << global_value_th << std::endl;
+    if (show_optimization)
+        std::cout << "Freq frame before focusing=" << min_freq_psd << ","
+        << max_freq_psd << std::endl << "Value_th before focusing="
+        << value_th << std::endl;
 
-    double w1 = global_min_freq, w2 = global_max_freq;
+    double w1 = min_freq_psd, w2 = max_freq_psd;
     if (adjust_freq)
     {
         double w1U, w2U, w1V, w2V;
-        compute_central_region(w1U, w2U, global_ctfmodel.azimuthal_angle);
-        compute_central_region(w1V, w2V, global_ctfmodel.azimuthal_angle + 90);
+        compute_central_region(w1U, w2U, current_ctfmodel.azimuthal_angle);
+        compute_central_region(w1V, w2V, current_ctfmodel.azimuthal_angle + 90);
         w1 = XMIPP_MIN(w1U, w1V);
         w2 = XMIPP_MAX(w2U, w2V);
-        global_min_freq = XMIPP_MAX(global_min_freq, w1 - 0.05);
-        global_max_freq = XMIPP_MIN(global_max_freq, w2 + 0.01);
+        min_freq_psd = XMIPP_MAX(min_freq_psd, w1 - 0.05);
+        max_freq_psd = XMIPP_MIN(max_freq_psd, w2 + 0.01);
     }
 
     // Compute maximum value within central region
@@ -1352,66 +1304,66 @@ void center_optimization_focus(bool adjust_freq, bool adjust_th, double margin =
         Image<double> save;
         generateModelSoFar(save);
         double max_val = 0;
-        FOR_ALL_ELEMENTS_IN_ARRAY2D(global_w_digfreq)
+        FOR_ALL_ELEMENTS_IN_ARRAY2D(w_digfreq)
         {
-            double w = global_w_digfreq(i, j);
+            double w = w_digfreq(i, j);
             if (w >= w1 && w <= w2)
                 max_val = XMIPP_MAX(max_val, save()(i, j));
         }
-        if (global_value_th != -1)
-            global_value_th = XMIPP_MIN(global_value_th, max_val * margin);
+        if (value_th != -1)
+            value_th = XMIPP_MIN(value_th, max_val * margin);
         else
-            global_value_th = max_val * margin;
+            value_th = max_val * margin;
     }
 
-    if (global_prm->show_optimization)
-        std::cout << "Freq frame after focusing=" << global_min_freq << ","
-        << global_max_freq << std::endl << "Value_th after focusing="
-        << global_value_th << std::endl;
+    if (show_optimization)
+        std::cout << "Freq frame after focusing=" << min_freq_psd << ","
+        << max_freq_psd << std::endl << "Value_th after focusing="
+        << value_th << std::endl;
 }
 
 // Estimate sqrt parameters ------------------------------------------------
-// Results are written in global_ctfmodel
-void estimate_background_sqrt_parameters()
+// Results are written in current_ctfmodel
+void ProgCTFEstimateFromPSD::estimate_background_sqrt_parameters()
 {
-    if (global_prm->show_optimization)
+    if (show_optimization)
         std::cout << "Computing first sqrt background ...\n";
 
     // Estimate the base line taking the value of the CTF
     // for the maximum X and Y frequencies
     double base_line = 0;
     int N = 0;
-    FOR_ALL_ELEMENTS_IN_ARRAY2D(global_w_digfreq)
-    if (global_w_digfreq(i, j) > 0.4)
+    FOR_ALL_ELEMENTS_IN_ARRAY2D(w_digfreq)
+    if (w_digfreq(i, j) > 0.4)
     {
         N++;
         base_line += (*f)(i, j);
     }
-    global_ctfmodel.base_line = base_line / N;
+    current_ctfmodel.base_line = base_line / N;
 
     // Find the linear least squares solution for the sqrt part
     Matrix2D<double> A(2, 2);
     A.initZeros();
     Matrix1D<double> b(2);
     b.initZeros();
-    FOR_ALL_ELEMENTS_IN_ARRAY2D(global_w_digfreq)
+    FOR_ALL_ELEMENTS_IN_ARRAY2D(w_digfreq)
     {
-        if (global_mask(i, j) <= 0)
+        if (freq_mask(i, j) <= 0)
             continue;
 
         // Compute weight for this point
-        double weight = 1 + global_max_freq - global_w_digfreq(i, j);
+        double weight = 1 + max_freq_psd - w_digfreq(i, j);
 
         // Compute error
-        global_ctfmodel.precomputeValues(global_x_contfreq(i, j),
-                                         global_y_contfreq(i, j));
-        double explained = global_ctfmodel.getValueNoiseAt();
+        current_ctfmodel.precomputeValues(x_contfreq(i, j),
+                                         y_contfreq(i, j));
+        double explained = current_ctfmodel.getValueNoiseAt();
         double unexplained = (*f)(i, j) - explained;
         if (unexplained <= 0)
             continue;
         unexplained = log(unexplained);
 
-        double X = -sqrt(global_w_contfreq(i, j));
+        double X = -sqrt(w_contfreq(i, j));
         A(0, 0) += weight * X * X;
         A(0, 1) += weight * X;
         A(1, 1) += weight * 1;
@@ -1422,15 +1374,15 @@ void estimate_background_sqrt_parameters()
 
     b = A.inv() * b;
 
-    global_ctfmodel.sqU = global_ctfmodel.sqV = b(0);
-    global_ctfmodel.sqrt_K = exp(b(1));
-    global_ctfmodel.sqrt_angle = 0;
+    current_ctfmodel.sqU = current_ctfmodel.sqV = b(0);
+    current_ctfmodel.sqrt_K = exp(b(1));
+    current_ctfmodel.sqrt_angle = 0;
 
     COPY_ctfmodel_TO_CURRENT_GUESS;
 
-    if (global_prm->show_optimization)
+    if (show_optimization)
     {
-        std::cout << "First SQRT Fit:\n" << global_ctfmodel << std::endl;
+        std::cout << "First SQRT Fit:\n" << current_ctfmodel << std::endl;
         saveIntermediateResults("step01a_first_sqrt_fit");
     }
 
@@ -1441,39 +1393,39 @@ void estimate_background_sqrt_parameters()
     steps.initConstant(1);
 
     // Optimize without penalization
-    if (global_prm->show_optimization)
+    if (show_optimization)
         std::cout << "Looking for best fitting sqrt ...\n";
-    global_penalize = false;
+    penalize = false;
     int iter;
-    powellOptimizer(*global_adjust, FIRST_SQRT_PARAMETER + 1,
-                    SQRT_CTF_PARAMETERS, &CTF_fitness, NULL, 0.05, fitness, iter, steps,
-                    global_prm->show_optimization);
+    powellOptimizer(*adjust_params, FIRST_SQRT_PARAMETER + 1,
+                    SQRT_CTF_PARAMETERS, &CTF_fitness, this, 0.05, fitness, iter, steps,
+                    show_optimization);
 
     // Optimize with penalization
-    if (global_prm->show_optimization)
+    if (show_optimization)
         std::cout << "Penalizing best fitting sqrt ...\n";
-    global_penalize = true;
-    global_current_penalty = 2;
+    penalize = true;
+    current_penalty = 2;
     int imax = CEIL(log(global_penalty) / log(2.0));
     for (int i = 1; i <= imax; i++)
     {
-        if (global_prm->show_optimization)
+        if (show_optimization)
             std::cout << "     Iteration " << i << " penalty="
-            << global_current_penalty << std::endl;
-        powellOptimizer(*global_adjust, FIRST_SQRT_PARAMETER + 1,
-                        SQRT_CTF_PARAMETERS, &CTF_fitness, NULL, 0.05, fitness, iter,
-                        steps, global_prm->show_optimization);
-        global_current_penalty *= 2;
-        global_current_penalty =
-            XMIPP_MIN(global_current_penalty, global_penalty);
-    }
-    // Keep the result in global_prm->adjust
-    global_ctfmodel.forcePhysicalMeaning();
+            << current_penalty << std::endl;
+        powellOptimizer(*adjust_params, FIRST_SQRT_PARAMETER + 1,
+                        SQRT_CTF_PARAMETERS, &CTF_fitness, this, 0.05, fitness, iter,
+                        steps, show_optimization);
+        current_penalty *= 2;
+        current_penalty =
+            XMIPP_MIN(current_penalty, global_penalty);
+    }
+    // Keep the result in adjust
+    current_ctfmodel.forcePhysicalMeaning();
     COPY_ctfmodel_TO_CURRENT_GUESS;
 
-    if (global_prm->show_optimization)
+    if (show_optimization)
     {
-        std::cout << "Best penalized SQRT Fit:\n" << global_ctfmodel
+        std::cout << "Best penalized SQRT Fit:\n" << current_ctfmodel
         << std::endl;
         saveIntermediateResults("step01b_best_penalized_sqrt_fit");
     }
@@ -1483,10 +1435,10 @@ void estimate_background_sqrt_parameters()
 
 // Estimate gaussian parameters --------------------------------------------
 //#define DEBUG
-void estimate_background_gauss_parameters()
+void ProgCTFEstimateFromPSD::estimate_background_gauss_parameters()
 {
 
-    if (global_prm->show_optimization)
+    if (show_optimization)
         std::cout << "Computing first background Gaussian parameters ...\n";
 
     // Compute radial averages
@@ -1494,18 +1446,18 @@ void estimate_background_gauss_parameters()
     MultidimArray<double> radial_CTFampl_avg(YSIZE(*f) / 2);
     MultidimArray<int> radial_N(YSIZE(*f) / 2);
     double w_max_gauss = 0.25;
-    FOR_ALL_ELEMENTS_IN_ARRAY2D(global_w_digfreq)
+    FOR_ALL_ELEMENTS_IN_ARRAY2D(w_digfreq)
     {
-        if (global_mask(i, j) <= 0)
+        if (freq_mask(i, j) <= 0)
             continue;
-        double w = global_w_digfreq(i, j);
+        double w = w_digfreq(i, j);
         if (w > w_max_gauss)
             continue;
 
         int r = FLOOR(w * (double)YSIZE(*f));
-        global_ctfmodel.precomputeValues(global_x_contfreq(i, j),
-                                         global_y_contfreq(i, j));
-        radial_CTFmodel_avg(r) += global_ctfmodel.getValueNoiseAt();
+        current_ctfmodel.precomputeValues(x_contfreq(i, j),
+                                         y_contfreq(i, j));
+        radial_CTFmodel_avg(r) += current_ctfmodel.getValueNoiseAt();
         radial_CTFampl_avg(r) += (*f)(i, j);
         radial_N(r)++;
     }
@@ -1539,7 +1491,7 @@ void estimate_background_gauss_parameters()
     {
         if (radial_N(i) == 0)
             continue;
-        double w = global_w_digfreq(i, 0);
+        double w = w_digfreq(i, 0);
 
         if (error(i) < 0 && first)
             continue;
@@ -1575,7 +1527,7 @@ void estimate_background_gauss_parameters()
     }
 
     // Compute the frequency of the minimum error
-    global_max_gauss_freq = wmin;
+    max_gauss_freq = wmin;
 #ifdef DEBUG
 
     std::cout << "Freq of the minimum error: " << wmin << " " << fmin << std::endl;
@@ -1588,7 +1540,7 @@ void estimate_background_gauss_parameters()
     {
         if (radial_N(i) == 0)
             continue;
-        double w = global_w_digfreq(i, 0);
+        double w = w_digfreq(i, 0);
         if (w > wmin)
             continue;
 
@@ -1613,7 +1565,7 @@ void estimate_background_gauss_parameters()
 #endif
 
     }
-    fmax = global_ctfmodel.cV = global_ctfmodel.cU = wmax / global_prm->Tm;
+    fmax = current_ctfmodel.cV = current_ctfmodel.cU = wmax / Tm;
 #ifdef DEBUG
 
     std::cout << "Freq of the maximum error: " << wmax << " " << fmax << std::endl;
@@ -1625,21 +1577,21 @@ void estimate_background_gauss_parameters()
     Matrix1D<double> b(2);
     b.initZeros();
 
-    FOR_ALL_ELEMENTS_IN_ARRAY2D(global_w_digfreq)
+    FOR_ALL_ELEMENTS_IN_ARRAY2D(w_digfreq)
     {
-        if (global_mask(i, j) <= 0)
+        if (freq_mask(i, j) <= 0)
             continue;
-        if (global_w_digfreq(i, j) > wmin)
+        if (w_digfreq(i, j) > wmin)
             continue;
-        double fmod = global_w_contfreq(i, j);
+        double fmod = w_contfreq(i, j);
 
         // Compute weight for this point
-        double weight = 1 + global_max_freq - global_w_digfreq(i, j);
+        double weight = 1 + max_freq_psd - w_digfreq(i, j);
 
         // Compute error
-        global_ctfmodel.precomputeValues(global_x_contfreq(i, j),
-                                         global_y_contfreq(i, j));
-        double explained = global_ctfmodel.getValueNoiseAt();
+        current_ctfmodel.precomputeValues(x_contfreq(i, j),
+                                         y_contfreq(i, j));
+        double explained = current_ctfmodel.getValueNoiseAt();
 
         double unexplained = (*f)(i, j) - explained;
         if (unexplained <= 0)
@@ -1662,17 +1614,17 @@ void estimate_background_gauss_parameters()
     else
     {
         b = A.inv() * b;
-        global_ctfmodel.sigmaU = XMIPP_MIN(fabs(b(1)), 95e3); // This value should be
-        global_ctfmodel.sigmaV = XMIPP_MIN(fabs(b(1)), 95e3); // conformant with the physical
+        current_ctfmodel.sigmaU = XMIPP_MIN(fabs(b(1)), 95e3); // This value should be
+        current_ctfmodel.sigmaV = XMIPP_MIN(fabs(b(1)), 95e3); // conformant with the physical
         // meaning routine in CTF.cc
-        global_ctfmodel.gaussian_K = exp(b(0));
-        // Store the CTF values in global_prm->adjust
-        global_ctfmodel.forcePhysicalMeaning();
+        current_ctfmodel.gaussian_K = exp(b(0));
+        // Store the CTF values in adjust
+        current_ctfmodel.forcePhysicalMeaning();
         COPY_ctfmodel_TO_CURRENT_GUESS;
 
-        if (global_prm->show_optimization)
+        if (show_optimization)
         {
-            std::cout << "First Background Fit:\n" << global_ctfmodel << std::endl;
+            std::cout << "First Background Fit:\n" << current_ctfmodel << std::endl;
             saveIntermediateResults("step01c_first_background_fit");
         }
         center_optimization_focus(false, true, 1.5);
@@ -1682,9 +1634,9 @@ void estimate_background_gauss_parameters()
 
 // Estimate second gaussian parameters -------------------------------------
 //#define DEBUG
-void estimate_background_gauss_parameters2()
+void ProgCTFEstimateFromPSD::estimate_background_gauss_parameters2()
 {
-    if (global_prm->show_optimization)
+    if (show_optimization)
         std::cout << "Computing first background Gaussian2 parameters ...\n";
 
     // Compute radial averages
@@ -1692,22 +1644,22 @@ void estimate_background_gauss_parameters2()
     MultidimArray<double> radial_CTFampl_avg(YSIZE(*f) / 2);
     MultidimArray<int> radial_N(YSIZE(*f) / 2);
     double w_max_gauss = 0.25;
-    FOR_ALL_ELEMENTS_IN_ARRAY2D(global_w_digfreq)
+    FOR_ALL_ELEMENTS_IN_ARRAY2D(w_digfreq)
     {
-        if (global_mask(i, j) <= 0)
+        if (freq_mask(i, j) <= 0)
             continue;
-        double w = global_w_digfreq(i, j);
+        double w = w_digfreq(i, j);
         if (w > w_max_gauss)
             continue;
 
         int r = FLOOR(w * (double)YSIZE(*f));
-        double f_x = DIRECT_A2D_ELEM(global_x_contfreq, i, j);
-        double f_y = DIRECT_A2D_ELEM(global_y_contfreq, i, j);
-        global_ctfmodel.precomputeValues(f_x, f_y);
-        double bg = global_ctfmodel.getValueNoiseAt();
-        double envelope = global_ctfmodel.getValueDampingAt();
+        double f_x = DIRECT_A2D_ELEM(x_contfreq, i, j);
+        double f_y = DIRECT_A2D_ELEM(y_contfreq, i, j);
+        current_ctfmodel.precomputeValues(f_x, f_y);
+        double bg = current_ctfmodel.getValueNoiseAt();
+        double envelope = current_ctfmodel.getValueDampingAt();
         double ctf_without_damping =
-            global_ctfmodel.getValuePureWithoutDampingAt();
+            current_ctfmodel.getValuePureWithoutDampingAt();
         double ctf_with_damping = envelope * ctf_without_damping;
         double ctf2_th = bg + ctf_with_damping * ctf_with_damping;
         radial_CTFmodel_avg(r) += ctf2_th;
@@ -1738,7 +1690,7 @@ void estimate_background_gauss_parameters2()
     {
         if (radial_N(i) == 0)
             continue;
-        double w = global_w_digfreq(i, 0);
+        double w = w_digfreq(i, 0);
         if (w > wmin)
             break;
         if (error(i) < error_max)
@@ -1747,7 +1699,7 @@ void estimate_background_gauss_parameters2()
             error_max = error(i);
         }
     }
-    fmax = global_ctfmodel.cV2 = global_ctfmodel.cU2 = wmax / global_prm->Tm;
+    fmax = current_ctfmodel.cV2 = current_ctfmodel.cU2 = wmax / Tm;
 #ifdef DEBUG
 
     std::cout << "Freq of the maximum error: " << wmax << " " << fmax << std::endl;
@@ -1759,33 +1711,33 @@ void estimate_background_gauss_parameters2()
     Matrix1D<double> b(2);
     b.initZeros();
     int N = 0;
-    FOR_ALL_ELEMENTS_IN_ARRAY2D(global_w_digfreq)
+    FOR_ALL_ELEMENTS_IN_ARRAY2D(w_digfreq)
     {
-        if (global_mask(i, j) <= 0)
+        if (freq_mask(i, j) <= 0)
             continue;
-        if (global_w_digfreq(i, j) > wmin)
+        if (w_digfreq(i, j) > wmin)
             continue;
-        double fmod = global_w_contfreq(i, j);
+        double fmod = w_contfreq(i, j);
 
         // Compute the zero on the direction of this point
         Matrix1D<double> u(2), fzero(2);
-        XX(u) = global_x_contfreq(i, j) / fmod;
-        YY(u) = global_y_contfreq(i, j) / fmod;
-        global_ctfmodel.lookFor(1, u, fzero, 0);
+        XX(u) = x_contfreq(i, j) / fmod;
+        YY(u) = y_contfreq(i, j) / fmod;
+        current_ctfmodel.lookFor(1, u, fzero, 0);
         if (fmod > fzero.module())
             continue;
 
         // Compute weight for this point
-        double weight = 1 + global_max_freq - global_w_digfreq(i, j);
+        double weight = 1 + max_freq_psd - w_digfreq(i, j);
 
         // Compute error
-        double f_x = DIRECT_A2D_ELEM(global_x_contfreq, i, j);
-        double f_y = DIRECT_A2D_ELEM(global_y_contfreq, i, j);
-        global_ctfmodel.precomputeValues(f_x, f_y);
-        double bg = global_ctfmodel.getValueNoiseAt();
-        double envelope = global_ctfmodel.getValueDampingAt();
+        double f_x = DIRECT_A2D_ELEM(x_contfreq, i, j);
+        double f_y = DIRECT_A2D_ELEM(y_contfreq, i, j);
+        current_ctfmodel.precomputeValues(f_x, f_y);
+        double bg = current_ctfmodel.getValueNoiseAt();
+        double envelope = current_ctfmodel.getValueDampingAt();
         double ctf_without_damping =
-            global_ctfmodel.getValuePureWithoutDampingAt();
+            current_ctfmodel.getValuePureWithoutDampingAt();
         double ctf_with_damping = envelope * ctf_without_damping;
         double ctf2_th = bg + ctf_with_damping * ctf_with_damping;
         double explained = ctf2_th;
@@ -1810,51 +1762,51 @@ void estimate_background_gauss_parameters2()
         if (fabs(det)>1e-9)
         {
             b = A.inv() * b;
-            global_ctfmodel.sigmaU2 = XMIPP_MIN(fabs(b(1)), 95e3); // This value should be
-            global_ctfmodel.sigmaV2 = XMIPP_MIN(fabs(b(1)), 95e3); // conformant with the physical
+            current_ctfmodel.sigmaU2 = XMIPP_MIN(fabs(b(1)), 95e3); // This value should be
+            current_ctfmodel.sigmaV2 = XMIPP_MIN(fabs(b(1)), 95e3); // conformant with the physical
             // meaning routine in CTF.cc
-            global_ctfmodel.gaussian_K2 = exp(b(0));
+            current_ctfmodel.gaussian_K2 = exp(b(0));
         }
         else
         {
-            global_ctfmodel.sigmaU2 = global_ctfmodel.sigmaV2 = 0;
-            global_ctfmodel.gaussian_K2 = 0;
+            current_ctfmodel.sigmaU2 = current_ctfmodel.sigmaV2 = 0;
+            current_ctfmodel.gaussian_K2 = 0;
         }
     }
     else
     {
-        global_ctfmodel.sigmaU2 = global_ctfmodel.sigmaV2 = 0;
-        global_ctfmodel.gaussian_K2 = 0;
+        current_ctfmodel.sigmaU2 = current_ctfmodel.sigmaV2 = 0;
+        current_ctfmodel.gaussian_K2 = 0;
     }
 
-    // Store the CTF values in global_prm->adjust
-    global_ctfmodel.forcePhysicalMeaning();
+    // Store the CTF values in adjust
+    current_ctfmodel.forcePhysicalMeaning();
     COPY_ctfmodel_TO_CURRENT_GUESS;
 
 #ifdef DEBUG
     // Check
-    FOR_ALL_ELEMENTS_IN_ARRAY2D(global_w_digfreq)
+    FOR_ALL_ELEMENTS_IN_ARRAY2D(w_digfreq)
     {
-        if (global_mask(i, j)<=0)
+        if (freq_mask(i, j)<=0)
             continue;
-        if (global_w_digfreq(i, j) > wmin)
+        if (w_digfreq(i, j) > wmin)
             continue;
-        double fmod = global_w_contfreq(i, j);
+        double fmod = w_contfreq(i, j);
 
         // Compute the zero on the direction of this point
         Matrix1D<double> u(2), fzero(2);
-        XX(u) = global_x_contfreq(i, j) / fmod;
-        YY(u) = global_y_contfreq(i, j) / fmod;
-        global_ctfmodel.zero(1, u, fzero);
+        XX(u) = x_contfreq(i, j) / fmod;
+        YY(u) = y_contfreq(i, j) / fmod;
+        current_ctfmodel.zero(1, u, fzero);
         if (fmod > fzero.module())
             continue;
 
         // Compute error
-        double f_x = DIRECT_A2D_ELEM(global_x_contfreq, i, j);
-        double f_y = DIRECT_A2D_ELEM(global_y_contfreq, i, j);
-        double bg = global_ctfmodel.getValueNoiseAt(f_x, f_y);
-        double envelope = global_ctfmodel.getValueDampingAt(f_x, f_y);
-        double ctf_without_damping = global_ctfmodel.getValuePureWithoutDampingAt(f_x, f_y);
+        double f_x = DIRECT_A2D_ELEM(x_contfreq, i, j);
+        double f_y = DIRECT_A2D_ELEM(y_contfreq, i, j);
+        double bg = current_ctfmodel.getValueNoiseAt(f_x, f_y);
+        double envelope = current_ctfmodel.getValueDampingAt(f_x, f_y);
+        double ctf_without_damping = current_ctfmodel.getValuePureWithoutDampingAt(f_x, f_y);
         double ctf_with_damping = envelope * ctf_without_damping;
         double ctf2_th = bg + ctf_with_damping * ctf_with_damping;
         double explained = ctf2_th;
@@ -1863,14 +1815,14 @@ void estimate_background_gauss_parameters2()
         if (unexplained <= 0)
             continue;
         std::cout << fmod << " " << unexplained << " "
-        << global_ctfmodel.gaussian_K2*exp(-global_ctfmodel.sigmaU2*
+        << current_ctfmodel.gaussian_K2*exp(-current_ctfmodel.sigmaU2*
                                            (fmod - fmax)*(fmod - fmax)) << std::endl;
     }
 #endif
 
-    if (global_prm->show_optimization)
+    if (show_optimization)
     {
-        std::cout << "First Background Gaussian 2 Fit:\n" << global_ctfmodel
+        std::cout << "First Background Gaussian 2 Fit:\n" << current_ctfmodel
         << std::endl;
         saveIntermediateResults("step04a_first_background2_fit");
     }
@@ -1879,26 +1831,26 @@ void estimate_background_gauss_parameters2()
 
 // Estimate envelope parameters --------------------------------------------
 //#define DEBUG
-void estimate_envelope_parameters()
+void ProgCTFEstimateFromPSD::estimate_envelope_parameters()
 {
-    if (global_prm->show_optimization)
+    if (show_optimization)
         std::cout << "Looking for best fitting envelope ...\n";
 
     // Set the envelope
-    global_ctfmodel.Ca = global_prm->initial_ctfmodel.Ca;
-    global_ctfmodel.K = 1.0;
-    global_ctfmodel.espr = 0.0;
-    global_ctfmodel.ispr = 0.0;
-    global_ctfmodel.alpha = 0.0;
-    global_ctfmodel.DeltaF = 0.0;
-    global_ctfmodel.DeltaR = 0.0;
-    global_ctfmodel.Q0 = global_prm->initial_ctfmodel.Q0;
-    global_ctfmodel.envR0 = 0.0;
-    global_ctfmodel.envR1 = 0.0;
+    current_ctfmodel.Ca = initial_ctfmodel.Ca;
+    current_ctfmodel.K = 1.0;
+    current_ctfmodel.espr = 0.0;
+    current_ctfmodel.ispr = 0.0;
+    current_ctfmodel.alpha = 0.0;
+    current_ctfmodel.DeltaF = 0.0;
+    current_ctfmodel.DeltaR = 0.0;
+    current_ctfmodel.Q0 = initial_ctfmodel.Q0;
+    current_ctfmodel.envR0 = 0.0;
+    current_ctfmodel.envR1 = 0.0;
     COPY_ctfmodel_TO_CURRENT_GUESS;
 
     // Now optimize the envelope
-    global_penalize = false;
+    penalize = false;
     int iter;
     double fitness;
     Matrix1D<double> steps;
@@ -1907,74 +1859,74 @@ void estimate_envelope_parameters()
     steps(1) = 0; // Do not optimize Cs
     steps(5) = 0; // Do not optimize for alpha, since Ealpha depends on the
     // defocus
-    if (global_prm->modelSimplification >= 1)
+    if (modelSimplification >= 1)
         steps(6) = steps(7) = 0; // Do not optimize DeltaF and DeltaR
-    powellOptimizer(*global_adjust, FIRST_ENVELOPE_PARAMETER + 1,
-                    ENVELOPE_PARAMETERS, &CTF_fitness, NULL, 0.05, fitness, iter, steps,
-                    global_prm->show_optimization);
+    powellOptimizer(*adjust_params, FIRST_ENVELOPE_PARAMETER + 1,
+                    ENVELOPE_PARAMETERS, &CTF_fitness, this, 0.05, fitness, iter, steps,
+                    show_optimization);
 
-    // Keep the result in global_prm->adjust
-    global_ctfmodel.forcePhysicalMeaning();
+    // Keep the result in adjust
+    current_ctfmodel.forcePhysicalMeaning();
     COPY_ctfmodel_TO_CURRENT_GUESS;
 
-    if (global_prm->show_optimization)
+    if (show_optimization)
     {
-        std::cout << "Best envelope Fit:\n" << global_ctfmodel << std::endl;
+        std::cout << "Best envelope Fit:\n" << current_ctfmodel << std::endl;
         saveIntermediateResults("step02a_best_envelope_fit");
     }
 
     // Optimize with penalization
-    if (global_prm->show_optimization)
+    if (show_optimization)
         std::cout << "Penalizing best fitting envelope ...\n";
-    global_penalize = true;
-    global_current_penalty = 2;
+    penalize = true;
+    current_penalty = 2;
     int imax = CEIL(log(global_penalty) / log(2.0));
     for (int i = 1; i <= imax; i++)
     {
-        if (global_prm->show_optimization)
+        if (show_optimization)
             std::cout << "     Iteration " << i << " penalty="
-            << global_current_penalty << std::endl;
-        powellOptimizer(*global_adjust, FIRST_ENVELOPE_PARAMETER + 1,
-                        ENVELOPE_PARAMETERS, &CTF_fitness, NULL, 0.05, fitness, iter,
-                        steps, global_prm->show_optimization);
-        global_current_penalty *= 2;
-        global_current_penalty =
-            XMIPP_MIN(global_current_penalty, global_penalty);
-    }
-    // Keep the result in global_prm->adjust
-    global_ctfmodel.forcePhysicalMeaning();
+            << current_penalty << std::endl;
+        powellOptimizer(*adjust_params, FIRST_ENVELOPE_PARAMETER + 1,
+                        ENVELOPE_PARAMETERS, &CTF_fitness, this, 0.05, fitness, iter,
+                        steps, show_optimization);
+        current_penalty *= 2;
+        current_penalty =
+            XMIPP_MIN(current_penalty, global_penalty);
+    }
+    // Keep the result in adjust
+    current_ctfmodel.forcePhysicalMeaning();
     COPY_ctfmodel_TO_CURRENT_GUESS;
 
-    if (global_prm->show_optimization)
+    if (show_optimization)
     {
-        std::cout << "Best envelope Fit:\n" << global_ctfmodel << std::endl;
+        std::cout << "Best envelope Fit:\n" << current_ctfmodel << std::endl;
         saveIntermediateResults("step02b_best_penalized_envelope_fit");
     }
 }
 #undef DEBUG
 
 // Estimate defoci ---------------------------------------------------------
-void showFirstDefoci()
+void ProgCTFEstimateFromPSD::showFirstDefoci()
 {
-    if (global_prm->show_optimization)
+    if (show_optimization)
     {
-        std::cout << "First defocus Fit:\n" << global_ctfmodel << std::endl;
+        std::cout << "First defocus Fit:\n" << current_ctfmodel << std::endl;
         saveIntermediateResults("step03a_first_defocus_fit");
-        global_prm->enhanced_ctftomodel.write("step03a_enhanced_PSD.xmp");
+        enhanced_ctftomodel.write("step03a_enhanced_PSD.xmp");
         Image<double> save, save2, save3;
-        save().resize(YSIZE(global_w_digfreq), XSIZE(global_w_digfreq));
+        save().resize(YSIZE(w_digfreq), XSIZE(w_digfreq));
         save2().resize(save());
         save3().resize(save());
         FOR_ALL_ELEMENTS_IN_ARRAY2D(save())
         {
-            save()(i, j) = global_prm->enhanced_ctftomodel()(i, j);
-            double f_x = DIRECT_A2D_ELEM(global_x_contfreq, i, j);
-            double f_y = DIRECT_A2D_ELEM(global_y_contfreq, i, j);
-            global_ctfmodel.precomputeValues(f_x, f_y);
+            save()(i, j) = enhanced_ctftomodel()(i, j);
+            double f_x = DIRECT_A2D_ELEM(x_contfreq, i, j);
+            double f_y = DIRECT_A2D_ELEM(y_contfreq, i, j);
+            current_ctfmodel.precomputeValues(f_x, f_y);
             double ctf_without_damping =
-                global_ctfmodel.getValuePureWithoutDampingAt();
+                current_ctfmodel.getValuePureWithoutDampingAt();
             save2()(i, j) = ctf_without_damping * ctf_without_damping;
-            save3()(i, j) = -global_prm->enhanced_ctftomodel()(i, j)
+            save3()(i, j) = -enhanced_ctftomodel()(i, j)
                             * ctf_without_damping * ctf_without_damping;
         }
         save.write("step03a_enhanced_PSD.xmp");
@@ -1984,12 +1936,12 @@ void showFirstDefoci()
 }
 
 //#define DEBUG
-void estimate_defoci()
+void ProgCTFEstimateFromPSD::estimate_defoci()
 {
-    if (global_prm->show_optimization)
+    if (show_optimization)
         std::cout << "Looking for first defoci ...\n";
     double best_defocusU=0, best_defocusV=0, best_angle=0, best_K=1;
-    double best_error = global_heavy_penalization * 1.1;
+    double best_error = heavy_penalization * 1.1;
     bool first = true;
     int i, j;
     double defocusV, defocusU;
@@ -2002,24 +1954,24 @@ void estimate_defoci()
     // Check if there is no initial guess
     double min_allowed_defocusU = 1e3, max_allowed_defocusU = 100e3;
     double min_allowed_defocusV = 1e3, max_allowed_defocusV = 100e3;
-    if (global_prm->initial_ctfmodel.DeltafU != 0)
+    if (initial_ctfmodel.DeltafU != 0)
     {
-        initial_defocusStep = std::min(global_prm->defocus_range,20000.0);
+        initial_defocusStep = std::min(defocus_range,20000.0);
         defocusU0 = std::max(
                         1e3,
-                        global_prm->initial_ctfmodel.DeltafU
-                        - global_prm->defocus_range);
-        double maxDeviation = std::max(global_prm->defocus_range,
-                                       0.25 * global_prm->initial_ctfmodel.DeltafU);
+                        initial_ctfmodel.DeltafU
+                        - defocus_range);
+        double maxDeviation = std::max(defocus_range,
+                                       0.25 * initial_ctfmodel.DeltafU);
         max_allowed_defocusU = std::min(100e3,
-                                        global_prm->initial_ctfmodel.DeltafU + maxDeviation);
+                                        initial_ctfmodel.DeltafU + maxDeviation);
         defocusUF = std::min(
                         150e3,
-                        global_prm->initial_ctfmodel.DeltafU
-                        + global_prm->defocus_range);
+                        initial_ctfmodel.DeltafU
+                        + defocus_range);
         min_allowed_defocusU = std::max(1e3,
-                                        global_prm->initial_ctfmodel.DeltafU - maxDeviation);
-        if (global_prm->initial_ctfmodel.DeltafV == 0)
+                                        initial_ctfmodel.DeltafU - maxDeviation);
+        if (initial_ctfmodel.DeltafV == 0)
         {
             defocusV0 = defocusU0;
             min_allowed_defocusV = min_allowed_defocusU;
@@ -2030,32 +1982,32 @@ void estimate_defoci()
         {
             defocusV0 = std::max(
                             1e3,
-                            global_prm->initial_ctfmodel.DeltafV
-                            - global_prm->defocus_range);
+                            initial_ctfmodel.DeltafV
+                            - defocus_range);
             max_allowed_defocusV = std::max(100e3,
-                                            global_prm->initial_ctfmodel.DeltafV + maxDeviation);
+                                            initial_ctfmodel.DeltafV + maxDeviation);
             defocusVF = std::min(
                             150e3,
-                            global_prm->initial_ctfmodel.DeltafV
-                            + global_prm->defocus_range);
+                            initial_ctfmodel.DeltafV
+                            + defocus_range);
             min_allowed_defocusV = std::max(1e3,
-                                            global_prm->initial_ctfmodel.DeltafV - maxDeviation);
+                                            initial_ctfmodel.DeltafV - maxDeviation);
         }
     }
 
-    double K_so_far = global_ctfmodel.K;
+    double K_so_far = current_ctfmodel.K;
     Matrix1D<double> steps(DEFOCUS_PARAMETERS);
     steps.initConstant(1);
     steps(3) = 0; // Do not optimize kV
     steps(4) = 0; // Do not optimize K
     for (double defocusStep = initial_defocusStep;
-         defocusStep >= std::min(5000., global_prm->defocus_range / 2);
+         defocusStep >= std::min(5000., defocus_range / 2);
          defocusStep /= 2)
     {
         error.resize(CEIL((defocusVF - defocusV0) / defocusStep + 1),
                      CEIL((defocusUF - defocusU0) / defocusStep + 1));
-        error.initConstant(global_heavy_penalization);
-        if (global_prm->show_optimization)
+        error.initConstant(heavy_penalization);
+        if (show_optimization)
             std::cout << "V=[" << defocusV0 << "," << defocusVF << "]\n"
             << "U=[" << defocusU0 << "," << defocusUF << "]\n"
             << "Defocus step=" << defocusStep << std::endl;
@@ -2068,7 +2020,7 @@ void estimate_defoci()
                 bool first_angle = true;
                 if (fabs(defocusU - defocusV) > 30e3)
                 {
-                    error(i, j) = global_heavy_penalization;
+                    error(i, j) = heavy_penalization;
                     continue;
                 }
                 for (double angle = 0; angle < 180; angle += 45)
@@ -2076,22 +2028,22 @@ void estimate_defoci()
                     int iter;
                     double fitness;
 
-                    (*global_adjust)(0) = defocusU;
-                    (*global_adjust)(1) = defocusV;
-                    (*global_adjust)(2) = angle;
-                    (*global_adjust)(4) = K_so_far;
+                    (*adjust_params)(0) = defocusU;
+                    (*adjust_params)(1) = defocusV;
+                    (*adjust_params)(2) = angle;
+                    (*adjust_params)(4) = K_so_far;
 
-                    powellOptimizer(*global_adjust, FIRST_DEFOCUS_PARAMETER + 1,
-                                    DEFOCUS_PARAMETERS, &CTF_fitness, NULL, 0.05,
+                    powellOptimizer(*adjust_params, FIRST_DEFOCUS_PARAMETER + 1,
+                                    DEFOCUS_PARAMETERS, &CTF_fitness, this, 0.05,
                                     fitness, iter, steps, false);
 
                     if ((first_angle || fitness < error(i, j))
-                        && (global_ctfmodel.DeltafU >= min_allowed_defocusU
-                            && global_ctfmodel.DeltafU
+                        && (current_ctfmodel.DeltafU >= min_allowed_defocusU
+                            && current_ctfmodel.DeltafU
                             <= max_allowed_defocusU
-                            && global_ctfmodel.DeltafV
+                            && current_ctfmodel.DeltafV
                             >= min_allowed_defocusV
-                            && global_ctfmodel.DeltafV
+                            && current_ctfmodel.DeltafV
                             <= max_allowed_defocusV))
                     {
                         error(i, j) = fitness;
@@ -2099,40 +2051,40 @@ void estimate_defoci()
                         if (error(i, j) < best_error || first)
                         {
                             best_error = error(i, j);
-                            best_defocusU = global_ctfmodel.DeltafU;
-                            best_defocusV = global_ctfmodel.DeltafV;
-                            best_angle = global_ctfmodel.azimuthal_angle;
-                            best_K = global_ctfmodel.K;
+                            best_defocusU = current_ctfmodel.DeltafU;
+                            best_defocusV = current_ctfmodel.DeltafV;
+                            best_angle = current_ctfmodel.azimuthal_angle;
+                            best_K = current_ctfmodel.K;
                             first = false;
-                            if (global_prm->show_optimization)
+                            if (show_optimization)
                             {
                                 std::cout << "    (DefocusU,DefocusV)=("
                                 << defocusU << "," << defocusV
                                 << "), ang=" << angle << " --> ("
-                                << global_ctfmodel.DeltafU << ","
-                                << global_ctfmodel.DeltafV << "),"
-                                << global_ctfmodel.azimuthal_angle
-                                << " K=" << global_ctfmodel.K
+                                << current_ctfmodel.DeltafU << ","
+                                << current_ctfmodel.DeltafV << "),"
+                                << current_ctfmodel.azimuthal_angle
+                                << " K=" << current_ctfmodel.K
                                 << " error=" << error(i, j)
                                 << std::endl;
 #ifdef DEBUG
 
-                                global_show=3;
-                                CTF_fitness(global_adjust->vdata-1,NULL);
-                                global_show=0;
+                                show_inf=3;
+                                CTF_fitness_object(adjust_params->vdata-1);
+                                show_inf=0;
 
                                 Image<double> save;
-                                save() = global_prm->enhanced_ctftomodel();
+                                save() = enhanced_ctftomodel();
                                 save.write("PPPenhanced.xmp");
-                                for (int i = 0; i < YSIZE(global_w_digfreq); i += 1)
-                                    for (int j = 0; j < XSIZE(global_w_digfreq); j += 1)
+                                for (int i = 0; i < YSIZE(w_digfreq); i += 1)
+                                    for (int j = 0; j < XSIZE(w_digfreq); j += 1)
                                     {
-                                        if (DIRECT_A2D_ELEM(global_mask, i, j)<=0)
+                                        if (DIRECT_A2D_ELEM(freq_mask, i, j)<=0)
                                             continue;
-                                        double f_x = DIRECT_A2D_ELEM(global_x_contfreq, i, j);
-                                        double f_y = DIRECT_A2D_ELEM(global_y_contfreq, i, j);
-                                        double envelope = global_ctfmodel.getValueDampingAt(f_x, f_y);
-                                        double ctf_without_damping = global_ctfmodel.getValuePureWithoutDampingAt(f_x, f_y);
+                                        double f_x = DIRECT_A2D_ELEM(x_contfreq, i, j);
+                                        double f_y = DIRECT_A2D_ELEM(y_contfreq, i, j);
+                                        double envelope = current_ctfmodel.getValueDampingAt(f_x, f_y);
+                                        double ctf_without_damping = current_ctfmodel.getValuePureWithoutDampingAt(f_x, f_y);
                                         double ctf_with_damping = envelope * ctf_without_damping;
                                         double ctf_with_damping2 = ctf_with_damping * ctf_with_damping;
                                         save(i, j) = ctf_with_damping2;
@@ -2156,24 +2108,24 @@ void estimate_defoci()
         for (int ii = STARTINGY(error); ii <= FINISHINGY(error); ii++)
             for (int jj = STARTINGX(error); jj <= FINISHINGX(error); jj++)
             {
-                if (error(ii, jj) != global_heavy_penalization)
+                if (error(ii, jj) != heavy_penalization)
                 {
                 	aValidErrorHasBeenFound=true;
                     if (error(ii, jj) < errmin)
                         errmin = error(ii, jj);
-                    else if (errmax == global_heavy_penalization)
+                    else if (errmax == heavy_penalization)
                         errmax = error(ii, jj);
                     else if (error(ii, jj) > errmax)
                         errmax = error(ii, jj);
                 }
             }
-        if (global_prm->show_optimization)
+        if (show_optimization)
             std::cout << "Error matrix\n" << error << std::endl;
         if (!aValidErrorHasBeenFound)
         	REPORT_ERROR(ERR_NUMERICAL,"Cannot find any good defocus within the given range");
 
         // Find those defoci which are within a 10% of the maximum
-        if (global_show >= 2)
+        if (show_inf >= 2)
             std::cout << "Range=" << errmax - errmin << std::endl;
         double best_defocusVmin = best_defocusV, best_defocusVmax =
                                       best_defocusV;
@@ -2185,7 +2137,7 @@ void estimate_defoci()
             for (defocusU = defocusU0, j = 0; defocusU <= defocusUF; defocusU +=
                      defocusStep, j++)
             {
-                if (global_show >= 2)
+                if (show_inf >= 2)
                     std::cout << i << "," << j << " " << error(i, j) << " "
                     << defocusU << " " << defocusV << std::endl
                     << best_defocusUmin << " " << best_defocusUmax
@@ -2214,7 +2166,7 @@ void estimate_defoci()
         defocusU0 = std::max(min_allowed_defocusU,
                              best_defocusUmin - defocusStep);
         i = j = 0;
-        if (global_show >= 2)
+        if (show_inf >= 2)
         {
             Image<double> save;
             save() = error;
@@ -2225,22 +2177,22 @@ void estimate_defoci()
         }
     }
 
-    global_ctfmodel.DeltafU = best_defocusU;
-    global_ctfmodel.DeltafV = best_defocusV;
-    global_ctfmodel.azimuthal_angle = best_angle;
-    global_ctfmodel.K = best_K;
+    current_ctfmodel.DeltafU = best_defocusU;
+    current_ctfmodel.DeltafV = best_defocusV;
+    current_ctfmodel.azimuthal_angle = best_angle;
+    current_ctfmodel.K = best_K;
 
-    // Keep the result in global_prm->adjust
-    global_ctfmodel.forcePhysicalMeaning();
+    // Keep the result in adjust
+    current_ctfmodel.forcePhysicalMeaning();
     COPY_ctfmodel_TO_CURRENT_GUESS;
-    global_ctfmodel_defoci = global_ctfmodel;
+    ctfmodel_defoci = current_ctfmodel;
 
     showFirstDefoci();
 }
 #undef DEBUG
 
 // Estimate defoci with Zernike and SPTH transform---------------------------------------------
-void estimate_defoci_Zernike(MultidimArray<double> &psdToModelFullSize, double min_freq, double max_freq, double Tm,
+void ProgCTFEstimateFromPSD::estimate_defoci_Zernike(MultidimArray<double> &psdToModelFullSize, double min_freq, double max_freq, double Tm,
                              double kV, double lambdaPhase, int sizeWindowPhase,
                              double &defocusU, double &defocusV, double &ellipseAngle, int verbose)
 {
@@ -2266,7 +2218,7 @@ void estimate_defoci_Zernike(MultidimArray<double> &psdToModelFullSize, double m
 
     int numElem = 10;
     kV = kV*1000;
-    double K_so_far = global_ctfmodel.K;
+    double K_so_far = current_ctfmodel.K;
     double lambda=12.2643247/std::sqrt(kV*(1.+0.978466e-6*kV));
     double Z8;
     double Z3;
@@ -2299,7 +2251,7 @@ void estimate_defoci_Zernike(MultidimArray<double> &psdToModelFullSize, double m
     lambdaPhase = 0.8;
     sizeWindowPhase = 10;
 
-    Matrix1D<double> initialGlobalAdjust = (*global_adjust);
+    Matrix1D<double> initialGlobalAdjust = (*adjust_params);
 
     for (int i = 1; i < numElem; i++)
     {
@@ -2329,20 +2281,20 @@ void estimate_defoci_Zernike(MultidimArray<double> &psdToModelFullSize, double m
 
             fmax -= fmaxStep;
 
-            (*global_adjust)(0) = deFocusAvg+deFocusDiff;
-            (*global_adjust)(1) = deFocusAvg-deFocusDiff;
-            (*global_adjust)(2) = eAngle;
-            (*global_adjust)(4) = K_so_far;
-            (*global_adjust)(6) = 2;
+            (*adjust_params)(0) = deFocusAvg+deFocusDiff;
+            (*adjust_params)(1) = deFocusAvg-deFocusDiff;
+            (*adjust_params)(2) = eAngle;
+            (*adjust_params)(4) = K_so_far;
+            (*adjust_params)(6) = 2;
 
 
             fitness =0;
-            powellOptimizer(*global_adjust, FIRST_DEFOCUS_PARAMETER + 1,
-                            DEFOCUS_PARAMETERS, &CTF_fitness, NULL, 0.05,
+            powellOptimizer(*adjust_params, FIRST_DEFOCUS_PARAMETER + 1,
+                            DEFOCUS_PARAMETERS, &CTF_fitness, this, 0.05,
                             fitness, iter, steps, false);
 
-            VEC_ELEM(arrayDefocusAvg,i)  = ((*global_adjust)(0) +(*global_adjust)(1))/2;
-            VEC_ELEM(arrayDefocusDiff,i) = ((*global_adjust)(0) -(*global_adjust)(1))/2;
+            VEC_ELEM(arrayDefocusAvg,i)  = ((*adjust_params)(0) +(*adjust_params)(1))/2;
+            VEC_ELEM(arrayDefocusDiff,i) = ((*adjust_params)(0) -(*adjust_params)(1))/2;
             VEC_ELEM(arrayError,i) = (-1)*fitness;
 
         }
@@ -2353,8 +2305,8 @@ void estimate_defoci_Zernike(MultidimArray<double> &psdToModelFullSize, double m
     while ( (VEC_ELEM(arrayDefocusAvg,maxInd) < 3000) || ((VEC_ELEM(arrayDefocusAvg,maxInd) > 50000) && VEC_ELEM(arrayError,maxInd)>-1e3 ))
     {
         VEC_ELEM(arrayError,maxInd) = -1e3;
-        VEC_ELEM(arrayDefocusAvg,maxInd) = global_prm->initial_ctfmodel.DeltafU;
-        VEC_ELEM(arrayDefocusDiff,maxInd) = global_prm->initial_ctfmodel.DeltafV;
+        VEC_ELEM(arrayDefocusAvg,maxInd) = initial_ctfmodel.DeltafU;
+        VEC_ELEM(arrayDefocusDiff,maxInd) = initial_ctfmodel.DeltafV;
         maxInd=arrayError.maxIndex();
     }
     if (VEC_ELEM(arrayError,maxInd)<=-1e3)
@@ -2374,51 +2326,51 @@ void estimate_defoci_Zernike(MultidimArray<double> &psdToModelFullSize, double m
 
     //We want to take care about more parameters
     // We optimize for deltaU, deltaV
-    (*global_adjust)(0) = VEC_ELEM(arrayDefocusAvg,maxInd)+VEC_ELEM(arrayDefocusDiff,maxInd);
-    (*global_adjust)(1) = VEC_ELEM(arrayDefocusAvg,maxInd)-VEC_ELEM(arrayDefocusDiff,maxInd);
-    (*global_adjust)(2) = eAngle;
-    (*global_adjust)(4) = K_so_far;
-    (*global_adjust)(6) = 2;
+    (*adjust_params)(0) = VEC_ELEM(arrayDefocusAvg,maxInd)+VEC_ELEM(arrayDefocusDiff,maxInd);
+    (*adjust_params)(1) = VEC_ELEM(arrayDefocusAvg,maxInd)-VEC_ELEM(arrayDefocusDiff,maxInd);
+    (*adjust_params)(2) = eAngle;
+    (*adjust_params)(4) = K_so_far;
+    (*adjust_params)(6) = 2;
 
     fitness =0;
-    powellOptimizer(*global_adjust, FIRST_DEFOCUS_PARAMETER + 1,
-                    DEFOCUS_PARAMETERS, &CTF_fitness, NULL, 0.05,
+    powellOptimizer(*adjust_params, FIRST_DEFOCUS_PARAMETER + 1,
+                    DEFOCUS_PARAMETERS, &CTF_fitness, this, 0.05,
                     fitness, iter, steps, false);
 
-    VEC_ELEM(arrayDefocusU,0) = (*global_adjust)(0);
-    VEC_ELEM(arrayDefocusV,0) = (*global_adjust)(1);
+    VEC_ELEM(arrayDefocusU,0) = (*adjust_params)(0);
+    VEC_ELEM(arrayDefocusV,0) = (*adjust_params)(1);
     VEC_ELEM(arrayError2,0) = (-1)*fitness;
 
     // We optimize for deltaU, deltaU
-    (*global_adjust)(0) = VEC_ELEM(arrayDefocusAvg,maxInd)+VEC_ELEM(arrayDefocusDiff,maxInd);
-    (*global_adjust)(1) = VEC_ELEM(arrayDefocusAvg,maxInd)+VEC_ELEM(arrayDefocusDiff,maxInd);
-    (*global_adjust)(2) = eAngle;
-    (*global_adjust)(4) = K_so_far;
-    (*global_adjust)(6) = 2;
+    (*adjust_params)(0) = VEC_ELEM(arrayDefocusAvg,maxInd)+VEC_ELEM(arrayDefocusDiff,maxInd);
+    (*adjust_params)(1) = VEC_ELEM(arrayDefocusAvg,maxInd)+VEC_ELEM(arrayDefocusDiff,maxInd);
+    (*adjust_params)(2) = eAngle;
+    (*adjust_params)(4) = K_so_far;
+    (*adjust_params)(6) = 2;
 
     fitness =0;
-    powellOptimizer(*global_adjust, FIRST_DEFOCUS_PARAMETER + 1,
-                    DEFOCUS_PARAMETERS, &CTF_fitness, NULL, 0.05,
+    powellOptimizer(*adjust_params, FIRST_DEFOCUS_PARAMETER + 1,
+                    DEFOCUS_PARAMETERS, &CTF_fitness, this, 0.05,
                     fitness, iter, steps, false);
 
-    VEC_ELEM(arrayDefocusU,1) = (*global_adjust)(0);
-    VEC_ELEM(arrayDefocusV,1) = (*global_adjust)(1);
+    VEC_ELEM(arrayDefocusU,1) = (*adjust_params)(0);
+    VEC_ELEM(arrayDefocusV,1) = (*adjust_params)(1);
     VEC_ELEM(arrayError2,1) = (-1)*fitness;
 
     // We optimize for deltaV, deltaV
-    (*global_adjust)(0) = VEC_ELEM(arrayDefocusAvg,maxInd)-VEC_ELEM(arrayDefocusDiff,maxInd);
-    (*global_adjust)(1) = VEC_ELEM(arrayDefocusAvg,maxInd)-VEC_ELEM(arrayDefocusDiff,maxInd);
-    (*global_adjust)(2) = eAngle;
-    (*global_adjust)(4) = K_so_far;
-    (*global_adjust)(6) = 2;
+    (*adjust_params)(0) = VEC_ELEM(arrayDefocusAvg,maxInd)-VEC_ELEM(arrayDefocusDiff,maxInd);
+    (*adjust_params)(1) = VEC_ELEM(arrayDefocusAvg,maxInd)-VEC_ELEM(arrayDefocusDiff,maxInd);
+    (*adjust_params)(2) = eAngle;
+    (*adjust_params)(4) = K_so_far;
+    (*adjust_params)(6) = 2;
 
     fitness =0;
-    powellOptimizer(*global_adjust, FIRST_DEFOCUS_PARAMETER + 1,
-                    DEFOCUS_PARAMETERS, &CTF_fitness, NULL, 0.05,
+    powellOptimizer(*adjust_params, FIRST_DEFOCUS_PARAMETER + 1,
+                    DEFOCUS_PARAMETERS, &CTF_fitness, this, 0.05,
                     fitness, iter, steps, false);
 
-    VEC_ELEM(arrayDefocusU,2) = (*global_adjust)(0);
-    VEC_ELEM(arrayDefocusV,2) = (*global_adjust)(1);
+    VEC_ELEM(arrayDefocusU,2) = (*adjust_params)(0);
+    VEC_ELEM(arrayDefocusV,2) = (*adjust_params)(1);
     VEC_ELEM(arrayError2,2) = (-1)*fitness;
 
     //Here we select the best one
@@ -2426,57 +2378,57 @@ void estimate_defoci_Zernike(MultidimArray<double> &psdToModelFullSize, double m
     defocusU = VEC_ELEM(arrayDefocusU,maxInd);
     defocusV = VEC_ELEM(arrayDefocusV,maxInd);
 
-    (*global_adjust)(0) = defocusU;
-    (*global_adjust)(1) = defocusV;
-    (*global_adjust)(2) = eAngle;
-    (*global_adjust)(4) = K_so_far;
-    (*global_adjust)(6) = 2;
+    (*adjust_params)(0) = defocusU;
+    (*adjust_params)(1) = defocusV;
+    (*adjust_params)(2) = eAngle;
+    (*adjust_params)(4) = K_so_far;
+    (*adjust_params)(6) = 2;
 
     while ( (0.5*(defocusU+defocusV) < 2500) || (0.5*(defocusU+defocusV) > 60000) )
     {
         VEC_ELEM(arrayError2,maxInd) = -1e3;
-        VEC_ELEM(arrayDefocusU,maxInd) = global_prm->initial_ctfmodel.DeltafU;
-        VEC_ELEM(arrayDefocusV,maxInd) = global_prm->initial_ctfmodel.DeltafV;
+        VEC_ELEM(arrayDefocusU,maxInd) = initial_ctfmodel.DeltafU;
+        VEC_ELEM(arrayDefocusV,maxInd) = initial_ctfmodel.DeltafV;
 
         maxInd=arrayError2.maxIndex();
         defocusU = VEC_ELEM(arrayDefocusU,maxInd);
         defocusV = VEC_ELEM(arrayDefocusV,maxInd);
-        (*global_adjust)(0) = defocusU;
-        (*global_adjust)(1) = defocusV;
-        (*global_adjust)(2) = eAngle;
-        (*global_adjust)(4) = K_so_far;
-        (*global_adjust)(6) = 2;
+        (*adjust_params)(0) = defocusU;
+        (*adjust_params)(1) = defocusV;
+        (*adjust_params)(2) = eAngle;
+        (*adjust_params)(4) = K_so_far;
+        (*adjust_params)(6) = 2;
     }
 
     if (VEC_ELEM(arrayError2,maxInd) <= 0)
     {
         COPY_ctfmodel_TO_CURRENT_GUESS;
-        global_ctfmodel_defoci = global_ctfmodel;
+        ctfmodel_defoci = current_ctfmodel;
 
-        global_action = 5;
+        action = 5;
 
         steps.resize(ALL_CTF_PARAMETERS);
         steps.initConstant(1);
         steps(3) = 0; // kV
         steps(5) = 0; // The spherical aberration (Cs) is not optimized
-        if (global_ctfmodel.Q0!=0)
+        if (current_ctfmodel.Q0!=0)
         	steps(12)=0;
 
         COPY_ctfmodel_TO_CURRENT_GUESS;
 
-        global_evaluation_reduction = 2;
-        powellOptimizer(*global_adjust, 0 + 1, ALL_CTF_PARAMETERS, &CTF_fitness,
-                        NULL, 0.01, fitness, iter, steps, global_prm->show_optimization);
+        evaluation_reduction = 2;
+        powellOptimizer(*adjust_params, 0 + 1, ALL_CTF_PARAMETERS, &CTF_fitness,
+                        this, 0.01, fitness, iter, steps, show_optimization);
         COPY_ctfmodel_TO_CURRENT_GUESS;
 
-        global_show=0;
-        global_action = 3;
-        global_evaluation_reduction = 1;
+        show_inf=0;
+        action = 3;
+        evaluation_reduction = 1;
 
-        double error = -CTF_fitness(global_adjust->vdata-1,NULL);
+        double error = -CTF_fitness_object(adjust_params->vdata-1);
         if ( error <= -0.1)
         {
-            *global_adjust = initialGlobalAdjust;
+            *adjust_params = initialGlobalAdjust;
             COPY_ctfmodel_TO_CURRENT_GUESS;
             //There is nothing to do and we have to perform an exhaustive search
 #ifndef RELEASE_MODE
@@ -2487,52 +2439,50 @@ void estimate_defoci_Zernike(MultidimArray<double> &psdToModelFullSize, double m
     }
 }
 
-void estimate_defoci_Zernike()
+void ProgCTFEstimateFromPSD::estimate_defoci_Zernike()
 {
-    if (global_prm->show_optimization)
+    if (show_optimization)
         std::cout << "Looking for first defoci ...\n";
 
     DEBUG_TEXTFILE("Step 6.1");
     DEBUG_MODEL_TEXTFILE;
-    estimate_defoci_Zernike(global_prm->enhanced_ctftomodel_fullsize(),
-                            global_prm->min_freq,global_prm->max_freq,global_prm->Tm,
-                            global_prm->initial_ctfmodel.kV,
-                            global_prm->lambdaPhase,global_prm->sizeWindowPhase,
-                            global_ctfmodel.DeltafU, global_ctfmodel.DeltafV, global_ctfmodel.azimuthal_angle, 0);
+    estimate_defoci_Zernike(enhanced_ctftomodel_fullsize(),
+                            min_freq,max_freq,Tm,
+                            initial_ctfmodel.kV,
+                            lambdaPhase,sizeWindowPhase,
+                            current_ctfmodel.DeltafU, current_ctfmodel.DeltafV, current_ctfmodel.azimuthal_angle, 0);
     DEBUG_TEXTFILE("Step 6.2");
     DEBUG_MODEL_TEXTFILE;
 
-    global_ctfmodel.forcePhysicalMeaning();
+    current_ctfmodel.forcePhysicalMeaning();
     COPY_ctfmodel_TO_CURRENT_GUESS;
-    global_ctfmodel_defoci = global_ctfmodel;
+    ctfmodel_defoci = current_ctfmodel;
 
     showFirstDefoci();
 }
 
 /* Main routine ------------------------------------------------------------ */
 //#define DEBUG
-double ROUT_Adjust_CTF(ProgCTFEstimateFromPSD &prm,
-                       CTFDescription &output_ctfmodel, bool standalone)
+double ProgCTFEstimateFromPSD::adjustCTF(CTFDescription &output_ctfmodel, bool standalone)
 {
-    DEBUG_OPEN_TEXTFILE(prm.fn_psd.removeLastExtension());
-    global_prm = &prm;
-    if (standalone || prm.show_optimization)
-        prm.show();
-    prm.produceSideInfo();
-    DEBUG_TEXTFILE(formatString("After producing side info: Avg=%f",prm.ctftomodel().computeAvg()));
+    DEBUG_OPEN_TEXTFILE(fn_psd.removeLastExtension());
+    if (standalone || show_optimization)
+        show();
+    produceSideInfo();
+    DEBUG_TEXTFILE(formatString("After producing side info: Avg=%f",ctftomodel().computeAvg()));
     DEBUG_MODEL_TEXTFILE;
 
     // Build initial frequency mask
-    global_value_th = -1;
-    global_min_freq = prm.min_freq;
-    global_max_freq = prm.max_freq;
+    value_th = -1;
+    min_freq_psd = min_freq;
+    max_freq_psd = max_freq;
 
-    // Set some global variables
-    global_adjust = &prm.adjust;
-    global_penalize = false;
-    global_max_gauss_freq = 0;
-    global_heavy_penalization = f->computeMax() * XSIZE(*f) * YSIZE(*f);
-    global_show = 0;
+    // Initialize the fitting state
+    adjust_params = &adjust;
+    penalize = false;
+    max_gauss_freq = 0;
+    heavy_penalization = f->computeMax() * XSIZE(*f) * YSIZE(*f);
+    show_inf = 0;
 
     // Some variables needed by all steps
     int iter;
@@ -2543,40 +2493,40 @@ double ROUT_Adjust_CTF(ProgCTFEstimateFromPSD &prm,
     /* STEPs 1, 2, 3 and 4:  Find background which best fits the CTF        */
     /************************************************************************/
 
-    global_ctfmodel.enable_CTFnoise = true;
-    global_ctfmodel.enable_CTF = false;
-    global_evaluation_reduction = 4;
+    current_ctfmodel.enable_CTFnoise = true;
+    current_ctfmodel.enable_CTF = false;
+    evaluation_reduction = 4;
 
     // If initial parameters were not supplied for the gaussian curve,
     // estimate them from the CTF file
-    global_action = 0;
-    if (prm.adjust(FIRST_SQRT_PARAMETER) == 0)
+    action = 0;
+    if (adjust(FIRST_SQRT_PARAMETER) == 0)
     {
         estimate_background_sqrt_parameters();
         estimate_background_gauss_parameters();
     }
 
     // Optimize the current background
-    global_action = 1;
-    global_penalize = true;
-    global_current_penalty = global_penalty;
+    action = 1;
+    penalize = true;
+    current_penalty = global_penalty;
     steps.resize(BACKGROUND_CTF_PARAMETERS);
     steps.initConstant(1);
-    if (!global_prm->modelSimplification >= 3)
+    if (!modelSimplification >= 3)
         steps(7) = steps(8) = steps(10) = 0;
-    powellOptimizer(*global_adjust, FIRST_SQRT_PARAMETER + 1,
-                    BACKGROUND_CTF_PARAMETERS, &CTF_fitness, NULL, 0.01, fitness, iter,
-                    steps, global_prm->show_optimization);
+    powellOptimizer(*adjust_params, FIRST_SQRT_PARAMETER + 1,
+                    BACKGROUND_CTF_PARAMETERS, &CTF_fitness, this, 0.01, fitness, iter,
+                    steps, show_optimization);
 
     // Make sure that the model has physical meaning
     // (In some machines due to numerical imprecission this check is necessary
     // at the end)
-    global_ctfmodel.forcePhysicalMeaning();
+    current_ctfmodel.forcePhysicalMeaning();
     COPY_ctfmodel_TO_CURRENT_GUESS;
 
-    if (global_prm->show_optimization)
+    if (show_optimization)
     {
-        std::cout << "Best background Fit:\n" << global_ctfmodel << std::endl;
+        std::cout << "Best background Fit:\n" << current_ctfmodel << std::endl;
         saveIntermediateResults("step01d_best_background_fit");
     }
     DEBUG_TEXTFILE(formatString("Step 4: CTF_fitness=%f",CTF_fitness));
@@ -2585,49 +2535,49 @@ double ROUT_Adjust_CTF(ProgCTFEstimateFromPSD &prm,
     /************************************************************************/
     /* STEPs 5 and 6:  Find envelope which best fits the CTF                */
     /************************************************************************/
-    global_action = 2;
-    global_ctfmodel.enable_CTF = true;
-    if (prm.initial_ctfmodel.K == 0)
-    {
-        global_ctfmodel.kV = prm.initial_ctfmodel.kV;
-        global_ctfmodel.Cs = prm.initial_ctfmodel.Cs;
-        if (prm.initial_ctfmodel.Q0 != 0)
-            global_ctfmodel.Q0 = prm.initial_ctfmodel.Q0;
+    action = 2;
+    current_ctfmodel.enable_CTF = true;
+    if (initial_ctfmodel.K == 0)
+    {
+        current_ctfmodel.kV = initial_ctfmodel.kV;
+        current_ctfmodel.Cs = initial_ctfmodel.Cs;
+        if (initial_ctfmodel.Q0 != 0)
+            current_ctfmodel.Q0 = initial_ctfmodel.Q0;
         estimate_envelope_parameters();
     }
     else
     {
-        global_ctfmodel.K = prm.initial_ctfmodel.K;
-        global_ctfmodel.kV = prm.initial_ctfmodel.kV;
-        global_ctfmodel.DeltafU = prm.initial_ctfmodel.DeltafU;
-        global_ctfmodel.DeltafV = prm.initial_ctfmodel.DeltafV;
-        global_ctfmodel.azimuthal_angle = prm.initial_ctfmodel.azimuthal_angle;
-        global_ctfmodel.Cs = prm.initial_ctfmodel.Cs;
-        global_ctfmodel.Ca = prm.initial_ctfmodel.Ca;
-        global_ctfmodel.espr = prm.initial_ctfmodel.espr;
-        global_ctfmodel.ispr = prm.initial_ctfmodel.ispr;
-        global_ctfmodel.alpha = prm.initial_ctfmodel.alpha;
-        global_ctfmodel.DeltaF = prm.initial_ctfmodel.DeltaF;
-        global_ctfmodel.DeltaR = prm.initial_ctfmodel.DeltaR;
-        global_ctfmodel.Q0 = prm.initial_ctfmodel.Q0;
+        current_ctfmodel.K = initial_ctfmodel.K;
+        current_ctfmodel.kV = initial_ctfmodel.kV;
+        current_ctfmodel.DeltafU = initial_ctfmodel.DeltafU;
+        current_ctfmodel.DeltafV = initial_ctfmodel.DeltafV;
+        current_ctfmodel.azimuthal_angle = initial_ctfmodel.azimuthal_angle;
+        current_ctfmodel.Cs = initial_ctfmodel.Cs;
+        current_ctfmodel.Ca = initial_ctfmodel.Ca;
+        current_ctfmodel.espr = initial_ctfmodel.espr;
+        current_ctfmodel.ispr = initial_ctfmodel.ispr;
+        current_ctfmodel.alpha = initial_ctfmodel.alpha;
+        current_ctfmodel.DeltaF = initial_ctfmodel.DeltaF;
+        current_ctfmodel.DeltaR = initial_ctfmodel.DeltaR;
+        current_ctfmodel.Q0 = initial_ctfmodel.Q0;
         COPY_ctfmodel_TO_CURRENT_GUESS;
     }
-    DEBUG_TEXTFILE(formatString("Step 6: espr=%f",global_ctfmodel.espr));
+    DEBUG_TEXTFILE(formatString("Step 6: espr=%f",current_ctfmodel.espr));
     DEBUG_MODEL_TEXTFILE;
     /************************************************************************/
     /* STEP 7:  the defocus and angular parameters                          */
     /************************************************************************/
 
-    global_action = 3;
-    global_evaluation_reduction = 1;
-    if (prm.fastDefocusEstimate)
+    action = 3;
+    evaluation_reduction = 1;
+    if (fastDefocusEstimate)
         estimate_defoci_Zernike();
     else
         estimate_defoci();
 
-    DEBUG_TEXTFILE(formatString("Step 7: DeltafU=%f",global_ctfmodel.DeltafU));
-    DEBUG_TEXTFILE(formatString("Step 7: DeltafV=%f",global_ctfmodel.DeltafV));
-    DEBUG_TEXTFILE(formatString("Step 7: azimutalAngle=%f",global_ctfmodel.azimuthal_angle));
+    DEBUG_TEXTFILE(formatString("Step 7: DeltafU=%f",current_ctfmodel.DeltafU));
+    DEBUG_TEXTFILE(formatString("Step 7: DeltafV=%f",current_ctfmodel.DeltafV));
+    DEBUG_TEXTFILE(formatString("Step 7: azimutalAngle=%f",current_ctfmodel.azimuthal_angle));
     DEBUG_MODEL_TEXTFILE;
 
     //This line is to test the results obtained
@@ -2636,94 +2586,94 @@ double ROUT_Adjust_CTF(ProgCTFEstimateFromPSD &prm,
     /************************************************************************/
     /* STEPs 9, 10 and 11: all parameters included second Gaussian          */
     /************************************************************************/
-    global_action = 5;
-    if (prm.modelSimplification < 2)
+    action = 5;
+    if (modelSimplification < 2)
         estimate_background_gauss_parameters2();
 
     steps.resize(ALL_CTF_PARAMETERS);
     steps.initConstant(1);
     steps(3) = 0; // kV
     steps(5) = 0; // The spherical aberration (Cs) is not optimized
-    if (prm.initial_ctfmodel.Q0 != 0)
+    if (initial_ctfmodel.Q0 != 0)
         steps(12) = 0; // Q0
-    if (prm.modelSimplification >= 3)
+    if (modelSimplification >= 3)
         steps(20) = steps(21) = steps(23) = 0;
-    if (prm.modelSimplification >= 2)
+    if (modelSimplification >= 2)
         steps(24) = steps(25) = steps(26) = steps(27) = steps(28) = steps(29) =
                                                 0;
-    if (prm.modelSimplification >= 1)
+    if (modelSimplification >= 1)
         steps(10) = steps(11) = 0;
 
-    powellOptimizer(*global_adjust, 0 + 1, ALL_CTF_PARAMETERS, &CTF_fitness,
-                    NULL, 0.01, fitness, iter, steps, global_prm->show_optimization);
+    powellOptimizer(*adjust_params, 0 + 1, ALL_CTF_PARAMETERS, &CTF_fitness,
+                    this, 0.01, fitness, iter, steps, show_optimization);
 
-    global_ctfmodel.forcePhysicalMeaning();
+    current_ctfmodel.forcePhysicalMeaning();
     COPY_ctfmodel_TO_CURRENT_GUESS;
 
-    if (global_prm->show_optimization)
+    if (show_optimization)
     {
-        std::cout << "Best fit with Gaussian2:\n" << global_ctfmodel
+        std::cout << "Best fit with Gaussian2:\n" << current_ctfmodel
         << std::endl;
         saveIntermediateResults("step04b_best_fit_with_gaussian2");
     }
 
-    global_evaluation_reduction = 2;
-    powellOptimizer(*global_adjust, 0 + 1, ALL_CTF_PARAMETERS, &CTF_fitness,
-                    NULL, 0.01, fitness, iter, steps, global_prm->show_optimization);
-    global_ctfmodel.forcePhysicalMeaning();
+    evaluation_reduction = 2;
+    powellOptimizer(*adjust_params, 0 + 1, ALL_CTF_PARAMETERS, &CTF_fitness,
+                    this, 0.01, fitness, iter, steps, show_optimization);
+    current_ctfmodel.forcePhysicalMeaning();
     COPY_ctfmodel_TO_CURRENT_GUESS;
 
-    global_evaluation_reduction = 1;
-    powellOptimizer(*global_adjust, 0 + 1, ALL_CTF_PARAMETERS, &CTF_fitness,
-                    NULL, 0.005, fitness, iter, steps, global_prm->show_optimization);
-    global_ctfmodel.forcePhysicalMeaning();
+    evaluation_reduction = 1;
+    powellOptimizer(*adjust_params, 0 + 1, ALL_CTF_PARAMETERS, &CTF_fitness,
+                    this, 0.005, fitness, iter, steps, show_optimization);
+    current_ctfmodel.forcePhysicalMeaning();
     COPY_ctfmodel_TO_CURRENT_GUESS;
 
-    if (global_prm->show_optimization)
+    if (show_optimization)
     {
-        std::cout << "Best fit:\n" << global_ctfmodel << std::endl;
+        std::cout << "Best fit:\n" << current_ctfmodel << std::endl;
         saveIntermediateResults("step04c_best_fit");
     }
-    DEBUG_TEXTFILE(formatString("Step 11: DeltafU=%f fitness=%f",global_ctfmodel.DeltafU,fitness));
+    DEBUG_TEXTFILE(formatString("Step 11: DeltafU=%f fitness=%f",current_ctfmodel.DeltafU,fitness));
     DEBUG_MODEL_TEXTFILE;
 
     //We adopt that always  DeltafU > DeltafV so if this is not the case we change the values and the angle
-    if ( global_ctfmodel.DeltafV > global_ctfmodel.DeltafU)
+    if ( current_ctfmodel.DeltafV > current_ctfmodel.DeltafU)
     {
         double temp;
-        temp = global_ctfmodel.DeltafU;
-        global_ctfmodel.DeltafU = global_ctfmodel.DeltafV;
-        global_ctfmodel.DeltafV = temp;
-        global_ctfmodel.azimuthal_angle -= 90;
+        temp = current_ctfmodel.DeltafU;
+        current_ctfmodel.DeltafU = current_ctfmodel.DeltafV;
+        current_ctfmodel.DeltafV = temp;
+        current_ctfmodel.azimuthal_angle -= 90;
         COPY_ctfmodel_TO_CURRENT_GUESS;
     }
 
     /************************************************************************/
     /* STEP 12: Produce output                                              */
     /************************************************************************/
-    global_action = 7;
+    action = 7;
 
-    if (prm.fn_psd != "")
+    if (fn_psd != "")
     {
         // Define mask between first and third zero
-        global_mask_between_zeroes.initZeros(global_mask);
+        mask_between_zeroes.initZeros(freq_mask);
         Matrix1D<double> u(2), z1(2), z3(2);
-        FOR_ALL_ELEMENTS_IN_ARRAY2D(global_mask_between_zeroes)
+        FOR_ALL_ELEMENTS_IN_ARRAY2D(mask_between_zeroes)
         {
-            VECTOR_R2(u, global_x_digfreq(i, j), global_y_digfreq(i, j));
+            VECTOR_R2(u, x_digfreq(i, j), y_digfreq(i, j));
             u /= u.module();
-            global_ctfmodel.lookFor(1, u, z1, 0);
-            global_ctfmodel.lookFor(3, u, z3, 0);
-            if (z1.module() < global_w_contfreq(i, j)
-                && global_w_contfreq(i, j) < z3.module())
-                global_mask_between_zeroes(i, j) = 1;
+            current_ctfmodel.lookFor(1, u, z1, 0);
+            current_ctfmodel.lookFor(3, u, z3, 0);
+            if (z1.module() < w_contfreq(i, j)
+                && w_contfreq(i, j) < z3.module())
+                mask_between_zeroes(i, j) = 1;
         }
 
         // Evaluate the correlation in this region
-        CTF_fitness(global_adjust->adaptForNumericalRecipes(), NULL);
+        CTF_fitness_object(adjust_params->adaptForNumericalRecipes());
 
         // Save results
-        FileName fn_rootCTFPARAM = prm.fn_psd.withoutExtension();
+        FileName fn_rootCTFPARAM = fn_psd.withoutExtension();
 
         FileName fn_rootMODEL = fn_rootCTFPARAM;
         size_t atPosition=fn_rootCTFPARAM.find('@');
@@ -2739,31 +2689,37 @@ double ROUT_Adjust_CTF(ProgCTFEstimateFromPSD &prm,
             fn_rootCTFPARAM=(String)"fullMicrograph@"+fn_rootCTFPARAM;
 
         saveIntermediateResults(fn_rootMODEL, false);
-        global_ctfmodel.Tm /= prm.downsampleFactor;
-        global_ctfmodel.azimuthal_angle = std::fmod(global_ctfmodel.azimuthal_angle,360.);
-        global_ctfmodel.write(fn_rootCTFPARAM + ".ctfparam_tmp");
+        current_ctfmodel.Tm /= downsampleFactor;
+        current_ctfmodel.azimuthal_angle = std::fmod(current_ctfmodel.azimuthal_angle,360.);
+        current_ctfmodel.write(fn_rootCTFPARAM + ".ctfparam_tmp");
         MetaData MD;
         MD.read(fn_rootCTFPARAM + ".ctfparam_tmp");
         size_t id = MD.firstObject();
-        MD.setValue(MDL_CTF_X0, (double)output_ctfmodel.x0*prm.Tm, id);
-        MD.setValue(MDL_CTF_XF, (double)output_ctfmodel.xF*prm.Tm, id);
-        MD.setValue(MDL_CTF_Y0, (double)output_ctfmodel.y0*prm.Tm, id);
-        MD.setValue(MDL_CTF_YF, (double)output_ctfmodel.yF*prm.Tm, id);
+        MD.setValue(MDL_CTF_X0, (double)output_ctfmodel.x0*Tm, id);
+        MD.setValue(MDL_CTF_XF, (double)output_ctfmodel.xF*Tm, id);
+        MD.setValue(MDL_CTF_Y0, (double)output_ctfmodel.y0*Tm, id);
+        MD.setValue(MDL_CTF_YF, (double)output_ctfmodel.yF*Tm, id);
         MD.setValue(MDL_CTF_CRIT_FITTINGSCORE, fitness, id);
-        MD.setValue(MDL_CTF_CRIT_FITTINGCORR13, global_corr13, id);
-        MD.setValue(MDL_CTF_DOWNSAMPLE_PERFORMED, prm.downsampleFactor, id);
+        MD.setValue(MDL_CTF_CRIT_FITTINGCORR13, corr13, id);
+        MD.setValue(MDL_CTF_DOWNSAMPLE_PERFORMED, downsampleFactor, id);
         MD.write(fn_rootCTFPARAM + ".ctfparam",MD_APPEND);
         fn_rootCTFPARAM = fn_rootCTFPARAM + ".ctfparam_tmp";
         fn_rootCTFPARAM.deleteFile();
     }
-    output_ctfmodel = global_ctfmodel;
+    output_ctfmodel = current_ctfmodel;
 
     DEBUG_CLOSE_TEXTFILE;
     return fitness;
 }
 
+double ROUT_Adjust_CTF(ProgCTFEstimateFromPSD &prm,
+                       CTFDescription &output_ctfmodel, bool standalone)
+{
+    return prm.adjustCTF(output_ctfmodel, standalone);
+}
+
 void ProgCTFEstimateFromPSD::run()
 {
     CTFDescription ctfmodel;
-    ROUT_Adjust_CTF(*this, ctfmodel);
+    adjustCTF(ctfmodel);
 }
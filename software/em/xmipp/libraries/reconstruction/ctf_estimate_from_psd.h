@@ -81,7 +81,73 @@ public:
     
     /// Model simplification
     int                  modelSimplification;
+
+public:
+    /* Fitting state, shared by the steps of adjustCTF and the fitness
+       function. Each object keeps its own state so that several PSDs
+       can be fitted at the same time by different objects. */
+    // The CTF to model
+    MultidimArray<double> *f;
+    // Current theoretical adjustment
+    Matrix1D<double>     *adjust_params;
+    // Correlation with enhanced PSD between rings 1 and 3
+    double               corr13;
+
+    // Frequency of each point in digital units
+    MultidimArray<double> x_digfreq;
+    MultidimArray<double> y_digfreq;
+    MultidimArray<double> w_digfreq;
+    MultidimArray<int>    w_digfreq_r;
+    MultidimArray<double> w_digfreq_r_iN;
+    MultidimArray<double> x_contfreq;
+    MultidimArray<double> y_contfreq;
+    MultidimArray<double> w_contfreq;
+    MultidimArray<double> freq_mask;
+    MultidimArray<double> mask_between_zeroes;
+    MultidimArray<double> w_count;
+
+    MultidimArray<double> psd_exp_radial_derivative;
+    MultidimArray<double> psd_theo_radial_derivative;
+    MultidimArray<double> psd_exp_radial;
+    MultidimArray<double> psd_theo_radial;
+
+    // Penalization for forbidden values of the parameters
+    double               heavy_penalization;
+    // Penalization factor for the background
+    bool                 penalize;
+    double               current_penalty;
+    // Speed up factor
+    int                  evaluation_reduction;
+
+    // CTF model and noise model
+    CTFDescription       current_ctfmodel;
+    CTFDescription       ctfmodel_defoci;
+
+    // Maximum of the gaussian
+    double               max_gauss_freq;
+
+    // Autofocus
+    double               value_th;
+    double               min_freq_psd;
+    double               max_freq_psd;
+
+    // Program status
+    int                  action; // 0: Computing the background (sqrt)
+    // 1: Computing the full background
+    // 2: Computing the envelope
+    // 3: Computing defoci
+    // 4: Computing all CTF parameters
+    // 5: Computing all CTF parameters + Gaussian2
+    // 6: Computing all CTF parameters + Gaussian2
+    // 7: Produce output
+    int                  show_inf; // 0: Do not show
+    // 1: Partially detailed
+    // 2: Very detailed
+
 public:
+    /// Empty constructor
+    ProgCTFEstimateFromPSD();
+
     /// Read parameters
     void readParams();
 
@@ -108,13 +174,68 @@ public:
         It is assumed that ROUT_Adjust_CTF has been already run */
     void generate_model_quadrant(int Ydim, int Xdim, MultidimArray<double> &model);
 
+    /** Core of the Adjust CTF routine.
+        This is the routine which does everything. It returns the fitting error
+        committed in the best fit. Several objects may run it at the same time
+        in different threads. */
+    double adjustCTF(CTFDescription &output_ctfmodel, bool standalone = true);
+
     /** Run */
     void run();
+
+    /// Assign the model from a vector of parameters
+    void assignCTFfromParameters(double *p, CTFDescription &ctfmodel, int ia,
+                                 int l, int modelSimplification);
+
+    /// Generate the model of the PSD with the current parameters
+    void generateModelSoFar(Image<double> &I, bool apply_log = false);
+
+    /// Save the current model and profiles
+    void saveIntermediateResults(const FileName &fn_root, bool generate_profiles = true);
+
+    /** Distance between the current model and the PSD.
+        p is the vector of parameters being optimized, starting at index 1 */
+    double CTF_fitness_object(double *p);
+
+    /// Region between the first zeroes
+    void compute_central_region(double &w1, double &w2, double ang);
+
+    /// Center the frequencies of the fitting around the first zeroes
+    void center_optimization_focus(bool adjust_freq, bool adjust_th, double margin = 1);
+
+    /// Estimate the parameters of the sqrt background
+    void estimate_background_sqrt_parameters();
+
+    /// Estimate the parameters of the gaussian background
+    void estimate_background_gauss_parameters();
+
+    /// Estimate the parameters of the second gaussian
+    void estimate_background_gauss_parameters2();
+
+    /// Estimate the parameters of the envelope
+    void estimate_envelope_parameters();
+
+    /// Show the first defoci
+    void showFirstDefoci();
+
+    /// Estimate the defoci by exhaustive search
+    void estimate_defoci();
+
+    /// Estimate the defoci from the Zernike fit of the PSD phase
+    void estimate_defoci_Zernike(MultidimArray<double> &psdToModelFullSize, double min_freq, double max_freq, double Tm,
+                                 double kV, double lambdaPhase, int sizeWindowPhase,
+                                 double &defocusU, double &defocusV, double &ellipseAngle, int verbose);
+
+    /// Estimate the defoci from the Zernike fit of the enhanced PSD
+    void estimate_defoci_Zernike();
 };
 
+/** Fitness function for powellOptimizer.
+    vprm points to the ProgCTFEstimateFromPSD whose state is being fitted. */
+double CTF_fitness(double *p, void *vprm);
+
 /** Core of the Adjust CTF routine.
-    This is the routine which does everything. It returns the fitting error
-    committed in the best fit.*/
+    Same as prm.adjustCTF(output_ctfmodel, standalone). */
 double ROUT_Adjust_CTF(ProgCTFEstimateFromPSD &prm, CTFDescription &output_ctfmodel, 
     bool standalone = true);
 //@}
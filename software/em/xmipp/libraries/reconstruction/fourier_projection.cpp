@@ -38,26 +38,32 @@ FourierProjector::FourierProjector(MultidimArray<double> &V, double paddFactor,
 
 void FourierProjector::project(double rot, double tilt, double psi, const MultidimArray<double> *ctf)
 {
-    double freqy, freqx;
-    std::complex< double > f;
     Euler_angles2matrix(rot,tilt,psi,E);
+    computeCentralSlice(E,projectionFourier,ctf);
+    transformer2D.inverseFourierTransform();
+}
 
-    projectionFourier.initZeros();
+void FourierProjector::computeCentralSlice(const Matrix2D<double> &Euler,
+        MultidimArray< std::complex<double> > &sliceFourier,
+        const MultidimArray<double> *ctf) const
+{
+    double freqy, freqx;
+    sliceFourier.initZeros();
     double maxFreq2=maxFrequency*maxFrequency;
     double volumePaddedSize=XSIZE(VfourierRealCoefs);
     int Xdim=(int)XSIZE(VfourierRealCoefs);
     int Ydim=(int)YSIZE(VfourierRealCoefs);
     int Zdim=(int)ZSIZE(VfourierRealCoefs);
 
-    for (size_t i=0; i<YSIZE(projectionFourier); ++i)
+    for (size_t i=0; i<YSIZE(sliceFourier); ++i)
     {
         FFT_IDX2DIGFREQ(i,volumeSize,freqy);
         double freqy2=freqy*freqy;
 
-        double freqYvol_X=MAT_ELEM(E,1,0)*freqy;
-        double freqYvol_Y=MAT_ELEM(E,1,1)*freqy;
-        double freqYvol_Z=MAT_ELEM(E,1,2)*freqy;
-        for (size_t j=0; j<XSIZE(projectionFourier); ++j)
+        double freqYvol_X=MAT_ELEM(Euler,1,0)*freqy;
+        double freqYvol_Y=MAT_ELEM(Euler,1,1)*freqy;
+        double freqYvol_Z=MAT_ELEM(Euler,1,2)*freqy;
+        for (size_t j=0; j<XSIZE(sliceFourier); ++j)
         {
             // The frequency of pairs (i,j) in 2D
             FFT_IDX2DIGFREQ(j,volumeSize,freqx);
@@ -67,9 +73,9 @@ void FourierProjector::project(double rot, double tilt, double psi, const Multid
                 continue;
 
             // Compute corresponding frequency in the volume
-            double freqvol_X=freqYvol_X+MAT_ELEM(E,0,0)*freqx;
-            double freqvol_Y=freqYvol_Y+MAT_ELEM(E,0,1)*freqx;
-            double freqvol_Z=freqYvol_Z+MAT_ELEM(E,0,2)*freqx;
+            double freqvol_X=freqYvol_X+MAT_ELEM(Euler,0,0)*freqx;
+            double freqvol_Y=freqYvol_Y+MAT_ELEM(Euler,0,1)*freqx;
+            double freqvol_Z=freqYvol_Z+MAT_ELEM(Euler,0,2)*freqx;
 
             double c,d;
             if (BSplineDeg==0)
@@ -183,12 +189,78 @@ void FourierProjector::project(double rot, double tilt, double psi, const Multid
             double ab_cd = (a + b) * (c + d);
 
             // And store the multiplication
-            double *ptrI_ij=(double *)&DIRECT_A2D_ELEM(projectionFourier,i,j);
+            double *ptrI_ij=(double *)&DIRECT_A2D_ELEM(sliceFourier,i,j);
             *ptrI_ij = ac - bd;
             *(ptrI_ij+1) = ab_cd - ac - bd;
         }
     }
-    transformer2D.inverseFourierTransform();
+}
+
+/* Threads computing projections of the same volume */
+typedef struct
+{
+    const FourierProjector *projector;
+    const std::vector<double> *rot, *tilt, *psi;
+    const std::vector<const MultidimArray<double> *> *ctfs;
+    MultidimArray<double> *projections;
+    ThreadTaskDistributor *td;
+}
+FourierProjectorThreadParams;
+
+void threadFourierProjections(ThreadArgument &thArg)
+{
+    FourierProjectorThreadParams *params = (FourierProjectorThreadParams *) thArg.workClass;
+    const FourierProjector &projector = *params->projector;
+    MultidimArray<double> &projections = *params->projections;
+
+    // The volume coefficients are shared, each thread has its own
+    // projection, transformer and Euler matrix
+    MultidimArray<double> I;
+    MultidimArray< std::complex<double> > IFourier;
+    FourierTransformer transformer;
+    Matrix2D<double> E;
+    I.initZeros(projector.volumeSize,projector.volumeSize);
+    I.setXmippOrigin();
+    transformer.FourierTransform(I,IFourier,false);
+
+    size_t imgSize = MULTIDIM_SIZE(I) * sizeof(double);
+    size_t first, last;
+    while (params->td->getTasks(first, last))
+        for (size_t n = first; n <= last; n++)
+        {
+            Euler_angles2matrix((*params->rot)[n],(*params->tilt)[n],(*params->psi)[n],E);
+            const MultidimArray<double> *ctf = (params->ctfs == NULL) ? NULL : (*params->ctfs)[n];
+            projector.computeCentralSlice(E,IFourier,ctf);
+            transformer.inverseFourierTransform();
+            memcpy(&DIRECT_NZYX_ELEM(projections,n,0,0,0),MULTIDIM_ARRAY(I),imgSize);
+        }
+}
+
+void FourierProjector::project(const std::vector<double> &rot, const std::vector<double> &tilt,
+                               const std::vector<double> &psi, MultidimArray<double> &projections,
+                               int threads, const std::vector<const MultidimArray<double> *> *ctfs) const
+{
+    size_t N = rot.size();
+    if (tilt.size() != N || psi.size() != N)
+        REPORT_ERROR(ERR_ARG_INCORRECT, "FourierProjector: there must be as many tilt and psi angles as rot angles");
+    if (ctfs != NULL && ctfs->size() != N)
+        REPORT_ERROR(ERR_ARG_INCORRECT, "FourierProjector: there must be as many CTFs as projection directions");
+    projections.resizeNoCopy(N,1,volumeSize,volumeSize);
+    projections.setXmippOrigin();
+    if (N == 0)
+        return;
+
+    FourierProjectorThreadParams params;
+    params.projector = this;
+    params.rot = &rot;
+    params.tilt = &tilt;
+    params.psi = &psi;
+    params.ctfs = ctfs;
+    params.projections = &projections;
+    params.td = new ThreadTaskDistributor(N, 1);
+    ThreadManager thMgr(XMIPP_MAX(1, XMIPP_MIN(threads, (int)N)), &params);
+    thMgr.run(threadFourierProjections);
+    delete params.td;
 }
 
 void FourierProjector::produceSideInfo()
@@ -80,6 +80,28 @@ public:
      * This method gets the volume's Fourier and the Euler's angles as the inputs and interpolates the related projection
      */
     void project(double rot, double tilt, double psi, const MultidimArray<double> *ctf=NULL);
+
+    /**
+     * Projections in several directions.
+     * The image n of the stack is the projection in the direction (rot[n], tilt[n], psi[n]),
+     * multiplied in Fourier space by (*ctfs)[n] if ctfs is not NULL. The CTFs have the size
+     * of the Fourier transform of a projection, a NULL CTF is not applied. The directions are
+     * distributed among the threads, that share the volume coefficients and have their own
+     * transformer. The member projection is not modified.
+     */
+    void project(const std::vector<double> &rot, const std::vector<double> &tilt,
+                 const std::vector<double> &psi, MultidimArray<double> &projections,
+                 int threads=1, const std::vector<const MultidimArray<double> *> *ctfs=NULL) const;
+
+    /**
+     * Central slice of the volume in Fourier space for the Euler matrix.
+     * sliceFourier must have the size of the Fourier transform of a projection.
+     * The volume coefficients are only read, so that several threads can compute
+     * slices at the same time.
+     */
+    void computeCentralSlice(const Matrix2D<double> &Euler,
+                             MultidimArray< std::complex<double> > &sliceFourier,
+                             const MultidimArray<double> *ctf=NULL) const;
 private:
     /*
      * This is a private method which provides the values for the class variable
@@ -35,6 +35,7 @@
 #include <data/xmipp_funcs.h>
 #include <data/metadata_extension.h>
 #include <data/xmipp_image.h>
+#include <data/xmipp_image_stack_map.h>
 #include <data/geometry.h>
 #include <data/filters.h>
 #include <data/mask.h>
@@ -70,7 +71,7 @@
 //For MPI
 #define IS_MASTER (rank == 0)
 //threads tasks
-typedef enum { TH_EXIT, TH_ESI_REFNO, TH_ESI_UPDATE_REFNO, TH_RR_REFNO, TH_RRR_REFNO, TH_PFS_REFNO } ThreadTask;
+typedef enum { TH_ESI_REFNO, TH_ESI_UPDATE_REFNO, TH_RR_REFNO, TH_RRR_REFNO, TH_PFS_REFNO, TH_PFS_WEIGHTS_REFNO } ThreadTask;
 //output types constants
 typedef enum { OUT_BLOCK, OUT_ITER, OUT_FINAL, OUT_REFS, OUT_IMGS } OutputType;
 
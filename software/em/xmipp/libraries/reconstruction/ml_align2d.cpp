@@ -28,15 +28,13 @@
 //Mutex for each thread update sums
 pthread_mutex_t update_mutex =
     PTHREAD_MUTEX_INITIALIZER;
-//Mutex for each thread get next refno
-pthread_mutex_t refno_mutex =
-    PTHREAD_MUTEX_INITIALIZER;
 
 // Constructor
 ProgML2D::ProgML2D()
 {
     do_ML3D = false;
     refs_per_class = 1;
+    pool = NULL;
 }
 
 
@@ -686,8 +684,8 @@ void ProgML2D::preselectFastSignificant()
     pfs_maxweight.initConstant(-99.e99);
     pfs_weight.resizeNoCopy(model.n_ref, nr_psi * nr_flip);
     pfs_weight.initZeros();
-    pfs_count = threads;
     awakeThreads(TH_PFS_REFNO, 0, refno_load_param);
+    awakeThreads(TH_PFS_WEIGHTS_REFNO, 0, refno_load_param);
 
 #ifdef DEBUG
 
@@ -928,134 +926,67 @@ void ProgML2D::expectationSingleImage(Matrix1D<double> &opt_offsets)
 /** Function to create threads that will work later */
 void ProgML2D::createThreads()
 {
-
-    //Initialize some variables for using for threads
-
-    th_ids = new pthread_t[threads];
-    threads_d = new structThreadTasks[threads];
-
-    barrier_init(&barrier, threads + 1);
-    barrier_init(&barrier2, threads + 1);
-    barrier_init(&barrier3, threads);//Main thread will not wait here
-
-    for (int i = 0; i < threads; i++)
-    {
-        threads_d[i].thread_id = i;
-        threads_d[i].prm = this;
-
-        int result = pthread_create((th_ids + i), NULL, doThreadsTasks,
-                                    (void *) (threads_d + i));
-
-        if (result != 0)
-        {
-            REPORT_ERROR(ERR_THREADS_NOTINIT, "");
-        }
-    }
-
+    pool = new ThreadPool(threads);
 }//close function createThreads
 
 /** Free threads memory and exit */
 void ProgML2D::destroyThreads()
 {
-    threadTask = TH_EXIT;
-    barrier_wait(&barrier);
-    delete[] th_ids;
-    delete[] threads_d;
+    delete pool;
+    pool = NULL;
 }
 
-/// Function for threads do different tasks
-void * doThreadsTasks(void * data)
+/* Body of the refno loops run by the threads */
+class ML2DRefnoBody: public ParallelForBody
 {
-    structThreadTasks * thread_data = (structThreadTasks *) data;
+public:
+    ProgML2D * prm;
+    ThreadTask task;
 
-    ProgML2D * prm = thread_data->prm;
-
-    barrier_t & barrier = prm->barrier;
-    barrier_t & barrier2 = prm->barrier2;
-
-    //Loop until the threadTask become TH_EXIT
-
-    do
+    void run(size_t first, size_t last, int thread_id)
     {
-        //Wait until main threads order to start
-        //debug_print("Waiting on barrier, th ", thread_id);
-        barrier_wait(&barrier);
-
-        //Check task to do
-
-        switch (prm->threadTask)
+        switch (task)
         {
-
         case TH_PFS_REFNO:
-            prm->doThreadPreselectFastSignificantRefno();
+            prm->doThreadPreselectFastSignificantRefno(first, last);
+            break;
+
+        case TH_PFS_WEIGHTS_REFNO:
+            prm->doThreadPreselectFastSignificantWeightsRefno(first, last);
             break;
 
         case TH_ESI_REFNO:
-            prm->doThreadExpectationSingleImageRefno();
+            prm->doThreadExpectationSingleImageRefno(first, last);
             break;
 
         case TH_ESI_UPDATE_REFNO:
-            prm->doThreadESIUpdateRefno();
+            prm->doThreadESIUpdateRefno(first, last);
             break;
 
         case TH_RR_REFNO:
-            prm->doThreadRotateReferenceRefno();
+            prm->doThreadRotateReferenceRefno(first, last);
             break;
 
         case TH_RRR_REFNO:
-            prm->doThreadReverseRotateReferenceRefno();
+            prm->doThreadReverseRotateReferenceRefno(first, last);
             break;
-
-        case TH_EXIT:
-            pthread_exit(NULL);
-            break;
-
         }
-
-        barrier_wait(&barrier2);
-
     }
-    while (1);
-
-}//close function doThreadsTasks
-
-
-/// Function to assign refno jobs to threads
-/// the starting refno is passed through the out refno parameter
-/// and is returned the number of refno's to do, 0 if no more refno's.
-int ProgML2D::getThreadRefnoJob(int &refno)
-{
-    int load = 0;
-
-    pthread_mutex_lock(&refno_mutex);
-
-    if (refno_count < model.n_ref)
-    {
-        load = XMIPP_MIN(refno_load, model.n_ref - refno_count);
-        refno = refno_index;
-        refno_index = (refno_index + load) % model.n_ref;
-        refno_count += load;
-    }
-
-    pthread_mutex_unlock(&refno_mutex);
-
-    return load;
-}//close function getThreadRefnoJob
+};
 
 ///Function for awake threads for different tasks
 void ProgML2D::awakeThreads(ThreadTask task, int start_refno, int load)
 {
-    threadTask = task;
-    refno_index = start_refno;
-    refno_count = 0;
-    refno_load = load;
-    barrier_wait(&barrier);
-    //Wait until done
-    barrier_wait(&barrier2);
+    ML2DRefnoBody body;
+    body.prm = this;
+    body.task = task;
+    // Blocks of refno are stolen by the idle threads, so that references
+    // of very different significance do not leave threads waiting
+    pool->parallelFor(model.n_ref, load, body, start_refno);
 }//close function awakeThreads
 
 
-void ProgML2D::doThreadRotateReferenceRefno()
+void ProgML2D::doThreadRotateReferenceRefno(int firstRefno, int lastRefno)
 {
 #ifdef DEBUG
     std::cerr << "entering doThreadRotateReference " << std::endl;
@@ -1116,7 +1047,7 @@ void ProgML2D::doThreadRotateReferenceRefno()
 
 }//close function doThreadRotateReferenceRefno
 
-void ProgML2D::doThreadReverseRotateReferenceRefno()
+void ProgML2D::doThreadReverseRotateReferenceRefno(int firstRefno, int lastRefno)
 {
     double psi, dum, avg;
     MultidimArray<double> Maux(dim, dim), Maux2(dim, dim), Maux3(dim, dim);
@@ -1163,15 +1094,14 @@ void ProgML2D::doThreadReverseRotateReferenceRefno()
 #define MAX_WEIGHT (dAij(pfs_maxweight, imirror, refno))
 #define MSIGNIFICANT (dAij(Msignificant, refno, IROT))
 
-void ProgML2D::doThreadPreselectFastSignificantRefno()
+void ProgML2D::doThreadPreselectFastSignificantRefno(int firstRefno, int lastRefno)
 {
     MultidimArray<double> Mtrans, Mflip;
-    double ropt, aux, diff, pdf, fracpdf;
+    double ropt, diff;
     double A2_plus_Xi2;
     int irefmir;
     Matrix1D<double> trans(2);
     double local_mindiff;
-    double sigma_noise2 = model.sigma_noise * model.sigma_noise;
     int nr_mirror = (do_mirror) ? 2 : 1;
 
     Mtrans.resize(dim, dim);
@@ -1228,15 +1158,22 @@ void ProgML2D::doThreadPreselectFastSignificantRefno()
     ///Update the real mindiff
     pthread_mutex_lock(&update_mutex);
     pfs_mindiff = XMIPP_MIN(pfs_mindiff, local_mindiff);
-    refno_index = refno_count = 0;
     pthread_mutex_unlock(&update_mutex);
 
-    ///Wait for all threads update mindiff
-    barrier_wait(&barrier3);
-    local_mindiff = pfs_mindiff;
+}//close function doThreadPreselectFastSignificantRefno
+
+void ProgML2D::doThreadPreselectFastSignificantWeightsRefno(int firstRefno, int lastRefno)
+{
+    double aux, pdf, fracpdf;
+    int irefmir;
+    Matrix1D<double> trans(2);
+    double sigma_noise2 = model.sigma_noise * model.sigma_noise;
+    int nr_mirror = (do_mirror) ? 2 : 1;
+    // All threads have updated pfs_mindiff in the previous pass
+    double local_mindiff = pfs_mindiff;
 
     // B. Now that we have local_mindiff, calculate the weights
-    FOR_ALL_THREAD_REFNO_NODECL()
+    FOR_ALL_THREAD_REFNO()
     {
 
         if (!limit_rot || pdf_directions[refno] > 0.)
@@ -1282,9 +1219,9 @@ void ProgML2D::doThreadPreselectFastSignificantRefno()
         } //endif limit_rot and pdf_directions
     } //end for_all refno
 
-}//close function doThreadPreselectFastSignificantRefno
+}//close function doThreadPreselectFastSignificantWeightsRefno
 
-void ProgML2D::doThreadExpectationSingleImageRefno()
+void ProgML2D::doThreadExpectationSingleImageRefno(int firstRefno, int lastRefno)
 {
     double diff;
     double aux, pdf, fracpdf, A2_plus_Xi2;
@@ -1613,7 +1550,7 @@ void ProgML2D::doThreadExpectationSingleImageRefno()
 
 }//close function doThreadExpectationSingleImage
 
-void ProgML2D::doThreadESIUpdateRefno()
+void ProgML2D::doThreadESIUpdateRefno(int firstRefno, int lastRefno)
 {
 
     double scale_dim2_sumw = (opt_scale * ddim2) / sum_refw;
@@ -1778,7 +1715,8 @@ void ProgML2D::expectation()
             mygroup = (factor_nref > 1) ? divide_equally_group(nr_images_global, factor_nref, imgno) : 0;
 
             MDimg.getValue(MDL_IMAGE, fn_img, img_id[imgno]);
-            img.read(fn_img);
+            // Cast from the mapped stack, aliased only if it is stored in double
+            stackMaps.read(fn_img, img());
             img().setXmippOrigin();
             Xi2 = img().sum2();
             Mimg = img();
@@ -29,29 +29,12 @@
 #include "ml2d.h"
 
 ///******** Some macro definitions ****************
-///Useful macro for thread iteration and work over all refno
+///Useful macro for thread iteration over the block of refno given to a thread
 #define FOR_ALL_THREAD_REFNO() \
-int refno, load; \
-while ((load = getThreadRefnoJob(refno)) > 0) \
-    for (int i = 0; i < load; i++, refno = (refno + 1) % model.n_ref)
-///Same macro as before, but without declaring refno and load
-#define FOR_ALL_THREAD_REFNO_NODECL() \
-while ((load = getThreadRefnoJob(refno)) > 0) \
-    for (int i = 0; i < load; i++, refno = (refno + 1) % model.n_ref)
-
-class ProgML2D;
-// This structure is needed to pass parameters to the threads
-typedef struct
-{
-    int thread_id;
-    ProgML2D * prm;
-}
-structThreadTasks;
+    for (int refno = firstRefno; refno <= lastRefno; ++refno)
 
 #define SPECIAL_ITER 0
 
-void * doThreadsTasks(void * data);
-
 /**@defgroup MLalign2D ml_align2d (Maximum likelihood in 2D)
    @ingroup ReconsLibrary */
 //@{
@@ -63,11 +46,8 @@ public:
   bool no_iem;
 
     MultidimArray<int> mask, omask;
-    /** Thread stuff */
-    int threadTask;
-    barrier_t barrier, barrier2, barrier3;
-    pthread_t * th_ids;
-    structThreadTasks * threads_d;
+    /** Pool of threads, created once for all the iterations */
+    ThreadPool * pool;
 
     /** New class variables, taken from old MAIN */
     double LL, sumfracweight;
@@ -76,6 +56,12 @@ public:
     std::vector<MultidimArray<double > > wsum_Mref;
     MultidimArray<int> Msignificant;
     MultidimArray<double> Mimg;
+    /** Stacks of the experimental images, mapped once instead of
+     * reading the images in every iteration. The images are double and
+     * the stacks are usually float, so each image is still cast from the
+     * mapped data: the mapping saves opening the stack and reading its
+     * header for every image, not the copy. */
+    ImageStackMaps stackMaps;
     std::vector<double> allref_offsets;
     std::vector<double> pdf_directions;
     std::vector<MultidimArray<double> > mref;
@@ -99,16 +85,14 @@ public:
     double pfs_mindiff;
     MultidimArray<double> pfs_maxweight;
     MultidimArray<double> pfs_weight;
-    int pfs_count;
 
     /** Sum of squared amplitudes of the references */
     std::vector<double> A2;
     /** Sum of squared amplitudes of the experimental image */
     double Xi2;
 
-    //These are for refno work assigns to threads
-    size_t refno_index, refno_load_param;
-    int refno_load, refno_count;
+    //Number of refno in each block of work of the threads
+    size_t refno_load_param;
     // Which group does this image belong to in iteration 0 (generation of K references)
     int mygroup;
     /// Read arguments from command line
@@ -152,26 +136,29 @@ public:
     /// Exit threads and free memory
     void destroyThreads();
 
-    /// Assign refno jobs to threads
-    int getThreadRefnoJob(int &refno);
-
-    /// Awake threads for different tasks
+    /** Run a task for all refno with the pool of threads.
+     * The refno are given to the threads in blocks of load refno,
+     * starting at start_refno, and waits until all are done.
+     */
     void awakeThreads(ThreadTask task, int start_refno, int load = 1);
 
     /// Thread code to parallelize refno loop in rotateReference
-    void doThreadRotateReferenceRefno();
+    void doThreadRotateReferenceRefno(int firstRefno, int lastRefno);
 
     ///Thread code to parallelize refno loop in reverseRotateReference
-    void doThreadReverseRotateReferenceRefno();
+    void doThreadReverseRotateReferenceRefno(int firstRefno, int lastRefno);
 
     /// Thread code to parallelize refno loop in preselectFastSignificant
-    void doThreadPreselectFastSignificantRefno();
+    void doThreadPreselectFastSignificantRefno(int firstRefno, int lastRefno);
+
+    /// Thread code to compute the weights in preselectFastSignificant, once pfs_mindiff is known
+    void doThreadPreselectFastSignificantWeightsRefno(int firstRefno, int lastRefno);
 
     /// Thread code to parallelize refno loop in expectationSingleImage
-    void doThreadExpectationSingleImageRefno();
+    void doThreadExpectationSingleImageRefno(int firstRefno, int lastRefno);
 
     /// Thread code to parallelize update loop in ESI
-    void doThreadESIUpdateRefno();
+    void doThreadESIUpdateRefno(int firstRefno, int lastRefno);
 
     /// Perform an iteration
     virtual void iteration();
@@ -367,6 +367,9 @@ void ProgMLRefine3D::produceSideInfo()
     copyVolumes();
     // Project volumes and store projections in a metadata
     projectVolumes(ml2d->MDref);
+    // The starting references are read by ML2D from disc
+    writeProjections(ml2d->MDref);
+    gallery.clear();
 //    //FIXME: this is for concurrency problem...remove after that
 //    FileName myImg = fn_root + formatString("images_node%02d.xmd", rank);
 //    MetaData(fn_sel).write(myImg);
@@ -397,9 +400,6 @@ void ProgMLRefine3D::run()
     produceSideInfo2();
     ml2d->createThreads();
 
-    //Local image to read data
-    Image<double> img;
-    FileName fn;
     bool doProject = false;
 
     // Loop over all iterations
@@ -425,18 +425,13 @@ void ProgMLRefine3D::run()
             if (doProject)// || ml2d->current_block > 0)
             {
                 projectVolumes(ml2d->MDref);
-                int refno = 0;
 
-                // Read new references from disc (I could just as well keep them in memory, maybe...)
-                FOR_ALL_OBJECTS_IN_METADATA(ml2d->MDref)
-                {
-                    ml2d->MDref.getValue(MDL_IMAGE, fn, __iter.objId);
-                    img.read(fn);
-                    img().setXmippOrigin();
-                    ml2d->model.Iref[refno]() = img();
-                    if (++refno == ml2d->model.n_ref) //avoid reading noise and c_ref projections
-                        break;
-                }
+                // Take the new references from the gallery
+                //avoid noise and c_ref projections
+                size_t nref = XMIPP_MIN((size_t)ml2d->model.n_ref, gallery.size());
+                for (size_t refno = 0; refno < nref; ++refno)
+                    gallery.getProjection(refno, ml2d->model.Iref[refno]());
+                gallery.clear();
             }
             LOG("Calling ML2D Expectation");
             // Integrate over all images
@@ -504,13 +499,7 @@ void ProgMLRefine3D::createEmptyFiles(int type)
     getImageSizeFromFilename(fn_sel, dim, idum, idum, idumLong);
     Image<double> img;
 
-    if (type == EMPTY_PROJECTIONS)
-        createEmptyFile(FN_PROJECTIONS, dim, dim, 1, Nvols*nr_projections, true);
-    //    {
-    //        img().initZeros(dim, dim);
-    //        img.write(FN_PROJECTIONS, Nvols * nr_projections, true, WRITE_OVERWRITE);
-    //    }
-    else if (type == EMPTY_VOLUMES)
+    if (type == EMPTY_VOLUMES)
     {
         img().initZeros(dim, dim, dim);
         for (size_t i = 0; i < reconsOutFnBase.size(); ++i)
@@ -519,6 +508,56 @@ void ProgMLRefine3D::createEmptyFiles(int type)
     }
 }
 
+// Gallery of projections ===================================================
+void ProjectionGallery::initialize(size_t n, size_t dim)
+{
+    stack.initZeros(n, 1, dim, dim);
+    rot.assign(n, 0.);
+    tilt.assign(n, 0.);
+    psi.assign(n, 0.);
+    volno.assign(n, 0);
+}
+
+void ProjectionGallery::clear()
+{
+    stack.clear();
+    rot.clear();
+    tilt.clear();
+    psi.clear();
+    volno.clear();
+}
+
+void ProjectionGallery::setProjection(size_t n, const MultidimArray<double> &proj)
+{
+    if (n >= size())
+        REPORT_ERROR(ERR_INDEX_OUTOFBOUNDS, formatString("ProjectionGallery: projection %lu out of %lu", n, size()));
+    if (XSIZE(proj) != XSIZE(stack) || YSIZE(proj) != YSIZE(stack))
+        REPORT_ERROR(ERR_MULTIDIM_SIZE, "ProjectionGallery: the projection size is not the one of the gallery");
+    memcpy(&DIRECT_NZYX_ELEM(stack, n, 0, 0, 0), MULTIDIM_ARRAY(proj), YXSIZE(stack) * sizeof(double));
+}
+
+void ProjectionGallery::getProjection(size_t n, MultidimArray<double> &proj) const
+{
+    if (n >= size())
+        REPORT_ERROR(ERR_INDEX_OUTOFBOUNDS, formatString("ProjectionGallery: projection %lu out of %lu", n, size()));
+    MultidimArray<double> aux;
+    aux.aliasImageInStack(stack, n);
+    proj = aux;
+    proj.setXmippOrigin();
+}
+
+void ProjectionGallery::write(const FileName &fnStack) const
+{
+    createEmptyFile(fnStack, XSIZE(stack), YSIZE(stack), 1, size(), true);
+    Image<double> img;
+    for (size_t n = 0; n < size(); ++n)
+    {
+        img().aliasImageInStack(stack, n);
+        img.setEulerAngles(rot[n], tilt[n], psi[n]);
+        img.write(fnStack, n + FIRST_IMAGE, true, WRITE_REPLACE);
+    }
+}
+
 // Projection of the reference (blob) volume =================================
 void ProgMLRefine3D::projectVolumes(MetaData &mdProj)
 {
@@ -529,7 +568,7 @@ void ProgMLRefine3D::projectVolumes(MetaData &mdProj)
     FileName                      fn_base = FN_PROJECTIONS, fn_tmp;
     Projection                    proj;
     double                       rot, tilt, psi = 0.;
-    size_t                        nl, nr_dir, id, bar_step;
+    size_t                        nl, nr_dir, id, bar_step, dim, idum, idumLong;
     int                           volno;
 
     // Here all nodes fill SFlib and DFlib, but each node actually projects
@@ -538,8 +577,10 @@ void ProgMLRefine3D::projectVolumes(MetaData &mdProj)
     nl = Nvols * nr_projections;
     bar_step = XMIPP_MAX(1, nl / 60);
 
-    // Initialize projections output metadata
+    // Initialize projections output metadata and the gallery
     mdProj.clear();
+    getImageSizeFromFilename(fn_sel, dim, idum, idum, idumLong);
+    gallery.initialize(nl, dim);
 
     if (verbose)
     {
@@ -547,39 +588,36 @@ void ProgMLRefine3D::projectVolumes(MetaData &mdProj)
         //init_progress_bar(nl);
     }
 
-    createEmptyFiles(EMPTY_PROJECTIONS);
-
     // Loop over all reference volumes
     volno = nr_dir = 0;
 
-    //std::cerr << "DEBUG_JM: ProgMLRefine3D::projectVolumes" <<std::endl;
     MDIterator iter(mdVol);
     for (size_t i = 0; i < Nvols; ++i)
-    //FOR_ALL_OBJECTS_IN_METADATA(mdVol)
     {
         mdVol.getValue(MDL_IMAGE, fn_tmp, iter.objId);
-        //std::cerr << "DEBUG_JM: fn_tmp: " << fn_tmp << std::endl;
         vol.read(fn_tmp);
         vol().setXmippOrigin();
         ++volno;
 
         for (int ilib = 0; ilib < nr_projections; ++ilib)
         {
-            ++nr_dir;
-            fn_tmp.compose(nr_dir, fn_base);
             rot = XX(mysampling.no_redundant_sampling_points_angles[ilib]);
             tilt = YY(mysampling.no_redundant_sampling_points_angles[ilib]);
+            gallery.rot[nr_dir] = rot;
+            gallery.tilt[nr_dir] = tilt;
+            gallery.psi[nr_dir] = psi;
+            gallery.volno[nr_dir] = volno;
 
-            // Parallelization: each rank projects and writes a different direction
+            // Parallelization: each rank projects a different direction,
+            // the others are left to zero in its gallery
+            ++nr_dir;
             if (nr_dir % size == rank)
             {
                 projectVolume(vol(), proj, vol().rowNumber(), vol().colNumber(), rot, tilt, psi);
-                //proj.setEulerAngles(rot, tilt, psi);
-                //std::cerr << formatString("DEBUG_JM: Proyecting vol: %s, rot: %f, tilt: %f, psi: %f", fn_tmp.c_str(), rot, tilt, psi) <<std::endl;
-                proj.write(fn_tmp);
-                //proj.write(formatString("%s_iter%d.stk", fn_tmp.c_str(), iter));
+                gallery.setProjection(nr_dir - 1, proj());
             }
 
+            fn_tmp.compose(nr_dir, fn_base);
             id = mdProj.addObject();
             mdProj.setValue(MDL_IMAGE, fn_tmp, id);
             mdProj.setValue(MDL_ENABLED, 1, id);
@@ -599,18 +637,14 @@ void ProgMLRefine3D::projectVolumes(MetaData &mdProj)
         //progress_bar(nl);
         std::cout << " -----------------------------------------------------------------" << std::endl;
     }
+}
 
-    // Only the master write the complete SFlib
-    if (rank == 0)
-    {
-        fn_tmp = FN_PROJECTIONS_MD;
-        mdProj.write(fn_tmp);
-        //Just copying projections md for debugging
-        //fn_tmp.copyFile(formatString("%s_iter%d_projections.xmd", fn_root.c_str(), iter));
-        //Also copying projections stack
-        //FileName(FN_PROJECTIONS).copyFile(formatString("%s_iter%d_projections.stk", fn_root.c_str(), iter));
-    }
-
+void ProgMLRefine3D::writeProjections(MetaData &mdProj)
+{
+    LOG_FUNCTION();
+    gallery.write(FN_PROJECTIONS);
+    FileName fn_tmp = FN_PROJECTIONS_MD;
+    mdProj.write(fn_tmp);
 }
 
 // Make noise images for 3D SSNR calculation ===================================
@@ -762,14 +796,24 @@ void ProgMLRefine3D::reconstructVolumes()
             //for now each node reconstruct one volume
             if (volno_index % size == rank)
             {
-                //fn_vol.compose(volno, fn_base);
+                // The references are still in memory, with MDL_REF in the metadata,
+                // Fourier reconstruction takes them from there
+                bool inMemory = (i == 0 && recons_type == RECONS_FOURIER);
 				mdProj.read(reconsMdFn[i]);
                 fn_one.compose(fn_base, volno, "projections.xmd");
                 // Select only relevant projections to reconstruct
                 mdOne.importObjects(mdProj, MDValueEQ(MDL_REF3D, volno));
+                // Written also when the images are in memory, it is the input of the program
                 mdOne.write(fn_one);
                 // Set input/output for the reconstruction algorithm
 				reconsProgram = createReconsProgram(fn_one, fn_vol);
+                if (inMemory)
+                {
+                    ProgRecFourier * fourierProgram = dynamic_cast<ProgRecFourier *>(reconsProgram);
+                    if (fourierProgram == NULL)
+                        REPORT_ERROR(ERR_TYPE_INCORRECT, "ML3D: the references in memory can only be reconstructed with Fourier");
+                    fourierProgram->setInputImages(mdOne, ml2d->model.Iref);
+                }
                 reconsProgram->run();
 				delete reconsProgram;
             }
@@ -35,7 +35,6 @@
 #define RECONS_ART 0
 #define RECONS_FOURIER 1
 
-#define EMPTY_PROJECTIONS 0
 #define EMPTY_VOLUMES 1
 
 #define FN_ITER_VOLMD() getIterExtraPath(fn_root, iter) + "volumes.xmd"
@@ -44,6 +43,45 @@
 /**@defgroup Refine3d ml_refine3d (Maximum likelihood 3D refinement)
    @ingroup ReconsLibrary */
 //@{
+/** Reference projections kept in memory.
+ * The projections of all the reference volumes, in the order of the
+ * projections metadata, are kept in a single stack together with their
+ * directions. In this way they are passed from the projection of the
+ * volumes to the 2D references without going through disk.
+ */
+class ProjectionGallery
+{
+public:
+    /// Stack with one projection per volume and direction
+    MultidimArray<double> stack;
+    /// Euler angles of each projection
+    std::vector<double> rot, tilt, psi;
+    /// Reference volume of each projection, from 1
+    std::vector<int> volno;
+
+public:
+    /// Allocate n projections of size dim x dim, all of them zero
+    void initialize(size_t n, size_t dim);
+
+    /// Free the memory
+    void clear();
+
+    /// Number of projections
+    size_t size() const
+    {
+        return volno.size();
+    }
+
+    /// Store the projection n, from 0
+    void setProjection(size_t n, const MultidimArray<double> &proj);
+
+    /// Copy the projection n, from 0, with its origin at the center
+    void getProjection(size_t n, MultidimArray<double> &proj) const;
+
+    /// Write the projections to a stack, with their angles in the headers
+    void write(const FileName &fnStack) const;
+};
+
 /** Refine3d parameters. */
 class ProgMLRefine3D: public XmippProgram
 {
@@ -92,6 +130,8 @@ public:
     int symmetry, sym_order;
     // Number of reference projections per 3D model
     int nr_projections;
+    // Projections of the current iteration
+    ProjectionGallery gallery;
 
     //MPI related stuff
     size_t rank, size;
@@ -130,13 +170,16 @@ public:
     void run();
 
     /// Create an empty file to avoid read/write conflicts when running in parallel
-    /// it will be used for projections and volumes stacks
+    /// it will be used for volumes stacks
     virtual void createEmptyFiles(int type);
 
     /// Project the reference volumes in evenly sampled directions
-    /// fill the metadata mdProj with the projections data
+    /// into the gallery, fill the metadata mdProj with the projections data
     virtual void projectVolumes(MetaData &mdProj) ;
 
+    /// Write the gallery and the metadata of the projections to disc
+    virtual void writeProjections(MetaData &mdProj);
+
     /// (For mpi-version only:) calculate noise averages and write to disc
     virtual void makeNoiseImages() ;
 
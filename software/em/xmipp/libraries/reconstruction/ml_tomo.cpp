@@ -31,6 +31,17 @@
 pthread_mutex_t mltomo_weightedsum_update_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t mltomo_selfile_access_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+// Constructor ===========================================================
+ProgMLTomo::ProgMLTomo()
+{
+    pool = NULL;
+}
+
+ProgMLTomo::~ProgMLTomo()
+{
+    delete pool;
+}
+
 // Usage ===================================================================
 void
 ProgMLTomo::defineParams()
@@ -2700,32 +2711,35 @@ ProgMLTomo::maxConstrainedCorrSingleImage(MultidimArray<double> &Mimg,
 
 }
 
-void *
-threadMLTomoExpectationSingleImage(void * data)
+/* Expectation of blocks of images, run by the threads */
+class MLTomoExpectationBody: public ParallelForBody
 {
-    structThreadExpectationSingleImage * thread_data =
-        (structThreadExpectationSingleImage *) data;
-
-    // Variables from above
-    int thread_id = thread_data->thread_id;
-    ProgMLTomo *prm = thread_data->prm;
-    MetaData *MDimg = thread_data->MDimg;
-    double *wsum_sigma_noise = thread_data->wsum_sigma_noise;
-    double *wsum_sigma_offset = thread_data->wsum_sigma_offset;
-    double *sumfracweight = thread_data->sumfracweight;
-    double *LL = thread_data->LL;
-    std::vector<MultidimArray<double> > *wsumimgs = thread_data->wsumimgs;
-    std::vector<MultidimArray<double> > *wsumweds = thread_data->wsumweds;
-    std::vector<Image<double> > *Iref = thread_data->Iref;
-
-    MultidimArray<double> *sumw = thread_data->sumw;
-    std::vector<size_t> * imgs_id = thread_data->imgs_id;
-    ThreadTaskDistributor * distributor = thread_data->distributor;
+public:
+    ProgMLTomo *prm;
+    MetaData *MDimg;
+    double *wsum_sigma_noise;
+    double *wsum_sigma_offset;
+    double *sumfracweight;
+    double *LL;
+    std::vector<MultidimArray<double> > *wsumimgs;
+    std::vector<MultidimArray<double> > *wsumweds;
+    std::vector<Image<double> > *Iref;
+    MultidimArray<double> *sumw;
+    std::vector<size_t> * imgs_id;
+    /// Images already processed, for the progress bar
+    size_t processed;
+    Mutex processedMutex;
+
+    void run(size_t firstIndex, size_t lastIndex, int thread_id);
+};
 
+void
+MLTomoExpectationBody::run(size_t firstIndex, size_t lastIndex, int thread_id)
+{
     //#define DEBUG_THREAD
 #ifdef DEBUG_THREAD
 
-    std::cerr<<"start threadMLTomoExpectationSingleImage"<<std::endl;
+    std::cerr<<"start MLTomoExpectationBody::run"<<std::endl;
 #endif
 
     // Local variables
@@ -2736,105 +2750,87 @@ threadMLTomoExpectationSingleImage(void * data)
     float old_psi = -999.;
     double fracweight, trymindiff, dLL;
     int opt_refno, opt_angno, missno;
+    MultidimArray<double> &docfiledata = prm->docfiledata;
 
-    //try
+    for (size_t imgno = firstIndex; imgno <= lastIndex; ++imgno)
     {
-        //Approximate number of images
-        size_t myNum = MDimg->size() / prm->threads;
-        //First and last image to process in each block
-        size_t firstIndex, lastIndex;
-
-        if (prm->verbose && thread_id == 0)
-            init_progress_bar(myNum);
-
-        // Loop over all images
-        size_t cc = 0;
-        MultidimArray<double> &docfiledata = prm->docfiledata;
+        //TODO: Check if really needed the mutexes
+        //only for read from MetaData
+        pthread_mutex_lock(&mltomo_selfile_access_mutex);
 
-        //Work while there are tasks to do
-        while (distributor->getTasks(firstIndex, lastIndex))
-        {
-            for (size_t imgno = firstIndex; imgno <= lastIndex; ++imgno)
-            {
-                //TODO: Check if really needed the mutexes
-                //only for read from MetaData
-                pthread_mutex_lock(&mltomo_selfile_access_mutex);
+        MDimg->getValue(MDL_IMAGE, fn_img, (*imgs_id)[imgno + prm->myFirstImg]);
 
-                MDimg->getValue(MDL_IMAGE, fn_img, (*imgs_id)[imgno + prm->myFirstImg]);
+        pthread_mutex_unlock(&mltomo_selfile_access_mutex);
 
-                pthread_mutex_unlock(&mltomo_selfile_access_mutex);
+        img.read(fn_img);
+        img().setXmippOrigin();
 
-                img.read(fn_img);
-                img().setXmippOrigin();
+        if (prm->dont_align || prm->do_only_average)
+        {
+            selfTranslate(LINEAR, img(), prm->imgs_optoffsets[imgno], DONT_WRAP);
+        }
+        prm->reScaleVolume(img(), true);
+        missno = (prm->do_missing) ? prm->imgs_missno[imgno] : -1;
+        // These three parameters speed up expectationSingleImage
+        trymindiff = prm->imgs_trymindiff[imgno];
+        opt_refno = prm->imgs_optrefno[imgno];
+        opt_angno = prm->imgs_optangno[imgno];
+        old_psi = prm->imgs_optpsi[imgno];
 
-                if (prm->dont_align || prm->do_only_average)
-                {
-                    selfTranslate(LINEAR, img(), prm->imgs_optoffsets[imgno], DONT_WRAP);
-                }
-                prm->reScaleVolume(img(), true);
-                missno = (prm->do_missing) ? prm->imgs_missno[imgno] : -1;
-                // These three parameters speed up expectationSingleImage
-                trymindiff = prm->imgs_trymindiff[imgno];
-                opt_refno = prm->imgs_optrefno[imgno];
-                opt_angno = prm->imgs_optangno[imgno];
-                old_psi = prm->imgs_optpsi[imgno];
-
-                if (prm->do_ml)
-                {
-                    // A. Use maximum likelihood approach
-                    prm->expectationSingleImage(img(), imgno, missno, old_psi, *Iref,
-                                                *wsumimgs, *wsumweds, *wsum_sigma_noise, *wsum_sigma_offset,
-                                                *sumw, *LL, dLL, fracweight, *sumfracweight, trymindiff,
-                                                opt_refno, opt_angno, opt_offsets);
-                }
-                else
-                {
-                    // B. Use constrained correlation coefficient approach
-                    prm->maxConstrainedCorrSingleImage(img(), imgno, missno, old_psi,
-                                                       *Iref, *wsumimgs, *wsumweds, *sumw, fracweight, *sumfracweight,
-                                                       opt_refno, opt_angno, opt_offsets);
-                }
-                // Store for next iteration
-                prm->imgs_trymindiff[imgno] = trymindiff;
-                prm->imgs_optrefno[imgno] = opt_refno;
-                prm->imgs_optangno[imgno] = opt_angno;
-                // Output MetaData
-                //FIXME: THIS ALSO LIKE JoseMiguel did ML2D
-                dAij(docfiledata, imgno, 0) = (prm->all_angle_info[opt_angno]).rot; // rot
-                dAij(docfiledata, imgno, 1) = (prm->all_angle_info[opt_angno]).tilt; // tilt
-                dAij(docfiledata, imgno, 2) = (prm->all_angle_info[opt_angno]).psi; // psi
-                if (prm->dont_align || prm->do_only_average)
-                {
-                    dAij(docfiledata, imgno, 3) = prm->imgs_optoffsets[imgno](0); // Xoff
-                    dAij(docfiledata, imgno, 4) = prm->imgs_optoffsets[imgno](1); // Yoff
-                    dAij(docfiledata, imgno, 5) = prm->imgs_optoffsets[imgno](2); // zoff
-                }
-                else
-                {
-                    dAij(docfiledata, imgno, 3) = opt_offsets(0) / prm->scale_factor; // Xoff
-                    dAij(docfiledata, imgno, 4) = opt_offsets(1) / prm->scale_factor; // Yoff
-                    dAij(docfiledata, imgno, 5) = opt_offsets(2) / prm->scale_factor; // Zoff
-                }
-                dAij(docfiledata, imgno, 6) = (double) (opt_refno + 1); // Ref
-                dAij(docfiledata, imgno, 7) = (double) (missno + 1); // Wedge number
+        if (prm->do_ml)
+        {
+            // A. Use maximum likelihood approach
+            prm->expectationSingleImage(img(), imgno, missno, old_psi, *Iref,
+                                        *wsumimgs, *wsumweds, *wsum_sigma_noise, *wsum_sigma_offset,
+                                        *sumw, *LL, dLL, fracweight, *sumfracweight, trymindiff,
+                                        opt_refno, opt_angno, opt_offsets);
+        }
+        else
+        {
+            // B. Use constrained correlation coefficient approach
+            prm->maxConstrainedCorrSingleImage(img(), imgno, missno, old_psi,
+                                               *Iref, *wsumimgs, *wsumweds, *sumw, fracweight, *sumfracweight,
+                                               opt_refno, opt_angno, opt_offsets);
+        }
+        // Store for next iteration
+        prm->imgs_trymindiff[imgno] = trymindiff;
+        prm->imgs_optrefno[imgno] = opt_refno;
+        prm->imgs_optangno[imgno] = opt_angno;
+        // Output MetaData
+        //FIXME: THIS ALSO LIKE JoseMiguel did ML2D
+        dAij(docfiledata, imgno, 0) = (prm->all_angle_info[opt_angno]).rot; // rot
+        dAij(docfiledata, imgno, 1) = (prm->all_angle_info[opt_angno]).tilt; // tilt
+        dAij(docfiledata, imgno, 2) = (prm->all_angle_info[opt_angno]).psi; // psi
+        if (prm->dont_align || prm->do_only_average)
+        {
+            dAij(docfiledata, imgno, 3) = prm->imgs_optoffsets[imgno](0); // Xoff
+            dAij(docfiledata, imgno, 4) = prm->imgs_optoffsets[imgno](1); // Yoff
+            dAij(docfiledata, imgno, 5) = prm->imgs_optoffsets[imgno](2); // zoff
+        }
+        else
+        {
+            dAij(docfiledata, imgno, 3) = opt_offsets(0) / prm->scale_factor; // Xoff
+            dAij(docfiledata, imgno, 4) = opt_offsets(1) / prm->scale_factor; // Yoff
+            dAij(docfiledata, imgno, 5) = opt_offsets(2) / prm->scale_factor; // Zoff
+        }
+        dAij(docfiledata, imgno, 6) = (double) (opt_refno + 1); // Ref
+        dAij(docfiledata, imgno, 7) = (double) (missno + 1); // Wedge number
 
-                dAij(docfiledata, imgno, 8) = fracweight; // P_max/P_tot
-                dAij(docfiledata, imgno, 9) = dLL; // log-likelihood
+        dAij(docfiledata, imgno, 8) = fracweight; // P_max/P_tot
+        dAij(docfiledata, imgno, 9) = dLL; // log-likelihood
 
-                if (prm->verbose && thread_id == 0)
-                    progress_bar(cc);
-                cc++;
-            }
-        }
-        if (prm->verbose && thread_id == 0)
-            progress_bar(myNum);
+        // Any thread may finish an image, the bar is drawn under the lock
+        processedMutex.lock();
+        ++processed;
+        if (prm->verbose)
+            progress_bar(processed);
+        processedMutex.unlock();
     }
 
 #ifdef DEBUG_THREAD
 
-    std::cerr<<"finished threadMLTomoExpectationSingleImage"<<std::endl;
+    std::cerr<<"finished MLTomoExpectationBody::run"<<std::endl;
 #endif
-    return NULL;
 }
 
 void
@@ -2871,48 +2867,37 @@ ProgMLTomo::expectation(MetaData &MDimg, std::vector<Image<double> > &Iref,
     wsum_sigma_offset = 0.;
     sumfracweight = 0.;
     sumw.initZeros(nr_ref);
-    //Create a task distributor to distribute images to process
-    //each thread will process images one by one
-    ThreadTaskDistributor * distributor = new ThreadTaskDistributor(
-                                              nr_images_local, 1);
 
     Mzero.initZeros();
     Mzero2.initZeros();
     Mzero2.setXmippOrigin();
     wsumimgs.assign(2 * nr_ref, Mzero2);
     wsumweds.assign(2 * nr_ref, Mzero);
-    // Call threads to calculate the expectation of each image in the selfile
-    pthread_t * th_ids = (pthread_t *) malloc(threads * sizeof(pthread_t));
-    structThreadExpectationSingleImage * threads_d =
-        (structThreadExpectationSingleImage *) malloc(
-            threads * sizeof(structThreadExpectationSingleImage));
-    for (int c = 0; c < threads; c++)
-    {
-        threads_d[c].thread_id = c;
-        threads_d[c].thread_num = threads;
-        threads_d[c].prm = this;
-        threads_d[c].MDimg = &MDimg;
-        threads_d[c].iter = &iter;
-        threads_d[c].wsum_sigma_noise = &wsum_sigma_noise;
-        threads_d[c].wsum_sigma_offset = &wsum_sigma_offset;
-        threads_d[c].sumfracweight = &sumfracweight;
-        threads_d[c].LL = &LL;
-        threads_d[c].wsumimgs = &wsumimgs;
-        threads_d[c].wsumweds = &wsumweds;
-        threads_d[c].Iref = &Iref;
-        threads_d[c].sumw = &sumw;
-        threads_d[c].imgs_id = &imgs_id;
-        threads_d[c].distributor = distributor;
-        pthread_create(
-            (th_ids + c), NULL, threadMLTomoExpectationSingleImage, (void *)(threads_d+c) );
-    }
-    // Wait for threads to finish and get joined MetaData
-    for (int c = 0; c < threads; c++)
-    {
-        pthread_join(*(th_ids + c), NULL);
-    }
-    //Free some memory
-    delete distributor;
+
+    // Calculate the expectation of each image in the selfile.
+    // The threads are created only once, and the images are
+    // processed one by one, so that idle threads take the images
+    // left by the threads still working
+    if (pool == NULL)
+        pool = new ThreadPool(threads);
+    MLTomoExpectationBody body;
+    body.prm = this;
+    body.MDimg = &MDimg;
+    body.wsum_sigma_noise = &wsum_sigma_noise;
+    body.wsum_sigma_offset = &wsum_sigma_offset;
+    body.sumfracweight = &sumfracweight;
+    body.LL = &LL;
+    body.wsumimgs = &wsumimgs;
+    body.wsumweds = &wsumweds;
+    body.Iref = &Iref;
+    body.sumw = &sumw;
+    body.imgs_id = &imgs_id;
+    body.processed = 0;
+    if (verbose)
+        init_progress_bar(nr_images_local);
+    pool->parallelFor(nr_images_local, 1, body);
+    if (verbose)
+        progress_bar(nr_images_local);
 
     //FIXME
     // Send back output in the form of a MetaData
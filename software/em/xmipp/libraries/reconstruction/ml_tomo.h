@@ -52,33 +52,6 @@
 #define FN_ITER_VOL(iter, base, refno) formatString("%s_it%d_%s%d.vol", fn_root.c_str(), iter, base, refno+1)
 #define FN_ITER_MD(iter) formatString("%s_it%d.sel", fn_root.c_str(), iter)
 
-class ProgMLTomo;
-
-// Thread declaration
-void * threadMLTomoExpectationSingleImage( void * data );
-
-// This structure is needed to pass parameters to threadMLTomoExpectationSingleImage
-typedef struct
-{
-    int thread_id;
-    int thread_num;
-    ProgMLTomo *prm;
-    MetaData *MDimg;
-    int *iter;
-    double *wsum_sigma_noise;
-    double *wsum_sigma_offset;
-    double *sumfracweight;
-    double *LL;
-    std::vector<MultidimArray<double> > *wsumimgs;
-    std::vector<MultidimArray<double> > *wsumweds;
-    std::vector<Image<double> > *Iref;
-    std::vector<MultidimArray<double> > *docfiledata;
-    MultidimArray<double> * sumw;
-    std::vector<size_t> * imgs_id;
-    ThreadTaskDistributor * distributor;
-}
-structThreadExpectationSingleImage ;
-
 /**@defgroup ml_tomo Maximum likelihood for tomograms
    @ingroup ReconsLibrary */
 //@{
@@ -242,6 +215,9 @@ public:
     /** Threads */
     int threads;
 
+    /** Pool of threads, created once for all the iterations */
+    ThreadPool * pool;
+
     /** FFTW objects */
     FourierTransformer transformer;
 
@@ -252,6 +228,12 @@ public:
     std::vector<size_t> imgs_id;
 
 public:
+    /// Empty constructor
+    ProgMLTomo();
+
+    /// Destructor, the threads are released
+    ~ProgMLTomo();
+
     /// Define the arguments accepted
     void defineParams();
 
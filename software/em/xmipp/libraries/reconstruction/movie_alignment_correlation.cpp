@@ -47,6 +47,7 @@ void ProgMovieAlignmentCorrelation::readParams()
     yLTcorner= getIntParam("--cropULCorner",1);
     xDRcorner = getIntParam("--cropDRCorner",0);
     yDRcorner = getIntParam("--cropDRCorner",1);
+    singlePrecision = checkParam("--single_precision");
     show();
 }
 
@@ -68,7 +69,8 @@ void ProgMovieAlignmentCorrelation::show()
     << "Aligned micrograph:  " << fnAvg              << std::endl
     << "Frame range:         " << nfirst << " " << nlast << std::endl
     << "Crop corners  " << "(" << xLTcorner << ", " << yLTcorner << ") "
-    << "(" << xDRcorner << ", " << yDRcorner << ") "
+    << "(" << xDRcorner << ", " << yDRcorner << ") " << std::endl
+    << "Single precision:    " << singlePrecision    << std::endl
     ;
 }
 
@@ -90,6 +92,8 @@ void ProgMovieAlignmentCorrelation::defineParams()
     addParamsLine("  [--cropDRCorner <x=-1> <y=-1>]    : crop down right corner (unit=px, index starts at 0), -1 -> no crop");
     addParamsLine("  [--dark <fn=\"\">]           : Dark correction image");
     addParamsLine("  [--gain <fn=\"\">]           : Gain correction image");
+    addParamsLine("  [--single_precision]         : Keep the Fourier transforms of the frames in single precision");
+    addParamsLine("                               : and correlate them in single precision. It halves the memory needed");
     addExampleLine("A typical example",false);
     addExampleLine("xmipp_movie_alignment_correlation -i movie.xmd --oaligned alignedMovie.stk --oavg alignedMicrograph.mrc");
     addSeeAlsoLine("xmipp_movie_optical_alignment_cpu");
@@ -117,6 +121,26 @@ void computeTotalShift(int iref, int j, const Matrix1D<double> &shiftX, const Ma
     }
 }
 
+// Transform the first nImages of a batch of reduced frames and keep their filtered transforms
+void transformFrameBatch(BatchFourierTransformer &transformer, MultidimArray<double> &batch, size_t nImages,
+                         const MultidimArray<double> &filter,
+                         std::vector< MultidimArray<std::complex<double> > * > &frameFourier)
+{
+    if (nImages<NSIZE(batch))
+        batch.resize(nImages,1,YSIZE(batch),XSIZE(batch));
+    MultidimArray< std::complex<double> > batchFourier, imageFourier;
+    transformer.FourierTransform(batch,batchFourier,false);
+    for (size_t k=0; k<nImages; ++k)
+    {
+        // Copy out of the batch, that is reused for the next frames
+        transformer.getFourierImage(k,imageFourier);
+        MultidimArray< std::complex<double> > *reducedFrameFourier=new MultidimArray< std::complex<double> >(imageFourier);
+        FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(filter)
+        DIRECT_MULTIDIM_ELEM(*reducedFrameFourier,n)*=DIRECT_MULTIDIM_ELEM(filter,n);
+        frameFourier.push_back(reducedFrameFourier);
+    }
+}
+
 void ProgMovieAlignmentCorrelation::run()
 {
     MetaData movie;
@@ -176,7 +200,26 @@ void ProgMovieAlignmentCorrelation::run()
         A1D_ELEM(lpf,i)=exp(K*(w*w));
     }
 
+    // Low pass filter in Fourier space
+    Matrix1D<double> w(2);
+    MultidimArray<double> filter;
+    filter.resizeNoCopy(newYdim,newXdim/2+1);
+    FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY2D(filter)
+    {
+        FFT_IDX2DIGFREQ(i,newYdim,YY(w));
+        FFT_IDX2DIGFREQ(j,newXdim,XX(w));
+        double wabs=w.module();
+        if (wabs>targetOccupancy)
+            A2D_ELEM(filter,i,j)=0;
+        else
+            A2D_ELEM(filter,i,j)=lpf.interpolatedElement1D(wabs*newXdim);
+    }
+
     // Compute the Fourier transform of all input images
+    int lastFrame=XMIPP_MIN(nlast,(int)movie.size()-1);
+    if (nfirst>lastFrame)
+        REPORT_ERROR(ERR_ARG_INCORRECT,formatString("There are no frames between %d and %d, the movie has %lu frames",
+                     nfirst,nlast,movie.size()));
     if (verbose)
     {
         std::cout << "Computing Fourier transform of frames ..." << std::endl;
@@ -185,9 +228,19 @@ void ProgMovieAlignmentCorrelation::run()
     FileName fnFrame;
     Image<double> frame, cropedFrame, reducedFrame, dark, gain;
     int n=0;
-    FourierTransformer transformer;
-    Matrix1D<double> w(2);
-    std::complex<double> zero=0;
+
+    // In double precision the reduced frames are collected in batches of a
+    // few frames, that are transformed at once. In single precision each
+    // reduced frame is transformed as soon as it is read. In both cases only
+    // the Fourier transforms of the frames are kept.
+    const size_t framesPerBatch=8;
+    MultidimArray<double> reducedBatch;
+    BatchFourierTransformer transformer;
+    if (!singlePrecision)
+        reducedBatch.resizeNoCopy(XMIPP_MIN((size_t)(lastFrame-nfirst+1),framesPerBatch),1,newYdim,newXdim);
+    MultidimArray<float> reducedFrameFloat;
+    FourierTransformerFloat transformerFloat;
+    size_t idxBatch=0;
 
     if (fnDark!="")
     {
@@ -228,21 +281,25 @@ void ProgMovieAlignmentCorrelation::run()
             //scaleToSizeFourier(1,newYdim,newXdim,frame(),reducedFrame());
             scaleToSizeFourier(1,newYdim,newXdim,cropedFrame(),reducedFrame());
 
-            // Now do the Fourier transform and filter
-            MultidimArray< std::complex<double> > *reducedFrameFourier=new MultidimArray< std::complex<double> >;
-            transformer.FourierTransform(reducedFrame(),*reducedFrameFourier,true);
-            FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY2D(*reducedFrameFourier)
+            if (singlePrecision)
             {
-                FFT_IDX2DIGFREQ(i,newYdim,YY(w));
-                FFT_IDX2DIGFREQ(j,newXdim,XX(w));
-                double wabs=w.module();
-                if (wabs>targetOccupancy)
-                    A2D_ELEM(*reducedFrameFourier,i,j)=zero;
-                else
-                    A2D_ELEM(*reducedFrameFourier,i,j)*=lpf.interpolatedElement1D(wabs*newXdim);
+                typeCast(reducedFrame(),reducedFrameFloat);
+                MultidimArray< std::complex<float> > *reducedFrameFourierFloat=new MultidimArray< std::complex<float> >;
+                transformerFloat.FourierTransform(reducedFrameFloat,*reducedFrameFourierFloat,true);
+                FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(filter)
+                DIRECT_MULTIDIM_ELEM(*reducedFrameFourierFloat,n)*=(float)DIRECT_MULTIDIM_ELEM(filter,n);
+                frameFourierFloat.push_back(reducedFrameFourierFloat);
+            }
+            else
+            {
+                memcpy(&DIRECT_NZYX_ELEM(reducedBatch,idxBatch,0,0,0),MULTIDIM_ARRAY(reducedFrame()),
+                       MULTIDIM_SIZE(reducedFrame())*sizeof(double));
+                if (++idxBatch==NSIZE(reducedBatch))
+                {
+                    transformFrameBatch(transformer,reducedBatch,idxBatch,filter,frameFourier);
+                    idxBatch=0;
+                }
             }
-
-            frameFourier.push_back(reducedFrameFourier);
         }
         ++n;
         if (verbose)
@@ -251,13 +308,21 @@ void ProgMovieAlignmentCorrelation::run()
     if (verbose)
         progress_bar(movie.size());
 
-    // Free useless memory
+    // The last frames, that do not fill a batch
+    if (idxBatch>0)
+        transformFrameBatch(transformer,reducedBatch,idxBatch,filter,frameFourier);
+
+    // Free useless memory before correlating the frames
     reducedFrame.clear();
+    reducedFrameFloat.clear();
+    transformerFloat.clear();
+    reducedBatch.clear();
+    transformer.clear();
     cropedFrame.clear();
     frame.clear();
 
     // Now compute all shifts
-    size_t N=frameFourier.size();
+    size_t N=singlePrecision ? frameFourierFloat.size() : frameFourier.size();
     Matrix2D<double> A(N*(N-1)/2,N-1);
     Matrix1D<double> bX(N*(N-1)/2), bY(N*(N-1)/2);
     if (verbose)
@@ -267,12 +332,16 @@ void ProgMovieAlignmentCorrelation::run()
     Mcorr.resizeNoCopy(newYdim,newXdim);
     Mcorr.setXmippOrigin();
     CorrelationAux aux;
+    CorrelationAuxFloat auxFloat;
     std::cout << "Aqui 1" << std::endl;
     for (size_t i=0; i<N-1; ++i)
     {
         for (size_t j=i+1; j<N; ++j)
         {
-            bestShift(*frameFourier[i],*frameFourier[j],Mcorr,bX(idx),bY(idx),aux,NULL,maxShift);
+            if (singlePrecision)
+                bestShift(*frameFourierFloat[i],*frameFourierFloat[j],Mcorr,bX(idx),bY(idx),auxFloat,NULL,maxShift);
+            else
+                bestShift(*frameFourier[i],*frameFourier[j],Mcorr,bX(idx),bY(idx),aux,NULL,maxShift);
             if (verbose)
                 std::cerr << "Frame " << i+nfirst << " to Frame " << j+nfirst << " -> (" << bX(idx) << "," << bY(idx) << ")\n";
             for (int ij=i; ij<j; ij++)
@@ -280,7 +349,10 @@ void ProgMovieAlignmentCorrelation::run()
 
             idx++;
         }
-        delete frameFourier[i];
+        if (singlePrecision)
+            delete frameFourierFloat[i];
+        else
+            delete frameFourier[i];
     }
 
     // Finally solve the equation system
@@ -66,11 +66,16 @@ public:
     int xDRcorner;
     /** y right down corner **/
     int yDRcorner;
+    /** Keep the Fourier transforms of the frames in single precision */
+    bool singlePrecision;
 
 public:
     // Fourier transforms of the input images
 	std::vector< MultidimArray<std::complex<double> > * > frameFourier;
 
+    // Fourier transforms of the input images in single precision
+	std::vector< MultidimArray<std::complex<float> > * > frameFourierFloat;
+
 	// Target sampling rate
 	double newTs;
 
@@ -36,6 +36,7 @@ ProgFilter::~ProgFilter(){}
 void ProgFilter::defineParams()
 {
     each_image_produces_an_output = true;
+    allow_io_threads = true;
     addUsageLine("Apply different type of filters to images or volumes.");
     XmippMetadataProgram::defineParams();
     FourierFilter::defineParams(this);
@@ -109,7 +110,7 @@ void ProgFilter::preProcess()
 void ProgFilter::processImage(const FileName &fnImg, const FileName &fnImgOut, const MDRow &rowIn, MDRow &rowOut)
 {
     Image<double> img;
-    img.read(fnImg);
+    readImage(fnImg, img);
     if (readCTF)
     {
     	((FourierFilter *)filter)->ctf.readFromMdRow(rowIn);
@@ -117,5 +118,5 @@ void ProgFilter::processImage(const FileName &fnImg, const FileName &fnImgOut, c
     	((FourierFilter *)filter)->generateMask(img());
     }
     filter->apply(img());
-    img.write(fnImgOut);
+    writeImage(img, fnImgOut);
 }
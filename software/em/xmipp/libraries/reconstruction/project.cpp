@@ -36,6 +36,7 @@ void ProgProject::readParams()
     fnPhantom = getParam("-i");
     fnOut = getParam("-o");
     samplingRate  = getDoubleParam("--sampling_rate");
+    threads = getIntParam("--thr");
     singleProjection = false;
     if (STR_EQUAL(getParam("--method"), "real_space"))
         projType = REALSPACE;
@@ -114,6 +115,8 @@ void ProgProject::defineParams()
     addParamsLine("                                              : linear:           Linear BSpline  ");
     addParamsLine("                                              :+++                        %BR% ");
     addParamsLine("                                              : bspline:          Cubic BSpline  ");
+    addParamsLine("  [--thr <n=1>]                               : Number of threads");
+    addParamsLine("                                              : It is only used by real_space with voxel volumes");
     addParamsLine("== Generating a set of projections == ");
     addParamsLine("  [--params <parameters_file>]           : File containing projection parameters");
     addParamsLine("                                         : Check the manual for a description of the parameters");
@@ -915,6 +918,7 @@ void PROJECT_Side_Info::produce_Side_Info(ParametersProjection &prm,
     paddFactor = prog_prm.paddFactor;
     maxFrequency = prog_prm.maxFrequency;
     BSplineDeg = prog_prm.BSplineDeg;
+    threads = prog_prm.threads;
 }
 
 /* Effectively project ===================================================== */
@@ -1071,7 +1075,7 @@ int PROJECT_Effectively_project(const FileName &fnOut,
                               rot, tilt, psi);
             else if (projType == REALSPACE)
                 projectVolume(side.phantomVol(), proj, prm.proj_Ydim, prm.proj_Xdim,
-                              rot, tilt, psi);
+                              rot, tilt, psi, NULL, side.threads);
 
             if (hasCTF)
             	ctf.applyCTF(proj(),sampling_rate, prm.doPhaseFlip);
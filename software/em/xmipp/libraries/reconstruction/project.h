@@ -83,6 +83,8 @@ public:
     double maxFrequency;
     /// The type of interpolation (NEAR
     int BSplineDeg;
+    /// Number of threads for real space projections of voxel volumes
+    int threads;
 
 public:
     /** Read parameters. */
@@ -231,6 +233,8 @@ public:
     double maxFrequency;
     /// The type of interpolation (NEAR
     int BSplineDeg;
+    /// Number of threads for real space projections of voxel volumes
+    int threads;
     /// Is this a crystal projection
     bool doCrystal;
 
@@ -27,6 +27,15 @@
  ***************************************************************************/
 
 #include "reconstruct_fourier.h"
+#include <data/metadata_columns.h>
+
+ProgRecFourier::ProgRecFourier()
+{
+    inputImages = NULL;
+    processedImages = 0;
+    pool = NULL;
+    th_args = NULL;
+}
 
 // Define params
 void ProgRecFourier::defineParams()
@@ -43,7 +52,8 @@ void ProgRecFourier::defineParams()
     addParamsLine("  [--prepare_fsc <fscfile>]      : Filename root for FSC files");
     addParamsLine("  [--max_resolution <p=0.5>]     : Max resolution (Nyquist=0.5)");
     addParamsLine("  [--weight]                     : Use weights stored in the image metadata");
-    addParamsLine("  [--thr <threads=1> <rows=1>]   : Number of concurrent threads and rows processed at time by a thread");
+    addParamsLine("  [--thr <threads=1> <planes=1>] : Number of concurrent threads and minimum width of the slab of volume planes");
+    addParamsLine("                                 : owned by each thread");
     addParamsLine("  [--blob <radius=1.9> <order=0> <alpha=15>] : Blob parameters");
     addParamsLine("                                 : radius in pixels, order of Bessel function in blob and parameter alpha");
     addParamsLine("  [--useCTF]                     : Use CTF information if present");
@@ -52,6 +62,12 @@ void ProgRecFourier::defineParams()
     addParamsLine("  [--phaseFlipped]               : Give this flag if images have been already phase flipped");
     addParamsLine("  [--minCTF <ctf=0.01>]          : Minimum value of the CTF that will be inverted");
     addParamsLine("                                 : CTF values (in absolute value) below this one will not be corrected");
+    addParamsLine("  [--stream <chunk=5000>]        : Low memory mode for large volumes or particle sets. The Fourier");
+    addParamsLine("                                 : volume is accumulated in single precision (weights in double)");
+    addParamsLine("                                 : and the selfile is read in chunks of this number of images.");
+    addParamsLine("                                 : The selfile must be binary (.xmdb), convert it with");
+    addParamsLine("                                 : xmipp_metadata_utilities -i images.xmd -o images.xmdb");
+    addParamsLine("                                 : Not available in the MPI version");
     addExampleLine("For reconstruct enforcing i3 symmetry and using stored weights:", false);
     addExampleLine("   xmipp_reconstruct_fourier  -i reconstruction.sel --sym i3 --weight");
 }
@@ -79,6 +95,13 @@ void ProgRecFourier::readParams()
     minCTF = getDoubleParam("--minCTF");
     if (useCTF)
         Ts=getDoubleParam("--sampling");
+    streamChunk = checkParam("--stream") ? getIntParam("--stream") : 0;
+    if (streamChunk > 0 && !fn_fsc.empty())
+        REPORT_ERROR(ERR_ARG_INCORRECT, "--prepare_fsc cannot be used with --stream");
+    // Only binary selfiles can be read in chunks, others would be read at once
+    if (streamChunk > 0 && fn_sel.removeBlockName().getExtension() != "xmdb")
+        REPORT_ERROR(ERR_ARG_INCORRECT, formatString("--stream needs a binary selfile (.xmdb), %s is read at once. "
+                     "Convert it with xmipp_metadata_utilities -i %s -o images.xmdb", fn_sel.c_str(), fn_sel.c_str()));
 }
 
 // Show ====================================================================
@@ -106,6 +129,8 @@ void ProgRecFourier::show()
             << "Sampling rate: " << Ts << std::endl
             << "Phase flipped: " << phaseFlipped << std::endl
             << "Minimum CTF: " << minCTF << std::endl;
+        if (streamChunk > 0)
+            std::cout << " Streaming in chunks of " << streamChunk << " images" << std::endl;
         std::cout << "\n Interpolation Function"
         << "\n   blrad                 : "  << blob.radius
         << "\n   blord                 : "  << blob.order
@@ -122,32 +147,18 @@ void ProgRecFourier::run()
     show();
     produceSideinfo();
     // Process all images in the selfile
+    processedImages = 0;
     if (verbose)
     {
         if (NiterWeight!=0)
-            init_progress_bar(NiterWeight*SF.size());
+            init_progress_bar(NiterWeight*totalImages);
         else
-            init_progress_bar(SF.size());
-    }
-    // Create threads stuff
-    barrier_init( &barrier, numThreads+1 );
-    pthread_mutex_init( &workLoadMutex, NULL );
-    statusArray = NULL;
-    th_ids = (pthread_t *)malloc( numThreads * sizeof( pthread_t));
-    th_args = (ImageThreadParams *) malloc ( numThreads * sizeof( ImageThreadParams ) );
-
-    // Create threads
-    for ( int nt = 0 ; nt < numThreads ; nt ++ )
-    {
-        // Passing parameters to each thread
-        th_args[nt].parent = this;
-        th_args[nt].myThreadID = nt;
-        th_args[nt].selFile = new MetaData(SF);
-        pthread_create( (th_ids+nt) , NULL, processImageThread, (void *)(th_args+nt) );
+            init_progress_bar(totalImages);
     }
+    createThreads();
 
     //Computing interpolated volume
-    processImages(0, SF.size() - 1, !fn_fsc.empty(), false);
+    processSelFile(false);
 
     // Correcting the weights
     correctWeight();
@@ -155,13 +166,93 @@ void ProgRecFourier::run()
     //Saving the volume
     finishComputations(fn_out);
 
-    threadOpCode = EXIT_THREAD;
+    destroyThreads();
+}
+
+void ImageThreadBuffers::initialize(const ProgRecFourier &parent, const MetaData &selFile)
+{
+    localA.initZeros(3, 3);
+    localAinv.initZeros(3, 3);
+    zWrapped.resizeNoCopy(3*parent.volPadSizeZ);
+    yWrapped.resizeNoCopy(3*parent.volPadSizeY);
+    xWrapped.resizeNoCopy(3*parent.volPadSizeX);
+    zWrapped.initConstant(-1);
+    yWrapped.initConstant(-1);
+    xWrapped.initConstant(-1);
+    zWrapped.setXmippOrigin();
+    yWrapped.setXmippOrigin();
+    xWrapped.setXmippOrigin();
+    zNegWrapped=zWrapped;
+    yNegWrapped=yWrapped;
+    xNegWrapped=xWrapped;
+
+    x2precalculated.resizeNoCopy(XSIZE(xWrapped));
+    y2precalculated.resizeNoCopy(XSIZE(yWrapped));
+    z2precalculated.resizeNoCopy(XSIZE(zWrapped));
+    x2precalculated.initConstant(-1);
+    y2precalculated.initConstant(-1);
+    z2precalculated.initConstant(-1);
+    x2precalculated.setXmippOrigin();
+    y2precalculated.setXmippOrigin();
+    z2precalculated.setXmippOrigin();
+    // Largest box around a blob
+    size_t boxSize=2*(int)ceil(parent.blob.radius)+2;
+    size_t footprintSize=boxSize*boxSize*boxSize;
+    blobWeights.resize(footprintSize);
+    footprintDist2.resize(footprintSize);
+    footprintSign.resize(footprintSize);
+    footprintIdx.resize(footprintSize);
+
+    hasCTF=(selFile.containsLabel(MDL_CTF_MODEL) || selFile.containsLabel(MDL_CTF_DEFOCUSU)) &&
+           parent.useCTF;
+}
 
-    // Waiting for threads to finish
-    barrier_wait( &barrier );
+void ProgRecFourier::createThreads()
+{
+    pool = new ThreadPool(numThreads);
+    th_args = new ImageThreadParams[numThreads];
     for ( int nt = 0 ; nt < numThreads ; nt ++ )
-        pthread_join(*(th_ids+nt), NULL);
-    barrier_destroy( &barrier );
+    {
+        // Passing parameters to each thread
+        th_args[nt].parent = this;
+        th_args[nt].myThreadID = nt;
+        th_args[nt].selFile = &SF;
+        th_args[nt].buffers.initialize(*this, SF);
+        if (th_args[nt].buffers.hasCTF)
+        {
+            th_args[nt].ctf.enable_CTF=true;
+            th_args[nt].ctf.enable_CTFnoise=false;
+        }
+    }
+}
+
+void ProgRecFourier::destroyThreads()
+{
+    delete pool;
+    pool = NULL;
+    delete[] th_args;
+    th_args = NULL;
+}
+
+/* Runs the current operation of the threads for a range of th_args */
+class RecFourierBody: public ParallelForBody
+{
+public:
+    ProgRecFourier * parent;
+
+    void run(size_t first, size_t last, int thread_id)
+    {
+        for (size_t nt = first; nt <= last; ++nt)
+            ProgRecFourier::processImageThread(parent->th_args + nt);
+    }
+};
+
+void ProgRecFourier::awakeThreads(int opCode)
+{
+    threadOpCode = opCode;
+    RecFourierBody body;
+    body.parent = this;
+    pool->parallelFor(numThreads, 1, body);
 }
 
 
@@ -171,32 +262,81 @@ void ProgRecFourier::produceSideinfo()
     // maxResolution=sampling_rate/maxResolution;
     maxResolution2=maxResolution*maxResolution;
 
-    // Read the input images
-    SF.read(fn_sel);
-    SF.removeDisabled();
+    // Read the input images, only the first chunk when streaming
+    streamSelFile = streamChunk > 0 && inputImages == NULL;
+    if (streamSelFile)
+    {
+        String blockName;
+        MDColumns::readBinaryInfo(fn_sel.removeBlockName(), totalImages, blockName);
+        for (size_t first = 0; first < totalImages && SF.isEmpty(); first += streamChunk)
+            readSelFile(first);
+    }
+    else
+    {
+        readSelFile(0);
+        totalImages = SF.size();
+    }
+    if (SF.isEmpty())
+        REPORT_ERROR(ERR_MD_NOOBJ, "There are no images to reconstruct in " + fn_sel);
+    // Keep the selfile in memory so that the threads can share it,
+    // it is built here and it is not modified while they run
+    SF.setColumnStore();
 
     // Ask for memory for the output volume and its Fourier transform
-    size_t objId = SF.firstObject();
-    FileName fnImg;
-    SF.getValue(MDL_IMAGE,fnImg,objId);
-    Image<double> I;
-    I.read(fnImg, HEADER);
-    int Ydim=YSIZE(I());
-    int Xdim=XSIZE(I());
+    int Ydim, Xdim;
+    if (inputImages != NULL)
+    {
+        Ydim=YSIZE((*inputImages)[0]());
+        Xdim=XSIZE((*inputImages)[0]());
+    }
+    else
+    {
+        size_t objId = SF.firstObject();
+        FileName fnImg;
+        SF.getValue(MDL_IMAGE,fnImg,objId);
+        Image<double> I;
+        I.read(fnImg, HEADER);
+        Ydim=YSIZE(I());
+        Xdim=XSIZE(I());
+    }
     if (Ydim!=Xdim)
         REPORT_ERROR(ERR_MULTIDIM_SIZE,"This algorithm only works for squared images");
     imgSize=Xdim;
     volPadSizeX = volPadSizeY = volPadSizeZ=(int)(Xdim*padding_factor_vol);
-    Vout().initZeros(volPadSizeZ,volPadSizeY,volPadSizeX);
+    if (streamChunk > 0)
+    {
+        // Single precision volume, its Fourier transform is the accumulator
+        VoutFloat().initZeros(volPadSizeZ,volPadSizeY,volPadSizeX);
+        transformerVolFloat.setThreadsNumber(numThreads);
+        transformerVolFloat.setReal(VoutFloat());
+        VoutFloat().clear();
+        transformerVolFloat.getFourierAlias(VoutFourierFloat);
+        VoutFourierFloat.initZeros();
+        FourierWeights.initZeros(VoutFourierFloat);
+    }
+    else
+    {
+        Vout().initZeros(volPadSizeZ,volPadSizeY,volPadSizeX);
 
-    //use threads for volume inverse fourier transform, plan is created in setReal()
-    transformerVol.setThreadsNumber(numThreads);
-    transformerVol.setReal(Vout());
+        //use threads for volume inverse fourier transform, plan is created in setReal()
+        transformerVol.setThreadsNumber(numThreads);
+        transformerVol.setReal(Vout());
 
-    Vout().clear(); // Free the memory so that it is available for FourierWeights
-    transformerVol.getFourierAlias(VoutFourier);
-    VoutFourier.initZeros();
-    FourierWeights.initZeros(VoutFourier);
+        Vout().clear(); // Free the memory so that it is available for FourierWeights
+        transformerVol.getFourierAlias(VoutFourier);
+        VoutFourier.initZeros();
+        FourierWeights.initZeros(VoutFourier);
+    }
+
+    // Each thread owns interleaved slabs of planes of the Fourier volume,
+    // so that the threads add their coefficients without locking.
+    // Slabs are as wide as the blob, unless there are too few for the threads
+    int zsize = (int)ZSIZE(FourierWeights);
+    int slabWidth = XMIPP_MAX(thrWidth, (int)ceil(2 * blob.radius));
+    slabWidth = XMIPP_MIN(slabWidth, XMIPP_MAX(1, zsize / (2 * numThreads)));
+    zOwner.resize(zsize);
+    for (int k = 0; k < zsize; k++)
+        zOwner[k] = (k / slabWidth) % numThreads;
 
     // Ask for memory for the padded images
     size_t paddedImgSize=(size_t)(Xdim*padding_factor_proj);
@@ -270,548 +410,489 @@ void ProgRecFourier::produceSideinfo()
     }
 }
 
-void * ProgRecFourier::processImageThread( void * threadArgs )
+void ProgRecFourier::readSelFile(size_t firstImage)
 {
+    // The column store of the previous chunk is outdated by the reading
+    SF.setColumnStore(false);
+    if (streamSelFile)
+        SF.readBinary(fn_sel, NULL, firstImage, streamChunk);
+    else if (inputImages == NULL)
+        SF.read(fn_sel);
+    SF.removeDisabled();
+    SF.findObjects(objIds);
+}
 
-    ImageThreadParams * threadParams = (ImageThreadParams *) threadArgs;
-    ProgRecFourier * parent = threadParams->parent;
-    barrier_t * barrier = &(parent->barrier);
-
-    int minSeparation;
-
-    if ( (int)ceil(parent->blob.radius) > parent->thrWidth )
-        minSeparation = (int)ceil(parent->blob.radius);
-    else
-        minSeparation = parent->thrWidth;
-
-    minSeparation+=1;
+void ProgRecFourier::processSelFile(bool reprocessFlag)
+{
+    if (!streamSelFile)
+    {
+        processImages(0, SF.size() - 1, !fn_fsc.empty(), reprocessFlag);
+        return;
+    }
+    for (size_t first = 0; first < totalImages; first += streamChunk)
+    {
+        readSelFile(first);
+        SF.setColumnStore();
+        if (!SF.isEmpty())
+            processImages(0, SF.size() - 1, false, reprocessFlag);
+    }
+}
 
-    Matrix2D<double>  localA(3, 3), localAinv(3, 3);
-    MultidimArray< std::complex<double> > localPaddedFourier;
-    MultidimArray<double> localPaddedImg;
-    FourierTransformer localTransformerImg;
+void ProgRecFourier::processImageThread( ImageThreadParams * threadParams )
+{
+    ProgRecFourier * parent = threadParams->parent;
+    ImageThreadBuffers &buffers = threadParams->buffers;
 
-    std::vector<size_t> objId;
+    Matrix2D<double> &localA = buffers.localA, &localAinv = buffers.localAinv;
+    MultidimArray< std::complex<double> > &localPaddedFourier = buffers.localPaddedFourier;
+    MultidimArray<double> &localPaddedImg = buffers.localPaddedImg;
+    FourierTransformer &localTransformerImg = buffers.localTransformerImg;
 
-    threadParams->selFile->findObjects(objId);
+    // Identifiers of the images of the selfile, they change when streaming
+    const std::vector<size_t> &objId = parent->objIds;
     ApplyGeoParams params;
     params.only_apply_shifts = true;
-    MultidimArray<int> zWrapped(3*parent->volPadSizeZ),yWrapped(3*parent->volPadSizeY),xWrapped(3*parent->volPadSizeX),
-    zNegWrapped, yNegWrapped, xNegWrapped;
-    zWrapped.initConstant(-1);
-    yWrapped.initConstant(-1);
-    xWrapped.initConstant(-1);
-    zWrapped.setXmippOrigin();
-    yWrapped.setXmippOrigin();
-    xWrapped.setXmippOrigin();
-    zNegWrapped=zWrapped;
-    yNegWrapped=yWrapped;
-    xNegWrapped=xWrapped;
-
-    MultidimArray<double> x2precalculated(XSIZE(xWrapped)), y2precalculated(XSIZE(yWrapped)), z2precalculated(XSIZE(zWrapped));
-    x2precalculated.initConstant(-1);
-    y2precalculated.initConstant(-1);
-    z2precalculated.initConstant(-1);
-    x2precalculated.setXmippOrigin();
-    y2precalculated.setXmippOrigin();
-    z2precalculated.setXmippOrigin();
-
-    bool hasCTF=(threadParams->selFile->containsLabel(MDL_CTF_MODEL) || threadParams->selFile->containsLabel(MDL_CTF_DEFOCUSU)) &&
-                parent->useCTF;
-    if (hasCTF)
-    {
-        threadParams->ctf.enable_CTF=true;
-        threadParams->ctf.enable_CTFnoise=false;
-    }
-    do
+    MultidimArray<int> &zWrapped = buffers.zWrapped, &yWrapped = buffers.yWrapped, &xWrapped = buffers.xWrapped;
+    MultidimArray<int> &zNegWrapped = buffers.zNegWrapped, &yNegWrapped = buffers.yNegWrapped,
+                       &xNegWrapped = buffers.xNegWrapped;
+    MultidimArray<double> &x2precalculated = buffers.x2precalculated, &y2precalculated = buffers.y2precalculated,
+                          &z2precalculated = buffers.z2precalculated;
+    std::vector<double> &blobWeights = buffers.blobWeights;
+    bool hasCTF = buffers.hasCTF;
+
+    switch ( parent->threadOpCode )
     {
-        barrier_wait( barrier );
-
-        switch ( parent->threadOpCode )
+    case PRELOAD_IMAGE:
         {
-        case PRELOAD_IMAGE:
-            {
 
-                threadParams->read = 0;
+            threadParams->read = 0;
 
-                if ( threadParams->imageIndex >= 0 )
-                {
-                    // Read input image
-                    double rot, tilt, psi, weight;
-                    Projection proj;
+            if ( threadParams->imageIndex >= 0 )
+            {
+                // Read input image
+                double rot, tilt, psi, weight;
+                Projection proj;
 
-                    //Read projection from selfile, read also angles and shifts if present
-                    //but only apply shifts
+                //Read projection from selfile, read also angles and shifts if present
+                //but only apply shifts
 
+                if (parent->inputImages != NULL)
+                {
+                    int ref;
+                    threadParams->selFile->getValue(MDL_REF, ref, objId[threadParams->imageIndex]);
+                    proj.Image<double>::operator=((*parent->inputImages)[ref - 1]);
+                    proj.ImageBase::applyGeo(*(threadParams->selFile), objId[threadParams->imageIndex], params);
+                }
+                else
                     proj.readApplyGeo(*(threadParams->selFile), objId[threadParams->imageIndex], params);
-                    rot  = proj.rot();
-                    tilt = proj.tilt();
-                    psi  = proj.psi();
-                    weight = proj.weight();
-                    if (hasCTF)
-                    {
-                        threadParams->ctf.readFromMetadataRow(*(threadParams->selFile),objId[threadParams->imageIndex]);
-                        threadParams->ctf.Tm=threadParams->parent->Ts;
-                        threadParams->ctf.produceSideInfo();
-                    }
+                rot  = proj.rot();
+                tilt = proj.tilt();
+                psi  = proj.psi();
+                weight = proj.weight();
+                if (hasCTF)
+                {
+                    threadParams->ctf.readFromMetadataRow(*(threadParams->selFile),objId[threadParams->imageIndex]);
+                    threadParams->ctf.Tm=threadParams->parent->Ts;
+                    threadParams->ctf.produceSideInfo();
+                }
 
-                    threadParams->weight = 1.;
+                threadParams->weight = 1.;
 
-                    if(parent->do_weights)
-                        threadParams->weight = weight;
-                    else if (!parent->do_weights)
-                    {
-                        weight=1.0;
-                    }
-                    else if (weight==0.0)
-                    {
-                        threadParams->read = 2;
-                        break;
-                    }
+                if(parent->do_weights)
+                    threadParams->weight = weight;
+                else if (!parent->do_weights)
+                {
+                    weight=1.0;
+                }
+                else if (weight==0.0)
+                {
+                    threadParams->read = 2;
+                    break;
+                }
 
-                    // Copy the projection to the center of the padded image
-                    // and compute its Fourier transform
-                    proj().setXmippOrigin();
-                    size_t localPaddedImgSize=(size_t)(parent->imgSize*parent->padding_factor_proj);
-                    if (threadParams->reprocessFlag)
-                        localPaddedFourier.initZeros(localPaddedImgSize,localPaddedImgSize/2+1);
-                    else
-                    {
-                        localPaddedImg.initZeros(localPaddedImgSize,localPaddedImgSize);
-                        localPaddedImg.setXmippOrigin();
-                        const MultidimArray<double> &mProj=proj();
-                        FOR_ALL_ELEMENTS_IN_ARRAY2D(mProj)
-                        A2D_ELEM(localPaddedImg,i,j)=A2D_ELEM(mProj,i,j);
-                        // COSS A2D_ELEM(localPaddedImg,i,j)=weight*A2D_ELEM(mProj,i,j);
-                        CenterFFT(localPaddedImg,true);
-
-                        // Fourier transformer for the images
-                        localTransformerImg.setReal(localPaddedImg);
-                        localTransformerImg.FourierTransform();
-                        localTransformerImg.getFourierAlias(localPaddedFourier);
-                    }
+                // Copy the projection to the center of the padded image
+                // and compute its Fourier transform
+                proj().setXmippOrigin();
+                size_t localPaddedImgSize=(size_t)(parent->imgSize*parent->padding_factor_proj);
+                if (threadParams->reprocessFlag)
+                    localPaddedFourier.initZeros(localPaddedImgSize,localPaddedImgSize/2+1);
+                else
+                {
+                    localPaddedImg.initZeros(localPaddedImgSize,localPaddedImgSize);
+                    localPaddedImg.setXmippOrigin();
+                    const MultidimArray<double> &mProj=proj();
+                    FOR_ALL_ELEMENTS_IN_ARRAY2D(mProj)
+                    A2D_ELEM(localPaddedImg,i,j)=A2D_ELEM(mProj,i,j);
+                    // COSS A2D_ELEM(localPaddedImg,i,j)=weight*A2D_ELEM(mProj,i,j);
+                    CenterFFT(localPaddedImg,true);
+
+                    // Fourier transformer for the images
+                    localTransformerImg.setReal(localPaddedImg);
+                    localTransformerImg.FourierTransform();
+                    localTransformerImg.getFourierAlias(localPaddedFourier);
+                }
 
-                    // Compute the coordinate axes associated to this image
-                    Euler_angles2matrix(rot, tilt, psi, localA);
-                    localAinv=localA.transpose();
+                // Compute the coordinate axes associated to this image
+                Euler_angles2matrix(rot, tilt, psi, localA);
+                localAinv=localA.transpose();
 
-                    threadParams->localweight = weight;
-                    threadParams->localAInv = &localAinv;
-                    threadParams->localPaddedFourier = &localPaddedFourier;
-                    //#define DEBUG22
+                threadParams->localweight = weight;
+                threadParams->localAInv = &localAinv;
+                threadParams->localPaddedFourier = &localPaddedFourier;
+                //#define DEBUG22
 #ifdef DEBUG22
 
-                    {//CORRECTO
-
-                        if(threadParams->myThreadID%1==0)
-                        {
-                            proj.write((std::string) integerToString(threadParams->myThreadID)  + "_" +\
-                                       integerToString(threadParams->imageIndex) + "proj.spi");
-
-                            ImageXmipp save44;
-                            save44()=localPaddedImg;
-                            save44.write((std::string) integerToString(threadParams->myThreadID)  + "_" +\
-                                         integerToString(threadParams->imageIndex) + "local_padded_img.spi");
-
-                            FourierImage save33;
-                            save33()=localPaddedFourier;
-                            save33.write((std::string) integerToString(threadParams->myThreadID)  + "_" +\
-                                         integerToString(threadParams->imageIndex) + "local_padded_fourier.spi");
-                            FourierImage save22;
-                            //save22()=*paddedFourier;
-                            save22().alias(*(threadParams->localPaddedFourier));
-                            save22.write((std::string) integerToString(threadParams->myThreadID)  + "_" +\
-                                         integerToString(threadParams->imageIndex) + "_padded_fourier.spi");
-                        }
+                {//CORRECTO
 
+                    if(threadParams->myThreadID%1==0)
+                    {
+                        proj.write((std::string) integerToString(threadParams->myThreadID)  + "_" +\
+                                   integerToString(threadParams->imageIndex) + "proj.spi");
+
+                        ImageXmipp save44;
+                        save44()=localPaddedImg;
+                        save44.write((std::string) integerToString(threadParams->myThreadID)  + "_" +\
+                                     integerToString(threadParams->imageIndex) + "local_padded_img.spi");
+
+                        FourierImage save33;
+                        save33()=localPaddedFourier;
+                        save33.write((std::string) integerToString(threadParams->myThreadID)  + "_" +\
+                                     integerToString(threadParams->imageIndex) + "local_padded_fourier.spi");
+                        FourierImage save22;
+                        //save22()=*paddedFourier;
+                        save22().alias(*(threadParams->localPaddedFourier));
+                        save22.write((std::string) integerToString(threadParams->myThreadID)  + "_" +\
+                                     integerToString(threadParams->imageIndex) + "_padded_fourier.spi");
                     }
-#endif
-                    #undef DEBUG22
 
-                    threadParams->read = 1;
                 }
-                break;
+#endif
+                #undef DEBUG22
+
+                threadParams->read = 1;
             }
-        case EXIT_THREAD:
-            return NULL;
-        case PROCESS_WEIGHTS:
-            {
+            break;
+        }
+    case PROCESS_WEIGHTS:
+        {
 
-                // Get a first approximation of the reconstruction
-                double corr2D_3D=pow(parent->padding_factor_proj,2.)/
-                                 (parent->imgSize* pow(parent->padding_factor_vol,3.));
-                // Divide by Zdim because of the
-                // the extra dimension added
-                // and padding differences
-                MultidimArray<double> &mFourierWeights=parent->FourierWeights;
-                for (int k=threadParams->myThreadID; k<=FINISHINGZ(mFourierWeights); k+=parent->numThreads)
-                    for (int i=STARTINGY(mFourierWeights); i<=FINISHINGY(mFourierWeights); i++)
-                        for (int j=STARTINGX(mFourierWeights); j<=FINISHINGX(mFourierWeights); j++)
-                        {
-                        	if (parent->NiterWeight==0)
-                        		A3D_ELEM(parent->VoutFourier,k,i,j)*=corr2D_3D;
-                        	else
-                        	{
-                        		double weight_kij=A3D_ELEM(mFourierWeights,k,i,j);
-                        		if (1.0/weight_kij>ACCURACY)
-                        			A3D_ELEM(parent->VoutFourier,k,i,j)*=corr2D_3D*A3D_ELEM(mFourierWeights,k,i,j);
-                        		else
-                        			A3D_ELEM(parent->VoutFourier,k,i,j)=0;
-                        	}
-                        }
+            // Get a first approximation of the reconstruction
+            double corr2D_3D=pow(parent->padding_factor_proj,2.)/
+                             (parent->imgSize* pow(parent->padding_factor_vol,3.));
+            // Divide by Zdim because of the
+            // the extra dimension added
+            // and padding differences
+            MultidimArray<double> &mFourierWeights=parent->FourierWeights;
+            for (int k=threadParams->myThreadID; k<=FINISHINGZ(mFourierWeights); k+=parent->numThreads)
+                for (int i=STARTINGY(mFourierWeights); i<=FINISHINGY(mFourierWeights); i++)
+                    for (int j=STARTINGX(mFourierWeights); j<=FINISHINGX(mFourierWeights); j++)
+                    {
+                        double factor;
+                    	if (parent->NiterWeight==0)
+                    		factor=corr2D_3D;
+                    	else
+                    	{
+                    		double weight_kij=A3D_ELEM(mFourierWeights,k,i,j);
+                    		if (1.0/weight_kij>ACCURACY)
+                    			factor=corr2D_3D*weight_kij;
+                    		else
+                    			factor=0;
+                    	}
+                        if (parent->streamChunk > 0)
+                            A3D_ELEM(parent->VoutFourierFloat,k,i,j)*=(float)factor;
+                        else
+                            A3D_ELEM(parent->VoutFourier,k,i,j)*=factor;
+                    }
+            break;
+        }
+    case PROCESS_IMAGE:
+        {
+            MultidimArray< std::complex<double> > *paddedFourier = threadParams->paddedFourier;
+            if (threadParams->weight==0.0)
                 break;
-            }
-        case PROCESS_IMAGE:
+            bool reprocessFlag = threadParams->reprocessFlag;
+            int myThreadID = threadParams->myThreadID;
+            const std::vector<int> &zOwner = parent->zOwner;
+            size_t conserveRows = parent->conserveRows;
+
+            // Get the inverse of the sampling rate
+            double iTs=1.0/parent->Ts; // The padding factor is not considered here, but later when the indexes
+                                       // are converted to digital frequencies
+            const std::vector< Matrix2D<double> > &A_SL = *(threadParams->symmetry);
+            size_t symNo = A_SL.size();
+
+            // Loop over all Fourier coefficients in the padded image
+            Matrix1D<double> freq(3), contFreq(3);
+            Matrix1D<int> corner1(3), corner2(3);
+
+            // Some alias and calculations moved from heavy loops
+            double wCTF=1, wModulator=1.0;
+            double blobRadius = parent->blob.radius;
+            double blobRadiusSquared = blobRadius * blobRadius;
+            double iDeltaSqrt = parent->iDeltaSqrt;
+            const double * blobTableSqrt = MATRIX1D_ARRAY(parent->blobTableSqrt);
+            int blobTableLast = VEC_XSIZE(parent->blobTableSqrt) - 1;
+            MultidimArray<double> &fourierWeights = parent->FourierWeights;
+            double * weightsPtr = MULTIDIM_ARRAY(fourierWeights);
+            int xsize_1 = XSIZE(fourierWeights) - 1;
+            int zsize_1 = ZSIZE(fourierWeights) - 1;
+            // Real and imaginary parts of the accumulated coefficients,
+            // in single precision when streaming
+            double * accDouble = NULL;
+            float * accFloat = NULL;
+            if (parent->streamChunk > 0)
+                accFloat = (float *) MULTIDIM_ARRAY(parent->VoutFourierFloat);
+            else
+                accDouble = (double *) MULTIDIM_ARRAY(parent->VoutFourier);
+            double * wBlob = &blobWeights[0];
+            double * footprintDist2 = &buffers.footprintDist2[0];
+            size_t * footprintIdx = &buffers.footprintIdx[0];
+            double * footprintSign = &buffers.footprintSign[0];
+
+            // Position in the volume of every coefficient of a row and every symmetry
+            size_t xdimFourier = XSIZE(*paddedFourier);
+            std::vector<double> &rowPositions = buffers.rowPositions;
+            rowPositions.resize(3 * symNo * xdimFourier);
+
+            // Every thread goes through the whole image, but only adds the
+            // coefficients that fall in the planes of the volume it owns
+            for (size_t i = 0; i < YSIZE(*paddedFourier); i ++ )
             {
-                MultidimArray< std::complex<double> > *paddedFourier = threadParams->paddedFourier;
-                if (threadParams->weight==0.0)
-                    break;
-                bool reprocessFlag = threadParams->reprocessFlag;
-                int * statusArray = parent->statusArray;
-
-                int minAssignedRow;
-                int maxAssignedRow;
-                bool breakCase;
-                bool assigned;
-
-                // Get the inverse of the sampling rate
-                double iTs=1.0/parent->Ts; // The padding factor is not considered here, but later when the indexes
-                                           // are converted to digital frequencies
-                do
+                // Rows beyond the maximum resolution are discarded
+                if ( i >= conserveRows && i < (YSIZE(*paddedFourier)-conserveRows))
+                    continue;
+                FFT_IDX2DIGFREQ(i,YSIZE(parent->paddedImg),YY(freq));
+                ZZ(freq)=0;
+
+                // Apply the symmetries to the whole row before gridding it.
+                // The frequencies of the row only change in X, so the
+                // contribution of Y is computed once per symmetry.
+                for (size_t isym = 0; isym < symNo; ++isym)
                 {
-                    minAssignedRow = -1;
-                    maxAssignedRow = -1;
-                    breakCase = false;
-                    assigned = false;
+                    const Matrix2D<double> &A = A_SL[isym];
+                    double yX = MAT_ELEM(A,0,1) * YY(freq);
+                    double yY = MAT_ELEM(A,1,1) * YY(freq);
+                    double yZ = MAT_ELEM(A,2,1) * YY(freq);
+                    for (size_t j = 0; j < xdimFourier; ++j)
+                    {
+                        double fx;
+                        FFT_IDX2DIGFREQ(j,XSIZE(parent->paddedImg),fx);
+                        double * position = &rowPositions[3 * (j * symNo + isym)];
+                        DIGFREQ2FFT_IDX_DOUBLE(MAT_ELEM(A,0,0) * fx + yX,parent->volPadSizeX,position[0]);
+                        DIGFREQ2FFT_IDX_DOUBLE(MAT_ELEM(A,1,0) * fx + yY,parent->volPadSizeY,position[1]);
+                        DIGFREQ2FFT_IDX_DOUBLE(MAT_ELEM(A,2,0) * fx + yZ,parent->volPadSizeZ,position[2]);
+                    }
+                }
 
-                    do
+                for (size_t j = 0; j < xdimFourier; j++)
+                {
+                    FFT_IDX2DIGFREQ(j,XSIZE(parent->paddedImg),XX(freq));
+                    if (XX(freq)*XX(freq)+YY(freq)*YY(freq)>parent->maxResolution2)
+                        continue;
+                    double *ptrIn=(double *)&(DIRECT_A2D_ELEM(*paddedFourier, i,j));
+                    // The CTF is computed once for all symmetries, the first time it is needed
+                    bool pendingCTF = hasCTF && !reprocessFlag;
+                    wModulator=1.0;
+
+                    // Loop over all symmetries
+                    for (size_t isym = 0; isym < symNo; ++isym)
                     {
-                        pthread_mutex_lock( &(parent->workLoadMutex) );
+                        // Corresponding index in the volume Fourier transform
+                        const double * real_position = &rowPositions[3 * (j * symNo + isym)];
+
+                        // Put a box around that coefficient
+                        XX(corner1)=CEIL (real_position[0]-blobRadius);
+                        YY(corner1)=CEIL (real_position[1]-blobRadius);
+                        ZZ(corner1)=CEIL (real_position[2]-blobRadius);
+                        XX(corner2)=FLOOR(real_position[0]+blobRadius);
+                        YY(corner2)=FLOOR(real_position[1]+blobRadius);
+                        ZZ(corner2)=FLOOR(real_position[2]+blobRadius);
+
+#ifdef DEBUG
 
-                        if ( parent->rowsProcessed == YSIZE(*paddedFourier) )
+                        std::cout << "Idx Img=(0," << i << "," << j << ") -> Idx Vol=("
+                        << real_position[0] << "," << real_position[1] << "," << real_position[2] << ")\n"
+                        << "   Corner1=" << corner1.transpose() << std::endl
+                        << "   Corner2=" << corner2.transpose() << std::endl;
+#endif
+                        // Squared distances to the blob center and wrapped
+                        // indexes along each axis of the box
+                        for (int intz = ZZ(corner1); intz <= ZZ(corner2); ++intz)
                         {
-                            pthread_mutex_unlock( &(parent->workLoadMutex) );
-                            breakCase = true;
-                            break;
+                            double z = intz - real_position[2];
+                            A1D_ELEM(z2precalculated,intz)=z*z;
+                            if (A1D_ELEM(zWrapped,intz)<0)
+                            {
+                                int iz, izneg;
+                                fastIntWRAP(iz, intz, 0, zsize_1);
+                                A1D_ELEM(zWrapped,intz)=iz;
+                                int miz=-iz;
+                                fastIntWRAP(izneg, miz,0,zsize_1);
+                                A1D_ELEM(zNegWrapped,intz)=izneg;
+                            }
                         }
-
-                        for (size_t w = 0 ; w < YSIZE(*paddedFourier) ; w++ )
+                        for (int inty = YY(corner1); inty <= YY(corner2); ++inty)
                         {
-                            if ( statusArray[w]==0 )
+                            double y = inty - real_position[1];
+                            A1D_ELEM(y2precalculated,inty)=y*y;
+                            if (A1D_ELEM(yWrapped,inty)<0)
                             {
-                                assigned = true;
-                                minAssignedRow = w;
-                                maxAssignedRow = w+minSeparation-1;
-
-                                if ( maxAssignedRow > (int)(YSIZE(*paddedFourier)-1) )
-                                    maxAssignedRow = YSIZE(*paddedFourier)-1;
-
-                                for ( int in = (minAssignedRow - minSeparation) ; in < (int)minAssignedRow ; in ++ )
-                                {
-                                    if ( ( in >= 0 ) && ( in < (int)YSIZE(*paddedFourier) ))
-                                    {
-                                        if ( statusArray[in] > -1 )
-                                            statusArray[in]++;
-                                    }
-                                }
-
-                                for ( int in = minAssignedRow ; in <= (int)maxAssignedRow ; in ++ )
-                                {
-                                    if ( ( in >= 0 ) && ( in < (int)YSIZE(*paddedFourier) ))
-                                    {
-                                        if ( statusArray[in] == 0 )
-                                        {
-                                            statusArray[in] = -1;
-                                            parent->rowsProcessed++;
-                                        }
-                                    }
-                                }
-
-                                for ( int in = maxAssignedRow+1 ; in <= (maxAssignedRow+minSeparation) ; in ++ )
-                                {
-                                    if ( ( in >= 0 ) && ( in < (int)YSIZE(*paddedFourier) ))
-                                    {
-                                        if ( statusArray[in] > -1 )
-                                            statusArray[in]++;
-                                    }
-                                }
-
-                                break;
+                                int iy, iyneg;
+                                fastIntWRAP(iy, inty, 0, zsize_1);
+                                A1D_ELEM(yWrapped,inty)=iy;
+                                int miy=-iy;
+                                fastIntWRAP(iyneg, miy,0,zsize_1);
+                                A1D_ELEM(yNegWrapped,inty)=iyneg;
+                            }
+                        }
+                        for (int intx = XX(corner1); intx <= XX(corner2); ++intx)
+                        {
+                            double x = intx - real_position[0];
+                            A1D_ELEM(x2precalculated,intx)=x*x;
+                            if (A1D_ELEM(xWrapped,intx)<0)
+                            {
+                                int ix, ixneg;
+                                fastIntWRAP(ix, intx, 0, zsize_1);
+                                A1D_ELEM(xWrapped,intx)=ix;
+                                int mix=-ix;
+                                fastIntWRAP(ixneg, mix,0,zsize_1);
+                                A1D_ELEM(xNegWrapped,intx)=ixneg;
                             }
                         }
 
-                        pthread_mutex_unlock( &(parent->workLoadMutex) );
-                    }
-                    while ( !assigned );
-
-                    if ( breakCase == true )
-                    {
-                        break;
-                    }
-
-                    Matrix2D<double> * A_SL = threadParams->symmetry;
-
-                    // Loop over all Fourier coefficients in the padded image
-                    Matrix1D<double> freq(3), gcurrent(3), real_position(3), contFreq(3);
-                    Matrix1D<int> corner1(3), corner2(3);
-
-                    // Some alias and calculations moved from heavy loops
-                    double wCTF=1, wModulator=1.0;
-                    double blobRadiusSquared = parent->blob.radius * parent->blob.radius;
-                    double iDeltaSqrt = parent->iDeltaSqrt;
-                    Matrix1D<double> & blobTableSqrt = parent->blobTableSqrt;
-                    int xsize_1 = XSIZE(parent->VoutFourier) - 1;
-                    int zsize_1 = ZSIZE(parent->VoutFourier) - 1;
-                    MultidimArray< std::complex<double> > &VoutFourier=parent->VoutFourier;
-                    MultidimArray<double> &fourierWeights = parent->FourierWeights;
-                    //                    MultidimArray<double> &prefourierWeights = parent->preFourierWeights;
-                    // Get i value for the thread
-                    for (int i = minAssignedRow; i <= maxAssignedRow ; i ++ )
-                    {
-                        // Discarded rows can be between minAssignedRow and maxAssignedRow, check
-                        if ( statusArray[i] == -1 )
-                            for (int j=STARTINGX(*paddedFourier); j<=FINISHINGX(*paddedFourier); j++)
+                        // Gather the voxels of the footprint that this thread
+                        // owns: their index in the volume, their squared
+                        // distance to the blob center and the sign of the
+                        // imaginary part (conjugated coefficients)
+                        size_t nFootprint = 0;
+                        for (int intz = ZZ(corner1); intz <= ZZ(corner2); ++intz)
+                        {
+                            double z2 = A1D_ELEM(z2precalculated,intz);
+                            int iz=A1D_ELEM(zWrapped,intz);
+                            int izneg=A1D_ELEM(zNegWrapped,intz);
+                            // Conjugated coefficients go to the plane izneg
+                            bool ownedPlane = zOwner[iz] == myThreadID;
+                            bool ownedNegPlane = zOwner[izneg] == myThreadID;
+                            if (!ownedPlane && !ownedNegPlane)
+                                continue;
+
+                            for (int inty = YY(corner1); inty <= YY(corner2); ++inty)
                             {
-                                // Compute the frequency of this coefficient in the
-                                // universal coordinate system
-                                FFT_IDX2DIGFREQ(j,XSIZE(parent->paddedImg),XX(freq));
-                                FFT_IDX2DIGFREQ(i,YSIZE(parent->paddedImg),YY(freq));
-                                ZZ(freq)=0;
-                                if (XX(freq)*XX(freq)+YY(freq)*YY(freq)>parent->maxResolution2)
+                                double y2z2 = A1D_ELEM(y2precalculated,inty) + z2;
+                                if (y2z2 > blobRadiusSquared)
                                     continue;
-                                wModulator=1.0;
-                                if (hasCTF && !reprocessFlag)
-                                {
-                                    XX(contFreq)=XX(freq)*iTs;
-                                    YY(contFreq)=YY(freq)*iTs;
-                                    threadParams->ctf.precomputeValues(XX(contFreq),YY(contFreq));
-                                    //wCTF=threadParams->ctf.getValueAt();
-                                    wCTF=threadParams->ctf.getValuePureNoKAt();
-                                    //wCTF=threadParams->ctf.getValuePureWithoutDampingAt();
-
-                                    if (std::isnan(wCTF))
-                                    {
-                                    	if (i==0 && j==0)
-                                    		wModulator=wCTF=1.0;
-                                    	else
-                                    		wModulator=wCTF=0.0;
-                                    }
-                                    if (fabs(wCTF)<parent->minCTF)
-                                    {
-                                        wModulator=fabs(wCTF);
-                                        wCTF=SGN(wCTF);
-                                    }
-                                    else
-                                        wCTF=1.0/wCTF;
-                                    if (parent->phaseFlipped)
-                                        wCTF=fabs(wCTF);
-                                }
-
-                                SPEED_UP_temps012;
-                                M3x3_BY_V3x1(freq,*A_SL,freq);
-
-                                // Look for the corresponding index in the volume Fourier transform
-                                DIGFREQ2FFT_IDX_DOUBLE(XX(freq),parent->volPadSizeX,XX(real_position));
-                                DIGFREQ2FFT_IDX_DOUBLE(YY(freq),parent->volPadSizeY,YY(real_position));
-                                DIGFREQ2FFT_IDX_DOUBLE(ZZ(freq),parent->volPadSizeZ,ZZ(real_position));
 
-                                // Put a box around that coefficient
-                                XX(corner1)=CEIL (XX(real_position)-parent->blob.radius);
-                                YY(corner1)=CEIL (YY(real_position)-parent->blob.radius);
-                                ZZ(corner1)=CEIL (ZZ(real_position)-parent->blob.radius);
-                                XX(corner2)=FLOOR(XX(real_position)+parent->blob.radius);
-                                YY(corner2)=FLOOR(YY(real_position)+parent->blob.radius);
-                                ZZ(corner2)=FLOOR(ZZ(real_position)+parent->blob.radius);
-
-#ifdef DEBUG
+                                // Part of this row inside the blob
+                                double dx = sqrt(blobRadiusSquared - y2z2);
+                                int xmin = XMIPP_MAX(XX(corner1), (int)CEIL(real_position[0] - dx));
+                                int xmax = XMIPP_MIN(XX(corner2), (int)FLOOR(real_position[0] + dx));
 
-                                std::cout << "Idx Img=(0," << i << "," << j << ") -> Freq Img=("
-                                << freq.transpose() << ") ->\n    Idx Vol=("
-                                << real_position.transpose() << ")\n"
-                                << "   Corner1=" << corner1.transpose() << std::endl
-                                << "   Corner2=" << corner2.transpose() << std::endl;
-#endif
-                                // Loop within the box
-                                double *ptrIn=(double *)&(A2D_ELEM(*paddedFourier, i,j));
-
-                                // Some precalculations
-                                for (int intz = ZZ(corner1); intz <= ZZ(corner2); ++intz)
-                                {
-                                    double z = intz - ZZ(real_position);
-                                    A1D_ELEM(z2precalculated,intz)=z*z;
-                                    if (A1D_ELEM(zWrapped,intz)<0)
-                                    {
-                                        int iz, izneg;
-                                        fastIntWRAP(iz, intz, 0, zsize_1);
-                                        A1D_ELEM(zWrapped,intz)=iz;
-                                        int miz=-iz;
-                                        fastIntWRAP(izneg, miz,0,zsize_1);
-                                        A1D_ELEM(zNegWrapped,intz)=izneg;
-                                    }
-                                }
-                                for (int inty = YY(corner1); inty <= YY(corner2); ++inty)
-                                {
-                                    double y = inty - YY(real_position);
-                                    A1D_ELEM(y2precalculated,inty)=y*y;
-                                    if (A1D_ELEM(yWrapped,inty)<0)
-                                    {
-                                        int iy, iyneg;
-                                        fastIntWRAP(iy, inty, 0, zsize_1);
-                                        A1D_ELEM(yWrapped,inty)=iy;
-                                        int miy=-iy;
-                                        fastIntWRAP(iyneg, miy,0,zsize_1);
-                                        A1D_ELEM(yNegWrapped,inty)=iyneg;
-                                    }
-                                }
-                                for (int intx = XX(corner1); intx <= XX(corner2); ++intx)
-                                {
-                                    double x = intx - XX(real_position);
-                                    A1D_ELEM(x2precalculated,intx)=x*x;
-                                    if (A1D_ELEM(xWrapped,intx)<0)
-                                    {
-                                        int ix, ixneg;
-                                        fastIntWRAP(ix, intx, 0, zsize_1);
-                                        A1D_ELEM(xWrapped,intx)=ix;
-                                        int mix=-ix;
-                                        fastIntWRAP(ixneg, mix,0,zsize_1);
-                                        A1D_ELEM(xNegWrapped,intx)=ixneg;
-                                    }
-                                }
+                                int iy=A1D_ELEM(yWrapped,inty);
+                                int iyneg=A1D_ELEM(yNegWrapped,inty);
+                                size_t size1=YXSIZE(fourierWeights)*(izneg)+((iyneg)*XSIZE(fourierWeights));
+                                size_t size2=YXSIZE(fourierWeights)*(iz)+((iy)*XSIZE(fourierWeights));
 
-                                // Actually compute
-                                for (int intz = ZZ(corner1); intz <= ZZ(corner2); ++intz)
+                                for (int intx = xmin; intx <= xmax; ++intx)
                                 {
-                                    double z2 = A1D_ELEM(z2precalculated,intz);
-                                    int iz=A1D_ELEM(zWrapped,intz);
-                                    int izneg=A1D_ELEM(zNegWrapped,intz);
-
-                                    for (int inty = YY(corner1); inty <= YY(corner2); ++inty)
-                                    {
-                                        double y2z2 = A1D_ELEM(y2precalculated,inty) + z2;
-                                        if (y2z2 > blobRadiusSquared)
-                                            continue;
-                                        int iy=A1D_ELEM(yWrapped,inty);
-                                        int iyneg=A1D_ELEM(yNegWrapped,inty);
-
-                                        int	size1=YXSIZE(VoutFourier)*(izneg)+((iyneg)*XSIZE(VoutFourier));
-                                        int	size2=YXSIZE(VoutFourier)*(iz)+((iy)*XSIZE(VoutFourier));
-                                        int	fixSize=0;
-
-                                        for (int intx = XX(corner1); intx <= XX(corner2); ++intx)
-                                        {
-                                            // Compute distance to the center of the blob
-                                            // Compute blob value at that distance
-                                            double d2 = A1D_ELEM(x2precalculated,intx) + y2z2;
-
-                                            if (d2 > blobRadiusSquared)
-                                                continue;
-                                            int aux = (int)(d2 * iDeltaSqrt + 0.5);//Same as ROUND but avoid comparison
-                                            double w = VEC_ELEM(blobTableSqrt, aux)*threadParams->weight *wModulator;
-
-                                            // Look for the location of this logical index
-                                            // in the physical layout
-#ifdef DEBUG
-
-                                            std::cout << "   gcurrent=" << gcurrent.transpose()
-                                            << " d=" << d << std::endl;
-                                            std::cout << "   1: intx=" << intx
-                                            << " inty=" << inty
-                                            << " intz=" << intz << std::endl;
-#endif
-
-                                            int ix=A1D_ELEM(xWrapped,intx);
-#ifdef DEBUG
-
-                                            std::cout << "   2: ix=" << ix << " iy=" << iy
-                                            << " iz=" << iz << std::endl;
-#endif
-
-                                            bool conjugate=false;
-                                            int izp, iyp, ixp;
-                                            if (ix > xsize_1)
-                                            {
-                                                izp = izneg;
-                                                iyp = iyneg;
-                                                ixp = A1D_ELEM(xNegWrapped,intx);
-                                                conjugate=true;
-                                                fixSize = size1;
-                                            }
-                                            else
-                                            {
-                                                izp=iz;
-                                                iyp=iy;
-                                                ixp=ix;
-                                                fixSize = size2;
-                                            }
-#ifdef DEBUG
-                                            std::cout << "   3: ix=" << ix << " iy=" << iy
-                                            << " iz=" << iz << " conj="
-                                            << conjugate << std::endl;
-#endif
-
-                                            // Add the weighted coefficient
-                                            if (reprocessFlag)
-                                            {
-                                                // Use VoutFourier as temporary to save the memory
-                                                double *ptrOut=(double *)&(DIRECT_A3D_ELEM(VoutFourier, izp,iyp,ixp));
-                                                DIRECT_A3D_ELEM(fourierWeights, izp,iyp,ixp) += (w * ptrOut[0]);
-                                            }
-                                            else
-                                            {
-                                                double wEffective=w*wCTF;
-                                                size_t memIdx=fixSize + ixp;//YXSIZE(VoutFourier)*(izp)+((iyp)*XSIZE(VoutFourier))+(ixp);
-                                                double *ptrOut=(double *)&(DIRECT_A1D_ELEM(VoutFourier, memIdx));
-                                                ptrOut[0] += wEffective * ptrIn[0];
-                                                DIRECT_A1D_ELEM(fourierWeights, memIdx) += w;
-
-                                                if (conjugate)
-                                                    ptrOut[1]-=wEffective*ptrIn[1];
-                                                else
-                                                    ptrOut[1]+=wEffective*ptrIn[1];
-                                            }
-                                        }
-                                    }
+                                    // Look for the location of this logical index
+                                    // in the physical layout
+                                    int ix=A1D_ELEM(xWrapped,intx);
+                                    bool conjugate=ix > xsize_1;
+                                    if (conjugate ? !ownedNegPlane : !ownedPlane)
+                                        continue;
+                                    footprintIdx[nFootprint] = conjugate ? size1 + A1D_ELEM(xNegWrapped,intx) : size2 + ix;
+                                    footprintDist2[nFootprint] = A1D_ELEM(x2precalculated,intx) + y2z2;
+                                    footprintSign[nFootprint] = conjugate ? -1.0 : 1.0;
+                                    ++nFootprint;
                                 }
                             }
-                    }
-
-                    pthread_mutex_lock( &(parent->workLoadMutex) );
+                        }
+                        if (nFootprint == 0)
+                            continue;
 
-                    for ( int w = (minAssignedRow - minSeparation) ; w < minAssignedRow ; w ++ )
-                    {
-                        if ( ( w >= 0 ) && ( w < (int)YSIZE(*paddedFourier) ))
+                        if (pendingCTF)
                         {
-                            if ( statusArray[w] > 0 )
+                            pendingCTF = false;
+                            XX(contFreq)=XX(freq)*iTs;
+                            YY(contFreq)=YY(freq)*iTs;
+                            threadParams->ctf.precomputeValues(XX(contFreq),YY(contFreq));
+                            //wCTF=threadParams->ctf.getValueAt();
+                            wCTF=threadParams->ctf.getValuePureNoKAt();
+                            //wCTF=threadParams->ctf.getValuePureWithoutDampingAt();
+
+                            if (std::isnan(wCTF))
                             {
-                                statusArray[w]--;
+                                if (i==0 && j==0)
+                                    wModulator=wCTF=1.0;
+                                else
+                                    wModulator=wCTF=0.0;
                             }
-                        }
-                    }
-
-                    for ( int w = maxAssignedRow+1 ; w <= (maxAssignedRow+minSeparation) ; w ++ )
-                    {
-                        if ( ( w >= 0 ) && ( w < (int)YSIZE(*paddedFourier) ))
-                        {
-                            if ( statusArray[w] > 0 )
+                            if (fabs(wCTF)<parent->minCTF)
                             {
-                                statusArray[w]--;
+                                wModulator=fabs(wCTF);
+                                wCTF=SGN(wCTF);
                             }
+                            else
+                                wCTF=1.0/wCTF;
+                            if (parent->phaseFlipped)
+                                wCTF=fabs(wCTF);
                         }
-                    }
+                        // Factor common to all the blob values of this coefficient
+                        double wFactor = threadParams->weight * wModulator;
 
-                    pthread_mutex_unlock( &(parent->workLoadMutex) );
+                        // Blob values of the whole footprint, this loop has
+                        // no branches and can be vectorized
+                        for (size_t n = 0; n < nFootprint; ++n)
+                        {
+                            int aux = (int)(footprintDist2[n] * iDeltaSqrt + 0.5);//Same as ROUND but avoid comparison
+                            aux = XMIPP_MIN(aux, blobTableLast);
+                            wBlob[n] = blobTableSqrt[aux] * wFactor;
+                        }
 
+                        // Add the weighted coefficient to the footprint. The
+                        // voxels are scattered in the volume, so these loops
+                        // are scalar.
+                        if (reprocessFlag)
+                        {
+                            // Use VoutFourier as temporary to save the memory
+                            if (accFloat)
+                                for (size_t n = 0; n < nFootprint; ++n)
+                                    weightsPtr[footprintIdx[n]] += wBlob[n] * accFloat[2*footprintIdx[n]];
+                            else
+                                for (size_t n = 0; n < nFootprint; ++n)
+                                    weightsPtr[footprintIdx[n]] += wBlob[n] * accDouble[2*footprintIdx[n]];
+                        }
+                        else
+                        {
+                            double re = wCTF*ptrIn[0];
+                            double im = wCTF*ptrIn[1];
+                            if (accFloat)
+                                for (size_t n = 0; n < nFootprint; ++n)
+                                {
+                                    size_t memIdx = footprintIdx[n];
+                                    double w = wBlob[n];
+                                    accFloat[2*memIdx] += w*re;
+                                    accFloat[2*memIdx+1] += w*im*footprintSign[n];
+                                    weightsPtr[memIdx] += w;
+                                }
+                            else
+                                for (size_t n = 0; n < nFootprint; ++n)
+                                {
+                                    size_t memIdx = footprintIdx[n];
+                                    double w = wBlob[n];
+                                    accDouble[2*memIdx] += w*re;
+                                    accDouble[2*memIdx+1] += w*im*footprintSign[n];
+                                    weightsPtr[memIdx] += w;
+                                }
+                        }
+                    }
                 }
-                while (!breakCase);
-                break;
             }
-        default:
             break;
         }
-
-        barrier_wait( barrier );
+    default:
+        break;
     }
-    while ( 1 );
 }
 
 //#define DEBUG
@@ -819,10 +900,14 @@ void ProgRecFourier::processImages( int firstImageIndex, int lastImageIndex, boo
 {
     MultidimArray< std::complex<double> > *paddedFourier;
 
-    int repaint = (int)ceil((double)SF.size()/60);
+    // The threads read SF at the same time, only safe from the column store
+    if (!SF.hasColumnStore())
+        REPORT_ERROR(ERR_MD, "ProgRecFourier: the selfile must be in memory before starting the threads");
+
+    // The progress is counted for the whole selfile, that may be processed in chunks
+    size_t repaint = XMIPP_MAX(1, (size_t)ceil((double)totalImages/60));
 
     bool processed;
-    int imgno = 0;
     int imgIndex = firstImageIndex;
 
     // This index tells when to save work for later FSC usage
@@ -834,8 +919,6 @@ void ProgRecFourier::processImages( int firstImageIndex, int lastImageIndex, boo
 
     do
     {
-        threadOpCode = PRELOAD_IMAGE;
-
         for ( int nt = 0 ; nt < numThreads ; nt ++ )
         {
             if ( imgIndex <= lastImageIndex )
@@ -850,17 +933,11 @@ void ProgRecFourier::processImages( int firstImageIndex, int lastImageIndex, boo
             }
         }
 
-        // Awaking sleeping threads
-        barrier_wait( &barrier );
         // here each thread is reading a different image and compute fft
-        // Threads are working now, wait for them to finish
-        // processing current projection
-        barrier_wait( &barrier );
+        awakeThreads(PRELOAD_IMAGE);
 
         // each threads have read a different image and now
         // all the thread will work in a different part of a single image.
-        threadOpCode = PROCESS_IMAGE;
-
         processed = false;
 
         for ( int nt = 0 ; nt < numThreads ; nt ++ )
@@ -870,8 +947,8 @@ void ProgRecFourier::processImages( int firstImageIndex, int lastImageIndex, boo
             else if ( th_args[nt].read == 1 )
             {
                 processed = true;
-                if (verbose && imgno++%repaint==0)
-                    progress_bar(imgno);
+                if (verbose && processedImages++%repaint==0)
+                    progress_bar(processedImages);
 
                 double weight = th_args[nt].localweight;
                 paddedFourier = th_args[nt].localPaddedFourier;
@@ -895,78 +972,51 @@ void ProgRecFourier::processImages( int firstImageIndex, int lastImageIndex, boo
 #endif
                 #undef DEBUG22
 
-                // Initialized just once
-                if ( statusArray == NULL )
-                {
-                    statusArray = (int *) malloc ( sizeof(int) * paddedFourier->ydim );
-                }
-
                 // Determine how many rows of the fourier
                 // transform are of interest for us. This is because
                 // the user can avoid to explore at certain resolutions
-                size_t conserveRows=(size_t)ceil((double)paddedFourier->ydim * maxResolution * 2.0);
+                conserveRows=(size_t)ceil((double)paddedFourier->ydim * maxResolution * 2.0);
                 conserveRows=(size_t)ceil((double)conserveRows/2.0);
 
-                // Loop over all symmetries
+                // Compute the coordinate axes of all the symmetrized projections,
+                // the threads loop over the symmetries for each coefficient
+                std::vector< Matrix2D<double> > A_SL(R_repository.size());
                 for (size_t isym = 0; isym < R_repository.size(); isym++)
-                {
-                    rowsProcessed = 0;
-
-                    // Compute the coordinate axes of the symmetrized projection
-                    Matrix2D<double> A_SL=R_repository[isym]*(*Ainv);
-
-                    // Fill the thread arguments for each thread
-                    for ( int th = 0 ; th < numThreads ; th ++ )
-                    {
-                        // Passing parameters to each thread
-                        th_args[th].symmetry = &A_SL;
-                        th_args[th].paddedFourier = paddedFourier;
-                        th_args[th].weight = weight;
-                        th_args[th].reprocessFlag = reprocessFlag;
-                    }
+                    A_SL[isym]=R_repository[isym]*(*Ainv);
 
-                    // Init status array
-                    for (size_t i = 0 ; i < paddedFourier->ydim ; i ++ )
-                    {
-                        if ( i >= conserveRows && i < (paddedFourier->ydim-conserveRows))
-                        {
-                            // -2 means "discarded"
-                            statusArray[i] = -2;
-                            rowsProcessed++;
-                        }
-                        else
-                        {
-                            statusArray[i] = 0;
-                        }
-                    }
+                // Fill the thread arguments for each thread
+                for ( int th = 0 ; th < numThreads ; th ++ )
+                {
+                    // Passing parameters to each thread
+                    th_args[th].symmetry = &A_SL;
+                    th_args[th].paddedFourier = paddedFourier;
+                    th_args[th].weight = weight;
+                    th_args[th].reprocessFlag = reprocessFlag;
+                }
 
-                    // Awaking sleeping threads
-                    barrier_wait( &barrier );
-                    // Threads are working now, wait for them to finish
-                    // processing current projection
-                    barrier_wait( &barrier );
+                // Threads are working now, wait for them to finish
+                // processing current projection
+                awakeThreads(PROCESS_IMAGE);
 
-                    //#define DEBUG2
+                //#define DEBUG2
 #ifdef DEBUG2
 
+                {
+                    static int ii=0;
+                    if(ii%1==0)
                     {
-                        static int ii=0;
-                        if(ii%1==0)
-                        {
-                            Image<double> save;
-                            save().alias( FourierWeights );
-                            save.write((std::string) integerToString(ii)  + "_1_Weights.vol");
+                        Image<double> save;
+                        save().alias( FourierWeights );
+                        save.write((std::string) integerToString(ii)  + "_1_Weights.vol");
 
-                            Image< std::complex<double> > save2;
-                            save2().alias( VoutFourier );
-                            save2.write((std::string) integerToString(ii)  + "_1_Fourier.vol");
-                        }
-                        ii++;
+                        Image< std::complex<double> > save2;
+                        save2().alias( VoutFourier );
+                        save2.write((std::string) integerToString(ii)  + "_1_Fourier.vol");
                     }
-#endif
-                    #undef DEBUG2
-
+                    ii++;
                 }
+#endif
+                #undef DEBUG2
 
                 if ( current_index == FSCIndex && saveFSC )
                 {
@@ -1034,6 +1084,15 @@ void ProgRecFourier::processImages( int firstImageIndex, int lastImageIndex, boo
 }
 
 void ProgRecFourier::correctWeight()
+{
+    if (streamChunk > 0)
+        correctWeight(VoutFourierFloat);
+    else
+        correctWeight(VoutFourier);
+}
+
+template<typename T>
+void ProgRecFourier::correctWeight(MultidimArray< std::complex<T> > &accumulator)
 {
     // If NiterWeight=0 then set the weights to one
 	forceWeightSymmetry(FourierWeights);
@@ -1046,13 +1105,13 @@ void ProgRecFourier::correctWeight()
     else
     {
         // Temporary save the Fourier of the volume
-        MultidimArray< std::complex<double> > VoutFourierTmp;
-        VoutFourierTmp=VoutFourier;
+        MultidimArray< std::complex<T> > accumulatorTmp;
+        accumulatorTmp=accumulator;
         forceWeightSymmetry(FourierWeights);
-        // Prepare the VoutFourier
-        FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY3D(VoutFourier)
+        // Prepare the accumulator
+        FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY3D(accumulator)
         {
-            double *ptrOut=(double *)&(DIRECT_A3D_ELEM(VoutFourier, k,i,j));
+            T *ptrOut=(T *)&(DIRECT_A3D_ELEM(accumulator, k,i,j));
             if (fabs(A3D_ELEM(FourierWeights,k,i,j))>1e-3)
                 ptrOut[0] = 1.0/DIRECT_A3D_ELEM(FourierWeights, k,i,j);
         }
@@ -1061,22 +1120,22 @@ void ProgRecFourier::correctWeight()
         {
             FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY3D(FourierWeights)
             A3D_ELEM(FourierWeights,k,i,j)=0;
-            processImages(0, SF.size() - 1, !fn_fsc.empty(), true);
+            processSelFile(true);
             forceWeightSymmetry(FourierWeights);
-            FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY3D(VoutFourier)
+            FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY3D(accumulator)
             {
-                double *ptrOut=(double *)&(DIRECT_A3D_ELEM(VoutFourier, k,i,j));
+                T *ptrOut=(T *)&(DIRECT_A3D_ELEM(accumulator, k,i,j));
                 if (fabs(A3D_ELEM(FourierWeights,k,i,j))>1e-3)
                     ptrOut[0] /= A3D_ELEM(FourierWeights,k,i,j);
             }
         }
-        FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY3D(VoutFourier)
+        FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY3D(accumulator)
         {
-            // Put back the weights to FourierWeights from temporary variable VoutFourier
-            double *ptrOut=(double *)&(DIRECT_A3D_ELEM(VoutFourier, k,i,j));
+            // Put back the weights to FourierWeights from temporary variable accumulator
+            T *ptrOut=(T *)&(DIRECT_A3D_ELEM(accumulator, k,i,j));
             A3D_ELEM(FourierWeights,k,i,j) = ptrOut[0];
         }
-        VoutFourier = VoutFourierTmp;
+        accumulator = accumulatorTmp;
     }
 }
 
@@ -1097,9 +1156,18 @@ void ProgRecFourier::finishComputations( const FileName &out_name )
 
     // Enforce symmetry in the Fourier values as well as the weights
     // Sjors 19aug10 enforceHermitianSymmetry first checks ndim...
-    Vout().initZeros(volPadSizeZ,volPadSizeY,volPadSizeX);
-    transformerVol.setReal(Vout());
-    transformerVol.enforceHermitianSymmetry();
+    if (streamChunk > 0)
+    {
+        VoutFloat().initZeros(volPadSizeZ,volPadSizeY,volPadSizeX);
+        transformerVolFloat.setReal(VoutFloat());
+        transformerVolFloat.enforceHermitianSymmetry();
+    }
+    else
+    {
+        Vout().initZeros(volPadSizeZ,volPadSizeY,volPadSizeX);
+        transformerVol.setReal(Vout());
+        transformerVol.enforceHermitianSymmetry();
+    }
     //forceWeightSymmetry(preFourierWeights);
 
     // Tell threads what to do
@@ -1116,24 +1184,35 @@ void ProgRecFourier::finishComputations( const FileName &out_name )
         save2.write((std::string) fn_out + "hermiticFourierVol.vol");
     }
 #endif
-    threadOpCode = PROCESS_WEIGHTS;
-    // Awake threads
-    barrier_wait( &barrier );
-    // Threads are working now, wait for them to finish
-    barrier_wait( &barrier );
+    awakeThreads(PROCESS_WEIGHTS);
 
-    transformerVol.inverseFourierTransform();
-    CenterFFT(Vout(),false);
+    if (streamChunk > 0)
+    {
+        transformerVolFloat.inverseFourierTransform();
+        correctBlob(VoutFloat());
+        VoutFloat.write(out_name);
+    }
+    else
+    {
+        transformerVol.inverseFourierTransform();
+        correctBlob(Vout());
+        Vout.write(out_name);
+    }
+}
+
+template<typename T>
+void ProgRecFourier::correctBlob(MultidimArray<T> &mVout)
+{
+    CenterFFT(mVout,false);
 
     // Correct by the Fourier transform of the blob
-    Vout().setXmippOrigin();
-    Vout().selfWindow(FIRST_XMIPP_INDEX(imgSize),FIRST_XMIPP_INDEX(imgSize),
-                      FIRST_XMIPP_INDEX(imgSize),LAST_XMIPP_INDEX(imgSize),
-                      LAST_XMIPP_INDEX(imgSize),LAST_XMIPP_INDEX(imgSize));
+    mVout.setXmippOrigin();
+    mVout.selfWindow(FIRST_XMIPP_INDEX(imgSize),FIRST_XMIPP_INDEX(imgSize),
+                     FIRST_XMIPP_INDEX(imgSize),LAST_XMIPP_INDEX(imgSize),
+                     LAST_XMIPP_INDEX(imgSize),LAST_XMIPP_INDEX(imgSize));
     double pad_relation= ((double)padding_factor_proj/padding_factor_vol);
     pad_relation = (pad_relation * pad_relation * pad_relation);
 
-    MultidimArray<double> &mVout=Vout();
     double ipad_relation=1.0/pad_relation;
     double meanFactor2=0;
     FOR_ALL_ELEMENTS_IN_ARRAY3D(mVout)
@@ -1156,7 +1235,6 @@ void ProgRecFourier::finishComputations( const FileName &out_name )
         FOR_ALL_ELEMENTS_IN_ARRAY3D(mVout)
         A3D_ELEM(mVout,k,i,j) *= meanFactor2;
     }
-    Vout.write(out_name);
 }
 
 void ProgRecFourier::setIO(const FileName &fn_in, const FileName &fn_out)
@@ -1165,6 +1243,14 @@ void ProgRecFourier::setIO(const FileName &fn_in, const FileName &fn_out)
     this->fn_out = fn_out;
 }
 
+void ProgRecFourier::setInputImages(const MetaData &md, const std::vector< Image<double> > &images)
+{
+    if (images.empty())
+        REPORT_ERROR(ERR_ARG_INCORRECT, "ProgRecFourier: there are no input images");
+    SF = md;
+    inputImages = &images;
+}
+
 void ProgRecFourier::forceWeightSymmetry(MultidimArray<double> &FourierWeights)
 {
     int yHalf=YSIZE(FourierWeights)/2;
@@ -54,7 +54,6 @@
 #define MINIMUMWEIGHT 0.001
 #define ACCURACY 0.001
 
-#define EXIT_THREAD 0
 #define PROCESS_IMAGE 1
 #define PROCESS_WEIGHTS 2
 #define PRELOAD_IMAGE 3
@@ -66,21 +65,46 @@ class ProgRecFourier;
 
 // static pthread_mutex_t mutexDocFile= PTHREAD_MUTEX_INITIALIZER;
 
+/** Buffers of a thread, kept from one image to the next */
+struct ImageThreadBuffers
+{
+    bool hasCTF;
+    Matrix2D<double> localA, localAinv;
+    MultidimArray< std::complex<double> > localPaddedFourier;
+    MultidimArray<double> localPaddedImg;
+    FourierTransformer localTransformerImg;
+    // Wrapped indexes of the logical indexes of the volume
+    MultidimArray<int> zWrapped, yWrapped, xWrapped, zNegWrapped, yNegWrapped, xNegWrapped;
+    // Squared distances to the center of the blob
+    MultidimArray<double> x2precalculated, y2precalculated, z2precalculated;
+    // Voxels of the footprint of a coefficient: blob values, squared
+    // distances to the center, indexes in the volume and sign of the
+    // imaginary part
+    std::vector<double> blobWeights, footprintDist2, footprintSign;
+    std::vector<size_t> footprintIdx;
+    // Positions in the volume of a row of the image for all the symmetries
+    std::vector<double> rowPositions;
+
+    /// Allocate the buffers for the volume size and blob of the program
+    void initialize(const ProgRecFourier &parent, const MetaData &selFile);
+};
+
 struct ImageThreadParams
 {
-    int myThreadID;
+    int myThreadID; // Slot of the thread, it owns the planes of the volume with this zOwner
+    ImageThreadBuffers buffers;
     ProgRecFourier * parent;
     MultidimArray< std::complex<double> > *paddedFourier;
     MultidimArray< std::complex<double> > *localPaddedFourier;
     CTFDescription ctf;
-    Matrix2D<double> * symmetry;
+    std::vector< Matrix2D<double> > * symmetry; // Projection axes for all the symmetries
     int read;
     Matrix2D<double> * localAInv;
     int imageIndex;
     double weight;
     double localweight;
     bool reprocessFlag;
-    MetaData * selFile;
+    MetaData * selFile; // Shared by all threads, only read
 };
 
 /** Fourier reconstruction parameters. */
@@ -93,6 +117,11 @@ public:
     /** SelFile containing all projections */
     MetaData SF;
 
+    /** Images of SF kept in memory, NULL if they are read from disk.
+     * The image of each row of SF is the one in the position MDL_REF-1.
+     */
+    const std::vector< Image<double> > * inputImages;
+
     /** Flag whether to use the weights in the image metadata */
     bool do_weights;
 
@@ -122,14 +151,20 @@ public:
     /// Max resolution in Angstroms
     double maxResolution;
 
+    /** Images read at a time in streaming mode, 0 if not streaming.
+     * In streaming mode the Fourier volume is accumulated in single
+     * precision, the weights still in double.
+     */
+    size_t streamChunk;
+
     /// Number of iterations for the weight
     int NiterWeight;
 
     /// Number of threads to use in parallel to process a single image
     int numThreads;
 
-    /// IDs for the threads
-    pthread_t * th_ids;
+    /// Pool of threads, created once for the whole reconstruction
+    ThreadPool * pool;
 
     /// Contains parameters passed to each thread
     ImageThreadParams * th_args;
@@ -137,23 +172,17 @@ public:
     /// Tells the threads what to do next
     int threadOpCode;
 
-    /// Number of rows already processed on an image
-    size_t rowsProcessed;
-
     /// Defines what a thread should do
-    static void * processImageThread( void * threadArgs );
-
-    /// Controls mutual exclusion on critical zones of code
-    pthread_mutex_t workLoadMutex;
+    static void processImageThread( ImageThreadParams * threadParams );
 
-    /// To create a barrier synchronization for threads
-    barrier_t barrier;
+    /// Minimum number of volume planes in the slabs owned by the threads
+    int thrWidth;
 
-    /// A status array for each row in an image (processing, processed,etc..)
-    int * statusArray;
+    /// Thread that adds the coefficients of each plane (Z) of the Fourier volume
+    std::vector<int> zOwner;
 
-    /// How many image rows are processed at a time by a single thread.
-    int thrWidth;
+    /// Number of image rows at each side of the Fourier transform below the maximum resolution
+    size_t conserveRows;
 
 public: // Internal members
     // Size of the original images
@@ -201,7 +230,27 @@ public: // Internal members
     // Output volume
     Image<double> Vout;
 
+    // Single precision volume, its transform and transformer, used when streaming
+    Image<float> VoutFloat;
+    MultidimArray< std::complex<float> > VoutFourierFloat;
+    FourierTransformerFloat transformerVolFloat;
+
+    // The selfile is read in chunks of streamChunk images
+    bool streamSelFile;
+
+    // Number of images in the selfile
+    size_t totalImages;
+
+    // Images processed since the progress bar was started
+    size_t processedImages;
+
+    // Identifiers of the images in SF
+    std::vector<size_t> objIds;
+
 public:
+    /// Empty constructor
+    ProgRecFourier();
+
     /// Read arguments from command line
     void readParams();
 
@@ -219,17 +268,51 @@ public:
 
     void finishComputations( const FileName &out_name );
 
+    /// Create the threads and their parameters
+    void createThreads();
+
+    /// Exit threads and free memory
+    void destroyThreads();
+
+    /** Run the operation for all the threads and wait until all are done.
+     * Each of the numThreads parameters th_args is processed once.
+     */
+    void awakeThreads(int opCode);
+
+    /// Correct the real volume by the Fourier transform of the blob
+    template<typename T>
+    void correctBlob(MultidimArray<T> &mVout);
+
+    /** Read the selfile into SF.
+     * When streaming only streamChunk images are read, from firstImage.
+     */
+    void readSelFile(size_t firstImage);
+
+    /// Process all the images of the selfile, chunk by chunk when streaming
+    void processSelFile(bool reprocessFlag);
+
     /// Process one image
     void processImages( int firstImageIndex, int lastImageIndex, bool saveFSC=false, bool reprocessFlag=false);
 
     /// Method for the correction of the fourier coefficients
     void correctWeight();
+
+    /// Correction of the weights for an accumulator of the given precision
+    template<typename T>
+    void correctWeight(MultidimArray< std::complex<T> > &accumulator);
 	
 	/// Force the weights to be symmetrized
     void forceWeightSymmetry(MultidimArray<double> &FourierWeights);
 
     ///Functions of common reconstruction interface
     virtual void setIO(const FileName &fn_in, const FileName &fn_out);
+
+    /** Reconstruct from images in memory instead of the input selfile.
+     * The metadata gives the angles and weights of the images, and the
+     * position of each one in images with MDL_REF, from 1.
+     * The images must not be released until the reconstruction is done.
+     */
+    void setInputImages(const MetaData &md, const std::vector< Image<double> > &images);
 };
 //@}
 #endif
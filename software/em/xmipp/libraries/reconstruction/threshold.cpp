@@ -52,6 +52,7 @@ void ProgThreshold::defineParams()
 {
     addUsageLine("Threshold volumes and images ");
     each_image_produces_an_output=true;
+    allow_io_threads=true;
     XmippMetadataProgram::defineParams();
     addSeeAlsoLine("transform_mask, transform_morphology");
     addParamsLine("   --select <mode>                        : Select pixels meeting");
@@ -96,7 +97,7 @@ void ProgThreshold::show()
 void ProgThreshold::processImage(const FileName &fnImg, const FileName &fnImgOut, const MDRow &rowIn, MDRow &rowOut)
 {
     Image<double> I;
-    I.read(fnImg);
+    readImage(fnImg, I);
     MultidimArray<double> &mI=I();
 
     // Compute substitute value
@@ -181,5 +182,5 @@ void ProgThreshold::processImage(const FileName &fnImg, const FileName &fnImgOut
     }
 
     // Write result
-    I.write(fnImgOut);
+    writeImage(I, fnImgOut);
 }